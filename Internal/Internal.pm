@@ -11,6 +11,47 @@ $VERSION = '0.1';
 
 bootstrap Fingerprint::Rabin::Internal $VERSION;
 
-@EXPORT_OK = qw(fp_buffer fp_compare fp_hash fp_combine fp_init fp_free);
+@EXPORT_OK = qw(fp_buffer fp_buffers fp_compare fp_hash fp_combine fp_init
+	       fp_free fp_basis_new fp_basis_random fp_basis_poly fp_buffer_basis
+	       fp_basis_free fp_matcher_new fp_matcher_scan fp_matcher_reset
+	       fp_matcher_free fp_sketch_new fp_sketch_update fp_sketch_values
+	       fp_sketch_jaccard fp_sketch_reset fp_sketch_free fp_simhash
+	       fp_simhash_distance fp_simhash_index_new fp_simhash_index_add
+	       fp_simhash_index_query fp_simhash_index_size fp_simhash_index_free
+	       fp_index_open fp_index_add fp_index_lookup fp_index_flush
+	       fp_index_compact fp_index_count fp_index_close fp_to_binary
+	       fp_from_binary fp_to_hex fp_from_hex fp_to_base32 fp_from_base32
+	       fp_set_new fp_set_contains fp_set_size fp_set_bytes fp_set_values
+	       fp_set_intersect fp_set_free fp_pool_new fp_pool_add_buffer
+	       fp_pool_add_file fp_pool_wait fp_pool_poll fp_pool_cancel
+	       fp_pool_pending fp_pool_free fp_range fp_range_basis fp_concat
+	       fp_concat_basis fp_layer_fingerprint fp_layer_reset fp_cache_new
+	       fp_cache_get fp_cache_put fp_cache_remove fp_cache_clear
+	       fp_cache_count fp_cache_bytes fp_cache_stats fp_cache_free
+	       fp_prefix_new fp_prefix_range fp_prefix_size fp_prefix_free
+	       fp_update_range fp128_buffer fp128_compare fp128_combine
+	       fp128_hash fp128_halves fp_ctx_new fp_ctx_update fp_ctx_final
+	       fp_ctx_length fp_ctx_save fp_ctx_restore fp_ctx_free
+	       fp_layer_save fp_layer_restore fp_chunker_new fp_chunker_split
+	       fp_chunker_free fp_store_open fp_store_put fp_store_get
+	       fp_store_ref fp_store_unref fp_store_flush fp_store_compact
+	       fp_store_stats fp_store_close fp_signature fp_delta fp_patch
+	       fp_deep fp_buffer_cached);
+
+# The handles below point to memory owned by the thread which made
+# them, so they are not copied into new threads, which see references
+# to undef in their place.  Fingerprints themselves are plain strings,
+# and are copied.  A cache, which has locks of its own, is shared by
+# all threads, and must be freed once, after they have finished with
+# it.
+
+foreach my $class (qw(fingerprint_basis_tPtr fingerprint_matcher_tPtr
+		      fingerprint_sketch_tPtr fingerprint_simhash_index_tPtr
+		      fingerprint_index_tPtr fingerprint_set_tPtr
+		      fingerprint_pool_tPtr fingerprint_prefix_tPtr
+		      fingerprint_ctx_tPtr fingerprint_chunker_tPtr
+		      fingerprint_store_tPtr fingerprint_store_viewPtr)) {
+	*{"${class}::CLONE_SKIP"} = sub { 1 };
+}
 
 return 1;
@@ -1,87 +1,2730 @@
 #include "EXTERN.h"
 #include "perl.h"
 #include "XSUB.h"
+#include "perliol.h"
 #include "rabin64.h"
+#include "match.h"
+#include "sketch.h"
+#include "simhash.h"
+#include "fpindex.h"
+#include "codec.h"
+#include "fpset.h"
+#include "pool.h"
+#include "cache.h"
+#include "iov.h"
+#include "chunk.h"
+#include "store.h"
+#include "delta.h"
+
+/* The pairs of numbers returned by fp_matcher_scan and
+   fp_simhash_index_query.  */
+
+typedef struct fp_hits_t {
+	IV  *item;
+	int  count;
+	int  size;
+} fp_hits_t;
+
+static void
+fp_add_pair(fp_hits_t *hits, IV a, IV b)
+{
+	if (hits->count + 2 > hits->size) {
+		hits->size = hits->size ? 2 * hits->size : 64;
+		Renew(hits->item, hits->size, IV);
+	}
+	hits->item[hits->count++] = a;
+	hits->item[hits->count++] = b;
+}
+
+static void
+fp_add_hit(void *arg, int pattern, unsigned long offset)
+{
+	fp_add_pair((fp_hits_t *) arg, pattern, (IV) offset);
+}
+
+static void
+fp_add_near(void *arg, unsigned long id, int distance)
+{
+	fp_add_pair((fp_hits_t *) arg, (IV) id, distance);
+}
+
+/* Copy the 8-byte string SV to *SIG, or croak on behalf of FUNC.  */
+
+static void
+fp_sv_to_sig(SV *sv, fingerprint_t *sig, const char *func)
+{
+	char   *text;
+	STRLEN  text_len;
+
+	text = (char *) SvPV(sv, text_len);
+	if (text_len != sizeof(fingerprint_t))
+		croak("%s: signature must be %d bytes", func,
+		      (int) sizeof(fingerprint_t));
+	memcpy(FINGERPRINT_BYTE(*sig), text, sizeof(fingerprint_t));
+}
+
+/* Fingerprint objects are references, blessed into fingerprint_tPtr,
+   to strings holding the bytes of the fingerprint, so that Perl owns
+   their memory and copies them safely into new threads.  */
+
+/* Return a new fingerprint object holding FP.  */
+
+static SV *
+fp_new_sv(fingerprint_t fp)
+{
+	return sv_setref_pvn(newSV(0), "fingerprint_tPtr",
+			     (char *) FINGERPRINT_BYTE(fp),
+			     sizeof(fingerprint_t));
+}
+
+/* Return the fingerprint held by the object SV, or croak on behalf of
+   FUNC that its argument NAME is not a fingerprint.  */
+
+static fingerprint_t *
+fp_sv_fingerprint(SV *sv, const char *func, const char *name)
+{
+	SV *obj;
+
+	if (SvROK(sv) && sv_derived_from(sv, "fingerprint_tPtr")) {
+		obj = SvRV(sv);
+		if (SvPOK(obj) && SvCUR(obj) == sizeof(fingerprint_t))
+			return (fingerprint_t *) SvPVX(obj);
+	}
+	croak("%s: %s is not a fingerprint", func, name);
+	return NULL;
+}
+
+/* 128-bit fingerprint objects are the same, blessed into
+   fingerprint128_tPtr.  */
+
+/* Return a new 128-bit fingerprint object holding FP.  */
+
+static SV *
+fp128_new_sv(fingerprint128_t fp)
+{
+	return sv_setref_pvn(newSV(0), "fingerprint128_tPtr", (char *) &fp,
+			     sizeof(fingerprint128_t));
+}
+
+/* Return the 128-bit fingerprint held by the object SV, or croak on
+   behalf of FUNC that its argument NAME is not one.  */
+
+static fingerprint128_t *
+fp128_sv_fingerprint(SV *sv, const char *func, const char *name)
+{
+	SV *obj;
+
+	if (SvROK(sv) && sv_derived_from(sv, "fingerprint128_tPtr")) {
+		obj = SvRV(sv);
+		if (SvPOK(obj) && SvCUR(obj) == sizeof(fingerprint128_t))
+			return (fingerprint128_t *) SvPVX(obj);
+	}
+	croak("%s: %s is not a 128-bit fingerprint", func, name);
+	return NULL;
+}
+
+/* The most bytes given to fingerprint_ctx_update at once.  */
+
+#define FP_CHUNK 0x40000000
+
+/* Append the LEN bytes of TEXT to CTX.  */
+
+static void
+fp_ctx_add(fingerprint_ctx_t *ctx, const char *text, STRLEN len)
+{
+	STRLEN n;
+
+	while (len > 0) {
+		n = len < FP_CHUNK ? len : FP_CHUNK;
+		fingerprint_ctx_update(ctx, text, (int) n);
+		text += n;
+		len -= n;
+	}
+}
+
+/* Store in *START and *N the range of a string of SIZE bytes that
+   starts at OFFSET, which counts from the end if negative, and runs for
+   LENGTH bytes, or to the end if LENGTH is undefined; or croak on
+   behalf of FUNC if the range is not all in the string.  */
+
+static void
+fp_resolve_range(STRLEN size, IV offset, SV *length, const char *func,
+		 STRLEN *start, STRLEN *n)
+{
+	IV len;
+
+	if (offset < 0)
+		offset += (IV) size;
+	if (offset < 0 || (STRLEN) offset > size)
+		croak("%s: offset outside string", func);
+	if (length == NULL || !SvOK(length))
+		len = (IV) (size - (STRLEN) offset);
+	else {
+		len = SvIV(length);
+		if (len < 0 || (STRLEN) len > size - (STRLEN) offset)
+			croak("%s: length outside string", func);
+	}
+	*start = (STRLEN) offset;
+	*n = (STRLEN) len;
+}
+
+/* Return the fingerprint with respect to BASIS of the bytes of BUFFER
+   in the range given by OFFSET and LENGTH, as for fp_resolve_range, or
+   croak on behalf of FUNC.  The bytes are read in place.  */
+
+static fingerprint_t
+fp_range_fingerprint(const fingerprint_basis_t *basis, SV *buffer,
+		     IV offset, SV *length, const char *func)
+{
+	fingerprint_ctx_t  ctx;
+	const char        *text;
+	STRLEN             text_len;
+	STRLEN             start;
+	STRLEN             n;
+
+	text = SvPV_const(buffer, text_len);
+	fp_resolve_range(text_len, offset, length, func, &start, &n);
+
+	if (n < FP_CHUNK)
+		return fingerprint_basis_from_buffer(basis, text + start,
+						     (int) n);
+	fingerprint_ctx_init(&ctx, basis);
+	fp_ctx_add(&ctx, text + start, n);
+	return fingerprint_ctx_final(&ctx);
+}
+
+/* Return the fingerprint with respect to BASIS of the N strings ARG
+   taken as one text, without joining them.  */
+
+static fingerprint_t
+fp_concat_fingerprint(const fingerprint_basis_t *basis, SV **arg, int n)
+{
+	fingerprint_ctx_t  ctx;
+	const char        *text;
+	STRLEN             text_len;
+	int                i;
+
+	fingerprint_ctx_init(&ctx, basis);
+	for (i = 0; i < n; i++) {
+		text = SvPV_const(arg[i], text_len);
+		fp_ctx_add(&ctx, text, text_len);
+	}
+	return fingerprint_ctx_final(&ctx);
+}
+
+#ifdef PERLIO_LAYERS
+/* The :fingerprint layer is the buffering layer :perlio, which also
+   fingerprints, with the default basis, the bytes read through it as
+   they are consumed and the bytes written through it as they are
+   flushed.  MARK is the start of the bytes of a read buffer consumed
+   but not yet fingerprinted, or NULL if there are none.  */
+
+typedef struct fp_layer_t {
+	PerlIOBuf          base;
+	fingerprint_ctx_t  ctx;
+	STDCHAR           *mark;
+} fp_layer_t;
+
+/* Fingerprint the bytes of the buffer of F which have been consumed or
+   written into CTX, which need not be the context of F.  */
+
+static void
+fp_layer_pending(PerlIO *f, fingerprint_ctx_t *ctx)
+{
+	fp_layer_t *l = PerlIOSelf(f, fp_layer_t);
+	U32         flags = PerlIOBase(f)->flags;
+
+	if ((flags & PERLIO_F_WRBUF) && l->base.ptr > l->base.buf)
+		fp_ctx_add(ctx, (const char *) l->base.buf,
+			   (STRLEN) (l->base.ptr - l->base.buf));
+	else if ((flags & PERLIO_F_RDBUF) && l->mark
+		 && l->base.ptr > l->mark)
+		fp_ctx_add(ctx, (const char *) l->mark,
+			   (STRLEN) (l->base.ptr - l->mark));
+}
+
+static IV
+fp_layer_pushed(pTHX_ PerlIO *f, const char *mode, SV *arg,
+		PerlIO_funcs *tab)
+{
+	fp_layer_t *l = PerlIOSelf(f, fp_layer_t);
+
+	fingerprint_ctx_init(&l->ctx, NULL);
+	l->mark = NULL;
+	return PerlIOBuf_pushed(aTHX_ f, mode, arg, tab);
+}
+
+static PerlIO *
+fp_layer_dup(pTHX_ PerlIO *f, PerlIO *o, CLONE_PARAMS *param, int flags)
+{
+	fp_layer_t *l;
+
+	f = PerlIOBuf_dup(aTHX_ f, o, param, flags);
+	if (f) {
+		l = PerlIOSelf(f, fp_layer_t);
+		l->ctx = PerlIOSelf(o, fp_layer_t)->ctx;
+		l->mark = NULL;
+	}
+	return f;
+}
+
+static IV
+fp_layer_flush(pTHX_ PerlIO *f)
+{
+	fp_layer_t *l = PerlIOSelf(f, fp_layer_t);
+	IV          code;
+
+	fp_layer_pending(f, &l->ctx);
+	code = PerlIOBuf_flush(aTHX_ f);
+
+	/* A read buffer is kept if the layer below cannot seek back over
+	   the bytes not yet consumed.  */
+	l->mark = (PerlIOBase(f)->flags & PERLIO_F_RDBUF) ? l->base.ptr : NULL;
+	return code;
+}
+
+static IV
+fp_layer_fill(pTHX_ PerlIO *f)
+{
+	fp_layer_t *l = PerlIOSelf(f, fp_layer_t);
+	IV          code;
+
+	code = PerlIOBuf_fill(aTHX_ f);
+	if (code == 0)
+		l->mark = l->base.ptr;
+	return code;
+}
+
+static PERLIO_FUNCS_DECL(fp_layer_funcs) = {
+	sizeof(PerlIO_funcs),
+	"fingerprint",
+	sizeof(fp_layer_t),
+	PERLIO_K_BUFFERED | PERLIO_K_RAW,
+	fp_layer_pushed,
+	PerlIOBuf_popped,
+	PerlIOBuf_open,
+	PerlIOBase_binmode,
+	NULL,
+	PerlIOBase_fileno,
+	fp_layer_dup,
+	PerlIOBuf_read,
+	PerlIOBuf_unread,
+	PerlIOBuf_write,
+	PerlIOBuf_seek,
+	PerlIOBuf_tell,
+	PerlIOBuf_close,
+	fp_layer_flush,
+	fp_layer_fill,
+	PerlIOBase_eof,
+	PerlIOBase_error,
+	PerlIOBase_clearerr,
+	PerlIOBase_setlinebuf,
+	PerlIOBuf_get_base,
+	PerlIOBuf_bufsiz,
+	PerlIOBuf_get_ptr,
+	PerlIOBuf_get_cnt,
+	PerlIOBuf_set_ptrcnt,
+};
+
+/* Return the topmost :fingerprint layer of F, or croak on behalf of
+   FUNC if there is none.  */
+
+static PerlIO *
+fp_layer_find(pTHX_ PerlIO *f, const char *func)
+{
+	for (; PerlIOValid(f); f = PerlIONext(f))
+		if (PerlIOBase(f)->tab == PERLIO_FUNCS_CAST(&fp_layer_funcs))
+			return f;
+	croak("%s: handle has no :fingerprint layer", func);
+	return NULL;
+}
+#endif /* PERLIO_LAYERS */
+
+/* The encoders and decoders of codec.h, as used by fp_encode and
+   fp_decode.  */
+
+typedef void (*fp_encode_fn_t)(const fingerprint_t *, int, char *);
+typedef int (*fp_decode_fn_t)(const char *, int, fingerprint_t *);
+
+static int
+fp_from_binary(const char *in, int n, fingerprint_t *out)
+{
+	fingerprint_from_binary(in, n, out);
+	return 1;
+}
+
+/* Return a new string holding the N fingerprint objects ARG, each
+   converted by ENCODE to SIZE characters, or croak on behalf of
+   FUNC.  */
+
+static SV *
+fp_encode(SV **arg, int n, fp_encode_fn_t encode, int size,
+	  const char *func)
+{
+	fingerprint_t *tmp;
+	SV            *sv;
+	int            i;
+
+	for (i = 0; i < n; i++)
+		fp_sv_fingerprint(arg[i], func, "argument");
+
+	New(0, tmp, n ? n : 1, fingerprint_t);
+	for (i = 0; i < n; i++)
+		tmp[i] = *fp_sv_fingerprint(arg[i], func, "argument");
+
+	sv = newSV((STRLEN) n * size + 1);
+	SvPOK_on(sv);
+	encode(tmp, n, SvPVX(sv));
+	SvCUR_set(sv, (STRLEN) n * size);
+	*SvEND(sv) = '\0';
+
+	Safefree(tmp);
+	return sv;
+}
+
+/* Convert the string SV of SIZE characters to a fingerprint by DECODE,
+   store the fingerprints in a new array *OUT, and return their number;
+   or croak on behalf of FUNC.  */
+
+static int
+fp_decode(SV *sv, fp_decode_fn_t decode, int size, const char *func,
+	  fingerprint_t **out)
+{
+	char   *text;
+	STRLEN  text_len;
+	int     n;
+
+	text = (char *) SvPV(sv, text_len);
+	if (text_len % size)
+		croak("%s: length must be a multiple of %d", func, size);
+	n = (int) (text_len / size);
+
+	New(0, *out, n ? n : 1, fingerprint_t);
+	if (!decode(text, n, *out)) {
+		Safefree(*out);
+		croak("%s: invalid character", func);
+	}
+	return n;
+}
+
+/* The argument of a job of a pool: the tag it was given, and a copy
+   of its buffer, which keeps the text unchanged while the job runs.  */
+
+typedef struct fp_job_t {
+	SV *tag;
+	SV *data;
+} fp_job_t;
+
+/* Return the basis object SV, or NULL if SV is undefined; or croak on
+   behalf of FUNC.  */
+
+static fingerprint_basis_t *
+fp_sv_basis(SV *sv, const char *func)
+{
+	if (sv == NULL || !SvOK(sv))
+		return NULL;
+	if (!sv_derived_from(sv, "fingerprint_basis_tPtr"))
+		croak("%s: basis is not of type fingerprint_basis_tPtr", func);
+	return INT2PTR(fingerprint_basis_t *, SvIV(SvRV(sv)));
+}
+
+/* Store in OUT the tag, fingerprint and error of RESULT, as mortal
+   values, and release its job.  */
+
+static void
+fp_result_svs(const fingerprint_pool_result_t *result, SV **out)
+{
+	fp_job_t *job = (fp_job_t *) result->arg;
+
+	out[0] = sv_2mortal(job->tag);
+	if (result->error) {
+		out[1] = &PL_sv_undef;
+		out[2] = sv_2mortal(newSVpv(Strerror(result->error), 0));
+	} else {
+		out[1] = sv_2mortal(fp_new_sv(result->fp));
+		out[2] = &PL_sv_undef;
+	}
+	if (job->data)
+		SvREFCNT_dec(job->data);
+	Safefree(job);
+}
+
+/* fp_store_get returns a reference, blessed into
+   fingerprint_store_viewPtr, to a read-only string whose bytes are
+   those of a view of a chunk, in the mapping of its pack.  Its magic
+   releases the view when the string is freed.  */
+
+static int
+fp_store_view_free(pTHX_ SV *sv, MAGIC *mg)
+{
+	fingerprint_store_view_t *view;
+
+	view = (fingerprint_store_view_t *) mg->mg_ptr;
+	SvPV_set(sv, NULL);
+	SvCUR_set(sv, 0);
+	SvPOK_off(sv);
+	fingerprint_store_release(view);
+	Safefree(view);
+	return 0;
+}
+
+static MGVTBL fp_store_view_vtbl = {
+	NULL,			/* get */
+	NULL,			/* set */
+	NULL,			/* len */
+	NULL,			/* clear */
+	fp_store_view_free,	/* free */
+	NULL,			/* copy */
+	NULL,			/* dup */
+	NULL			/* local */
+};
+
+/* Return a new reference to a string viewing the chunk of VIEW, which
+   it takes over.  */
+
+static SV *
+fp_store_view_sv(pTHX_ fingerprint_store_view_t *view)
+{
+	SV *sv = newSV(0);
+	SV *rv;
+
+	sv_upgrade(sv, SVt_PVMG);
+	SvPV_set(sv, (char *) view->data);
+	SvCUR_set(sv, view->size);
+	SvLEN_set(sv, 0);
+	SvPOK_on(sv);
+	sv_magicext(sv, NULL, PERL_MAGIC_ext, &fp_store_view_vtbl,
+		    (char *) view, 0);
+	rv = sv_bless(newRV_noinc(sv),
+		      gv_stashpv("fingerprint_store_viewPtr", GV_ADD));
+	SvREADONLY_on(sv);
+	return rv;
+}
+
+/* fp_deep fingerprints a data structure by walking it, with the
+   default basis.  Each array, hash and referent of a reference is a
+   node, whose fingerprint is that of a tag for its kind combined with
+   that of its contents, written in a canonical form: an array as its
+   elements in turn, a hash as its keys, in order, each followed by its
+   value.  A string is written as a type byte, its length and its
+   bytes, which are its characters if they all fit in a byte, and its
+   UTF-8 otherwise, so that equal strings agree however Perl holds
+   them; a number as the string Perl would make of it, without making
+   it; undef as a type byte; and a reference as a type byte and the
+   fingerprint of its referent, which if blessed is also combined with
+   its class.  A reference to a referent still being walked closes a
+   cycle, and is written as the number of levels it goes back.
+
+   The contents of a node are fingerprinted as they are written, through
+   a small buffer shared by all the nodes being walked, which is emptied
+   before a reference is followed.  The referents being walked are kept
+   in a small hash table, and the entries of the hashes being walked on
+   a stack, so that the walk needs memory for the depth of the structure
+   and its largest hash, but not for its size.  Both live in mortal
+   strings, which are freed if the walk croaks.  */
+
+enum {
+	FP_DEEP_ARRAY, FP_DEEP_HASH, FP_DEEP_REF, FP_DEEP_BLESSED,
+	FP_DEEP_TAGS
+};
+
+static const char *const fp_deep_tag_name[FP_DEEP_TAGS] = {
+	"array", "hash", "reference", "blessed"
+};
+
+/* The type bytes of values within a node.  */
+
+#define FP_DEEP_UNDEF  'u'
+#define FP_DEEP_STRING 's'
+#define FP_DEEP_WIDE   'w'
+#define FP_DEEP_NODE   'r'
+#define FP_DEEP_CYCLE  'c'
+
+/* The deepest structure fp_deep walks.  */
+
+#define FP_DEEP_MAX_DEPTH 4096
+
+/* The home slot of the referent SV in a table of MASK + 1 slots.  */
+
+#define FP_DEEP_HOME(sv, mask) \
+	((STRLEN) ((PTR2UV(sv) >> 4) ^ (PTR2UV(sv) >> 12)) & (mask))
+
+typedef struct fp_deep_seen_t {
+	const SV *sv;
+	int       depth;
+} fp_deep_seen_t;
+
+typedef struct fp_deep_t {
+	fingerprint_t  tag[FP_DEEP_TAGS];
+	SV            *seen;		/* The table of referents.  */
+	STRLEN         seen_mask;
+	int            depth;		/* The number of referents.  */
+	SV            *keys;		/* The stack of hash entries.  */
+	STRLEN         keys_used;
+	int            used;		/* The bytes pending in BUF.  */
+	char           buf[1024];
+} fp_deep_t;
+
+/* Fingerprint the bytes pending in the buffer of D into CTX.  */
+
+static void
+fp_deep_flush(fp_deep_t *d, fingerprint_ctx_t *ctx)
+{
+	fingerprint_ctx_update(ctx, d->buf, d->used);
+	d->used = 0;
+}
+
+/* Write the LEN bytes of TEXT to CTX.  */
+
+static void
+fp_deep_put(fp_deep_t *d, fingerprint_ctx_t *ctx, const char *text,
+	    STRLEN len)
+{
+	if (len > sizeof(d->buf) - d->used) {
+		fp_deep_flush(d, ctx);
+		if (len > sizeof(d->buf) / 2) {
+			fp_ctx_add(ctx, text, len);
+			return;
+		}
+	}
+	memcpy(d->buf + d->used, text, len);
+	d->used += (int) len;
+}
+
+/* Write the type byte TYPE and the number N to CTX.  */
+
+static void
+fp_deep_put_head(fp_deep_t *d, fingerprint_ctx_t *ctx, int type, UV n)
+{
+	char head[16];
+	int  len = 0;
+
+	head[len++] = (char) type;
+	for (; n >= 0x80; n >>= 7)
+		head[len++] = (char) (n | 0x80);
+	head[len++] = (char) n;
+	fp_deep_put(d, ctx, head, len);
+}
+
+/* Write the string of LEN bytes at TEXT, which are UTF-8 if UTF8 is
+   non-zero, to CTX.  */
+
+static void
+fp_deep_put_string(fp_deep_t *d, fingerprint_ctx_t *ctx, const char *text,
+		   STRLEN len, int utf8)
+{
+	const U8 *p = (const U8 *) text;
+	const U8 *end = p + len;
+	const U8 *q;
+	STRLEN    wide = 0;
+
+	if (utf8) {
+		while (p < end && *p < 0x80)
+			p++;
+		for (q = p; q < end; q++) {
+			if (*q < 0x80)
+				continue;
+			if ((*q != 0xC2 && *q != 0xC3) || q + 1 == end ||
+			    (q[1] & 0xC0) != 0x80) {
+				fp_deep_put_head(d, ctx, FP_DEEP_WIDE, len);
+				fp_deep_put(d, ctx, text, len);
+				return;
+			}
+			q++;
+			wide++;
+		}
+	}
+	if (!wide) {
+		if (len < 0x80 && len + 2 <= sizeof(d->buf) - d->used) {
+			/* The common case: a short string of bytes.  */
+			d->buf[d->used++] = FP_DEEP_STRING;
+			d->buf[d->used++] = (char) len;
+			memcpy(d->buf + d->used, text, len);
+			d->used += (int) len;
+			return;
+		}
+		fp_deep_put_head(d, ctx, FP_DEEP_STRING, len);
+		fp_deep_put(d, ctx, text, len);
+		return;
+	}
+	fp_deep_put_head(d, ctx, FP_DEEP_STRING, len - wide);
+
+	/* Every character fits in a byte: write those bytes.  */
+	fp_deep_put(d, ctx, text, (const char *) p - text);
+	while (p < end) {
+		if (d->used == (int) sizeof(d->buf))
+			fp_deep_flush(d, ctx);
+		if (*p < 0x80) {
+			d->buf[d->used++] = (char) *p++;
+		} else {
+			d->buf[d->used++] = (char) (((p[0] & 0x03) << 6) |
+						    (p[1] & 0x3F));
+			p += 2;
+		}
+	}
+}
+
+/* Write U in decimal before END, and return the start.  */
+
+static char *
+fp_deep_digits(char *end, UV u)
+{
+	do {
+		*--end = (char) ('0' + u % 10);
+		u /= 10;
+	} while (u);
+	return end;
+}
+
+/* Write the number SV, whose IV or NV is valid, to CTX as a string.  */
+
+static void
+fp_deep_put_number(fp_deep_t *d, fingerprint_ctx_t *ctx, SV *sv)
+{
+	char        buf[64];
+	char       *end = buf + sizeof(buf);
+	char       *q;
+	const char *p;
+	NV          nv;
+
+	if (SvIOK(sv)) {
+		if (SvIsUV(sv)) {
+			q = fp_deep_digits(end, SvUVX(sv));
+		} else if (SvIVX(sv) < 0) {
+			q = fp_deep_digits(end, -(UV) SvIVX(sv));
+			*--q = '-';
+		} else {
+			q = fp_deep_digits(end, (UV) SvIVX(sv));
+		}
+		fp_deep_put_string(d, ctx, q, end - q, 0);
+		return;
+	}
+	nv = SvNVX(sv);
+	if (Perl_isnan(nv))
+		p = "NaN";
+	else if (Perl_isinf(nv))
+		p = nv > 0 ? "Inf" : "-Inf";
+	else if (nv == 0.0)
+		p = "0";
+	else {
+		my_snprintf(buf, sizeof(buf), "%.*" NVgf, NV_DIG, nv);
+		p = buf;
+	}
+	fp_deep_put_string(d, ctx, p, strlen(p), 0);
+}
+
+/* Return the depth at which the referent SV is being walked, or -1.  */
+
+static int
+fp_deep_find(const fp_deep_t *d, const SV *sv)
+{
+	const fp_deep_seen_t *slot = (const fp_deep_seen_t *) SvPVX(d->seen);
+	STRLEN                i = FP_DEEP_HOME(sv, d->seen_mask);
+
+	for (; slot[i].sv; i = (i + 1) & d->seen_mask)
+		if (slot[i].sv == sv)
+			return slot[i].depth;
+	return -1;
+}
+
+/* Record that the referent SV is being walked, one level down.  */
+
+static void
+fp_deep_enter(pTHX_ fp_deep_t *d, const SV *sv)
+{
+	fp_deep_seen_t *slot = (fp_deep_seen_t *) SvPVX(d->seen);
+	fp_deep_seen_t *old;
+	STRLEN          old_mask = d->seen_mask;
+	STRLEN          i;
+	STRLEN          j;
+
+	if (2 * (STRLEN) (d->depth + 1) > d->seen_mask + 1) {
+		old = slot;
+		d->seen_mask = 2 * old_mask + 1;
+		d->seen = sv_2mortal(newSV((d->seen_mask + 1) *
+					   sizeof(fp_deep_seen_t)));
+		slot = (fp_deep_seen_t *) SvPVX(d->seen);
+		Zero(slot, d->seen_mask + 1, fp_deep_seen_t);
+		for (i = 0; i <= old_mask; i++) {
+			if (!old[i].sv)
+				continue;
+			j = FP_DEEP_HOME(old[i].sv, d->seen_mask);
+			while (slot[j].sv)
+				j = (j + 1) & d->seen_mask;
+			slot[j] = old[i];
+		}
+	}
+	i = FP_DEEP_HOME(sv, d->seen_mask);
+	while (slot[i].sv)
+		i = (i + 1) & d->seen_mask;
+	slot[i].sv = sv;
+	slot[i].depth = d->depth++;
+}
+
+/* Record that the referent SV has been walked.  */
+
+static void
+fp_deep_leave(fp_deep_t *d, const SV *sv)
+{
+	fp_deep_seen_t *slot = (fp_deep_seen_t *) SvPVX(d->seen);
+	STRLEN          mask = d->seen_mask;
+	STRLEN          i = FP_DEEP_HOME(sv, mask);
+	STRLEN          j;
+	STRLEN          k;
+
+	while (slot[i].sv != sv)
+		i = (i + 1) & mask;
+	slot[i].sv = NULL;
+	for (j = (i + 1) & mask; slot[j].sv; j = (j + 1) & mask) {
+		k = FP_DEEP_HOME(slot[j].sv, mask);
+		if (i < j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		slot[i] = slot[j];
+		slot[j].sv = NULL;
+		i = j;
+	}
+	d->depth--;
+}
+
+/* An entry of a hash being walked, with the first bytes of its key,
+   most significant first, to sort by.  */
+
+typedef struct fp_deep_key_t {
+	UV  prefix;
+	HE *he;
+} fp_deep_key_t;
+
+/* Order hash entries by the bytes of their keys.  */
+
+static int
+fp_deep_key_cmp(const void *a, const void *b)
+{
+	const fp_deep_key_t *x = (const fp_deep_key_t *) a;
+	const fp_deep_key_t *y = (const fp_deep_key_t *) b;
+	I32                  x_len;
+	I32                  y_len;
+	int                  c;
+
+	if (x->prefix != y->prefix)
+		return x->prefix < y->prefix ? -1 : 1;
+	x_len = HeKLEN(x->he);
+	y_len = HeKLEN(y->he);
+	c = memcmp(HeKEY(x->he), HeKEY(y->he), x_len < y_len ? x_len : y_len);
+	if (c)
+		return c;
+	return (x_len > y_len) - (x_len < y_len);
+}
+
+static void fp_deep_put_value(pTHX_ fp_deep_t *d, fingerprint_ctx_t *ctx,
+			      SV *sv);
+
+/* Write the elements of the array AV to CTX.  */
+
+static void
+fp_deep_put_array(pTHX_ fp_deep_t *d, fingerprint_ctx_t *ctx, AV *av)
+{
+	SV      **item;
+	SSize_t   i;
+
+	if (SvRMAGICAL((SV *) av) && mg_find((SV *) av, PERL_MAGIC_tied))
+		croak("fp_deep: cannot fingerprint a tied array");
+	for (i = 0; i <= av_len(av); i++) {
+		if (SvRMAGICAL((SV *) av))
+			item = av_fetch(av, i, 0);
+		else
+			item = AvARRAY(av)[i] ? &AvARRAY(av)[i] : NULL;
+		if (item)
+			fp_deep_put_value(aTHX_ d, ctx, *item);
+		else
+			fp_deep_put(d, ctx, "u", 1);
+	}
+}
+
+/* Write the entries of the hash HV to CTX, in the order of their keys:
+   bytes first, then wide strings, each by their bytes, since Perl keeps
+   a key as bytes whenever it can.  The entries are read from the
+   buckets of HV, which leaves its iterator alone.  */
+
+static void
+fp_deep_put_hash(pTHX_ fp_deep_t *d, fingerprint_ctx_t *ctx, HV *hv)
+{
+	STRLEN          base = d->keys_used;
+	STRLEN          size = HvTOTALKEYS(hv);
+	STRLEN          bytes = 0;
+	STRLEN          wide = 0;
+	STRLEN          i;
+	fp_deep_key_t  *keys;
+	fp_deep_key_t  *key;
+	HE             *he;
+	const U8       *text;
+	I32             len;
+	I32             j;
+	UV              prefix;
+
+	if (SvRMAGICAL((SV *) hv) && mg_find((SV *) hv, PERL_MAGIC_tied))
+		croak("fp_deep: cannot fingerprint a tied hash");
+	SvGROW(d->keys, (base + size + 1) * sizeof(fp_deep_key_t));
+	keys = (fp_deep_key_t *) SvPVX(d->keys) + base;
+	if (HvARRAY(hv)) {
+		for (i = 0; i <= HvMAX(hv); i++) {
+			for (he = HvARRAY(hv)[i]; he; he = HeNEXT(he)) {
+				if (HeVAL(he) == &PL_sv_placeholder)
+					continue;
+				text = (const U8 *) HeKEY(he);
+				len = HeKLEN(he);
+				prefix = 0;
+				for (j = 0; j < (I32) sizeof(UV); j++)
+					prefix = (prefix << 8) |
+						 (j < len ? text[j] : 0);
+				key = HeKUTF8(he) ? &keys[size - ++wide]
+						  : &keys[bytes++];
+				key->prefix = prefix;
+				key->he = he;
+			}
+		}
+	}
+	qsort(keys, bytes, sizeof(fp_deep_key_t), fp_deep_key_cmp);
+	qsort(keys + size - wide, wide, sizeof(fp_deep_key_t),
+	      fp_deep_key_cmp);
+	d->keys_used = base + size;
+
+	for (i = 0; i < size; i++) {
+		if (i == bytes)
+			i = size - wide;
+		if (i == size)
+			break;
+		/* The stack may move while a value is walked.  */
+		he = ((fp_deep_key_t *) SvPVX(d->keys))[base + i].he;
+		fp_deep_put_string(d, ctx, HeKEY(he), HeKLEN(he), HeKUTF8(he));
+		fp_deep_put_value(aTHX_ d, ctx, HeVAL(he));
+	}
+	d->keys_used = base;
+}
+
+/* Return the fingerprint of the referent SV, which is not being
+   walked.  */
+
+static fingerprint_t
+fp_deep_node(pTHX_ fp_deep_t *d, SV *sv)
+{
+	fingerprint_ctx_t  ctx;
+	fingerprint_t      fp;
+	HV                *stash;
+	const char        *text;
+	STRLEN             text_len;
+	int                tag;
+
+	if (d->depth == FP_DEEP_MAX_DEPTH)
+		croak("fp_deep: data nested more than %d deep",
+		      FP_DEEP_MAX_DEPTH);
+
+	fp_deep_enter(aTHX_ d, sv);
+	fingerprint_ctx_init(&ctx, NULL);
+	switch (SvTYPE(sv)) {
+	case SVt_PVAV:
+		tag = FP_DEEP_ARRAY;
+		fp_deep_put_array(aTHX_ d, &ctx, (AV *) sv);
+		break;
+	case SVt_PVHV:
+		tag = FP_DEEP_HASH;
+		fp_deep_put_hash(aTHX_ d, &ctx, (HV *) sv);
+		break;
+	case SVt_PVCV:
+	case SVt_PVGV:
+	case SVt_PVIO:
+	case SVt_PVFM:
+		croak("fp_deep: cannot fingerprint a %s reference",
+		      sv_reftype(sv, 0));
+		break;
+	case SVt_REGEXP:
+		tag = FP_DEEP_REF;
+		text = SvPV_nomg_const(sv, text_len);
+		fp_deep_put_string(d, &ctx, text, text_len, SvUTF8(sv));
+		break;
+	default:
+		tag = FP_DEEP_REF;
+		fp_deep_put_value(aTHX_ d, &ctx, sv);
+		break;
+	}
+	fp_deep_flush(d, &ctx);
+	fp = fingerprint_combine(d->tag[tag], fingerprint_ctx_final(&ctx));
+
+	if (SvOBJECT(sv)) {
+		stash = SvSTASH(sv);
+		fingerprint_ctx_init(&ctx, NULL);
+		fp_deep_put_string(d, &ctx, HvNAME_get(stash),
+				   HvNAMELEN_get(stash), HvNAMEUTF8(stash));
+		fp_deep_flush(d, &ctx);
+		fp = fingerprint_combine(fingerprint_combine(
+			d->tag[FP_DEEP_BLESSED], fingerprint_ctx_final(&ctx)),
+			fp);
+	}
+	fp_deep_leave(d, sv);
+	return fp;
+}
+
+/* Write the value SV to CTX.  */
+
+static void
+fp_deep_put_value(pTHX_ fp_deep_t *d, fingerprint_ctx_t *ctx, SV *sv)
+{
+	fingerprint_t  fp;
+	const char    *text;
+	STRLEN         text_len;
+	int            depth;
+
+	SvGETMAGIC(sv);
+	if (SvROK(sv)) {
+		depth = fp_deep_find(d, SvRV(sv));
+		if (depth >= 0) {
+			fp_deep_put_head(d, ctx, FP_DEEP_CYCLE,
+					 (UV) (d->depth - depth));
+			return;
+		}
+		fp_deep_flush(d, ctx);
+		fp = fp_deep_node(aTHX_ d, SvRV(sv));
+		d->buf[d->used++] = FP_DEEP_NODE;
+		fp_deep_put(d, ctx, (const char *) FINGERPRINT_BYTE(fp),
+			    sizeof(fingerprint_t));
+	} else if (SvPOK(sv)) {
+		fp_deep_put_string(d, ctx, SvPVX_const(sv), SvCUR(sv),
+				   SvUTF8(sv));
+	} else if (SvIOK(sv) || SvNOK(sv)) {
+		fp_deep_put_number(d, ctx, sv);
+	} else if (!SvOK(sv)) {
+		fp_deep_put(d, ctx, "u", 1);
+	} else {
+		text = SvPV_nomg_const(sv, text_len);
+		fp_deep_put_string(d, ctx, text, text_len, SvUTF8(sv));
+	}
+}
+
+/* fp_buffer_cached keeps the fingerprint of a string in ext magic on
+   it, so that fingerprinting the string again, while it is unchanged,
+   only looks the fingerprint up.  Perl calls the set magic of a scalar
+   whenever it modifies it, whether by assignment or in place, as by
+   substr, .= or sysread, and the set magic marks the fingerprint
+   stale; the buffer and length it was taken from are also kept, and
+   checked, in case a modification comes without set magic.  The
+   memo is the string of the magic, so Perl copies it into new threads
+   and frees it with the magic.  */
+
+typedef struct fp_memo_t {
+	fingerprint_t  fp;
+	const char    *text;
+	STRLEN         len;
+	int            valid;
+} fp_memo_t;
+
+static int
+fp_memo_set(pTHX_ SV *sv, MAGIC *mg)
+{
+	PERL_UNUSED_ARG(sv);
+	((fp_memo_t *) mg->mg_ptr)->valid = 0;
+	return 0;
+}
+
+static MGVTBL fp_memo_vtbl = {
+	NULL,			/* get */
+	fp_memo_set,		/* set */
+	NULL,			/* len */
+	NULL,			/* clear */
+	NULL,			/* free */
+	NULL,			/* copy */
+	NULL,			/* dup */
+	NULL			/* local */
+};
+
+/* Return the fingerprint of the LEN bytes of TEXT.  */
+
+static fingerprint_t
+fp_memo_bytes(const char *text, STRLEN len)
+{
+	fingerprint_ctx_t ctx;
+
+	if (len < FP_CHUNK)
+		return fingerprint_from_buffer(text, (int) len);
+	fingerprint_ctx_init(&ctx, NULL);
+	fp_ctx_add(&ctx, text, len);
+	return fingerprint_ctx_final(&ctx);
+}
+
+/* Return the fingerprint of the string SV, from its memo if it has a
+   valid one, and otherwise noting it in a new one.  */
+
+static fingerprint_t
+fp_memo_fingerprint(pTHX_ SV *sv)
+{
+	MAGIC       *mg = NULL;
+	fp_memo_t   *memo;
+	fp_memo_t    new_memo;
+	const char  *text;
+	STRLEN       text_len;
+
+	if (SvGMAGICAL(sv) || SvPADTMP(sv) || SvTEMP(sv)) {
+		/* The value is fetched afresh, or the scalar is
+		   short-lived: do not keep a memo.  */
+		text = SvPV_const(sv, text_len);
+		return fp_memo_bytes(text, text_len);
+	}
+
+	if (SvTYPE(sv) >= SVt_PVMG && SvSMAGICAL(sv))
+		mg = mg_findext(sv, PERL_MAGIC_ext, &fp_memo_vtbl);
+	text = SvPV_const(sv, text_len);
+	if (mg) {
+		memo = (fp_memo_t *) mg->mg_ptr;
+		if (memo->valid && memo->text == text && memo->len == text_len)
+			return memo->fp;
+	} else {
+		memo = &new_memo;
+	}
+
+	memo->fp = fp_memo_bytes(text, text_len);
+	memo->text = text;
+	memo->len = text_len;
+	memo->valid = 1;
+	if (!mg)
+		sv_magicext(sv, NULL, PERL_MAGIC_ext, &fp_memo_vtbl,
+			    (const char *) memo, sizeof(fp_memo_t));
+	return memo->fp;
+}
 
 MODULE = Fingerprint::Rabin::Internal PACKAGE = Fingerprint::Rabin::Internal
 
-void 
-fp_init()
+BOOT:
+#ifdef PERLIO_LAYERS
+	PerlIO_define_layer(aTHX_ PERLIO_FUNCS_CAST(&fp_layer_funcs));
+#endif
+
+void 
+fp_init()
+	PPCODE:
+{
+	fingerprint_init();
+}
+
+SV *
+fp_buffer(buffer)
+	SV *buffer
+	CODE:
+{
+	char          *text;
+	STRLEN         text_len;
+
+	text = (char *) SvPV(buffer, text_len);
+	
+	RETVAL = fp_new_sv(fingerprint_from_buffer(text, (int) text_len));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_buffer_cached(buffer)
+	SV *buffer
+	CODE:
+{
+	RETVAL = fp_new_sv(fp_memo_fingerprint(aTHX_ buffer));
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_buffers(...)
+	PPCODE:
+{
+	const char   **text;
+	int           *text_len;
+	fingerprint_t *tmp;
+	STRLEN         len;
+	int            i;
+
+	New(0, text, items, const char *);
+	New(0, text_len, items, int);
+	New(0, tmp, items, fingerprint_t);
+
+	for (i = 0; i < items; i++) {
+		text[i] = (const char *) SvPV(ST(i), len);
+		if (len > INT_MAX) {
+			Safefree(text);
+			Safefree(text_len);
+			Safefree(tmp);
+			croak("fp_buffers: buffer %d too long", i);
+		}
+		text_len[i] = (int) len;
+	}
+
+	fingerprint_from_buffers(text, text_len, items, tmp);
+
+	for (i = 0; i < items; i++)
+		ST(i) = sv_2mortal(fp_new_sv(tmp[i]));
+
+	Safefree(text);
+	Safefree(text_len);
+	Safefree(tmp);
+
+	XSRETURN(items);
+}
+
+int
+fp_compare(f1, f2)
+	fingerprint_t *f1
+	fingerprint_t *f2
+	CODE:
+{
+#if FINGERPRINT_USE_INTEGRAL_TYPE
+	RETVAL = fingerprint_equal_f(*f1, *f2);
+#else
+	RETVAL = fingerprint_equal(*f1, *f2);
+#endif
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_combine(f1, f2)
+	fingerprint_t *f1
+	fingerprint_t *f2
+	CODE:
+{
+	RETVAL = fp_new_sv(fingerprint_combine(*f1, *f2));
+}
+	OUTPUT:
+	RETVAL
+
+unsigned int
+fp_hash(fp)
+	fingerprint_t *fp
+	CODE:
+{
+	RETVAL = fingerprint_hash(*fp);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp128_buffer(buffer, basis1 = NULL, basis2 = NULL)
+	SV *buffer
+	SV *basis1
+	SV *basis2
+	CODE:
+{
+	const char *text;
+	STRLEN      text_len;
+
+	text = SvPV_const(buffer, text_len);
+	if (text_len > INT_MAX)
+		croak("fp128_buffer: buffer too long");
+	RETVAL = fp128_new_sv(fingerprint128_basis_from_buffer(
+				      fp_sv_basis(basis1, "fp128_buffer"),
+				      fp_sv_basis(basis2, "fp128_buffer"),
+				      text, (int) text_len));
+}
+	OUTPUT:
+	RETVAL
+
+int
+fp128_compare(f1, f2)
+	fingerprint128_t *f1
+	fingerprint128_t *f2
+	CODE:
+{
+	RETVAL = fingerprint128_equal(*f1, *f2);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp128_combine(f1, f2)
+	fingerprint128_t *f1
+	fingerprint128_t *f2
+	CODE:
+{
+	RETVAL = fp128_new_sv(fingerprint128_combine(*f1, *f2));
+}
+	OUTPUT:
+	RETVAL
+
+unsigned int
+fp128_hash(fp)
+	fingerprint128_t *fp
+	CODE:
+{
+	RETVAL = fingerprint128_hash(*fp);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp128_halves(fp)
+	fingerprint128_t *fp
+	PPCODE:
+{
+	EXTEND(SP, 2);
+	PUSHs(sv_2mortal(fp_new_sv(fp->fp[0])));
+	PUSHs(sv_2mortal(fp_new_sv(fp->fp[1])));
+}
+
+void
+fp_free(fp)
+	SV *fp
+	CODE:
+{
+	/* Fingerprint objects are freed by Perl.  */
+	PERL_UNUSED_VAR(fp);
+}
+
+fingerprint_basis_t *
+fp_basis_new(poly)
+	SV *poly
+	CODE:
+{
+	fingerprint_t  tmp;
+	char          *text;
+	STRLEN         text_len;
+
+	text = (char *) SvPV(poly, text_len);
+	if (text_len != sizeof(fingerprint_t))
+		croak("fp_basis_new: polynomial must be %d bytes",
+		      (int) sizeof(fingerprint_t));
+	memcpy(&tmp, text, sizeof(fingerprint_t));
+
+	RETVAL = fingerprint_basis_new(tmp);
+	if (RETVAL == NULL)
+		croak("fp_basis_new: polynomial is not irreducible");
+}
+	OUTPUT:
+	RETVAL
+
+fingerprint_basis_t *
+fp_basis_random(seed)
+	unsigned long seed
+	CODE:
+{
+	RETVAL = fingerprint_basis_random(seed);
+	if (RETVAL == NULL)
+		croak("fp_basis_random: out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_basis_poly(basis)
+	fingerprint_basis_t *basis
+	CODE:
+{
+	fingerprint_t tmp;
+
+	tmp = fingerprint_basis_poly(basis);
+	RETVAL = newSVpvn((char *) FINGERPRINT_BYTE(tmp),
+			  sizeof(fingerprint_t));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_buffer_basis(basis, buffer)
+	fingerprint_basis_t *basis
+	SV *buffer
+	CODE:
+{
+	char          *text;
+	STRLEN         text_len;
+
+	text = (char *) SvPV(buffer, text_len);
+	
+	RETVAL = fp_new_sv(fingerprint_basis_from_buffer(basis, text,
+							 (int) text_len));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_range(buffer, offset, length = NULL)
+	SV *buffer
+	IV offset
+	SV *length
+	CODE:
+{
+	RETVAL = fp_new_sv(fp_range_fingerprint(NULL, buffer, offset, length,
+						"fp_range"));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_range_basis(basis, buffer, offset, length = NULL)
+	fingerprint_basis_t *basis
+	SV *buffer
+	IV offset
+	SV *length
+	CODE:
+{
+	RETVAL = fp_new_sv(fp_range_fingerprint(basis, buffer, offset, length,
+						"fp_range_basis"));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_concat(...)
+	CODE:
+{
+	RETVAL = fp_new_sv(fp_concat_fingerprint(NULL, &ST(0), items));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_concat_basis(basis, ...)
+	fingerprint_basis_t *basis
+	CODE:
+{
+	RETVAL = fp_new_sv(fp_concat_fingerprint(basis, &ST(1), items - 1));
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_basis_free(basis)
+	fingerprint_basis_t *basis
+	CODE:
+{
+	fingerprint_basis_free(basis);
+}
+
+fingerprint_matcher_t *
+fp_matcher_new(...)
+	CODE:
+{
+	const char **text;
+	int         *text_len;
+	STRLEN       len;
+	int          i;
+
+	New(0, text, items + 1, const char *);
+	New(0, text_len, items + 1, int);
+
+	for (i = 0; i < items; i++) {
+		text[i] = (const char *) SvPV(ST(i), len);
+		text_len[i] = (int) len;
+		if (len == 0 || len > INT_MAX) {
+			Safefree(text);
+			Safefree(text_len);
+			croak("fp_matcher_new: pattern %d is %s", i,
+			      len ? "too long" : "empty");
+		}
+	}
+
+	RETVAL = fingerprint_matcher_new(text, text_len, items);
+
+	Safefree(text);
+	Safefree(text_len);
+
+	if (RETVAL == NULL)
+		croak("fp_matcher_new: out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_matcher_scan(matcher, buffer)
+	fingerprint_matcher_t *matcher
+	SV *buffer
+	PPCODE:
+{
+	fp_hits_t  hits = { NULL, 0, 0 };
+	char      *text;
+	STRLEN     text_len;
+	STRLEN     n;
+	int        i;
+
+	text = (char *) SvPV(buffer, text_len);
+
+	while (text_len > 0) {
+		n = text_len < FP_CHUNK ? text_len : FP_CHUNK;
+		if (fingerprint_matcher_scan(matcher, text, (int) n,
+					     fp_add_hit, &hits) < 0) {
+			Safefree(hits.item);
+			croak("fp_matcher_scan: out of memory");
+		}
+		text += n;
+		text_len -= n;
+	}
+
+	EXTEND(SP, hits.count);
+	for (i = 0; i < hits.count; i++)
+		PUSHs(sv_2mortal(newSViv(hits.item[i])));
+	Safefree(hits.item);
+}
+
+void
+fp_matcher_reset(matcher)
+	fingerprint_matcher_t *matcher
+	CODE:
+{
+	fingerprint_matcher_reset(matcher);
+}
+
+void
+fp_matcher_free(matcher)
+	fingerprint_matcher_t *matcher
+	CODE:
+{
+	fingerprint_matcher_free(matcher);
+}
+
+fingerprint_sketch_t *
+fp_sketch_new(shingle, k, kind)
+	int shingle
+	int k
+	int kind
+	CODE:
+{
+	if (kind != FINGERPRINT_SKETCH_BOTTOM_K
+	    && kind != FINGERPRINT_SKETCH_K_PERM)
+		croak("fp_sketch_new: unknown kind %d", kind);
+
+	RETVAL = fingerprint_sketch_new(NULL, shingle, k,
+					(fingerprint_sketch_kind_t) kind);
+	if (RETVAL == NULL)
+		croak("fp_sketch_new: bad size or out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_sketch_update(sketch, buffer)
+	fingerprint_sketch_t *sketch
+	SV *buffer
+	CODE:
+{
+	char   *text;
+	STRLEN  text_len;
+	STRLEN  n;
+
+	text = (char *) SvPV(buffer, text_len);
+	while (text_len > 0) {
+		n = text_len < FP_CHUNK ? text_len : FP_CHUNK;
+		fingerprint_sketch_update(sketch, text, (int) n);
+		text += n;
+		text_len -= n;
+	}
+}
+
+void
+fp_sketch_values(sketch)
+	fingerprint_sketch_t *sketch
+	PPCODE:
+{
+	fingerprint_word_t *values;
+	int                 i, n;
+
+	New(0, values, fingerprint_sketch_k(sketch), fingerprint_word_t);
+	n = fingerprint_sketch_values(sketch, values);
+
+	EXTEND(SP, n);
+	for (i = 0; i < n; i++)
+		PUSHs(sv_2mortal(newSVuv(values[i])));
+	Safefree(values);
+}
+
+double
+fp_sketch_jaccard(s1, s2)
+	fingerprint_sketch_t *s1
+	fingerprint_sketch_t *s2
+	CODE:
+{
+	RETVAL = fingerprint_sketch_jaccard(s1, s2);
+	if (RETVAL < 0)
+		croak("fp_sketch_jaccard: sketches are not comparable");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_sketch_reset(sketch)
+	fingerprint_sketch_t *sketch
+	CODE:
+{
+	fingerprint_sketch_reset(sketch);
+}
+
+void
+fp_sketch_free(sketch)
+	fingerprint_sketch_t *sketch
+	CODE:
+{
+	fingerprint_sketch_free(sketch);
+}
+
+SV *
+fp_simhash(...)
+	CODE:
+{
+	fingerprint_simhash_ctx_t  ctx;
+	fingerprint_t              sig;
+	char                      *text;
+	STRLEN                     text_len;
+	int                        i;
+
+	if (items % 2)
+		croak("fp_simhash: features and weights must come in pairs");
+
+	fingerprint_simhash_init(&ctx);
+	for (i = 0; i < items; i += 2) {
+		text = (char *) SvPV(ST(i), text_len);
+		if (text_len > INT_MAX)
+			croak("fp_simhash: feature too long");
+		fingerprint_simhash_add_buffer(&ctx, text, (int) text_len,
+					       (int) SvIV(ST(i + 1)));
+	}
+	sig = fingerprint_simhash_final(&ctx);
+
+	RETVAL = newSVpvn((char *) FINGERPRINT_BYTE(sig),
+			  sizeof(fingerprint_t));
+}
+	OUTPUT:
+	RETVAL
+
+int
+fp_simhash_distance(sig1, sig2)
+	SV *sig1
+	SV *sig2
+	CODE:
+{
+	fingerprint_t s1;
+	fingerprint_t s2;
+
+	fp_sv_to_sig(sig1, &s1, "fp_simhash_distance");
+	fp_sv_to_sig(sig2, &s2, "fp_simhash_distance");
+	RETVAL = fingerprint_simhash_distance(s1, s2);
+}
+	OUTPUT:
+	RETVAL
+
+fingerprint_simhash_index_t *
+fp_simhash_index_new(k)
+	int k
+	CODE:
+{
+	RETVAL = fingerprint_simhash_index_new(k);
+	if (RETVAL == NULL)
+		croak("fp_simhash_index_new: bad distance or out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_simhash_index_add(index, sig, id)
+	fingerprint_simhash_index_t *index
+	SV *sig
+	unsigned long id
+	CODE:
+{
+	fingerprint_t s;
+
+	fp_sv_to_sig(sig, &s, "fp_simhash_index_add");
+	if (!fingerprint_simhash_index_add(index, s, id))
+		croak("fp_simhash_index_add: out of memory");
+}
+
+void
+fp_simhash_index_query(index, sig)
+	fingerprint_simhash_index_t *index
+	SV *sig
+	PPCODE:
+{
+	fp_hits_t     hits = { NULL, 0, 0 };
+	fingerprint_t s;
+	int           i;
+
+	fp_sv_to_sig(sig, &s, "fp_simhash_index_query");
+	fingerprint_simhash_index_query(index, s, fp_add_near, &hits);
+
+	EXTEND(SP, hits.count);
+	for (i = 0; i < hits.count; i++)
+		PUSHs(sv_2mortal(newSViv(hits.item[i])));
+	Safefree(hits.item);
+}
+
+unsigned long
+fp_simhash_index_size(index)
+	fingerprint_simhash_index_t *index
+	CODE:
+{
+	RETVAL = fingerprint_simhash_index_size(index);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_simhash_index_free(index)
+	fingerprint_simhash_index_t *index
+	CODE:
+{
+	fingerprint_simhash_index_free(index);
+}
+
+fingerprint_index_t *
+fp_index_open(dir)
+	char *dir
+	CODE:
+{
+	RETVAL = fingerprint_index_open(dir);
+	if (RETVAL == NULL)
+		croak("fp_index_open: cannot open %s: %s", dir,
+		      Strerror(errno));
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_index_add(index, fp, offset, length)
+	fingerprint_index_t *index
+	fingerprint_t *fp
+	unsigned long offset
+	unsigned long length
+	CODE:
+{
+	if (!fingerprint_index_add(index, *fp, offset, length))
+		croak("fp_index_add: %s", Strerror(errno));
+}
+
+void
+fp_index_lookup(index, fp)
+	fingerprint_index_t *index
+	fingerprint_t *fp
+	PPCODE:
+{
+	unsigned long offset;
+	unsigned long length;
+
+	if (fingerprint_index_lookup(index, *fp, &offset, &length)) {
+		EXTEND(SP, 2);
+		PUSHs(sv_2mortal(newSVuv(offset)));
+		PUSHs(sv_2mortal(newSVuv(length)));
+	}
+}
+
+void
+fp_index_flush(index)
+	fingerprint_index_t *index
+	CODE:
+{
+	if (!fingerprint_index_flush(index))
+		croak("fp_index_flush: %s", Strerror(errno));
+}
+
+void
+fp_index_compact(index)
+	fingerprint_index_t *index
+	CODE:
+{
+	if (!fingerprint_index_compact(index))
+		croak("fp_index_compact: %s", Strerror(errno));
+}
+
+unsigned long
+fp_index_count(index)
+	fingerprint_index_t *index
+	CODE:
+{
+	RETVAL = fingerprint_index_count(index);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_index_close(index)
+	fingerprint_index_t *index
+	CODE:
+{
+	if (!fingerprint_index_close(index))
+		croak("fp_index_close: %s", Strerror(errno));
+}
+
+SV *
+fp_to_binary(...)
+	CODE:
+{
+	RETVAL = fp_encode(&ST(0), items, fingerprint_to_binary,
+			   FINGERPRINT_BINARY_SIZE, "fp_to_binary");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_from_binary(text)
+	SV *text
+	PPCODE:
+{
+	fingerprint_t *tmp;
+	int            n;
+	int            i;
+
+	n = fp_decode(text, fp_from_binary, FINGERPRINT_BINARY_SIZE,
+		      "fp_from_binary", &tmp);
+
+	EXTEND(SP, n);
+	for (i = 0; i < n; i++)
+		PUSHs(sv_2mortal(fp_new_sv(tmp[i])));
+
+	Safefree(tmp);
+}
+
+SV *
+fp_to_hex(...)
+	CODE:
+{
+	RETVAL = fp_encode(&ST(0), items, fingerprint_to_hex,
+			   FINGERPRINT_HEX_SIZE, "fp_to_hex");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_from_hex(text)
+	SV *text
+	PPCODE:
+{
+	fingerprint_t *tmp;
+	int            n;
+	int            i;
+
+	n = fp_decode(text, fingerprint_from_hex, FINGERPRINT_HEX_SIZE,
+		      "fp_from_hex", &tmp);
+
+	EXTEND(SP, n);
+	for (i = 0; i < n; i++)
+		PUSHs(sv_2mortal(fp_new_sv(tmp[i])));
+
+	Safefree(tmp);
+}
+
+SV *
+fp_to_base32(...)
+	CODE:
+{
+	RETVAL = fp_encode(&ST(0), items, fingerprint_to_base32,
+			   FINGERPRINT_BASE32_SIZE, "fp_to_base32");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_from_base32(text)
+	SV *text
+	PPCODE:
+{
+	fingerprint_t *tmp;
+	int            n;
+	int            i;
+
+	n = fp_decode(text, fingerprint_from_base32, FINGERPRINT_BASE32_SIZE,
+		      "fp_from_base32", &tmp);
+
+	EXTEND(SP, n);
+	for (i = 0; i < n; i++)
+		PUSHs(sv_2mortal(fp_new_sv(tmp[i])));
+
+	Safefree(tmp);
+}
+
+fingerprint_set_t *
+fp_set_new(text)
+	SV *text
+	CODE:
+{
+	fingerprint_t *tmp;
+	int            n;
+
+	n = fp_decode(text, fp_from_binary, FINGERPRINT_BINARY_SIZE,
+		      "fp_set_new", &tmp);
+	RETVAL = fingerprint_set_new(tmp, n);
+	Safefree(tmp);
+	if (RETVAL == NULL)
+		croak("fp_set_new: out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+int
+fp_set_contains(set, fp)
+	fingerprint_set_t *set
+	fingerprint_t *fp
+	CODE:
+{
+	RETVAL = fingerprint_set_contains(set, *fp);
+}
+	OUTPUT:
+	RETVAL
+
+UV
+fp_set_size(set)
+	fingerprint_set_t *set
+	CODE:
+{
+	RETVAL = fingerprint_set_size(set);
+}
+	OUTPUT:
+	RETVAL
+
+UV
+fp_set_bytes(set)
+	fingerprint_set_t *set
+	CODE:
+{
+	RETVAL = fingerprint_set_bytes(set);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_set_values(set)
+	fingerprint_set_t *set
+	CODE:
+{
+	fingerprint_set_iter_t  iter;
+	fingerprint_t           fp;
+	char                   *out;
+
+	RETVAL = newSV(fingerprint_set_size(set) * FINGERPRINT_BINARY_SIZE + 1);
+	SvPOK_on(RETVAL);
+	out = SvPVX(RETVAL);
+	fingerprint_set_iter_init(&iter, set);
+	while (fingerprint_set_iter_next(&iter, &fp)) {
+		fingerprint_to_binary(&fp, 1, out);
+		out += FINGERPRINT_BINARY_SIZE;
+	}
+	SvCUR_set(RETVAL, out - SvPVX(RETVAL));
+	*SvEND(RETVAL) = '\0';
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_set_intersect(set1, set2)
+	fingerprint_set_t *set1
+	fingerprint_set_t *set2
+	CODE:
+{
+	fingerprint_t *tmp;
+	unsigned long  n;
+
+	n = fingerprint_set_size(set1) < fingerprint_set_size(set2)
+		? fingerprint_set_size(set1) : fingerprint_set_size(set2);
+	New(0, tmp, n ? n : 1, fingerprint_t);
+	n = fingerprint_set_intersect(set1, set2, tmp);
+
+	RETVAL = newSV(n * FINGERPRINT_BINARY_SIZE + 1);
+	SvPOK_on(RETVAL);
+	fingerprint_to_binary(tmp, (int) n, SvPVX(RETVAL));
+	SvCUR_set(RETVAL, n * FINGERPRINT_BINARY_SIZE);
+	*SvEND(RETVAL) = '\0';
+
+	Safefree(tmp);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_set_free(set)
+	fingerprint_set_t *set
+	CODE:
+{
+	fingerprint_set_free(set);
+}
+
+fingerprint_pool_t *
+fp_pool_new(threads = 0)
+	int threads
+	CODE:
+{
+	RETVAL = fingerprint_pool_new(threads);
+	if (RETVAL == NULL)
+		croak("fp_pool_new: cannot start threads");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_pool_add_buffer(pool, tag, buffer, basis = NULL)
+	fingerprint_pool_t *pool
+	SV *tag
+	SV *buffer
+	SV *basis
+	CODE:
+{
+	fingerprint_basis_t *b;
+	fp_job_t            *job;
+	char                *text;
+	STRLEN               text_len;
+
+	b = fp_sv_basis(basis, "fp_pool_add_buffer");
+
+	New(0, job, 1, fp_job_t);
+	job->tag = newSVsv(tag);
+	job->data = newSVsv(buffer);
+	text = (char *) SvPV(job->data, text_len);
+
+	if (!fingerprint_pool_add_buffer(pool, b, text,
+					 (unsigned long) text_len, job)) {
+		SvREFCNT_dec(job->tag);
+		SvREFCNT_dec(job->data);
+		Safefree(job);
+		croak("fp_pool_add_buffer: cannot add job");
+	}
+}
+
+void
+fp_pool_add_file(pool, tag, path, basis = NULL)
+	fingerprint_pool_t *pool
+	SV *tag
+	char *path
+	SV *basis
+	CODE:
+{
+	fingerprint_basis_t *b;
+	fp_job_t            *job;
+
+	b = fp_sv_basis(basis, "fp_pool_add_file");
+
+	New(0, job, 1, fp_job_t);
+	job->tag = newSVsv(tag);
+	job->data = NULL;
+
+	if (!fingerprint_pool_add_file(pool, b, path, job)) {
+		SvREFCNT_dec(job->tag);
+		Safefree(job);
+		croak("fp_pool_add_file: cannot add job");
+	}
+}
+
+void
+fp_pool_wait(pool)
+	fingerprint_pool_t *pool
+	PPCODE:
+{
+	fingerprint_pool_result_t  result;
+	SV                        *out[3];
+
+	if (fingerprint_pool_wait(pool, &result)) {
+		fp_result_svs(&result, out);
+		EXTEND(SP, 3);
+		PUSHs(out[0]);
+		PUSHs(out[1]);
+		PUSHs(out[2]);
+	}
+}
+
+void
+fp_pool_poll(pool)
+	fingerprint_pool_t *pool
+	PPCODE:
+{
+	fingerprint_pool_result_t  result;
+	SV                        *out[3];
+
+	if (fingerprint_pool_poll(pool, &result)) {
+		fp_result_svs(&result, out);
+		EXTEND(SP, 3);
+		PUSHs(out[0]);
+		PUSHs(out[1]);
+		PUSHs(out[2]);
+	}
+}
+
+void
+fp_pool_cancel(pool)
+	fingerprint_pool_t *pool
+	CODE:
+{
+	fingerprint_pool_cancel(pool);
+}
+
+UV
+fp_pool_pending(pool)
+	fingerprint_pool_t *pool
+	CODE:
+{
+	RETVAL = fingerprint_pool_pending(pool);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_pool_free(pool)
+	fingerprint_pool_t *pool
+	CODE:
+{
+	fingerprint_pool_result_t  result;
+	fp_job_t                  *job;
+
+	fingerprint_pool_cancel(pool);
+	while (fingerprint_pool_wait(pool, &result)) {
+		job = (fp_job_t *) result.arg;
+		SvREFCNT_dec(job->tag);
+		if (job->data)
+			SvREFCNT_dec(job->data);
+		Safefree(job);
+	}
+	fingerprint_pool_free(pool);
+}
+
+fingerprint_ctx_t *
+fp_ctx_new(basis = NULL)
+	SV *basis
+	CODE:
+{
+	New(0, RETVAL, 1, fingerprint_ctx_t);
+	fingerprint_ctx_init(RETVAL, fp_sv_basis(basis, "fp_ctx_new"));
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_ctx_update(ctx, ...)
+	fingerprint_ctx_t *ctx
+	CODE:
+{
+	const char *buffer;
+	STRLEN      len;
+	int         i;
+
+	for (i = 1; i < items; i++) {
+		buffer = SvPV_const(ST(i), len);
+		fp_ctx_add(ctx, buffer, len);
+	}
+}
+
+SV *
+fp_ctx_final(ctx)
+	fingerprint_ctx_t *ctx
+	CODE:
+{
+	RETVAL = fp_new_sv(fingerprint_ctx_final(ctx));
+}
+	OUTPUT:
+	RETVAL
+
+UV
+fp_ctx_length(ctx)
+	fingerprint_ctx_t *ctx
+	CODE:
+{
+	RETVAL = ctx->length;
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_ctx_save(ctx)
+	fingerprint_ctx_t *ctx
+	CODE:
+{
+	fingerprint_byte_t state[FINGERPRINT_CTX_STATE_SIZE];
+
+	fingerprint_ctx_save(ctx, state);
+	RETVAL = newSVpvn((char *) state, sizeof(state));
+}
+	OUTPUT:
+	RETVAL
+
+fingerprint_ctx_t *
+fp_ctx_restore(state, basis = NULL)
+	SV *state
+	SV *basis
+	CODE:
+{
+	const char        *text;
+	STRLEN             text_len;
+	fingerprint_ctx_t  ctx;
+
+	text = SvPV_const(state, text_len);
+	if (!fingerprint_ctx_restore(&ctx, fp_sv_basis(basis, "fp_ctx_restore"),
+				     (const fingerprint_byte_t *) text,
+				     (unsigned long) text_len))
+		croak("fp_ctx_restore: state not saved by fp_ctx_save "
+		      "with this basis");
+	New(0, RETVAL, 1, fingerprint_ctx_t);
+	*RETVAL = ctx;
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_ctx_free(ctx)
+	fingerprint_ctx_t *ctx
+	CODE:
+{
+	Safefree(ctx);
+}
+
+fingerprint_prefix_t *
+fp_prefix_new(buffer, basis = NULL)
+	SV *buffer
+	SV *basis
+	CODE:
+{
+	const char *text;
+	STRLEN      text_len;
+
+	text = SvPV_const(buffer, text_len);
+	RETVAL = fingerprint_prefix_new(fp_sv_basis(basis, "fp_prefix_new"),
+					text, (unsigned long) text_len);
+	if (RETVAL == NULL)
+		croak("fp_prefix_new: out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_prefix_range(prefix, offset, length = NULL)
+	fingerprint_prefix_t *prefix
+	IV offset
+	SV *length
+	CODE:
+{
+	STRLEN start;
+	STRLEN n;
+
+	fp_resolve_range(fingerprint_prefix_size(prefix), offset, length,
+			 "fp_prefix_range", &start, &n);
+	RETVAL = fp_new_sv(fingerprint_prefix_range(prefix, start, start + n));
+}
+	OUTPUT:
+	RETVAL
+
+UV
+fp_prefix_size(prefix)
+	fingerprint_prefix_t *prefix
+	CODE:
+{
+	RETVAL = fingerprint_prefix_size(prefix);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_prefix_free(prefix)
+	fingerprint_prefix_t *prefix
+	CODE:
+{
+	fingerprint_prefix_free(prefix);
+}
+
+SV *
+fp_update_range(fp, size, offset, old, new, basis = NULL)
+	fingerprint_t *fp
+	UV size
+	UV offset
+	SV *old
+	SV *new
+	SV *basis
+	CODE:
+{
+	const char *old_text;
+	const char *new_text;
+	STRLEN      old_len;
+	STRLEN      new_len;
+
+	old_text = SvPV_const(old, old_len);
+	new_text = SvPV_const(new, new_len);
+	if (old_len != new_len)
+		croak("fp_update_range: old and new differ in length");
+	if (offset > size || old_len > size - offset)
+		croak("fp_update_range: range outside text");
+	RETVAL = fp_new_sv(fingerprint_basis_update_range(
+				   fp_sv_basis(basis, "fp_update_range"), *fp,
+				   (unsigned long) size,
+				   (unsigned long) offset, old_text, new_text,
+				   (unsigned long) old_len));
+}
+	OUTPUT:
+	RETVAL
+
+fingerprint_chunker_t *
+fp_chunker_new(window, min_size, avg_size, max_size, basis = NULL)
+	int window
+	unsigned long min_size
+	unsigned long avg_size
+	unsigned long max_size
+	SV *basis
+	CODE:
+{
+	RETVAL = fingerprint_chunker_new(fp_sv_basis(basis, "fp_chunker_new"),
+					 window, min_size, avg_size, max_size);
+	if (RETVAL == NULL)
+		croak("fp_chunker_new: bad size or out of memory");
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_chunker_split(chunker, buffer, threads = 0)
+	fingerprint_chunker_t *chunker
+	SV *buffer
+	int threads
 	PPCODE:
 {
-	fingerprint_init();
+	fingerprint_chunk_t *chunks;
+	unsigned long        count;
+	unsigned long        i;
+	const char          *text;
+	STRLEN               text_len;
+
+	text = SvPV_const(buffer, text_len);
+	if (!fingerprint_chunker_split(chunker, text, (unsigned long) text_len,
+				       threads, &chunks, &count))
+		croak("fp_chunker_split: out of memory");
+
+	EXTEND(SP, (SSize_t) (3 * count));
+	for (i = 0; i < count; i++) {
+		PUSHs(sv_2mortal(newSVuv(chunks[i].offset)));
+		PUSHs(sv_2mortal(newSVuv(chunks[i].size)));
+		PUSHs(sv_2mortal(fp_new_sv(chunks[i].fp)));
+	}
+	free(chunks);
 }
 
-fingerprint_t *
-fp_buffer(buffer)
+void
+fp_chunker_free(chunker)
+	fingerprint_chunker_t *chunker
+	CODE:
+{
+	fingerprint_chunker_free(chunker);
+}
+
+fingerprint_store_t *
+fp_store_open(dir, basis = NULL)
+	char *dir
+	SV *basis
+	CODE:
+{
+	RETVAL = fingerprint_store_open(dir, fp_sv_basis(basis,
+							 "fp_store_open"));
+	if (RETVAL == NULL)
+		croak("fp_store_open: cannot open %s: %s", dir,
+		      Strerror(errno));
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_store_put(store, buffer)
+	fingerprint_store_t *store
 	SV *buffer
 	CODE:
 {
-	fingerprint_t *f; 
-	char          *text;
-	fingerprint_t  tmp;
+	fingerprint_t  fp;
+	const char    *text;
 	STRLEN         text_len;
 
-	New(0, f, 1, fingerprint_t);
+	text = SvPV_const(buffer, text_len);
+	if (!fingerprint_store_put(store, text, (unsigned long) text_len, &fp))
+		croak("fp_store_put: %s", Strerror(errno));
+	RETVAL = fp_new_sv(fp);
+}
+	OUTPUT:
+	RETVAL
 
-	text = (char *) SvPV(buffer, text_len);
-	
-	tmp = fingerprint_from_buffer(text, (int) text_len);
-	memcpy(f, &tmp, sizeof(fingerprint_t));
-	
-	RETVAL = f;
+SV *
+fp_store_get(store, fp)
+	fingerprint_store_t *store
+	fingerprint_t *fp
+	CODE:
+{
+	fingerprint_store_view_t *view;
+	int                       found;
+
+	New(0, view, 1, fingerprint_store_view_t);
+	found = fingerprint_store_get(store, *fp, view);
+	if (found != 1) {
+		Safefree(view);
+		if (found < 0)
+			croak("fp_store_get: %s", Strerror(errno));
+		XSRETURN_UNDEF;
+	}
+	RETVAL = fp_store_view_sv(aTHX_ view);
 }
 	OUTPUT:
 	RETVAL
 
-int
-fp_compare(f1, f2)
-	fingerprint_t *f1
-	fingerprint_t *f2
+SV *
+fp_store_ref(store, fp)
+	fingerprint_store_t *store
+	fingerprint_t *fp
 	CODE:
 {
-#if FINGERPRINT_USE_INTEGRAL_TYPE
-	RETVAL = fingerprint_equal_f(*f1, *f2);
-#else
-	RETVAL = fingerprint_equal(*f1, *f2);
-#endif
+	long refs = fingerprint_store_ref(store, *fp);
+
+	RETVAL = refs < 0 ? &PL_sv_undef : newSViv(refs);
 }
 	OUTPUT:
 	RETVAL
 
-fingerprint_t *
-fp_combine(f1, f2)
-	fingerprint_t *f1
-	fingerprint_t *f2
+SV *
+fp_store_unref(store, fp)
+	fingerprint_store_t *store
+	fingerprint_t *fp
 	CODE:
 {
-	fingerprint_t *f;
-	fingerprint_t  tmp;
+	long refs = fingerprint_store_unref(store, *fp);
 
-	New(0, f, 1, fingerprint_t);
-	
-	tmp = fingerprint_combine(*f1, *f2);
-	memcpy(f, &tmp, sizeof(fingerprint_t));
+	RETVAL = refs < 0 ? &PL_sv_undef : newSViv(refs);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_store_flush(store)
+	fingerprint_store_t *store
+	CODE:
+{
+	if (!fingerprint_store_flush(store))
+		croak("fp_store_flush: %s", Strerror(errno));
+}
 
-	RETVAL = f;
+long
+fp_store_compact(store, waste = 0.5)
+	fingerprint_store_t *store
+	double waste
+	CODE:
+{
+	RETVAL = fingerprint_store_compact(store, waste);
+	if (RETVAL < 0)
+		croak("fp_store_compact: %s", Strerror(errno));
 }
 	OUTPUT:
 	RETVAL
 
-unsigned int
-fp_hash(fp)
+void
+fp_store_stats(store)
+	fingerprint_store_t *store
+	PPCODE:
+{
+	unsigned long chunks;
+	unsigned long live;
+	unsigned long total;
+	unsigned long packs;
+
+	fingerprint_store_stats(store, &chunks, &live, &total, &packs);
+	EXTEND(SP, 4);
+	PUSHs(sv_2mortal(newSVuv(chunks)));
+	PUSHs(sv_2mortal(newSVuv(live)));
+	PUSHs(sv_2mortal(newSVuv(total)));
+	PUSHs(sv_2mortal(newSVuv(packs)));
+}
+
+void
+fp_store_close(store)
+	fingerprint_store_t *store
+	CODE:
+{
+	if (!fingerprint_store_close(store))
+		croak("fp_store_close: %s", Strerror(errno));
+}
+
+SV *
+fp_signature(buffer, block, basis = NULL)
+	SV *buffer
+	int block
+	SV *basis
+	CODE:
+{
+	fingerprint_signature_t *sig;
+	const char              *text;
+	STRLEN                   text_len;
+
+	text = SvPV_const(buffer, text_len);
+	sig = fingerprint_signature_new(fp_sv_basis(basis, "fp_signature"),
+					text, (unsigned long) text_len, block);
+	if (sig == NULL)
+		croak("fp_signature: bad block size or out of memory");
+	RETVAL = newSV(fingerprint_signature_size(sig) + 1);
+	fingerprint_signature_save(sig, SvPVX(RETVAL));
+	SvCUR_set(RETVAL, fingerprint_signature_size(sig));
+	*SvEND(RETVAL) = '\0';
+	SvPOK_on(RETVAL);
+	fingerprint_signature_free(sig);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_delta(signature, buffer, basis = NULL)
+	SV *signature
+	SV *buffer
+	SV *basis
+	CODE:
+{
+	fingerprint_signature_t *sig;
+	const char              *text;
+	STRLEN                   text_len;
+	char                    *delta;
+	unsigned long            delta_size;
+	int                      ok;
+
+	text = SvPV_const(signature, text_len);
+	sig = fingerprint_signature_load(fp_sv_basis(basis, "fp_delta"),
+					 text, (unsigned long) text_len);
+	if (sig == NULL)
+		croak("fp_delta: not a signature with this basis, "
+		      "or out of memory");
+	text = SvPV_const(buffer, text_len);
+	ok = fingerprint_delta_new(sig, text, (unsigned long) text_len,
+				   &delta, &delta_size);
+	fingerprint_signature_free(sig);
+	if (!ok)
+		croak("fp_delta: out of memory");
+	RETVAL = newSVpvn(delta, delta_size);
+	free(delta);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_patch(old, delta, basis = NULL)
+	SV *old
+	SV *delta
+	SV *basis
+	CODE:
+{
+	const char    *old_text;
+	STRLEN         old_len;
+	const char    *text;
+	STRLEN         text_len;
+	char          *out;
+	unsigned long  out_size;
+
+	old_text = SvPV_const(old, old_len);
+	text = SvPV_const(delta, text_len);
+	if (!fingerprint_delta_apply(fp_sv_basis(basis, "fp_patch"),
+				     old_text, (unsigned long) old_len,
+				     text, (unsigned long) text_len,
+				     &out, &out_size))
+		croak("fp_patch: delta does not apply to this text");
+	RETVAL = newSVpvn(out, out_size);
+	free(out);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_deep(data)
+	SV *data
+	CODE:
+{
+	fp_deep_t          d;
+	fingerprint_ctx_t  ctx;
+	int                i;
+
+	for (i = 0; i < FP_DEEP_TAGS; i++)
+		d.tag[i] = fingerprint_from_text(fp_deep_tag_name[i]);
+	d.seen = sv_2mortal(newSV(64 * sizeof(fp_deep_seen_t)));
+	Zero(SvPVX(d.seen), 64, fp_deep_seen_t);
+	d.seen_mask = 63;
+	d.depth = 0;
+	d.keys = sv_2mortal(newSV(64 * sizeof(fp_deep_key_t)));
+	d.keys_used = 0;
+	d.used = 0;
+
+	fingerprint_ctx_init(&ctx, NULL);
+	fp_deep_put_value(aTHX_ &d, &ctx, data);
+	fp_deep_flush(&d, &ctx);
+	RETVAL = fp_new_sv(fingerprint_ctx_final(&ctx));
+}
+	OUTPUT:
+	RETVAL
+
+fingerprint_cache_t *
+fp_cache_new(entries, value_size, shards = 0)
+	unsigned long entries
+	unsigned long value_size
+	int shards
+	CODE:
+{
+	RETVAL = fingerprint_cache_new(entries, value_size, shards);
+	if (RETVAL == NULL)
+		croak("fp_cache_new: cannot make a cache of %lu entries "
+		      "of %lu bytes", entries, value_size);
+}
+	OUTPUT:
+	RETVAL
+
+SV *
+fp_cache_get(cache, fp)
+	fingerprint_cache_t *cache
 	fingerprint_t *fp
 	CODE:
 {
-	RETVAL = fingerprint_hash(*fp);
+	unsigned long size;
+
+	RETVAL = newSV(fingerprint_cache_value_size(cache) + 1);
+	if (fingerprint_cache_get(cache, *fp, SvPVX(RETVAL), &size)) {
+		SvPOK_on(RETVAL);
+		SvCUR_set(RETVAL, size);
+		*SvEND(RETVAL) = '\0';
+	} else {
+		SvREFCNT_dec(RETVAL);
+		RETVAL = &PL_sv_undef;
+	}
 }
 	OUTPUT:
 	RETVAL
 
 void
-fp_free(fp)
+fp_cache_put(cache, fp, value)
+	fingerprint_cache_t *cache
+	fingerprint_t *fp
+	SV *value
+	CODE:
+{
+	const char *text;
+	STRLEN      text_len;
+
+	text = SvPV_const(value, text_len);
+	if (!fingerprint_cache_put(cache, *fp, text, (unsigned long) text_len))
+		croak("fp_cache_put: value longer than %lu bytes",
+		      fingerprint_cache_value_size(cache));
+}
+
+int
+fp_cache_remove(cache, fp)
+	fingerprint_cache_t *cache
 	fingerprint_t *fp
 	CODE:
 {
-	Safefree(fp);
+	RETVAL = fingerprint_cache_remove(cache, *fp);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_cache_clear(cache)
+	fingerprint_cache_t *cache
+	CODE:
+{
+	fingerprint_cache_clear(cache);
+}
+
+UV
+fp_cache_count(cache)
+	fingerprint_cache_t *cache
+	CODE:
+{
+	RETVAL = fingerprint_cache_count(cache);
+}
+	OUTPUT:
+	RETVAL
+
+UV
+fp_cache_bytes(cache)
+	fingerprint_cache_t *cache
+	CODE:
+{
+	RETVAL = fingerprint_cache_bytes(cache);
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_cache_stats(cache)
+	fingerprint_cache_t *cache
+	PPCODE:
+{
+	unsigned long hits;
+	unsigned long misses;
+
+	fingerprint_cache_stats(cache, &hits, &misses);
+	EXTEND(SP, 2);
+	PUSHs(sv_2mortal(newSVuv(hits)));
+	PUSHs(sv_2mortal(newSVuv(misses)));
+}
+
+void
+fp_cache_free(cache)
+	fingerprint_cache_t *cache
+	CODE:
+{
+	fingerprint_cache_free(cache);
+}
+
+#ifdef PERLIO_LAYERS
+
+SV *
+fp_layer_fingerprint(fh)
+	PerlIO *fh
+	CODE:
+{
+	PerlIO            *f;
+	fingerprint_ctx_t  ctx;
+
+	f = fp_layer_find(aTHX_ fh, "fp_layer_fingerprint");
+	ctx = PerlIOSelf(f, fp_layer_t)->ctx;
+	fp_layer_pending(f, &ctx);
+	RETVAL = fp_new_sv(fingerprint_ctx_final(&ctx));
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_layer_reset(fh)
+	PerlIO *fh
+	CODE:
+{
+	PerlIO     *f;
+	fp_layer_t *l;
+
+	f = fp_layer_find(aTHX_ fh, "fp_layer_reset");
+	l = PerlIOSelf(f, fp_layer_t);
+	if (PerlIOBase(f)->flags & PERLIO_F_WRBUF)
+		PerlIO_flush(f);
+	fingerprint_ctx_init(&l->ctx, NULL);
+	l->mark = (PerlIOBase(f)->flags & PERLIO_F_RDBUF) ? l->base.ptr : NULL;
+}
+
+SV *
+fp_layer_save(fh)
+	PerlIO *fh
+	CODE:
+{
+	PerlIO             *f;
+	fingerprint_ctx_t   ctx;
+	fingerprint_byte_t  state[FINGERPRINT_CTX_STATE_SIZE];
+
+	f = fp_layer_find(aTHX_ fh, "fp_layer_save");
+	ctx = PerlIOSelf(f, fp_layer_t)->ctx;
+	fp_layer_pending(f, &ctx);
+	fingerprint_ctx_save(&ctx, state);
+	RETVAL = newSVpvn((char *) state, sizeof(state));
+}
+	OUTPUT:
+	RETVAL
+
+void
+fp_layer_restore(fh, state)
+	PerlIO *fh
+	SV *state
+	CODE:
+{
+	PerlIO            *f;
+	fp_layer_t        *l;
+	const char        *text;
+	STRLEN             text_len;
+	fingerprint_ctx_t  ctx;
+
+	f = fp_layer_find(aTHX_ fh, "fp_layer_restore");
+	l = PerlIOSelf(f, fp_layer_t);
+	text = SvPV_const(state, text_len);
+	if (!fingerprint_ctx_restore(&ctx, NULL,
+				     (const fingerprint_byte_t *) text,
+				     (unsigned long) text_len))
+		croak("fp_layer_restore: state not saved by fp_layer_save");
+	if (PerlIOBase(f)->flags & PERLIO_F_WRBUF)
+		PerlIO_flush(f);
+	l->ctx = ctx;
+	l->mark = (PerlIOBase(f)->flags & PERLIO_F_RDBUF) ? l->base.ptr : NULL;
 }
+
+#endif /* PERLIO_LAYERS */
@@ -0,0 +1,494 @@
+/***********************************************************************
+
+ File:   cache.c
+
+ Contents: A cache of values keyed by fingerprints.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+/* CACHE_THREADS is 1 if each shard has a lock.  */
+
+#if !defined(FINGERPRINT_NO_THREADS) && !defined(_WIN32)
+#define CACHE_THREADS 1
+#include <pthread.h>
+#else /* !(!defined(FINGERPRINT_NO_THREADS) && ...) */
+#define CACHE_THREADS 0
+#endif /* !defined(FINGERPRINT_NO_THREADS) && ... */
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* CACHE_SHARDS is the number of shards if none is given, and
+   CACHE_MAX_SHARDS the most allowed.  */
+
+#define CACHE_SHARDS 16
+#define CACHE_MAX_SHARDS 4096
+
+/* CACHE_LINE is the size of a cache line, by which shards are kept
+   apart so that their locks do not share lines.  */
+
+#define CACHE_LINE 64
+
+/* CACHE_MAX_VALUE is the greatest value size, and CACHE_MAX_ENTRIES
+   the most values in a shard.  */
+
+#define CACHE_MAX_VALUE 0xffffffffUL
+#define CACHE_MAX_ENTRIES 0x3fffffffUL
+
+#if CACHE_THREADS
+#define CACHE_LOCK(shard) pthread_mutex_lock (&(shard)->lock)
+#define CACHE_UNLOCK(shard) pthread_mutex_unlock (&(shard)->lock)
+#else /* !CACHE_THREADS */
+#define CACHE_LOCK(shard) ((void) 0)
+#define CACHE_UNLOCK(shard) ((void) 0)
+#endif /* CACHE_THREADS */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+typedef fingerprint_byte_t byte_t;
+
+/* A cache_entry_t is the key and state of a value.  */
+
+typedef struct cache_entry_t {
+  byte_t        key[8]; /* The bytes of the fingerprint.  */
+  unsigned int  size;   /* The length of the value.  */
+  unsigned int  next;   /* If the entry is free, the next free entry
+                           plus one, or zero.  */
+  unsigned int  referenced;
+                        /* The bit of the CLOCK algorithm.  */
+} cache_entry_t;
+
+/* A cache_shard_t is a shard.  */
+
+typedef struct cache_shard_t {
+#if CACHE_THREADS
+  pthread_mutex_t
+                lock;   /* Guards the shard.  */
+#endif /* CACHE_THREADS */
+  cache_entry_t*
+                entry;  /* The entries.  */
+  byte_t*       value;  /* The values, VALUE_SIZE bytes apart.  */
+  unsigned int* slot;   /* A hash table of the entries; each slot holds
+                           the index of an entry plus one, or zero.  */
+  unsigned long mask;   /* The number of slots less one.  */
+  unsigned long top;    /* The number of entries ever used.  */
+  unsigned long count;  /* The number of entries in use.  */
+  unsigned int  free;   /* The first free entry below TOP, plus one, or
+                           zero.  */
+  unsigned long hand;   /* The hand of the CLOCK algorithm.  */
+  unsigned long hits;
+  unsigned long misses;
+} cache_shard_t;
+
+/* A cache_padded_t is a shard, padded to a whole number of cache
+   lines.  */
+
+typedef union cache_padded_t {
+  cache_shard_t shard;
+  char          pad[(sizeof (cache_shard_t) + CACHE_LINE - 1)
+                    / CACHE_LINE * CACHE_LINE];
+} cache_padded_t;
+
+struct fingerprint_cache_t {
+  cache_padded_t*
+                shard;  /* The shards.  */
+  void*         block;  /* The memory of SHARD, before alignment.  */
+  unsigned long shards; /* The number of shards.  */
+  int           shard_bits;
+                        /* The base 2 logarithm of SHARDS.  */
+  unsigned long capacity;
+                        /* The number of entries of each shard.  */
+  unsigned long value_size;
+                        /* The most bytes in a value.  */
+  unsigned long bytes;  /* The memory used.  */
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Return a hash of KEY.  The fingerprints of short texts are close to
+   the texts themselves, so all the bits of the key are mixed.  */
+
+static unsigned int
+cache_hash (const byte_t* key)
+{
+  unsigned int lo = key[0] | key[1] << 8 | key[2] << 16
+    | (unsigned int) key[3] << 24;
+  unsigned int hi = key[4] | key[5] << 8 | key[6] << 16
+    | (unsigned int) key[7] << 24;
+  unsigned int h;
+
+  h = (lo ^ (hi >> 16 | hi << 16)) * 0x9e3779b1U;
+  h ^= h >> 15;
+  h = (h ^ hi) * 0x85ebca6bU;
+  h ^= h >> 13;
+  return h & 0xffffffffU;
+}
+
+/* Return the shard of CACHE for the hash H.  */
+
+static cache_shard_t*
+cache_shard (const fingerprint_cache_t* cache, unsigned int h)
+{
+  if (cache->shard_bits == 0)
+    return &cache->shard[0].shard;
+  return &cache->shard[h >> (32 - cache->shard_bits)].shard;
+}
+
+/* Return the slot of KEY, of hash H, in SHARD: either the slot of its
+   entry, or the empty slot where it would go.  */
+
+static unsigned long
+cache_slot (const cache_shard_t* shard, const byte_t* key, unsigned int h)
+{
+  unsigned long s;
+
+  for (s = h & shard->mask;
+       shard->slot[s]
+         && memcmp (shard->entry[shard->slot[s] - 1].key, key, 8) != 0;
+       s = (s + 1) & shard->mask)
+    ;
+  return s;
+}
+
+/* Empty slot S of SHARD, moving back the slots after it which would
+   otherwise not be found.  */
+
+static void
+cache_unlink (cache_shard_t* shard, unsigned long s)
+{
+  unsigned long t = s;
+  unsigned long home;
+
+  for (;;) {
+    t = (t + 1) & shard->mask;
+    if (!shard->slot[t])
+      break;
+    home = cache_hash (shard->entry[shard->slot[t] - 1].key)
+      & shard->mask;
+
+    /* Move the entry in slot T to slot S unless its home lies
+       cyclically in (S, T].  */
+    if (s <= t ? (home <= s || home > t) : (home <= s && home > t)) {
+      shard->slot[s] = shard->slot[t];
+      s = t;
+    }
+  }
+  shard->slot[s] = 0;
+}
+
+/* Free entry E of SHARD, whose slot is S.  */
+
+static void
+cache_release (cache_shard_t* shard, unsigned long e, unsigned long s)
+{
+  cache_unlink (shard, s);
+  shard->entry[e].next = shard->free;
+  shard->free = (unsigned int) (e + 1);
+  --shard->count;
+}
+
+/* Return a free entry of SHARD, of CAPACITY entries, making one by
+   removing a value if there is none.  */
+
+static unsigned long
+cache_allocate (cache_shard_t* shard, unsigned long capacity)
+{
+  unsigned long e;
+
+  if (shard->free) {
+    e = shard->free - 1;
+    shard->free = shard->entry[e].next;
+    return e;
+  }
+  if (shard->top < capacity)
+    return shard->top++;
+
+  /* Every entry is in use: sweep the hand round to one whose bit is
+     clear, clearing bits as it goes.  */
+  while (shard->entry[shard->hand].referenced) {
+    shard->entry[shard->hand].referenced = 0;
+    shard->hand = shard->hand + 1 < capacity ? shard->hand + 1 : 0;
+  }
+  e = shard->hand;
+  shard->hand = shard->hand + 1 < capacity ? shard->hand + 1 : 0;
+  cache_unlink (shard,
+                cache_slot (shard, shard->entry[e].key,
+                            cache_hash (shard->entry[e].key)));
+  --shard->count;
+  return e;
+}
+
+/* Empty SHARD.  */
+
+static void
+cache_reset (cache_shard_t* shard)
+{
+  memset (shard->slot, 0, (shard->mask + 1) * sizeof (unsigned int));
+  shard->top = 0;
+  shard->count = 0;
+  shard->free = 0;
+  shard->hand = 0;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_cache_t*
+fingerprint_cache_new (unsigned long entries,
+                       unsigned long value_size,
+                       int           shards)
+{
+  fingerprint_cache_t* cache;
+  unsigned long slots;
+  unsigned long i;
+
+  if (entries == 0 || value_size > CACHE_MAX_VALUE)
+    return NULL;
+  cache = (fingerprint_cache_t*) calloc (1, sizeof (*cache));
+  if (!cache)
+    return NULL;
+
+  if (shards <= 0)
+    shards = CACHE_SHARDS;
+  if (shards > CACHE_MAX_SHARDS)
+    shards = CACHE_MAX_SHARDS;
+  cache->shards = 1;
+  while (cache->shards < (unsigned long) shards) {
+    cache->shards *= 2;
+    ++cache->shard_bits;
+  }
+  cache->capacity = (entries + cache->shards - 1) / cache->shards;
+  if (cache->capacity > CACHE_MAX_ENTRIES) {
+    free (cache);
+    return NULL;
+  }
+  cache->value_size = value_size;
+  for (slots = 1; slots < 2 * cache->capacity; slots *= 2)
+    ;
+
+  cache->block = malloc (cache->shards * sizeof (cache_padded_t)
+                         + CACHE_LINE);
+  if (!cache->block) {
+    free (cache);
+    return NULL;
+  }
+  cache->shard = (cache_padded_t*)
+    (((size_t) cache->block + CACHE_LINE - 1) & ~(size_t) (CACHE_LINE - 1));
+  memset (cache->shard, 0, cache->shards * sizeof (cache_padded_t));
+  cache->bytes = sizeof (*cache) + cache->shards * sizeof (cache_padded_t)
+    + CACHE_LINE;
+
+  for (i = 0; i < cache->shards; ++i) {
+    cache_shard_t* shard = &cache->shard[i].shard;
+
+    shard->mask = slots - 1;
+    shard->entry = (cache_entry_t*)
+      malloc (cache->capacity * sizeof (cache_entry_t));
+    shard->value = (byte_t*)
+      malloc (cache->capacity * value_size + 1);
+    shard->slot = (unsigned int*) malloc (slots * sizeof (unsigned int));
+#if CACHE_THREADS
+    if (pthread_mutex_init (&shard->lock, NULL) != 0) {
+      free (shard->entry);
+      free (shard->value);
+      free (shard->slot);
+      shard->entry = NULL;
+      shard->value = NULL;
+      shard->slot = NULL;
+      cache->shards = i;
+      fingerprint_cache_free (cache);
+      return NULL;
+    }
+#endif /* CACHE_THREADS */
+    if (!shard->entry || !shard->value || !shard->slot) {
+      cache->shards = i + 1;
+      fingerprint_cache_free (cache);
+      return NULL;
+    }
+    cache_reset (shard);
+  }
+  cache->bytes += cache->shards
+    * (cache->capacity * (sizeof (cache_entry_t) + value_size) + 1
+       + slots * sizeof (unsigned int));
+  return cache;
+}
+
+void
+fingerprint_cache_free (fingerprint_cache_t* cache)
+{
+  unsigned long i;
+
+  if (!cache)
+    return;
+  for (i = 0; i < cache->shards; ++i) {
+    cache_shard_t* shard = &cache->shard[i].shard;
+
+#if CACHE_THREADS
+    pthread_mutex_destroy (&shard->lock);
+#endif /* CACHE_THREADS */
+    free (shard->entry);
+    free (shard->value);
+    free (shard->slot);
+  }
+  free (cache->block);
+  free (cache);
+}
+
+int
+fingerprint_cache_get (fingerprint_cache_t* cache,
+                       fingerprint_t        fp,
+                       void*                value,
+                       unsigned long*       size)
+{
+  const byte_t* key = FINGERPRINT_BYTE (fp);
+  unsigned int h = cache_hash (key);
+  cache_shard_t* shard = cache_shard (cache, h);
+  unsigned long s;
+  int found = 0;
+
+  CACHE_LOCK (shard);
+  s = cache_slot (shard, key, h);
+  if (shard->slot[s]) {
+    cache_entry_t* e = &shard->entry[shard->slot[s] - 1];
+
+    memcpy (value,
+            shard->value + (shard->slot[s] - 1) * cache->value_size,
+            e->size);
+    *size = e->size;
+    e->referenced = 1;
+    ++shard->hits;
+    found = 1;
+  } else
+    ++shard->misses;
+  CACHE_UNLOCK (shard);
+  return found;
+}
+
+int
+fingerprint_cache_put (fingerprint_cache_t* cache,
+                       fingerprint_t        fp,
+                       const void*          value,
+                       unsigned long        size)
+{
+  const byte_t* key = FINGERPRINT_BYTE (fp);
+  unsigned int h = cache_hash (key);
+  cache_shard_t* shard = cache_shard (cache, h);
+  unsigned long s;
+  unsigned long e;
+
+  if (size > cache->value_size)
+    return 0;
+
+  CACHE_LOCK (shard);
+  s = cache_slot (shard, key, h);
+  if (shard->slot[s])
+    e = shard->slot[s] - 1;
+  else {
+    e = cache_allocate (shard, cache->capacity);
+
+    /* Removing a value may have moved the slot.  */
+    s = cache_slot (shard, key, h);
+    shard->slot[s] = (unsigned int) (e + 1);
+    memcpy (shard->entry[e].key, key, 8);
+    shard->entry[e].referenced = 0;
+    ++shard->count;
+  }
+  memcpy (shard->value + e * cache->value_size, value, size);
+  shard->entry[e].size = (unsigned int) size;
+  CACHE_UNLOCK (shard);
+  return 1;
+}
+
+int
+fingerprint_cache_remove (fingerprint_cache_t* cache, fingerprint_t fp)
+{
+  const byte_t* key = FINGERPRINT_BYTE (fp);
+  unsigned int h = cache_hash (key);
+  cache_shard_t* shard = cache_shard (cache, h);
+  unsigned long s;
+  int found = 0;
+
+  CACHE_LOCK (shard);
+  s = cache_slot (shard, key, h);
+  if (shard->slot[s]) {
+    cache_release (shard, shard->slot[s] - 1, s);
+    found = 1;
+  }
+  CACHE_UNLOCK (shard);
+  return found;
+}
+
+void
+fingerprint_cache_clear (fingerprint_cache_t* cache)
+{
+  unsigned long i;
+
+  for (i = 0; i < cache->shards; ++i) {
+    cache_shard_t* shard = &cache->shard[i].shard;
+
+    CACHE_LOCK (shard);
+    cache_reset (shard);
+    CACHE_UNLOCK (shard);
+  }
+}
+
+unsigned long
+fingerprint_cache_count (fingerprint_cache_t* cache)
+{
+  unsigned long count = 0;
+  unsigned long i;
+
+  for (i = 0; i < cache->shards; ++i) {
+    cache_shard_t* shard = &cache->shard[i].shard;
+
+    CACHE_LOCK (shard);
+    count += shard->count;
+    CACHE_UNLOCK (shard);
+  }
+  return count;
+}
+
+unsigned long
+fingerprint_cache_value_size (const fingerprint_cache_t* cache)
+{
+  return cache->value_size;
+}
+
+unsigned long
+fingerprint_cache_bytes (const fingerprint_cache_t* cache)
+{
+  return cache->bytes;
+}
+
+void
+fingerprint_cache_stats (fingerprint_cache_t* cache,
+                         unsigned long*       hits,
+                         unsigned long*       misses)
+{
+  unsigned long i;
+
+  *hits = 0;
+  *misses = 0;
+  for (i = 0; i < cache->shards; ++i) {
+    cache_shard_t* shard = &cache->shard[i].shard;
+
+    CACHE_LOCK (shard);
+    *hits += shard->hits;
+    *misses += shard->misses;
+    CACHE_UNLOCK (shard);
+  }
+}
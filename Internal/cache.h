@@ -0,0 +1,110 @@
+/***********************************************************************
+
+ File:   cache.h
+
+ Contents: A cache of values keyed by fingerprints.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_CACHE_H
+#define FINGERPRINT_CACHE_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A cache holds up to a fixed number of values, each a string of bytes
+   no longer than a fixed size, keyed by fingerprints.  All its memory
+   is allocated when it is made, so that its size is known in advance
+   and storing a value allocates nothing.  When the cache is full, the
+   value to make way for a new one is chosen by the CLOCK algorithm, an
+   approximation of least recently used: each value has a bit which is
+   set when it is found, and a hand sweeps round the values, clearing
+   set bits, until it reaches one whose bit is clear.  A value newly
+   stored starts with its bit clear, so that a run of values used once
+   only displaces other such values.
+
+   The cache is split into shards, chosen by the bits of the key, each
+   with a hash table, values, hand and lock of its own, so that threads
+   using different shards do not wait for each other.  Each operation
+   takes constant time.  Where threads are not available, which is
+   assumed if FINGERPRINT_NO_THREADS is defined or the target is
+   Windows, a cache must be used by one thread at a time.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* The type fingerprint_cache_t is opaque.  */
+
+typedef struct fingerprint_cache_t fingerprint_cache_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return a new cache of at least ENTRIES values of up to VALUE_SIZE
+   bytes each, in SHARDS shards, or in 16 if SHARDS is not positive.
+   The number of shards is rounded up to a power of two.  Return NULL
+   if ENTRIES is zero, or if memory is exhausted.  */
+extern fingerprint_cache_t* fingerprint_cache_new (unsigned long entries,
+                                                   unsigned long value_size,
+                                                   int           shards);
+
+/* Release CACHE.  */
+extern void fingerprint_cache_free (fingerprint_cache_t* cache);
+
+/* If CACHE holds a value for FP, copy it to VALUE, which must have room
+   for the value size of CACHE, store its length in *SIZE, and return
+   non-zero; otherwise, return zero.  */
+extern int fingerprint_cache_get (fingerprint_cache_t* cache,
+                                  fingerprint_t        fp,
+                                  void*                value,
+                                  unsigned long*       size);
+
+/* Store the SIZE bytes of VALUE in CACHE for FP, replacing any value
+   for FP already there, and making room if need be.  Return zero if
+   SIZE is more than the value size of CACHE, and non-zero
+   otherwise.  */
+extern int fingerprint_cache_put (fingerprint_cache_t* cache,
+                                  fingerprint_t        fp,
+                                  const void*          value,
+                                  unsigned long        size);
+
+/* Remove the value for FP from CACHE.  Return non-zero if there was
+   one, and zero otherwise.  */
+extern int fingerprint_cache_remove (fingerprint_cache_t* cache,
+                                     fingerprint_t        fp);
+
+/* Remove all values from CACHE.  */
+extern void fingerprint_cache_clear (fingerprint_cache_t* cache);
+
+/* Return the number of values in CACHE.  */
+extern unsigned long fingerprint_cache_count (fingerprint_cache_t* cache);
+
+/* Return the value size of CACHE.  */
+extern unsigned long fingerprint_cache_value_size
+                        (const fingerprint_cache_t* cache);
+
+/* Return the number of bytes of memory used by CACHE.  */
+extern unsigned long fingerprint_cache_bytes
+                        (const fingerprint_cache_t* cache);
+
+/* Store in *HITS and *MISSES the numbers of calls to
+   fingerprint_cache_get on CACHE which found a value and which did
+   not.  */
+extern void fingerprint_cache_stats (fingerprint_cache_t* cache,
+                                     unsigned long*       hits,
+                                     unsigned long*       misses);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_CACHE_H */
@@ -0,0 +1,547 @@
+/***********************************************************************
+
+ File:   chunk.c
+
+ Contents: Content-defined chunking of a text, on several threads.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chunk.h"
+
+/* CHUNK_THREADS is 1 if segments are chunked on threads of their
+   own.  */
+
+#if !defined(FINGERPRINT_NO_THREADS) && !defined(_WIN32)
+#define CHUNK_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#else /* !(!defined(FINGERPRINT_NO_THREADS) && ...) */
+#define CHUNK_THREADS 0
+#endif /* !defined(FINGERPRINT_NO_THREADS) && ... */
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* CHUNK_BLOCK is the number of bytes whose window fingerprints are
+   computed at a time.  */
+
+#define CHUNK_BLOCK 4096
+
+/* CHUNK_MAX_THREADS bounds the number of threads, and CHUNK_MIN_SEGMENT
+   the length of a segment, below which threads cost more than they
+   save.  A segment is also at least twice the greatest chunk size, so
+   that the chunk which runs into a segment ends within it.  */
+
+#define CHUNK_MAX_THREADS 256
+#define CHUNK_MIN_SEGMENT 262144
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+struct fingerprint_chunker_t {
+  const fingerprint_basis_t*
+                basis;  /* The basis of the fingerprints.  */
+  int           window; /* The length of a window.  */
+  unsigned long min_size;
+                        /* The least length of a chunk.  */
+  unsigned long max_size;
+                        /* The greatest length of a chunk.  */
+  fingerprint_word_t
+                mask;   /* The bits which are clear in the value of
+                           the window at a candidate.  */
+};
+
+/* A chunk_list_t is a growing array of chunks, and a chunk_ends_t a
+   growing array of candidate ends.  */
+
+typedef struct chunk_list_t {
+  fingerprint_chunk_t*
+                item;
+  unsigned long count;
+  unsigned long room;
+} chunk_list_t;
+
+typedef struct chunk_ends_t {
+  unsigned long* item;
+  unsigned long count;
+  unsigned long room;
+} chunk_ends_t;
+
+/* A chunk_segment_t is the work of one thread on one segment.  */
+
+typedef struct chunk_segment_t {
+  const fingerprint_chunker_t*
+                chunker;
+  const char*   buffer; /* The text.  */
+  unsigned long size;   /* The length of the text.  */
+  unsigned long start;  /* The offset of the segment.  */
+  unsigned long end;    /* The offset of the end of the segment.  */
+  chunk_ends_t  ends;   /* The candidate ends in (START..END].  */
+  chunk_list_t  chunks; /* The chunks found from START, up to the first
+                           which ends at or after END.  */
+  int           failed; /* Non-zero if memory was exhausted.  */
+} chunk_segment_t;
+
+/* A chunk_fill_t is the work of one thread fingerprinting chunks
+   found while joining segments.  */
+
+typedef struct chunk_fill_t {
+  const fingerprint_chunker_t*
+                chunker;
+  const char*   buffer; /* The text.  */
+  fingerprint_chunk_t*
+                chunks; /* The chunks of the text.  */
+  const unsigned long*
+                which;  /* The indexes of the chunks to fingerprint.  */
+  unsigned long count;  /* The number of indexes.  */
+} chunk_fill_t;
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Return the value of the window whose fingerprint is FP, mixed as by
+   the finalizer of MurmurHash3, so that its low bits depend on every
+   byte of the window.  */
+
+static fingerprint_word_t
+chunk_value (const fingerprint_t* fp)
+{
+  fingerprint_word_t half[2];
+  fingerprint_word_t v;
+
+  memcpy (half, FINGERPRINT_BYTE (*fp), sizeof (half));
+  v = half[0] ^ (half[1] * 0x85ebca6bU);
+  v ^= v >> 16;
+  v *= 0xc2b2ae35U;
+  v ^= v >> 13;
+  v *= 0x846ca68bU;
+  return v ^ (v >> 16);
+}
+
+/* Append CHUNK to LIST, or return zero if memory is exhausted.  */
+
+static int
+chunk_push (chunk_list_t* list, const fingerprint_chunk_t* chunk)
+{
+  if (list->count == list->room) {
+    unsigned long room = list->room ? 2 * list->room : 64;
+    fingerprint_chunk_t* item = (fingerprint_chunk_t*)
+      realloc (list->item, room * sizeof (fingerprint_chunk_t));
+
+    if (!item)
+      return 0;
+    list->item = item;
+    list->room = room;
+  }
+  list->item[list->count++] = *chunk;
+  return 1;
+}
+
+/* Append END to ENDS, or return zero if memory is exhausted.  */
+
+static int
+chunk_push_end (chunk_ends_t* ends, unsigned long end)
+{
+  if (ends->count == ends->room) {
+    unsigned long room = ends->room ? 2 * ends->room : 64;
+    unsigned long* item = (unsigned long*)
+      realloc (ends->item, room * sizeof (unsigned long));
+
+    if (!item)
+      return 0;
+    ends->item = item;
+    ends->room = room;
+  }
+  ends->item[ends->count++] = end;
+  return 1;
+}
+
+/* Append to LIST the chunk of BUFFER from START up to END, with its
+   fingerprint with respect to BASIS, or return zero if memory is
+   exhausted.  */
+
+static int
+chunk_add (chunk_list_t* list, const fingerprint_basis_t* basis,
+           const char* buffer, unsigned long start, unsigned long end)
+{
+  fingerprint_chunk_t chunk;
+
+  chunk.offset = start;
+  chunk.size = end - start;
+  chunk.fp = fingerprint_basis_from_buffer (basis, buffer + start,
+                                            (int) chunk.size);
+  return chunk_push (list, &chunk);
+}
+
+/* Chunk the segment ARG, a chunk_segment_t.  The window fingerprints
+   of a block are computed first, and then the candidates among them
+   are tested; a chunk which ends in the block is fingerprinted at
+   once, while its last bytes are in the cache.  */
+
+static void*
+chunk_scan (void* arg)
+{
+  chunk_segment_t* seg = (chunk_segment_t*) arg;
+  const fingerprint_chunker_t* chunker = seg->chunker;
+  fingerprint_roller_t* roller;
+  fingerprint_t* window;
+  unsigned long  from;
+  unsigned long  at;
+  unsigned long  chunk_start = seg->start;
+
+  roller = fingerprint_roller_new (chunker->basis, chunker->window);
+  window = (fingerprint_t*) malloc (CHUNK_BLOCK * sizeof (fingerprint_t));
+  if (!roller || !window) {
+    seg->failed = 1;
+    goto done;
+  }
+
+  /* Prime the roller with the bytes before the segment, so that its
+     windows are those of a scan of the whole text.  */
+  from = seg->start > (unsigned long) chunker->window - 1
+         ? seg->start - (chunker->window - 1) : 0;
+  fingerprint_roller_update (roller, seg->buffer + from,
+                             (int) (seg->start - from), NULL);
+
+  for (at = seg->start; at < seg->size; at += CHUNK_BLOCK) {
+    int n = seg->size - at < CHUNK_BLOCK ? (int) (seg->size - at)
+                                         : CHUNK_BLOCK;
+    int i;
+
+    fingerprint_roller_update (roller, seg->buffer + at, n, window);
+    for (i = 0; i < n; ++i) {
+      unsigned long end = at + i + 1;
+      unsigned long len = end - chunk_start;
+      int hit = (chunk_value (&window[i]) & chunker->mask) == 0;
+
+      if (hit && end <= seg->end && !chunk_push_end (&seg->ends, end)) {
+        seg->failed = 1;
+        goto done;
+      }
+      if (len >= chunker->max_size || (hit && len >= chunker->min_size)) {
+        if (!chunk_add (&seg->chunks, chunker->basis, seg->buffer,
+                        chunk_start, end)) {
+          seg->failed = 1;
+          goto done;
+        }
+        chunk_start = end;
+        if (end >= seg->end)
+          goto done;
+      }
+    }
+  }
+
+  /* The segment runs to the end of the text.  */
+  if (chunk_start < seg->size
+      && !chunk_add (&seg->chunks, chunker->basis, seg->buffer,
+                     chunk_start, seg->size))
+    seg->failed = 1;
+
+ done:
+  free (window);
+  fingerprint_roller_free (roller);
+  return NULL;
+}
+
+/* Fingerprint the chunks of the chunk_fill_t ARG.  */
+
+static void*
+chunk_fill (void* arg)
+{
+  chunk_fill_t* fill = (chunk_fill_t*) arg;
+  unsigned long i;
+
+  for (i = 0; i < fill->count; ++i) {
+    fingerprint_chunk_t* chunk = &fill->chunks[fill->which[i]];
+
+    chunk->fp = fingerprint_basis_from_buffer (fill->chunker->basis,
+                                               fill->buffer + chunk->offset,
+                                               (int) chunk->size);
+  }
+  return NULL;
+}
+
+/* Run BODY on each of the N objects of SIZE bytes at ARG, each on a
+   thread of its own where possible, and wait for them all.  */
+
+static void
+chunk_run (void* (*body) (void*), void* arg, size_t size, int n)
+{
+#if CHUNK_THREADS
+  pthread_t thread[CHUNK_MAX_THREADS];
+  int       started[CHUNK_MAX_THREADS];
+  int       i;
+
+  for (i = 1; i < n; ++i)
+    started[i] = pthread_create (&thread[i], NULL, body,
+                                 (char*) arg + i * size) == 0;
+  if (n > 0)
+    body (arg);
+  for (i = 1; i < n; ++i)
+    if (started[i])
+      pthread_join (thread[i], NULL);
+    else
+      body ((char*) arg + i * size);
+#else /* !CHUNK_THREADS */
+  int i;
+
+  for (i = 0; i < n; ++i)
+    body ((char*) arg + i * size);
+#endif /* CHUNK_THREADS */
+}
+
+/* Return the number of threads to use for THREADS, as given to
+   fingerprint_chunker_split.  */
+
+static int
+chunk_threads (int threads)
+{
+#if CHUNK_THREADS
+  if (threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+#endif /* ifdef _SC_NPROCESSORS_ONLN */
+    if (threads <= 0)
+      threads = 1;
+  }
+  return threads > CHUNK_MAX_THREADS ? CHUNK_MAX_THREADS : threads;
+#else /* !CHUNK_THREADS */
+  return threads > 0 && threads < CHUNK_MAX_THREADS
+         ? threads : CHUNK_MAX_THREADS;
+#endif /* CHUNK_THREADS */
+}
+
+/* Return the index of the chunk of LIST which starts at OFFSET, or -1
+   if there is none.  */
+
+static long
+chunk_find (const chunk_list_t* list, unsigned long offset)
+{
+  unsigned long lo = 0;
+  unsigned long hi = list->count;
+
+  while (lo < hi) {
+    unsigned long mid = lo + (hi - lo) / 2;
+
+    if (list->item[mid].offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < list->count && list->item[lo].offset == offset ? (long) lo : -1;
+}
+
+/* Join the N chunked segments SEG into the chunks of the text in OUT,
+   and store in WHICH the indexes of the chunks of OUT which have still
+   to be fingerprinted.  Return the number of chunks, or -1 if memory
+   is exhausted.  */
+
+static long
+chunk_join (const fingerprint_chunker_t* chunker, chunk_segment_t* seg,
+            int n, chunk_list_t* out, chunk_ends_t* which)
+{
+  unsigned long size = seg[0].size;
+  unsigned long p = 0;
+  int           k = 0;
+  int           e = 0;
+  unsigned long ei = 0;
+
+  while (p < size) {
+    long found;
+
+    while (k + 1 < n && seg[k + 1].start <= p)
+      ++k;
+
+    /* Once the true chunking reaches an end the thread of this
+       segment also chose, it follows that thread's chunks.  */
+    found = chunk_find (&seg[k].chunks, p);
+    if (found >= 0) {
+      unsigned long i;
+
+      for (i = (unsigned long) found; i < seg[k].chunks.count; ++i)
+        if (!chunk_push (out, &seg[k].chunks.item[i]))
+          return -1;
+      p = out->item[out->count - 1].offset
+          + out->item[out->count - 1].size;
+      continue;
+    }
+
+    /* Otherwise, the next end is the first candidate far enough from
+       P, or the end of the longest chunk, taken from the candidates
+       of the segments in order.  */
+    {
+      fingerprint_chunk_t chunk;
+      unsigned long limit = size - p < chunker->max_size
+                            ? size : p + chunker->max_size;
+      unsigned long cut = limit;
+
+      for (;;) {
+        unsigned long c;
+
+        while (e < n && ei >= seg[e].ends.count) {
+          ++e;
+          ei = 0;
+        }
+        if (e >= n)
+          break;
+        c = seg[e].ends.item[ei];
+        if (c > limit)
+          break;
+        ++ei;
+        if (c > p && c - p >= chunker->min_size) {
+          cut = c;
+          break;
+        }
+      }
+
+      chunk.offset = p;
+      chunk.size = cut - p;
+      memset (&chunk.fp, 0, sizeof (chunk.fp));
+      if (!chunk_push (out, &chunk)
+          || !chunk_push_end (which, out->count - 1))
+        return -1;
+      p = cut;
+    }
+  }
+  return (long) out->count;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_chunker_t*
+fingerprint_chunker_new (const fingerprint_basis_t* basis,
+                         int                        window,
+                         unsigned long              min_size,
+                         unsigned long              avg_size,
+                         unsigned long              max_size)
+{
+  fingerprint_chunker_t* chunker;
+  fingerprint_word_t     bits = 1;
+
+  if (window <= 0 || avg_size == 0 || min_size > max_size || max_size == 0
+      || max_size > INT_MAX)
+    return NULL;
+
+  chunker = (fingerprint_chunker_t*) malloc (sizeof (*chunker));
+  if (!chunker)
+    return NULL;
+  while (bits <= avg_size / 2 && bits < 0x80000000U)
+    bits <<= 1;
+  chunker->basis = basis;
+  chunker->window = window;
+  chunker->min_size = min_size;
+  chunker->max_size = max_size;
+  chunker->mask = bits - 1;
+  return chunker;
+}
+
+void
+fingerprint_chunker_free (fingerprint_chunker_t* chunker)
+{
+  free (chunker);
+}
+
+int
+fingerprint_chunker_split (const fingerprint_chunker_t* chunker,
+                           const char*                  buffer,
+                           unsigned long                size,
+                           int                          threads,
+                           fingerprint_chunk_t**        chunks,
+                           unsigned long*               count)
+{
+  chunk_segment_t* seg;
+  chunk_fill_t*    fill = NULL;
+  chunk_list_t     out;
+  chunk_ends_t     which;
+  unsigned long    length;
+  unsigned long    least;
+  int              n;
+  int              i;
+  int              ok = 0;
+
+  memset (&out, 0, sizeof (out));
+  memset (&which, 0, sizeof (which));
+
+  /* Cut the text into segments of equal length, no shorter than the
+     least length of a segment.  */
+  n = chunk_threads (threads);
+  least = 2 * chunker->max_size > CHUNK_MIN_SEGMENT
+          ? 2 * chunker->max_size : CHUNK_MIN_SEGMENT;
+  if (size / least < (unsigned long) n)
+    n = size / least > 0 ? (int) (size / least) : 1;
+  length = size / n;
+
+  seg = (chunk_segment_t*) calloc (n, sizeof (chunk_segment_t));
+  if (!seg)
+    return 0;
+  for (i = 0; i < n; ++i) {
+    seg[i].chunker = chunker;
+    seg[i].buffer = buffer;
+    seg[i].size = size;
+    seg[i].start = i * length;
+    seg[i].end = i == n - 1 ? size : (i + 1) * length;
+  }
+
+  chunk_run (chunk_scan, seg, sizeof (chunk_segment_t), n);
+  for (i = 0; i < n; ++i)
+    if (seg[i].failed)
+      goto done;
+
+  if (n == 1) {
+    /* A single segment needs no joining.  */
+    out = seg[0].chunks;
+    memset (&seg[0].chunks, 0, sizeof (seg[0].chunks));
+  } else if (chunk_join (chunker, seg, n, &out, &which) < 0)
+    goto done;
+
+  /* Fingerprint the chunks found while joining, on as many threads as
+     there are chunks to share among them.  */
+  if (which.count > 0) {
+    int           m = which.count < (unsigned long) n ? (int) which.count : n;
+    unsigned long share = (which.count + m - 1) / m;
+
+    fill = (chunk_fill_t*) calloc (m, sizeof (chunk_fill_t));
+    if (!fill)
+      goto done;
+    for (i = 0; i < m; ++i) {
+      unsigned long first = i * share;
+
+      fill[i].chunker = chunker;
+      fill[i].buffer = buffer;
+      fill[i].chunks = out.item;
+      fill[i].which = which.item + first;
+      fill[i].count = first >= which.count ? 0
+                      : which.count - first < share
+                      ? which.count - first : share;
+    }
+    chunk_run (chunk_fill, fill, sizeof (chunk_fill_t), m);
+  }
+
+  *chunks = out.item;
+  *count = out.count;
+  out.item = NULL;
+  ok = 1;
+
+ done:
+  for (i = 0; i < n; ++i) {
+    free (seg[i].ends.item);
+    free (seg[i].chunks.item);
+  }
+  free (seg);
+  free (fill);
+  free (which.item);
+  free (out.item);
+  return ok;
+}
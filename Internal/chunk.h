@@ -0,0 +1,102 @@
+/***********************************************************************
+
+ File:   chunk.h
+
+ Contents: Content-defined chunking of a text, on several threads.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_CHUNK_H
+#define FINGERPRINT_CHUNK_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A chunker cuts a text into chunks whose ends are chosen by the
+   content of the text, so that an insertion or deletion moves only the
+   ends near it, and the chunks of two versions of a text are mostly
+   the same.  A chunk ends after a byte if the window of bytes ending
+   there has a fingerprint whose mixed value has its low bits clear,
+   provided that the chunk is no shorter than the least chunk size; and
+   a chunk which reaches the greatest chunk size ends there in any
+   case.  The last chunk of a text may be shorter than the least size.
+
+   The text is split into segments, one for each thread.  Each thread
+   finds the candidate ends in its segment, and chunks the segment as
+   if a chunk began at its start, fingerprinting each chunk while its
+   bytes are still in the cache.  The segments are then joined in
+   order: where the true chunking of one segment runs into the next, it
+   is continued from the candidates until it meets an end the next
+   thread also chose, after which the two agree.  The chunks are
+   therefore exactly those of a scan of the whole text by a single
+   thread.  Chunks found while joining are fingerprinted afterwards, on
+   all threads; there are usually few of them.
+
+   Where threads are not available, which is assumed if
+   FINGERPRINT_NO_THREADS is defined or the target is Windows, the
+   segments are taken one after another.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* The type fingerprint_chunker_t is opaque.  A chunker does not
+   change once it has been made, so it may be used by several threads
+   at once.  */
+
+typedef struct fingerprint_chunker_t fingerprint_chunker_t;
+
+/* A fingerprint_chunk_t is a chunk of a text.  */
+
+typedef struct fingerprint_chunk_t {
+  unsigned long offset; /* The offset of the chunk in the text.  */
+  unsigned long size;   /* The length of the chunk.  */
+  fingerprint_t fp;     /* The fingerprint of the chunk.  */
+} fingerprint_chunk_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return a new chunker whose chunks are from MIN_SIZE to MAX_SIZE
+   bytes long, with windows of WINDOW bytes, and fingerprints of
+   windows and chunks with respect to BASIS.  A chunk ends at a
+   candidate with probability 1 in AVG_SIZE, rounded down to a power
+   of two, so that chunks average about MIN_SIZE + AVG_SIZE bytes.
+   Return NULL if WINDOW or AVG_SIZE is not positive, if MIN_SIZE
+   exceeds MAX_SIZE, if MAX_SIZE is zero or does not fit in an int, or
+   if memory is exhausted.  */
+extern fingerprint_chunker_t* fingerprint_chunker_new
+                        (const fingerprint_basis_t* basis,
+                         int                        window,
+                         unsigned long              min_size,
+                         unsigned long              avg_size,
+                         unsigned long              max_size);
+
+/* Release CHUNKER.  */
+extern void fingerprint_chunker_free (fingerprint_chunker_t* chunker);
+
+/* Cut the SIZE bytes of BUFFER into chunks with CHUNKER, using THREADS
+   threads, or one for each processor if THREADS is not positive.
+   Store in *CHUNKS an array of the chunks in order, which the caller
+   must release with free, and in *COUNT their number, and return
+   non-zero.  Return zero if memory is exhausted.  */
+extern int fingerprint_chunker_split (const fingerprint_chunker_t* chunker,
+                                      const char*                  buffer,
+                                      unsigned long                size,
+                                      int                          threads,
+                                      fingerprint_chunk_t**        chunks,
+                                      unsigned long*               count);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_CHUNK_H */
@@ -0,0 +1,322 @@
+/***********************************************************************
+
+ File:   codec.c
+
+ Contents: Conversion of fingerprints to and from text and bytes.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <string.h>
+#include "codec.h"
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* CODEC_X86_SIMD is 1 if the compiler can build kernels for the x86
+   vector extensions, which are then selected at run time according to
+   the processor.  Defining FINGERPRINT_NO_SIMD suppresses them.  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(FINGERPRINT_NO_SIMD)
+#define CODEC_X86_SIMD 1
+#include <immintrin.h>
+#else /* !(defined(__GNUC__) && ...) */
+#define CODEC_X86_SIMD 0
+#endif /* defined(__GNUC__) && ... */
+
+/***********************************************************************
+  Static Variables
+***********************************************************************/
+
+static const char codec_hex_digit[] = "0123456789abcdef";
+
+static const char codec_base32_digit[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+/* The value of each character as a hexadecimal digit, or -1.  */
+
+static const signed char codec_hex_value[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/* The value of each character as a base32 digit, or -1.  */
+
+static const signed char codec_base32_value[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, 26, 27, 28, 29, 30, 31, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+  -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Store the first four bytes of FP in *HI and the last four in *LO,
+   each taking the earlier byte as the more significant.  */
+
+static void
+codec_halves (fingerprint_t fp, unsigned long* hi, unsigned long* lo)
+{
+  const fingerprint_byte_t* b = FINGERPRINT_BYTE (fp);
+
+  *hi = (unsigned long) b[0] << 24 | (unsigned long) b[1] << 16
+    | (unsigned long) b[2] << 8 | b[3];
+  *lo = (unsigned long) b[4] << 24 | (unsigned long) b[5] << 16
+    | (unsigned long) b[6] << 8 | b[7];
+}
+
+/* Store the N bytes IN in OUT, in hexadecimal.  */
+
+static void
+codec_to_hex (const unsigned char* in, long n, char* out)
+{
+  long i;
+
+  for (i = 0; i < n; ++i) {
+    out[2 * i] = codec_hex_digit[in[i] >> 4];
+    out[2 * i + 1] = codec_hex_digit[in[i] & 0xf];
+  }
+}
+
+/* Store in OUT the N bytes in hexadecimal in IN.  Return zero if IN
+   holds a character which is not a hexadecimal digit.  */
+
+static int
+codec_from_hex (const char* in, long n, unsigned char* out)
+{
+  long i;
+
+  for (i = 0; i < n; ++i) {
+    int hi = codec_hex_value[(unsigned char) in[2 * i]];
+    int lo = codec_hex_value[(unsigned char) in[2 * i + 1]];
+
+    if (hi < 0 || lo < 0)
+      return 0;
+    out[i] = (unsigned char) (hi << 4 | lo);
+  }
+  return 1;
+}
+
+#if CODEC_X86_SIMD
+/* As codec_to_hex, for N a multiple of 16.  Each byte is widened to
+   16 bits, with its high digit in the low half and its low digit in
+   the high half, so that looking up the digits in place leaves them
+   in order.  */
+
+__attribute__ ((target ("avx2")))
+static void
+codec_to_hex_avx2 (const unsigned char* in, long n, char* out)
+{
+  const __m256i digit = _mm256_setr_epi8 ('0', '1', '2', '3', '4', '5',
+                                          '6', '7', '8', '9', 'a', 'b',
+                                          'c', 'd', 'e', 'f',
+                                          '0', '1', '2', '3', '4', '5',
+                                          '6', '7', '8', '9', 'a', 'b',
+                                          'c', 'd', 'e', 'f');
+  const __m256i low = _mm256_set1_epi16 (0x0f);
+  long i;
+
+  for (i = 0; i < n; i += 16) {
+    __m256i b = _mm256_cvtepu8_epi16
+                  (_mm_loadu_si128 ((const __m128i*) (in + i)));
+    __m256i d = _mm256_or_si256 (_mm256_srli_epi16 (b, 4),
+                                 _mm256_slli_epi16
+                                   (_mm256_and_si256 (b, low), 8));
+
+    _mm256_storeu_si256 ((__m256i*) (out + 2 * i),
+                         _mm256_shuffle_epi8 (digit, d));
+  }
+}
+
+/* As codec_from_hex, for N a multiple of 16.  The digits are checked
+   and converted in place, and each pair is then combined by a multiply
+   and add.  */
+
+__attribute__ ((target ("avx2")))
+static int
+codec_from_hex_avx2 (const char* in, long n, unsigned char* out)
+{
+  const __m256i case_bit = _mm256_set1_epi8 (0x20);
+  const __m256i below_0 = _mm256_set1_epi8 ('0' - 1);
+  const __m256i above_9 = _mm256_set1_epi8 ('9' + 1);
+  const __m256i below_a = _mm256_set1_epi8 ('a' - 1);
+  const __m256i above_f = _mm256_set1_epi8 ('f' + 1);
+  const __m256i zero = _mm256_set1_epi8 ('0');
+  const __m256i ten = _mm256_set1_epi8 ('a' - 10);
+  const __m256i weight = _mm256_set1_epi16 (0x0110);
+  long i;
+
+  for (i = 0; i < n; i += 16) {
+    __m256i c = _mm256_loadu_si256 ((const __m256i*) (in + 2 * i));
+    __m256i lower = _mm256_or_si256 (c, case_bit);
+    __m256i is_digit = _mm256_and_si256 (_mm256_cmpgt_epi8 (c, below_0),
+                                         _mm256_cmpgt_epi8 (above_9, c));
+    __m256i is_letter = _mm256_and_si256
+                          (_mm256_cmpgt_epi8 (lower, below_a),
+                           _mm256_cmpgt_epi8 (above_f, lower));
+    __m256i v;
+
+    if (_mm256_movemask_epi8 (_mm256_or_si256 (is_digit, is_letter)) != -1)
+      return 0;
+    v = _mm256_blendv_epi8 (_mm256_sub_epi8 (lower, ten),
+                            _mm256_sub_epi8 (c, zero), is_digit);
+    v = _mm256_maddubs_epi16 (v, weight);
+    _mm_storeu_si128 ((__m128i*) (out + i),
+                      _mm_packus_epi16 (_mm256_castsi256_si128 (v),
+                                        _mm256_extracti128_si256 (v, 1)));
+  }
+  return 1;
+}
+#endif /* CODEC_X86_SIMD */
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+void
+fingerprint_to_binary (const fingerprint_t* fp, int n, char* out)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    memcpy (out + FINGERPRINT_BINARY_SIZE * i, FINGERPRINT_BYTE (fp[i]),
+            FINGERPRINT_BINARY_SIZE);
+}
+
+void
+fingerprint_from_binary (const char* in, int n, fingerprint_t* out)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    memcpy (FINGERPRINT_BYTE (out[i]), in + FINGERPRINT_BINARY_SIZE * i,
+            FINGERPRINT_BINARY_SIZE);
+}
+
+void
+fingerprint_to_hex (const fingerprint_t* fp, int n, char* out)
+{
+  /* A fingerprint_t is its eight bytes in either configuration, so the
+     array can be taken as one run of bytes.  */
+  const unsigned char* in = (const unsigned char*) FINGERPRINT_BYTE (fp[0]);
+  long size = (long) n * FINGERPRINT_BINARY_SIZE;
+  long done = 0;
+
+  if (n <= 0)
+    return;
+#if CODEC_X86_SIMD
+  if (size >= 16 && __builtin_cpu_supports ("avx2")) {
+    done = size & ~15L;
+    codec_to_hex_avx2 (in, done, out);
+  }
+#endif /* CODEC_X86_SIMD */
+  codec_to_hex (in + done, size - done, out + 2 * done);
+}
+
+int
+fingerprint_from_hex (const char* in, int n, fingerprint_t* out)
+{
+  unsigned char* o;
+  long size = (long) n * FINGERPRINT_BINARY_SIZE;
+  long done = 0;
+
+  if (n <= 0)
+    return 1;
+  o = (unsigned char*) FINGERPRINT_BYTE (out[0]);
+#if CODEC_X86_SIMD
+  if (size >= 16 && __builtin_cpu_supports ("avx2")) {
+    done = size & ~15L;
+    if (!codec_from_hex_avx2 (in, done, o))
+      return 0;
+  }
+#endif /* CODEC_X86_SIMD */
+  return codec_from_hex (in + 2 * done, size - done, o + done);
+}
+
+void
+fingerprint_to_base32 (const fingerprint_t* fp, int n, char* out)
+{
+  int i;
+
+  for (i = 0; i < n; ++i, out += FINGERPRINT_BASE32_SIZE) {
+    unsigned long hi, lo;
+
+    codec_halves (fp[i], &hi, &lo);
+    out[0] = codec_base32_digit[(hi >> 27) & 31];
+    out[1] = codec_base32_digit[(hi >> 22) & 31];
+    out[2] = codec_base32_digit[(hi >> 17) & 31];
+    out[3] = codec_base32_digit[(hi >> 12) & 31];
+    out[4] = codec_base32_digit[(hi >> 7) & 31];
+    out[5] = codec_base32_digit[(hi >> 2) & 31];
+    out[6] = codec_base32_digit[((hi << 3) | (lo >> 29)) & 31];
+    out[7] = codec_base32_digit[(lo >> 24) & 31];
+    out[8] = codec_base32_digit[(lo >> 19) & 31];
+    out[9] = codec_base32_digit[(lo >> 14) & 31];
+    out[10] = codec_base32_digit[(lo >> 9) & 31];
+    out[11] = codec_base32_digit[(lo >> 4) & 31];
+    out[12] = codec_base32_digit[(lo << 1) & 31];
+  }
+}
+
+int
+fingerprint_from_base32 (const char* in, int n, fingerprint_t* out)
+{
+  int i, j;
+
+  for (i = 0; i < n; ++i, in += FINGERPRINT_BASE32_SIZE) {
+    fingerprint_byte_t* b = FINGERPRINT_BYTE (out[i]);
+    unsigned long v[FINGERPRINT_BASE32_SIZE];
+    unsigned long hi, lo;
+    int bad = 0;
+
+    for (j = 0; j < FINGERPRINT_BASE32_SIZE; ++j) {
+      int d = codec_base32_value[(unsigned char) in[j]];
+
+      bad |= d;
+      v[j] = (unsigned long) d;
+    }
+    if (bad < 0 || (v[12] & 1))
+      return 0;
+    hi = v[0] << 27 | v[1] << 22 | v[2] << 17 | v[3] << 12 | v[4] << 7
+      | v[5] << 2 | v[6] >> 3;
+    lo = v[6] << 29 | v[7] << 24 | v[8] << 19 | v[9] << 14
+      | v[10] << 9 | v[11] << 4 | v[12] >> 1;
+    for (j = 0; j < 4; ++j) {
+      b[j] = (fingerprint_byte_t) (hi >> (24 - 8 * j));
+      b[4 + j] = (fingerprint_byte_t) (lo >> (24 - 8 * j));
+    }
+  }
+  return 1;
+}
@@ -0,0 +1,94 @@
+/***********************************************************************
+
+ File:   codec.h
+
+ Contents: Conversion of fingerprints to and from text and bytes.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_CODEC_H
+#define FINGERPRINT_CODEC_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* Each routine converts an array of fingerprints at once.  A
+   fingerprint is always written as its eight bytes in the order of
+   FINGERPRINT_BYTE, which is the same in every configuration:
+
+     binary   8 bytes each.
+
+     hex      16 lower-case hexadecimal digits each, two to a byte, the
+              high digit first.  Upper-case digits are accepted when
+              decoding.
+
+     base32   13 characters each, from the alphabet of RFC 4648
+              ("A" to "Z", then "2" to "7"), taking the 64 bits five at
+              a time from the high bit of the first byte; the last
+              character carries the last four bits and a zero.  There
+              is no padding.  Lower-case letters are accepted when
+              decoding.
+
+   Hexadecimal conversion uses the x86 vector extensions where the
+   processor has them.  */
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* The number of characters of each form of one fingerprint.  */
+
+#define FINGERPRINT_BINARY_SIZE 8
+#define FINGERPRINT_HEX_SIZE 16
+#define FINGERPRINT_BASE32_SIZE 13
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Store the N fingerprints FP in OUT, in binary.  */
+extern void fingerprint_to_binary (const fingerprint_t* fp,
+                                   int                  n,
+                                   char*                out);
+
+/* Store in OUT the N fingerprints in binary in IN.  */
+extern void fingerprint_from_binary (const char*    in,
+                                     int            n,
+                                     fingerprint_t* out);
+
+/* Store the N fingerprints FP in OUT, in hexadecimal.  */
+extern void fingerprint_to_hex (const fingerprint_t* fp,
+                                int                  n,
+                                char*                out);
+
+/* Store in OUT the N fingerprints in hexadecimal in IN.  Return zero
+   if IN holds a character which is not a hexadecimal digit, and
+   non-zero otherwise.  */
+extern int fingerprint_from_hex (const char*    in,
+                                 int            n,
+                                 fingerprint_t* out);
+
+/* Store the N fingerprints FP in OUT, in base32.  */
+extern void fingerprint_to_base32 (const fingerprint_t* fp,
+                                   int                  n,
+                                   char*                out);
+
+/* Store in OUT the N fingerprints in base32 in IN.  Return zero if IN
+   holds a character outside the alphabet, or a last character with its
+   low bit set, and non-zero otherwise.  */
+extern int fingerprint_from_base32 (const char*    in,
+                                    int            n,
+                                    fingerprint_t* out);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_CODEC_H */
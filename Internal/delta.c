@@ -0,0 +1,647 @@
+/***********************************************************************
+
+ File:   delta.c
+
+ Contents: Deltas between versions of a file, in the manner of rsync.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "delta.h"
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* DELTA_SIGNATURE_MAGIC starts a signature, and DELTA_MAGIC a delta;
+   DELTA_SIGNATURE_HEADER and DELTA_HEADER are the sizes of their
+   headers.  */
+
+#define DELTA_SIGNATURE_MAGIC "FPSIGN01"
+#define DELTA_MAGIC "FPDELTA1"
+#define DELTA_SIGNATURE_HEADER 32
+#define DELTA_HEADER 40
+
+/* DELTA_MAX_BLOCKS is the most blocks in a signature, so that the
+   number of a block fits in a slot, and the count of a copy in an
+   instruction.  */
+
+#define DELTA_MAX_BLOCKS 0x7fffffffUL
+
+/* DELTA_PIECE is the number of bytes rolled at once.  DELTA_LITERAL
+   is the most bytes inserted by one instruction, and the most given to
+   fingerprint_ctx_update at once.  */
+
+#define DELTA_PIECE 4096
+#define DELTA_LITERAL 0x40000000UL
+
+/* DELTA_NONE is the number of no block.  */
+
+#define DELTA_NONE ((unsigned long) -1)
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+typedef fingerprint_byte_t byte_t;
+
+/* A delta_slot_t is a slot of the hash table of a signature: four
+   bytes of the fingerprint of a block, and the number of the block
+   plus one, or zero if the slot is empty.  */
+
+typedef struct delta_slot_t {
+  unsigned int  tag;
+  unsigned int  index;
+} delta_slot_t;
+
+struct fingerprint_signature_t {
+  const fingerprint_basis_t*
+                basis;
+  unsigned long size;   /* The length of the old version.  */
+  unsigned long block;  /* The block size.  */
+  unsigned long blocks; /* The number of blocks.  */
+  unsigned long full;   /* The number of full blocks.  */
+  fingerprint_t* fp;    /* The fingerprints of the blocks.  */
+  delta_slot_t* slot;   /* The hash table of the full blocks.  */
+  unsigned long mask;   /* The number of slots less one.  */
+  unsigned char* home;  /* A bit for each slot, set if it is the home
+                           slot of some block.  */
+};
+
+/* A delta_out_t is a delta being written.  */
+
+typedef struct delta_out_t {
+  byte_t*       b;
+  unsigned long n;      /* The number of bytes written.  */
+  unsigned long room;   /* The number of bytes there is room for.  */
+  int           ok;     /* Zero once memory has been exhausted.  */
+  unsigned long start;  /* The first block of the copy pending.  */
+  unsigned long count;  /* The number of blocks of the copy pending.  */
+} delta_out_t;
+
+/***********************************************************************
+  Static Functions: Encoding
+***********************************************************************/
+
+static void
+delta_put64 (byte_t* b, unsigned long x)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    b[i] = (byte_t) (x & 0xff);
+    x >>= 8;
+  }
+}
+
+static unsigned long
+delta_get64 (const byte_t* b)
+{
+  unsigned long x = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i)
+    x = (x << 8) | b[i];
+  return x;
+}
+
+/* Read a number of an instruction from *P, which is before END, into
+   *X, and advance *P past it.  Return zero if it is cut short or too
+   large.  */
+
+static int
+delta_get_number (const byte_t** p, const byte_t* end, unsigned long* x)
+{
+  unsigned long v = 0;
+  unsigned int shift = 0;
+
+  while (*p < end) {
+    byte_t c = *(*p)++;
+
+    if (shift >= CHAR_BIT * sizeof (unsigned long)
+        || ((unsigned long) (c & 0x7f) << shift >> shift) != (c & 0x7f))
+      return 0;
+    v |= (unsigned long) (c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *x = v;
+      return 1;
+    }
+    shift += 7;
+  }
+  return 0;
+}
+
+/* Return the fingerprint of the SIZE bytes of BUFFER with respect to
+   BASIS.  */
+
+static fingerprint_t
+delta_fingerprint (const fingerprint_basis_t* basis,
+                   const char*                buffer,
+                   unsigned long              size)
+{
+  fingerprint_ctx_t ctx;
+
+  if (size <= INT_MAX)
+    return fingerprint_basis_from_buffer (basis, buffer, (int) size);
+  fingerprint_ctx_init (&ctx, basis);
+  while (size > 0) {
+    unsigned long n = size < DELTA_LITERAL ? size : DELTA_LITERAL;
+
+    fingerprint_ctx_update (&ctx, buffer, (int) n);
+    buffer += n;
+    size -= n;
+  }
+  return fingerprint_ctx_final (&ctx);
+}
+
+/***********************************************************************
+  Static Functions: Signatures
+***********************************************************************/
+
+/* Return the home slot of the fingerprint whose bytes are KEY in a
+   table of MASK + 1 slots, and store in *TAG the bytes it keeps.  */
+
+static unsigned long
+delta_hash (const byte_t* key, unsigned long mask, unsigned int* tag)
+{
+  *tag = ((unsigned int) key[4] << 24 | (unsigned int) key[5] << 16
+          | (unsigned int) key[6] << 8 | key[7]);
+  return ((unsigned long) key[0] << 24 | (unsigned long) key[1] << 16
+          | (unsigned long) key[2] << 8 | key[3]) & mask;
+}
+
+/* Return the number of a full block of SIGNATURE with fingerprint FP,
+   or DELTA_NONE if there is none.  If block PREFER has it, return
+   PREFER, so that copies of runs of blocks join up.  */
+
+static unsigned long
+delta_lookup (const fingerprint_signature_t* signature,
+              const fingerprint_t*           fp,
+              unsigned long                  prefer)
+{
+  const byte_t* key = FINGERPRINT_BYTE (*fp);
+  unsigned int tag;
+  unsigned long s = delta_hash (key, signature->mask, &tag);
+
+  /* Most windows match nothing, and are turned away here.  */
+  if (!(signature->home[s >> 3] & (1 << (s & 7))))
+    return DELTA_NONE;
+  if (prefer < signature->full
+      && memcmp (FINGERPRINT_BYTE (signature->fp[prefer]), key, 8) == 0)
+    return prefer;
+  for (; signature->slot[s].index; s = (s + 1) & signature->mask) {
+    const delta_slot_t* slot = &signature->slot[s];
+
+    if (slot->tag == tag
+        && memcmp (FINGERPRINT_BYTE (signature->fp[slot->index - 1]),
+                   key, 8) == 0)
+      return slot->index - 1;
+  }
+  return DELTA_NONE;
+}
+
+/* Make the hash table of SIGNATURE, whose blocks have been
+   fingerprinted.  A fingerprint shared by several blocks is entered
+   for the first.  Return zero if memory is exhausted.  */
+
+static int
+delta_index (fingerprint_signature_t* signature)
+{
+  unsigned long mask = 15;
+  unsigned long i;
+
+  while (mask < 2 * signature->full)
+    mask = 2 * mask + 1;
+  signature->slot = (delta_slot_t*) calloc (mask + 1, sizeof (delta_slot_t));
+  signature->home = (unsigned char*) calloc ((mask + 1) / 8, 1);
+  if (!signature->slot || !signature->home)
+    return 0;
+  signature->mask = mask;
+  for (i = 0; i < signature->full; ++i)
+    if (delta_lookup (signature, &signature->fp[i], DELTA_NONE)
+        == DELTA_NONE) {
+      unsigned int tag;
+      unsigned long s = delta_hash (FINGERPRINT_BYTE (signature->fp[i]),
+                                    mask, &tag);
+
+      signature->home[s >> 3] |= (unsigned char) (1 << (s & 7));
+      while (signature->slot[s].index)
+        s = (s + 1) & mask;
+      signature->slot[s].tag = tag;
+      signature->slot[s].index = (unsigned int) (i + 1);
+    }
+  return 1;
+}
+
+/* Return a new signature of BLOCKS blocks of BLOCK bytes, covering
+   SIZE bytes, with respect to BASIS, whose fingerprints are yet to be
+   filled in, or NULL if memory is exhausted.  */
+
+static fingerprint_signature_t*
+delta_signature_make (const fingerprint_basis_t* basis,
+                      unsigned long              size,
+                      unsigned long              block)
+{
+  fingerprint_signature_t* signature;
+
+  signature = (fingerprint_signature_t*) calloc (1, sizeof (*signature));
+  if (!signature)
+    return NULL;
+  signature->basis = basis;
+  signature->size = size;
+  signature->block = block;
+  signature->blocks = size / block + (size % block != 0);
+  signature->full = size / block;
+  signature->fp = (fingerprint_t*)
+    malloc ((signature->blocks ? signature->blocks : 1)
+            * sizeof (fingerprint_t));
+  if (!signature->fp) {
+    free (signature);
+    return NULL;
+  }
+  return signature;
+}
+
+/***********************************************************************
+  Static Functions: Writing Deltas
+***********************************************************************/
+
+/* Append the N bytes of DATA to OUT.  */
+
+static void
+delta_write (delta_out_t* out, const void* data, unsigned long n)
+{
+  if (!out->ok)
+    return;
+  if (n > out->room - out->n) {
+    unsigned long room = out->room ? out->room : 256;
+    byte_t* b;
+
+    while (n > room - out->n)
+      room *= 2;
+    b = (byte_t*) realloc (out->b, room);
+    if (!b) {
+      out->ok = 0;
+      return;
+    }
+    out->b = b;
+    out->room = room;
+  }
+  memcpy (out->b + out->n, data, n);
+  out->n += n;
+}
+
+/* Append the number X to the instructions of OUT.  */
+
+static void
+delta_put_number (delta_out_t* out, unsigned long x)
+{
+  byte_t b[16];
+  int n = 0;
+
+  while (x >= 0x80) {
+    b[n++] = (byte_t) (x & 0x7f) | 0x80;
+    x >>= 7;
+  }
+  b[n++] = (byte_t) x;
+  delta_write (out, b, n);
+}
+
+/* Write the copy pending in OUT, if there is one.  */
+
+static void
+delta_flush (delta_out_t* out)
+{
+  if (out->count == 0)
+    return;
+  delta_put_number (out, 2 * out->count + 1);
+  delta_put_number (out, out->start);
+  out->count = 0;
+}
+
+/* Append to OUT an instruction to insert the N bytes of DATA.  */
+
+static void
+delta_insert (delta_out_t* out, const char* data, unsigned long n)
+{
+  if (n == 0)
+    return;
+  delta_flush (out);
+  while (n > 0) {
+    unsigned long m = n < DELTA_LITERAL ? n : DELTA_LITERAL;
+
+    delta_put_number (out, 2 * m);
+    delta_write (out, data, m);
+    data += m;
+    n -= m;
+  }
+}
+
+/* Append to OUT an instruction to copy block B, joining it to the copy
+   pending if that ends just before B.  */
+
+static void
+delta_copy (delta_out_t* out, unsigned long b)
+{
+  if (out->count > 0 && out->start + out->count == b) {
+    ++out->count;
+    return;
+  }
+  delta_flush (out);
+  out->start = b;
+  out->count = 1;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_signature_t*
+fingerprint_signature_new (const fingerprint_basis_t* basis,
+                           const char*                buffer,
+                           unsigned long              size,
+                           int                        block)
+{
+  fingerprint_signature_t* signature;
+  unsigned long i;
+
+  if (block <= 0)
+    return NULL;
+  if (size / (unsigned long) block >= DELTA_MAX_BLOCKS) {
+    errno = EFBIG;
+    return NULL;
+  }
+  signature = delta_signature_make (basis, size, (unsigned long) block);
+  if (!signature)
+    return NULL;
+  for (i = 0; i < signature->blocks; ++i) {
+    unsigned long offset = i * signature->block;
+    unsigned long n = size - offset < signature->block
+      ? size - offset : signature->block;
+
+    signature->fp[i] = fingerprint_basis_from_buffer (basis,
+                                                      buffer + offset,
+                                                      (int) n);
+  }
+  if (!delta_index (signature)) {
+    fingerprint_signature_free (signature);
+    return NULL;
+  }
+  return signature;
+}
+
+fingerprint_signature_t*
+fingerprint_signature_load (const fingerprint_basis_t* basis,
+                            const char*                buffer,
+                            unsigned long              size)
+{
+  const byte_t* b = (const byte_t*) buffer;
+  fingerprint_t poly = fingerprint_basis_poly (basis);
+  fingerprint_signature_t* signature;
+  unsigned long block, length;
+
+  if (size < DELTA_SIGNATURE_HEADER
+      || memcmp (b, DELTA_SIGNATURE_MAGIC, 8) != 0
+      || memcmp (b + 8, FINGERPRINT_BYTE (poly), 8) != 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  block = delta_get64 (b + 16);
+  length = delta_get64 (b + 24);
+  if (block == 0 || block > INT_MAX
+      || length / block >= DELTA_MAX_BLOCKS
+      || (size - DELTA_SIGNATURE_HEADER) / 8
+           != length / block + (length % block != 0)
+      || (size - DELTA_SIGNATURE_HEADER) % 8 != 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  signature = delta_signature_make (basis, length, block);
+  if (!signature)
+    return NULL;
+  memcpy (signature->fp, b + DELTA_SIGNATURE_HEADER,
+          8 * signature->blocks);
+  if (!delta_index (signature)) {
+    fingerprint_signature_free (signature);
+    return NULL;
+  }
+  return signature;
+}
+
+void
+fingerprint_signature_free (fingerprint_signature_t* signature)
+{
+  if (!signature)
+    return;
+  free (signature->fp);
+  free (signature->slot);
+  free (signature->home);
+  free (signature);
+}
+
+unsigned long
+fingerprint_signature_size (const fingerprint_signature_t* signature)
+{
+  return DELTA_SIGNATURE_HEADER + 8 * signature->blocks;
+}
+
+void
+fingerprint_signature_save (const fingerprint_signature_t* signature,
+                            char*                          out)
+{
+  byte_t* b = (byte_t*) out;
+  fingerprint_t poly = fingerprint_basis_poly (signature->basis);
+
+  memcpy (b, DELTA_SIGNATURE_MAGIC, 8);
+  memcpy (b + 8, FINGERPRINT_BYTE (poly), 8);
+  delta_put64 (b + 16, signature->block);
+  delta_put64 (b + 24, signature->size);
+  memcpy (b + DELTA_SIGNATURE_HEADER, signature->fp, 8 * signature->blocks);
+}
+
+int
+fingerprint_delta_new (const fingerprint_signature_t* signature,
+                       const char*                    buffer,
+                       unsigned long                  size,
+                       char**                         delta,
+                       unsigned long*                 delta_size)
+{
+  unsigned long block = signature->block;
+  unsigned long tail = signature->size % block;
+  fingerprint_roller_t* roller;
+  fingerprint_t* window;
+  fingerprint_t fp;
+  delta_out_t out;
+  byte_t header[DELTA_HEADER];
+  unsigned long pos = 0, lit = 0, next = DELTA_NONE;
+  int follow = 0;
+
+  roller = fingerprint_roller_new (signature->basis, (int) block);
+  window = (fingerprint_t*) malloc (DELTA_PIECE * sizeof (fingerprint_t));
+  memset (&out, 0, sizeof (out));
+  out.ok = roller && window;
+
+  fp = delta_fingerprint (signature->basis, buffer, size);
+  memcpy (header, DELTA_MAGIC, 8);
+  delta_put64 (header + 8, block);
+  delta_put64 (header + 16, signature->size);
+  delta_put64 (header + 24, size);
+  memcpy (header + 32, FINGERPRINT_BYTE (fp), 8);
+  delta_write (&out, header, DELTA_HEADER);
+
+  while (out.ok && size - pos >= block) {
+    unsigned long b = DELTA_NONE, at, start = 0;
+
+    /* After a match, try the next block whole: in an unchanged
+       stretch it matches too, and this is cheaper than rolling.  */
+    if (follow) {
+      fp = fingerprint_basis_from_buffer (signature->basis,
+                                          buffer + pos, (int) block);
+      b = delta_lookup (signature, &fp, next);
+      if (b != DELTA_NONE) {
+        delta_copy (&out, b);
+        pos += block;
+        lit = pos;
+        next = b + 1;
+        continue;
+      }
+      follow = 0;
+    }
+
+    /* Roll a window over the rest, from POS, until one matches.  */
+    fingerprint_roller_reset (roller);
+    fingerprint_roller_update (roller, buffer + pos, (int) (block - 1),
+                               NULL);
+    for (at = pos + block - 1; b == DELTA_NONE && at < size; ) {
+      int n = size - at < DELTA_PIECE ? (int) (size - at) : DELTA_PIECE;
+      int i;
+
+      fingerprint_roller_update (roller, buffer + at, n, window);
+      for (i = 0; i < n; ++i) {
+        b = delta_lookup (signature, &window[i], next);
+        if (b != DELTA_NONE) {
+          start = at + i + 1 - block;
+          break;
+        }
+      }
+      at += n;
+    }
+    if (b == DELTA_NONE)
+      break;
+    delta_insert (&out, buffer + lit, start - lit);
+    delta_copy (&out, b);
+    pos = start + block;
+    lit = pos;
+    next = b + 1;
+    follow = 1;
+  }
+
+  /* The short last block can only match at the end.  */
+  if (out.ok && tail > 0 && size - lit >= tail) {
+    fp = fingerprint_basis_from_buffer (signature->basis,
+                                        buffer + size - tail, (int) tail);
+    if (memcmp (FINGERPRINT_BYTE (fp),
+                FINGERPRINT_BYTE (signature->fp[signature->blocks - 1]),
+                8) == 0) {
+      delta_insert (&out, buffer + lit, size - tail - lit);
+      delta_copy (&out, signature->blocks - 1);
+      lit = size;
+    }
+  }
+  delta_insert (&out, buffer + lit, size - lit);
+  delta_flush (&out);
+
+  fingerprint_roller_free (roller);
+  free (window);
+  if (!out.ok) {
+    free (out.b);
+    return 0;
+  }
+  *delta = (char*) out.b;
+  *delta_size = out.n;
+  return 1;
+}
+
+int
+fingerprint_delta_apply (const fingerprint_basis_t* basis,
+                         const char*                old,
+                         unsigned long              old_size,
+                         const char*                delta,
+                         unsigned long              delta_size,
+                         char**                     out,
+                         unsigned long*             out_size)
+{
+  const byte_t* p = (const byte_t*) delta;
+  const byte_t* end = p + delta_size;
+  unsigned long block, blocks, size, done = 0;
+  fingerprint_t fp;
+  char* b;
+  int ok = 1;
+
+  if (delta_size < DELTA_HEADER || memcmp (p, DELTA_MAGIC, 8) != 0) {
+    errno = EINVAL;
+    return 0;
+  }
+  block = delta_get64 (p + 8);
+  size = delta_get64 (p + 24);
+  if (block == 0 || delta_get64 (p + 16) != old_size) {
+    errno = EINVAL;
+    return 0;
+  }
+  blocks = old_size / block + (old_size % block != 0);
+  b = (char*) malloc (size ? size : 1);
+  if (!b)
+    return 0;
+
+  for (p += DELTA_HEADER; ok && p < end; ) {
+    unsigned long n, first, offset;
+
+    ok = delta_get_number (&p, end, &n);
+    if (!ok)
+      break;
+    if (n % 2 == 0) {
+      n /= 2;
+      ok = n <= (unsigned long) (end - p) && n <= size - done;
+      if (ok) {
+        memcpy (b + done, p, n);
+        p += n;
+        done += n;
+      }
+      continue;
+    }
+    n /= 2;
+    ok = (delta_get_number (&p, end, &first) && n > 0
+          && first < blocks && n <= blocks - first);
+    if (!ok)
+      break;
+    offset = first * block;
+    n = first + n == blocks ? old_size - offset : n * block;
+    ok = n <= size - done;
+    if (ok) {
+      memcpy (b + done, old + offset, n);
+      done += n;
+    }
+  }
+
+  if (ok && done == size) {
+    fp = delta_fingerprint (basis, b, size);
+    ok = memcmp (FINGERPRINT_BYTE (fp),
+                 (const byte_t*) delta + 32, 8) == 0;
+  } else
+    ok = 0;
+  if (!ok) {
+    free (b);
+    errno = EINVAL;
+    return 0;
+  }
+  *out = b;
+  *out_size = size;
+  return 1;
+}
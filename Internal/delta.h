@@ -0,0 +1,128 @@
+/***********************************************************************
+
+ File:   delta.h
+
+ Contents: Deltas between versions of a file, in the manner of rsync.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_DELTA_H
+#define FINGERPRINT_DELTA_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A delta turns an old version of a file into a new one, and is made
+   without the old version at hand.  The holder of the old version cuts
+   it into blocks of a fixed size, the last perhaps shorter, and sends
+   the fingerprint of each block: its signature.  The holder of the new
+   version rolls a window of the block size over it, looking up the
+   fingerprint of each window among those of the blocks; since the
+   fingerprint of a full window is that of its bytes, this one value
+   serves both as the rolling checksum and as the strong one.  Where a
+   window matches a block, the delta says to copy the block, and the
+   scan resumes after it, first trying the next block whole, since
+   unchanged stretches of a file match block after block; bytes which
+   match no block are sent as they are.  The short last block matches
+   only at the end of the new version.
+
+   The fingerprints of the blocks are held in a hash table of eight
+   byte slots, each some bits of a fingerprint and the number of its
+   block, so that a window which matches nothing, which is most of
+   them, costs one probe of a small table, and the fingerprints
+   themselves are fetched only when those bits agree.
+
+   A signature is written as the eight bytes "FPSIGN01"; the polynomial
+   of its basis; the block size and the length of the old version,
+   eight bytes each; and then the fingerprints of the blocks.  A delta
+   is written as "FPDELTA1"; the block size, the length of the old
+   version and that of the new, eight bytes each; the fingerprint of
+   the new version; and then the instructions.  Each instruction starts
+   with a number N: if N is even, N / 2 bytes follow, to be inserted;
+   if N is odd, a block number B follows, and the (N - 1) / 2 blocks
+   from B onwards are to be copied.  Numbers within instructions are
+   written seven bits to a byte, low bits first, with the top bit of
+   each byte but the last set; other numbers are little-endian.
+   Applying a delta checks the fingerprint of the result, so that a
+   delta applied to the wrong old version is caught.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* The type fingerprint_signature_t is opaque.  A signature does not
+   change once it has been made, so it may be used by several threads
+   at once.  */
+
+typedef struct fingerprint_signature_t fingerprint_signature_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return the signature of the SIZE bytes of BUFFER, in blocks of BLOCK
+   bytes, with respect to BASIS.  Return NULL if BLOCK is not positive,
+   if there are too many blocks, or if memory is exhausted.  */
+extern fingerprint_signature_t* fingerprint_signature_new
+                        (const fingerprint_basis_t* basis,
+                         const char*                buffer,
+                         unsigned long              size,
+                         int                        block);
+
+/* Return the signature written in the SIZE bytes of BUFFER, with
+   respect to BASIS.  Return NULL if BUFFER does not hold a signature
+   made with BASIS, or if memory is exhausted.  */
+extern fingerprint_signature_t* fingerprint_signature_load
+                        (const fingerprint_basis_t* basis,
+                         const char*                buffer,
+                         unsigned long              size);
+
+/* Release SIGNATURE.  */
+extern void fingerprint_signature_free (fingerprint_signature_t* signature);
+
+/* Return the number of bytes in the written form of SIGNATURE.  */
+extern unsigned long fingerprint_signature_size
+                        (const fingerprint_signature_t* signature);
+
+/* Write SIGNATURE to OUT, which must have room for
+   fingerprint_signature_size bytes.  */
+extern void fingerprint_signature_save
+                        (const fingerprint_signature_t* signature,
+                         char*                          out);
+
+/* Store in *DELTA a delta from the version of which SIGNATURE was
+   taken to the SIZE bytes of BUFFER, which the caller must release
+   with free, and in *DELTA_SIZE its length, and return non-zero.
+   Return zero if memory is exhausted.  */
+extern int fingerprint_delta_new (const fingerprint_signature_t* signature,
+                                  const char*                    buffer,
+                                  unsigned long                  size,
+                                  char**                         delta,
+                                  unsigned long*                 delta_size);
+
+/* Apply the DELTA_SIZE bytes of DELTA to the OLD_SIZE bytes of OLD,
+   store in *OUT the new version, which the caller must release with
+   free, and in *OUT_SIZE its length, and return non-zero.  Return zero
+   if DELTA is not a delta from OLD, if the result does not have the
+   fingerprint the delta gives for it with respect to BASIS, or if
+   memory is exhausted.  */
+extern int fingerprint_delta_apply (const fingerprint_basis_t* basis,
+                                    const char*                old,
+                                    unsigned long              old_size,
+                                    const char*                delta,
+                                    unsigned long              delta_size,
+                                    char**                     out,
+                                    unsigned long*             out_size);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_DELTA_H */
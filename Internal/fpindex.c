@@ -0,0 +1,879 @@
+/***********************************************************************
+
+ File:   fpindex.c
+
+ Contents: A persistent index from fingerprints to extents of a file.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fpindex.h"
+
+/* INDEX_MMAP is 1 if segments can be mapped into memory.  */
+
+#if defined(__unix__) || defined(__unix) || defined(unix) \
+    || (defined(__APPLE__) && defined(__MACH__))
+#define INDEX_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else /* !(defined(__unix__) || ...) */
+#define INDEX_MMAP 0
+#endif /* defined(__unix__) || ... */
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* INDEX_PAGE is the size of a page of a segment, and INDEX_RECORD the
+   size of a record: a fingerprint, then the offset and the length as
+   eight bytes each.  */
+
+#define INDEX_PAGE 4096
+#define INDEX_RECORD 24
+#define INDEX_PER_PAGE (INDEX_PAGE / INDEX_RECORD)
+
+/* INDEX_MAGIC starts both the header of a segment and the MANIFEST.  */
+
+#define INDEX_MAGIC "FPINDEX1"
+
+/* INDEX_MEMORY is the number of records kept in memory before they are
+   written out as a segment.  */
+
+#define INDEX_MEMORY 262144
+
+/* INDEX_FANOUT is the number of segments of a similar size which are
+   merged into one.  */
+
+#define INDEX_FANOUT 8
+
+/* INDEX_MAX_SEGMENTS is the greatest number of segments in an index.
+   With INDEX_FANOUT segments of each size, this is ample.  */
+
+#define INDEX_MAX_SEGMENTS 256
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+typedef fingerprint_byte_t byte_t;
+
+/* An index_segment_t is a segment in memory.  */
+
+typedef struct index_segment_t {
+  unsigned long id;     /* The number in the name of the file.  */
+  const byte_t* base;   /* The contents of the file.  */
+  size_t        size;   /* The size of the file.  */
+  int           mapped; /* Non-zero if BASE is mapped, rather than
+                           allocated.  */
+  unsigned long count;  /* The number of records.  */
+  unsigned long pages;  /* The number of pages of records.  */
+  const byte_t* fences; /* The fence keys.  */
+} index_segment_t;
+
+/* An index_entry_t is a record in memory.  */
+
+typedef struct index_entry_t {
+  byte_t        key[8]; /* The bytes of the fingerprint.  */
+  unsigned long offset;
+  unsigned long length;
+} index_entry_t;
+
+/* An index_writer_t writes a segment.  */
+
+typedef struct index_writer_t {
+  FILE*         file;
+  byte_t        page[INDEX_PAGE];
+                        /* The page being filled.  */
+  int           used;   /* The number of records in PAGE.  */
+  unsigned long count;  /* The number of records written.  */
+  unsigned long pages;  /* The number of pages written.  */
+  byte_t*       fences; /* The fence keys so far.  */
+  unsigned long room;   /* The number of fence keys there is room for.  */
+} index_writer_t;
+
+struct fingerprint_index_t {
+  char*         dir;    /* The directory of the index.  */
+  unsigned long next;   /* The number for the next segment.  */
+  int           segments;
+                        /* The number of segments.  */
+  index_segment_t
+                segment[INDEX_MAX_SEGMENTS];
+                        /* The segments, oldest first.  */
+  index_entry_t*
+                entry;  /* The records only in memory.  */
+  int           entries;
+                        /* The number of entries in ENTRY.  */
+  int*          slot;   /* A hash table of the entries; each slot
+                           holds an index into ENTRY, or -1.  */
+};
+
+/***********************************************************************
+  Static Functions: Encoding
+***********************************************************************/
+
+static void
+index_put (byte_t* b, unsigned long x)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    b[i] = (byte_t) (x & 0xff);
+    x >>= 8;
+  }
+}
+
+static unsigned long
+index_get (const byte_t* b)
+{
+  unsigned long x = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i)
+    x = (x << 8) | b[i];
+  return x;
+}
+
+/* Return the leading bytes of KEY as a fraction of the range of
+   keys.  */
+
+static double
+index_position (const byte_t* key)
+{
+  return (((key[0] * 256.0 + key[1]) * 256.0 + key[2]) * 256.0 + key[3])
+    / 4294967296.0;
+}
+
+/* Return the name of file NAME within the directory of INDEX, or NULL
+   if memory is exhausted.  The caller must free the result.  */
+
+static char*
+index_path (const fingerprint_index_t* index, const char* name)
+{
+  char* path = (char*) malloc (strlen (index->dir) + strlen (name) + 2);
+
+  if (path)
+    sprintf (path, "%s/%s", index->dir, name);
+  return path;
+}
+
+/* Return the name of the file of segment ID of INDEX, with SUFFIX, or
+   NULL if memory is exhausted.  The caller must free the result.  */
+
+static char*
+index_segment_path (const fingerprint_index_t* index,
+                    unsigned long              id,
+                    const char*                suffix)
+{
+  char name[64];
+
+  sprintf (name, "%08lu.seg%s", id, suffix);
+  return index_path (index, name);
+}
+
+/***********************************************************************
+  Static Functions: Segments
+***********************************************************************/
+
+/* Release the memory of SEGMENT.  */
+
+static void
+index_unload (index_segment_t* segment)
+{
+  if (!segment->base)
+    return;
+#if INDEX_MMAP
+  if (segment->mapped)
+    munmap ((void*) segment->base, segment->size);
+  else
+#endif /* INDEX_MMAP */
+    free ((void*) segment->base);
+  segment->base = NULL;
+}
+
+/* Load segment ID of INDEX into SEGMENT.  Return zero on failure.  */
+
+static int
+index_load (const fingerprint_index_t* index,
+            unsigned long              id,
+            index_segment_t*           segment)
+{
+  char* path = index_segment_path (index, id, "");
+  const byte_t* base = NULL;
+  size_t size = 0;
+  int mapped = 0;
+
+  if (!path)
+    return 0;
+
+#if INDEX_MMAP
+  {
+    int fd = open (path, O_RDONLY);
+    struct stat st;
+
+    if (fd >= 0 && fstat (fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED,
+                      fd, 0);
+
+      if (p != MAP_FAILED) {
+        base = (const byte_t*) p;
+        size = (size_t) st.st_size;
+        mapped = 1;
+      }
+    }
+    if (fd >= 0)
+      close (fd);
+  }
+#endif /* INDEX_MMAP */
+
+  if (!base) {
+    FILE* file = fopen (path, "rb");
+    byte_t* b = NULL;
+    long n;
+
+    if (file && fseek (file, 0, SEEK_END) == 0 && (n = ftell (file)) > 0
+        && fseek (file, 0, SEEK_SET) == 0
+        && (b = (byte_t*) malloc ((size_t) n)) != NULL
+        && fread (b, 1, (size_t) n, file) == (size_t) n) {
+      base = b;
+      size = (size_t) n;
+    } else
+      free (b);
+    if (file)
+      fclose (file);
+  }
+  free (path);
+  if (!base)
+    return 0;
+
+  segment->id = id;
+  segment->base = base;
+  segment->size = size;
+  segment->mapped = mapped;
+  if (size < INDEX_PAGE || memcmp (base, INDEX_MAGIC, 8) != 0) {
+    index_unload (segment);
+    errno = EINVAL;
+    return 0;
+  }
+  segment->count = index_get (base + 8);
+  segment->pages = index_get (base + 16);
+  if (size != (1 + segment->pages) * INDEX_PAGE + 8 * segment->pages) {
+    index_unload (segment);
+    errno = EINVAL;
+    return 0;
+  }
+  segment->fences = base + (1 + segment->pages) * INDEX_PAGE;
+  return 1;
+}
+
+/* Return the record at position I of SEGMENT.  */
+
+static const byte_t*
+index_record (const index_segment_t* segment, unsigned long i)
+{
+  return (segment->base
+          + (1 + i / INDEX_PER_PAGE) * INDEX_PAGE
+          + (i % INDEX_PER_PAGE) * INDEX_RECORD);
+}
+
+/* Return the record for KEY in SEGMENT, or NULL if there is none.  */
+
+static const byte_t*
+index_search (const index_segment_t* segment, const byte_t* key)
+{
+  const byte_t* fences = segment->fences;
+  unsigned long pages = segment->pages;
+  unsigned long lo, hi, mid, n, page;
+  unsigned long step = 1;
+
+  if (segment->count == 0 || memcmp (key, fences, 8) < 0)
+    return NULL;
+
+  /* Find the last page whose fence key is not above KEY.  Start from
+     where the page would be if the keys were spread perfectly evenly,
+     and widen the search outwards until it brackets KEY.  */
+  page = (unsigned long) (index_position (key) * pages);
+  if (page >= pages)
+    page = pages - 1;
+  if (memcmp (fences + 8 * page, key, 8) <= 0) {
+    lo = page;
+    hi = page + 1;
+    while (hi < pages && memcmp (fences + 8 * hi, key, 8) <= 0) {
+      lo = hi;
+      hi = step < pages - hi ? hi + step : pages;
+      step *= 2;
+    }
+  } else {
+    hi = page;
+    lo = page;
+    do {
+      hi = lo;
+      lo = step < lo ? lo - step : 0;
+      step *= 2;
+    } while (lo > 0 && memcmp (fences + 8 * lo, key, 8) > 0);
+  }
+  /* Now the fence key of LO is not above KEY, and that of HI is.  */
+  while (hi - lo > 1) {
+    mid = lo + (hi - lo) / 2;
+    if (memcmp (fences + 8 * mid, key, 8) <= 0)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  /* Search the page.  */
+  lo *= INDEX_PER_PAGE;
+  n = segment->count - lo < INDEX_PER_PAGE
+    ? segment->count - lo : INDEX_PER_PAGE;
+  hi = lo + n;
+  while (lo < hi) {
+    const byte_t* r;
+    int c;
+
+    mid = lo + (hi - lo) / 2;
+    r = index_record (segment, mid);
+    c = memcmp (r, key, 8);
+    if (c == 0)
+      return r;
+    if (c < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return NULL;
+}
+
+/* Start writing a segment to the file PATH.  Return zero on failure.  */
+
+static int
+index_writer_open (index_writer_t* w, const char* path)
+{
+  memset (w, 0, sizeof (*w));
+  w->file = fopen (path, "wb");
+  if (!w->file)
+    return 0;
+  /* The header is written last, when the counts are known.  */
+  return fwrite (w->page, 1, INDEX_PAGE, w->file) == INDEX_PAGE;
+}
+
+/* Write the page of W.  Return zero on failure.  */
+
+static int
+index_writer_page (index_writer_t* w)
+{
+  memset (w->page + w->used * INDEX_RECORD, 0,
+          INDEX_PAGE - w->used * INDEX_RECORD);
+  if (fwrite (w->page, 1, INDEX_PAGE, w->file) != INDEX_PAGE)
+    return 0;
+  ++w->pages;
+  w->used = 0;
+  return 1;
+}
+
+/* Append a record to the segment of W.  Records must be presented in
+   increasing order of KEY.  Return zero on failure.  */
+
+static int
+index_writer_put (index_writer_t* w,
+                  const byte_t*   key,
+                  unsigned long   offset,
+                  unsigned long   length)
+{
+  byte_t* r = w->page + w->used * INDEX_RECORD;
+
+  if (w->used == 0) {
+    if (w->pages == w->room) {
+      unsigned long room = w->room ? 2 * w->room : 64;
+      byte_t* fences = (byte_t*) realloc (w->fences, 8 * room);
+
+      if (!fences)
+        return 0;
+      w->fences = fences;
+      w->room = room;
+    }
+    memcpy (w->fences + 8 * w->pages, key, 8);
+  }
+  memcpy (r, key, 8);
+  index_put (r + 8, offset);
+  index_put (r + 16, length);
+  ++w->count;
+  if (++w->used == INDEX_PER_PAGE)
+    return index_writer_page (w);
+  return 1;
+}
+
+/* Finish the segment of W.  Return zero on failure.  */
+
+static int
+index_writer_close (index_writer_t* w)
+{
+  int ok = 1;
+
+  if (w->used > 0)
+    ok = index_writer_page (w);
+  if (ok && w->pages > 0)
+    ok = fwrite (w->fences, 8, w->pages, w->file) == w->pages;
+  if (ok) {
+    memset (w->page, 0, INDEX_PAGE);
+    memcpy (w->page, INDEX_MAGIC, 8);
+    index_put (w->page + 8, w->count);
+    index_put (w->page + 16, w->pages);
+    index_put (w->page + 24, INDEX_PER_PAGE);
+    ok = (fseek (w->file, 0, SEEK_SET) == 0
+          && fwrite (w->page, 1, INDEX_PAGE, w->file) == INDEX_PAGE);
+  }
+  ok = fflush (w->file) == 0 && ok;
+#if INDEX_MMAP
+  ok = ok && fsync (fileno (w->file)) == 0;
+#endif /* INDEX_MMAP */
+  ok = fclose (w->file) == 0 && ok;
+  free (w->fences);
+  return ok;
+}
+
+/***********************************************************************
+  Static Functions: The Index
+***********************************************************************/
+
+/* Write the MANIFEST of INDEX.  Return zero on failure.  */
+
+static int
+index_write_manifest (fingerprint_index_t* index)
+{
+  char* tmp = index_path (index, "MANIFEST.tmp");
+  char* path = index_path (index, "MANIFEST");
+  FILE* file = NULL;
+  int ok = 0;
+  int i;
+
+  if (tmp && path && (file = fopen (tmp, "w")) != NULL) {
+    ok = fprintf (file, "%s %lu\n", INDEX_MAGIC, index->next) > 0;
+    for (i = 0; ok && i < index->segments; ++i)
+      ok = fprintf (file, "%lu\n", index->segment[i].id) > 0;
+    ok = fflush (file) == 0 && ok;
+#if INDEX_MMAP
+    ok = ok && fsync (fileno (file)) == 0;
+#endif /* INDEX_MMAP */
+    ok = fclose (file) == 0 && ok;
+#if !INDEX_MMAP
+    remove (path);
+#endif /* !INDEX_MMAP */
+    ok = ok && rename (tmp, path) == 0;
+  }
+  free (tmp);
+  free (path);
+  return ok;
+}
+
+/* Write a new segment from RECORDS, and load it into *SEGMENT.  Records
+   are fetched with NEXT (ARG, &KEY, &OFFSET, &LENGTH), which returns
+   zero once there are no more, and must come in increasing order of
+   key.  Return zero on failure.  */
+
+static int
+index_new_segment (fingerprint_index_t* index,
+                   int                  (*next) (void*, const byte_t**,
+                                                 unsigned long*,
+                                                 unsigned long*),
+                   void*                arg,
+                   index_segment_t*     segment)
+{
+  unsigned long id = index->next;
+  char* tmp = index_segment_path (index, id, ".tmp");
+  char* path = index_segment_path (index, id, "");
+  index_writer_t w;
+  const byte_t* key;
+  unsigned long offset, length;
+  int ok = 0;
+
+  if (tmp && path && index_writer_open (&w, tmp)) {
+    ok = 1;
+    while (ok && next (arg, &key, &offset, &length))
+      ok = index_writer_put (&w, key, offset, length);
+    ok = index_writer_close (&w) && ok;
+    ok = ok && rename (tmp, path) == 0;
+    if (!ok)
+      remove (tmp);
+  }
+  free (tmp);
+  free (path);
+  if (!ok)
+    return 0;
+  ++index->next;
+  return index_load (index, id, segment);
+}
+
+/* The state of a merge of segments.  */
+
+typedef struct index_merge_t {
+  const index_segment_t*
+                segment;
+                        /* The segments, oldest first.  */
+  int           n;      /* The number of segments.  */
+  unsigned long at[INDEX_MAX_SEGMENTS];
+                        /* The next record of each segment.  */
+} index_merge_t;
+
+/* Fetch the next record of the merge ARG: the least key left, from
+   the newest segment that has it.  */
+
+static int
+index_merge_next (void*           arg,
+                  const byte_t**  key,
+                  unsigned long*  offset,
+                  unsigned long*  length)
+{
+  index_merge_t* m = (index_merge_t*) arg;
+  const byte_t* best = NULL;
+  int i;
+
+  for (i = 0; i < m->n; ++i)
+    if (m->at[i] < m->segment[i].count) {
+      const byte_t* r = index_record (&m->segment[i], m->at[i]);
+
+      if (!best || memcmp (r, best, 8) <= 0)
+        best = r;
+    }
+  if (!best)
+    return 0;
+  for (i = 0; i < m->n; ++i)
+    if (m->at[i] < m->segment[i].count
+        && memcmp (index_record (&m->segment[i], m->at[i]), best, 8) == 0)
+      ++m->at[i];
+  *key = best;
+  *offset = index_get (best + 8);
+  *length = index_get (best + 16);
+  return 1;
+}
+
+/* Merge the segments of INDEX from FIRST onwards into one.  Return zero
+   on failure, leaving INDEX as it was.  */
+
+static int
+index_merge (fingerprint_index_t* index, int first)
+{
+  index_merge_t m;
+  index_segment_t merged;
+  index_segment_t old[INDEX_MAX_SEGMENTS];
+  int n = index->segments - first;
+  int i;
+
+  m.segment = &index->segment[first];
+  m.n = n;
+  memset (m.at, 0, sizeof (m.at));
+  if (!index_new_segment (index, index_merge_next, &m, &merged))
+    return 0;
+
+  memcpy (old, &index->segment[first], n * sizeof (index_segment_t));
+  index->segment[first] = merged;
+  index->segments = first + 1;
+  if (!index_write_manifest (index)) {
+    char* path = index_segment_path (index, merged.id, "");
+
+    memcpy (&index->segment[first], old, n * sizeof (index_segment_t));
+    index->segments = first + n;
+    index_unload (&merged);
+    if (path)
+      remove (path);
+    free (path);
+    return 0;
+  }
+
+  /* Once the MANIFEST no longer names the old segments, they can go;
+     readers which have them mapped keep them until they close.  */
+  for (i = 0; i < n; ++i) {
+    char* path = index_segment_path (index, old[i].id, "");
+
+    index_unload (&old[i]);
+    if (path)
+      remove (path);
+    free (path);
+  }
+  return 1;
+}
+
+/* Return the size class of a segment of COUNT records.  */
+
+static int
+index_class (unsigned long count)
+{
+  unsigned long limit = INDEX_MEMORY;
+  int c = 0;
+
+  while (count > limit && c < 16) {
+    limit *= INDEX_FANOUT;
+    ++c;
+  }
+  return c;
+}
+
+/* Merge the newest segments of INDEX while INDEX_FANOUT of them are of
+   the same size class.  Return zero on failure.  */
+
+static int
+index_settle (fingerprint_index_t* index)
+{
+  while (index->segments >= INDEX_FANOUT) {
+    int first = index->segments - INDEX_FANOUT;
+    int c = index_class (index->segment[first].count);
+    int i;
+
+    for (i = first + 1; i < index->segments; ++i)
+      if (index_class (index->segment[i].count) != c)
+        return 1;
+    if (!index_merge (index, first))
+      return 0;
+  }
+  return 1;
+}
+
+/* Return the slot of KEY in the table of INDEX: either the slot of its
+   entry, or the empty slot where it would go.  */
+
+static int
+index_slot (const fingerprint_index_t* index, const byte_t* key)
+{
+  unsigned int mask = 2 * INDEX_MEMORY - 1;
+  unsigned int h;
+  int s;
+
+  memcpy (&h, key, sizeof (h));
+  h ^= (unsigned int) key[4] << 24 | key[5] << 16 | key[6] << 8 | key[7];
+  h *= 0x9e3779b1U;
+  for (s = (h >> 8) & mask;
+       index->slot[s] >= 0
+         && memcmp (index->entry[index->slot[s]].key, key, 8) != 0;
+       s = (s + 1) & mask)
+    ;
+  return s;
+}
+
+/* Order two entries by key.  */
+
+static int
+index_compare (const void* a, const void* b)
+{
+  return memcmp (((const index_entry_t*) a)->key,
+                 ((const index_entry_t*) b)->key, 8);
+}
+
+/* The state of a walk over the sorted entries of an index.  */
+
+typedef struct index_dump_t {
+  const index_entry_t*
+                entry;
+  int           n;
+  int           at;
+} index_dump_t;
+
+/* Fetch the next entry of the walk ARG.  */
+
+static int
+index_dump_next (void*           arg,
+                 const byte_t**  key,
+                 unsigned long*  offset,
+                 unsigned long*  length)
+{
+  index_dump_t* d = (index_dump_t*) arg;
+  const index_entry_t* e;
+
+  if (d->at == d->n)
+    return 0;
+  e = &d->entry[d->at++];
+  *key = e->key;
+  *offset = e->offset;
+  *length = e->length;
+  return 1;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_index_t*
+fingerprint_index_open (const char* dir)
+{
+  fingerprint_index_t* index;
+  char* path;
+  FILE* file;
+  char magic[16];
+  unsigned long id;
+
+  index = (fingerprint_index_t*) calloc (1, sizeof (*index));
+  if (!index)
+    return NULL;
+  index->dir = (char*) malloc (strlen (dir) + 1);
+  index->entry = (index_entry_t*)
+    malloc (INDEX_MEMORY * sizeof (index_entry_t));
+  index->slot = (int*) malloc (2 * INDEX_MEMORY * sizeof (int));
+  if (!index->dir || !index->entry || !index->slot) {
+    fingerprint_index_close (index);
+    return NULL;
+  }
+  strcpy (index->dir, dir);
+  memset (index->slot, -1, 2 * INDEX_MEMORY * sizeof (int));
+  index->next = 1;
+
+  path = index_path (index, "MANIFEST");
+  file = path ? fopen (path, "r") : NULL;
+  free (path);
+  if (file) {
+    int ok = (fscanf (file, "%15s %lu", magic, &index->next) == 2
+              && strcmp (magic, INDEX_MAGIC) == 0);
+
+    while (ok && fscanf (file, "%lu", &id) == 1) {
+      ok = (index->segments < INDEX_MAX_SEGMENTS
+            && index_load (index, id,
+                           &index->segment[index->segments]));
+      if (ok)
+        ++index->segments;
+    }
+    fclose (file);
+    if (!ok) {
+      fingerprint_index_close (index);
+      return NULL;
+    }
+  } else if (errno != ENOENT || !index_write_manifest (index)) {
+    /* A new index starts with an empty MANIFEST, which also checks
+       that the directory is there.  */
+    fingerprint_index_close (index);
+    return NULL;
+  }
+  return index;
+}
+
+int
+fingerprint_index_close (fingerprint_index_t* index)
+{
+  int ok = 1;
+  int i;
+
+  if (!index)
+    return 1;
+  if (index->dir && index->entry && index->slot)
+    ok = fingerprint_index_flush (index);
+  for (i = 0; i < index->segments; ++i)
+    index_unload (&index->segment[i]);
+  free (index->dir);
+  free (index->entry);
+  free (index->slot);
+  free (index);
+  return ok;
+}
+
+int
+fingerprint_index_lookup (fingerprint_index_t* index,
+                          fingerprint_t        fp,
+                          unsigned long*       offset,
+                          unsigned long*       length)
+{
+  const byte_t* key = FINGERPRINT_BYTE (fp);
+  int s = index_slot (index, key);
+  int i;
+
+  if (index->slot[s] >= 0) {
+    *offset = index->entry[index->slot[s]].offset;
+    *length = index->entry[index->slot[s]].length;
+    return 1;
+  }
+  for (i = index->segments - 1; i >= 0; --i) {
+    const byte_t* r = index_search (&index->segment[i], key);
+
+    if (r) {
+      *offset = index_get (r + 8);
+      *length = index_get (r + 16);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int
+fingerprint_index_add (fingerprint_index_t* index,
+                       fingerprint_t        fp,
+                       unsigned long        offset,
+                       unsigned long        length)
+{
+  const byte_t* key = FINGERPRINT_BYTE (fp);
+  int s = index_slot (index, key);
+  index_entry_t* e;
+
+  if (index->slot[s] < 0) {
+    if (index->entries == INDEX_MEMORY) {
+      if (!fingerprint_index_flush (index))
+        return 0;
+      s = index_slot (index, key);
+    }
+    index->slot[s] = index->entries++;
+    memcpy (index->entry[index->slot[s]].key, key, 8);
+  }
+  e = &index->entry[index->slot[s]];
+  e->offset = offset;
+  e->length = length;
+  return 1;
+}
+
+int
+fingerprint_index_flush (fingerprint_index_t* index)
+{
+  index_dump_t d;
+
+  if (index->entries == 0)
+    return 1;
+  if (index->segments == INDEX_MAX_SEGMENTS
+      && !index_merge (index, 0))
+    return 0;
+
+  qsort (index->entry, index->entries, sizeof (index_entry_t),
+         index_compare);
+  d.entry = index->entry;
+  d.n = index->entries;
+  d.at = 0;
+  if (!index_new_segment (index, index_dump_next, &d,
+                          &index->segment[index->segments])) {
+    /* The sort spoiled the table; rebuild it, so that nothing is
+       lost.  */
+    int i;
+
+    memset (index->slot, -1, 2 * INDEX_MEMORY * sizeof (int));
+    for (i = 0; i < index->entries; ++i)
+      index->slot[index_slot (index, index->entry[i].key)] = i;
+    return 0;
+  }
+  ++index->segments;
+  if (!index_write_manifest (index))
+    return 0;
+
+  index->entries = 0;
+  memset (index->slot, -1, 2 * INDEX_MEMORY * sizeof (int));
+  return index_settle (index);
+}
+
+int
+fingerprint_index_compact (fingerprint_index_t* index)
+{
+  if (!fingerprint_index_flush (index))
+    return 0;
+  if (index->segments <= 1)
+    return 1;
+  return index_merge (index, 0);
+}
+
+unsigned long
+fingerprint_index_count (const fingerprint_index_t* index)
+{
+  unsigned long count = index->entries;
+  int i;
+
+  for (i = 0; i < index->segments; ++i)
+    count += index->segment[i].count;
+  return count;
+}
@@ -0,0 +1,102 @@
+/***********************************************************************
+
+ File:   fpindex.h
+
+ Contents: A persistent index from fingerprints to extents of a file.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_INDEX_H
+#define FINGERPRINT_INDEX_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* An index maps fingerprints to records of two numbers, an offset and
+   a length, and lives in a directory of its own.  It is kept as a
+   number of segments, each a file of records sorted by fingerprint,
+   together with a table in memory of records not yet written out.  A
+   file called MANIFEST names the segments, oldest first.
+
+   A segment is a header page, followed by pages of records, followed
+   by the fence keys: the fingerprint of the first record of each
+   page.  Where the system provides it, segments are mapped into memory
+   rather than read, so that opening an index is quick however large
+   it is.  Since fingerprints are evenly spread, the page that should
+   hold a fingerprint is first estimated from its leading bytes, and
+   the estimate corrected by searching the fence keys near it; a lookup
+   usually touches one page of fence keys and one page of records.
+
+   New records go to the table in memory, which is sorted and written
+   as a new segment when it fills, or when the index is flushed.
+   Segments are merged when enough of a similar size have built up, so
+   that each record is rewritten only a few times however many are
+   added; this also serves to build an index from records presented in
+   any order.  If a fingerprint is added more than once, the latest
+   record wins.
+
+   All numbers in the files are little-endian, so that an index can be
+   moved between machines.  An index may be read by several processes,
+   but only one may change it at a time.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* A fingerprint_index_t is an open index.  The type is opaque.  */
+
+typedef struct fingerprint_index_t fingerprint_index_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Open the index in the directory DIR, which must exist; an empty
+   directory holds an empty index.  Return NULL if the index cannot be
+   read, or if memory is exhausted.  */
+extern fingerprint_index_t* fingerprint_index_open (const char* dir);
+
+/* Flush INDEX, and release it.  Return zero if the flush fails, and
+   non-zero otherwise; INDEX is released either way.  */
+extern int fingerprint_index_close (fingerprint_index_t* index);
+
+/* Look up FP in INDEX.  If it is present, store its record in *OFFSET
+   and *LENGTH, and return non-zero; otherwise, return zero.  */
+extern int fingerprint_index_lookup (fingerprint_index_t* index,
+                                     fingerprint_t        fp,
+                                     unsigned long*       offset,
+                                     unsigned long*       length);
+
+/* Add the record (OFFSET, LENGTH) for FP to INDEX, replacing any
+   record for FP already there.  Return zero if a segment cannot be
+   written, or if memory is exhausted, and non-zero otherwise.  */
+extern int fingerprint_index_add (fingerprint_index_t* index,
+                                  fingerprint_t        fp,
+                                  unsigned long        offset,
+                                  unsigned long        length);
+
+/* Write the records of INDEX which are only in memory to a new
+   segment.  Return zero on failure, and non-zero otherwise.  */
+extern int fingerprint_index_flush (fingerprint_index_t* index);
+
+/* Flush INDEX, and merge all of its segments into one.  Return zero on
+   failure, and non-zero otherwise.  */
+extern int fingerprint_index_compact (fingerprint_index_t* index);
+
+/* Return the number of records in INDEX, counting each record which
+   has been replaced but not yet merged away.  */
+extern unsigned long fingerprint_index_count
+                        (const fingerprint_index_t* index);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_INDEX_H */
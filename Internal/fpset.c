@@ -0,0 +1,436 @@
+/***********************************************************************
+
+ File:   fpset.c
+
+ Contents: Compressed sets of fingerprints.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "fpset.h"
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* SET_SAMPLE is the spacing of the sampled clear bits.  */
+
+#define SET_SAMPLE 64
+
+/* SET_STEP is the number of buckets an iterator steps through before
+   it jumps instead.  */
+
+#define SET_STEP 16
+
+/* SET_BIT (V, P) is bit P of the bit vector V.  */
+
+#define SET_BIT(v, p) (((v)[(p) >> 5] >> ((p) & 31)) & 1)
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+typedef fingerprint_word_t word_t;
+
+/* Within this file, a fingerprint is handled as its key: two words,
+   the high 32 bits of its number and the low.  Each key of a set is
+   cut into three parts: its high B bits, given by the bit vector; the
+   next SHIFT = 32 - B, its middle bits; and its low word.  */
+
+struct fingerprint_set_t {
+  unsigned long count;  /* The number of fingerprints.  */
+  int           shift;  /* The number of middle bits.  */
+  unsigned long buckets;
+                        /* The number of values of the high bits,
+                           2^(32 - SHIFT).  */
+  word_t*       low;    /* The low word of each key.  */
+  word_t*       middle; /* The middle bits of each key, packed.  */
+  word_t*       upper;  /* The bit vector: the key with index I and
+                           high bits H is bit I + H, and bucket H ends
+                           at clear bit H.  It has COUNT + BUCKETS
+                           bits, and a spare word.  */
+  word_t*       zero;   /* ZERO[J] is the position of clear bit
+                           J * SET_SAMPLE.  */
+  unsigned long middle_words;
+                        /* The number of words of MIDDLE.  */
+  unsigned long upper_words;
+                        /* The number of words of UPPER.  */
+  unsigned long samples;
+                        /* The number of entries of ZERO.  */
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Return the number of bits set in X.  */
+
+static int
+set_popcount (word_t x)
+{
+#ifdef __GNUC__
+  return __builtin_popcount (x);
+#else /* !__GNUC__ */
+  x = x - ((x >> 1) & 0x55555555U);
+  x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+  x = (x + (x >> 4)) & 0x0f0f0f0fU;
+  return (int) ((x * 0x01010101U) >> 24);
+#endif /* __GNUC__ */
+}
+
+/* Return the position of the lowest bit set in X, which is not
+   zero.  */
+
+static int
+set_lowest (word_t x)
+{
+#ifdef __GNUC__
+  return __builtin_ctz (x);
+#else /* !__GNUC__ */
+  int n = 0;
+
+  while (!(x & 1)) {
+    x >>= 1;
+    ++n;
+  }
+  return n;
+#endif /* __GNUC__ */
+}
+
+/* Store the key of FP in KEY.  */
+
+static void
+set_key (fingerprint_t fp, word_t* key)
+{
+  const fingerprint_byte_t* b = FINGERPRINT_BYTE (fp);
+
+  key[0] = (word_t) b[0] << 24 | (word_t) b[1] << 16
+    | (word_t) b[2] << 8 | b[3];
+  key[1] = (word_t) b[4] << 24 | (word_t) b[5] << 16
+    | (word_t) b[6] << 8 | b[7];
+}
+
+/* Return the fingerprint whose key is KEY.  */
+
+static fingerprint_t
+set_fingerprint (const word_t* key)
+{
+  fingerprint_t fp;
+  fingerprint_byte_t* b = FINGERPRINT_BYTE (fp);
+  int i;
+
+  for (i = 0; i < 4; ++i) {
+    b[i] = (fingerprint_byte_t) (key[0] >> (24 - 8 * i));
+    b[4 + i] = (fingerprint_byte_t) (key[1] >> (24 - 8 * i));
+  }
+  return fp;
+}
+
+/* Compare the keys A and B, as memcmp does.  */
+
+static int
+set_compare (const word_t* a, const word_t* b)
+{
+  if (a[0] != b[0])
+    return a[0] < b[0] ? -1 : 1;
+  if (a[1] != b[1])
+    return a[1] < b[1] ? -1 : 1;
+  return 0;
+}
+
+static int
+set_compare_qsort (const void* a, const void* b)
+{
+  return set_compare ((const word_t*) a, (const word_t*) b);
+}
+
+/* Return the middle bits of key I of SET.  */
+
+static word_t
+set_middle (const fingerprint_set_t* set, unsigned long i)
+{
+  unsigned long offset = i * set->shift;
+  int b = (int) (offset & 31);
+  const word_t* m = set->middle + (offset >> 5);
+  word_t v = m[0] >> b;
+
+  if (b + set->shift > 32)
+    v |= m[1] << (32 - b);
+  return v & (((word_t) 1 << set->shift) - 1);
+}
+
+/* Return the position of the first bit of the bit vector of SET set
+   at or after POS, which there must be.  */
+
+static unsigned long
+set_next_one (const fingerprint_set_t* set, unsigned long pos)
+{
+  unsigned long w = pos >> 5;
+  word_t x = set->upper[w] & ((word_t) ~0U << (pos & 31));
+
+  while (!x)
+    x = set->upper[++w];
+  return (w << 5) + set_lowest (x);
+}
+
+/* Return the position of clear bit K of the bit vector of SET, for K
+   below SET->BUCKETS.  */
+
+static unsigned long
+set_select_zero (const fingerprint_set_t* set, unsigned long k)
+{
+  unsigned long pos = set->zero[k / SET_SAMPLE];
+  unsigned long w = pos >> 5;
+  int r = (int) (k % SET_SAMPLE);
+  word_t x = ~set->upper[w] & ((word_t) ~0U << (pos & 31));
+  int c;
+
+  while ((c = set_popcount (x)) <= r) {
+    r -= c;
+    x = ~set->upper[++w];
+  }
+  while (r-- > 0)
+    x &= x - 1;
+  return (w << 5) + set_lowest (x);
+}
+
+/* If ITER has keys left, store the next in KEY, and return non-zero;
+   otherwise, return zero.  ITER is not advanced past the key.  */
+
+static int
+set_peek (fingerprint_set_iter_t* iter, word_t* key)
+{
+  const fingerprint_set_t* set = iter->set;
+
+  if (iter->index >= set->count)
+    return 0;
+  iter->pos = set_next_one (set, iter->pos);
+  key[0] = (word_t) (iter->pos - iter->index) << set->shift
+    | set_middle (set, iter->index);
+  key[1] = set->low[iter->index];
+  return 1;
+}
+
+/* Advance ITER, which has just peeked at a key, past that key.  */
+
+static void
+set_advance (fingerprint_set_iter_t* iter)
+{
+  ++iter->index;
+  ++iter->pos;
+}
+
+/* Move ITER to the start of bucket H.  */
+
+static void
+set_jump (fingerprint_set_iter_t* iter, unsigned long h)
+{
+  unsigned long start = h ? set_select_zero (iter->set, h - 1) + 1 : 0;
+
+  iter->index = start - h;
+  iter->pos = start;
+}
+
+/* Advance ITER past the keys below KEY.  */
+
+static void
+set_seek (fingerprint_set_iter_t* iter, const word_t* key)
+{
+  const fingerprint_set_t* set = iter->set;
+  word_t next[2];
+
+  if (!set_peek (iter, next) || set_compare (next, key) >= 0)
+    return;
+
+  /* Jump to the bucket of KEY, unless ITER is in it already or close
+     enough to step there.  */
+  if ((key[0] >> set->shift) > (next[0] >> set->shift) + SET_STEP)
+    set_jump (iter, key[0] >> set->shift);
+  while (set_peek (iter, next) && set_compare (next, key) < 0)
+    set_advance (iter);
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_set_t*
+fingerprint_set_new (const fingerprint_t* fp, int n)
+{
+  fingerprint_set_t* set;
+  word_t* key;
+  unsigned long count, bits, i, pos, zeros;
+  int b, sorted = 1;
+
+  if (n < 0)
+    return NULL;
+  key = (word_t*) malloc (2 * (n ? n : 1) * sizeof (word_t));
+  if (!key)
+    return NULL;
+  for (i = 0; i < (unsigned long) n; ++i) {
+    set_key (fp[i], key + 2 * i);
+    if (i > 0 && set_compare (key + 2 * (i - 1), key + 2 * i) > 0)
+      sorted = 0;
+  }
+  if (!sorted)
+    qsort (key, n, 2 * sizeof (word_t), set_compare_qsort);
+  for (count = 0, i = 0; i < (unsigned long) n; ++i)
+    if (count == 0 || set_compare (key + 2 * (count - 1), key + 2 * i)) {
+      key[2 * count] = key[2 * i];
+      key[2 * count + 1] = key[2 * i + 1];
+      ++count;
+    }
+
+  set = (fingerprint_set_t*) calloc (1, sizeof (*set));
+  if (!set) {
+    free (key);
+    return NULL;
+  }
+
+  /* Take B bits, at least 1, so that the buckets are at least as many
+     as the keys.  As N is an int, B is at most 31.  */
+  for (b = 1; (1UL << b) < count; ++b)
+    ;
+  set->count = count;
+  set->shift = 32 - b;
+  set->buckets = 1UL << b;
+  bits = count + set->buckets;
+  set->middle_words = count * set->shift / 32 + 2;
+  set->upper_words = bits / 32 + 2;
+  set->samples = (set->buckets - 1) / SET_SAMPLE + 1;
+  set->low = (word_t*) malloc ((count ? count : 1) * sizeof (word_t));
+  set->middle = (word_t*) calloc (set->middle_words, sizeof (word_t));
+  set->upper = (word_t*) calloc (set->upper_words, sizeof (word_t));
+  set->zero = (word_t*) malloc (set->samples * sizeof (word_t));
+  if (!set->low || !set->middle || !set->upper || !set->zero) {
+    free (key);
+    fingerprint_set_free (set);
+    return NULL;
+  }
+
+  for (i = 0; i < count; ++i) {
+    word_t middle = key[2 * i] & (((word_t) 1 << set->shift) - 1);
+    unsigned long offset = i * set->shift;
+    int s = (int) (offset & 31);
+
+    pos = (key[2 * i] >> set->shift) + i;
+    set->upper[pos >> 5] |= (word_t) 1 << (pos & 31);
+    set->middle[offset >> 5] |= middle << s;
+    if (s + set->shift > 32)
+      set->middle[(offset >> 5) + 1] |= middle >> (32 - s);
+    set->low[i] = key[2 * i + 1];
+  }
+  free (key);
+
+  for (pos = 0, zeros = 0; pos < bits; ++pos)
+    if (!SET_BIT (set->upper, pos)) {
+      if (zeros % SET_SAMPLE == 0)
+        set->zero[zeros / SET_SAMPLE] = (word_t) pos;
+      ++zeros;
+    }
+  return set;
+}
+
+void
+fingerprint_set_free (fingerprint_set_t* set)
+{
+  if (!set)
+    return;
+  free (set->low);
+  free (set->middle);
+  free (set->upper);
+  free (set->zero);
+  free (set);
+}
+
+unsigned long
+fingerprint_set_size (const fingerprint_set_t* set)
+{
+  return set->count;
+}
+
+unsigned long
+fingerprint_set_bytes (const fingerprint_set_t* set)
+{
+  return sizeof (*set) + set->count * sizeof (word_t)
+    + (set->middle_words + set->upper_words) * sizeof (word_t)
+    + set->samples * sizeof (word_t);
+}
+
+int
+fingerprint_set_contains (const fingerprint_set_t* set, fingerprint_t fp)
+{
+  fingerprint_set_iter_t iter;
+  word_t key[2], next[2];
+
+  set_key (fp, key);
+  fingerprint_set_iter_init (&iter, set);
+  set_jump (&iter, key[0] >> set->shift);
+  while (set_peek (&iter, next) && set_compare (next, key) < 0)
+    set_advance (&iter);
+  return set_peek (&iter, next) && !set_compare (next, key);
+}
+
+void
+fingerprint_set_iter_init (fingerprint_set_iter_t*  iter,
+                           const fingerprint_set_t* set)
+{
+  iter->set = set;
+  iter->index = 0;
+  iter->pos = 0;
+}
+
+int
+fingerprint_set_iter_next (fingerprint_set_iter_t* iter, fingerprint_t* fp)
+{
+  word_t key[2];
+
+  if (!set_peek (iter, key))
+    return 0;
+  set_advance (iter);
+  *fp = set_fingerprint (key);
+  return 1;
+}
+
+void
+fingerprint_set_iter_seek (fingerprint_set_iter_t* iter, fingerprint_t fp)
+{
+  word_t key[2];
+
+  set_key (fp, key);
+  set_seek (iter, key);
+}
+
+unsigned long
+fingerprint_set_intersect (const fingerprint_set_t* set1,
+                           const fingerprint_set_t* set2,
+                           fingerprint_t*           out)
+{
+  fingerprint_set_iter_t iter1, iter2;
+  word_t key1[2], key2[2];
+  unsigned long count = 0;
+
+  /* Each iterator skips to the key of the other in turn, so runs of
+     keys found in only one set are passed over in a few steps.  */
+  fingerprint_set_iter_init (&iter1, set1);
+  fingerprint_set_iter_init (&iter2, set2);
+  while (set_peek (&iter1, key1)) {
+    set_seek (&iter2, key1);
+    if (!set_peek (&iter2, key2))
+      break;
+    if (set_compare (key1, key2) == 0) {
+      if (out)
+        out[count] = set_fingerprint (key1);
+      ++count;
+      set_advance (&iter1);
+      set_advance (&iter2);
+    } else
+      set_seek (&iter1, key2);
+  }
+  return count;
+}
@@ -0,0 +1,108 @@
+/***********************************************************************
+
+ File:   fpset.h
+
+ Contents: Compressed sets of fingerprints.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_SET_H
+#define FINGERPRINT_SET_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A fingerprint_set_t is an immutable set of fingerprints, held in the
+   Elias-Fano encoding.  Each fingerprint is taken as a 64-bit number,
+   the first byte of FINGERPRINT_BYTE the most significant, and the
+   sets are ordered by that number.  For a set of N fingerprints, the
+   low 64 - B bits of each number, where B is about log2 N, are stored
+   as they are; the high B bits, which are nearly the same for
+   neighbouring numbers, are stored as a bit vector of about 2N bits,
+   in which each number is a set bit and each step in the high bits a
+   clear one.  A set thus takes about 66 - log2 N bits per fingerprint,
+   within a few bits of the least possible for evenly spread numbers:
+   a set of a million fingerprints takes under six bytes each.
+
+   A sample of the positions of the clear bits lets any fingerprint be
+   found in a few steps without decoding the set, so membership tests
+   are quick, and iterators can skip forward to a given fingerprint,
+   so that an intersection costs in proportion to the smaller set.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* The type fingerprint_set_t is opaque.  */
+
+typedef struct fingerprint_set_t fingerprint_set_t;
+
+/* A fingerprint_set_iter_t visits the fingerprints of a set in
+   order.  */
+
+typedef struct fingerprint_set_iter_t {
+  const fingerprint_set_t*
+                set;    /* The set.  */
+  unsigned long index;  /* The number of fingerprints visited.  */
+  unsigned long pos;    /* The position in the bit vector of the high
+                           bits of the next fingerprint, or a clear bit
+                           before it.  */
+} fingerprint_set_iter_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return a new set of the N fingerprints FP, which may be in any order
+   and may repeat.  Sorted input is detected and not sorted again.
+   Return NULL if N is negative, or if memory is exhausted.  */
+extern fingerprint_set_t* fingerprint_set_new (const fingerprint_t* fp,
+                                               int                  n);
+
+/* Release SET.  */
+extern void fingerprint_set_free (fingerprint_set_t* set);
+
+/* Return the number of fingerprints in SET.  */
+extern unsigned long fingerprint_set_size (const fingerprint_set_t* set);
+
+/* Return the number of bytes of memory used by SET.  */
+extern unsigned long fingerprint_set_bytes (const fingerprint_set_t* set);
+
+/* Return non-zero if FP is in SET, and zero otherwise.  */
+extern int fingerprint_set_contains (const fingerprint_set_t* set,
+                                     fingerprint_t            fp);
+
+/* Start ITER at the first fingerprint of SET.  */
+extern void fingerprint_set_iter_init (fingerprint_set_iter_t*  iter,
+                                       const fingerprint_set_t* set);
+
+/* If ITER has fingerprints left, store the next in *FP, advance ITER
+   past it, and return non-zero; otherwise, return zero.  */
+extern int fingerprint_set_iter_next (fingerprint_set_iter_t* iter,
+                                      fingerprint_t*          fp);
+
+/* Advance ITER past the fingerprints below FP, so that the next it
+   yields is the first not below FP.  ITER never moves back.  */
+extern void fingerprint_set_iter_seek (fingerprint_set_iter_t* iter,
+                                       fingerprint_t           fp);
+
+/* Store in OUT, in order, the fingerprints in both SET1 and SET2, and
+   return their number.  OUT must have room for the size of the smaller
+   set, or may be NULL if only the number is wanted.  */
+extern unsigned long fingerprint_set_intersect
+                        (const fingerprint_set_t* set1,
+                         const fingerprint_set_t* set2,
+                         fingerprint_t*           out);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_SET_H */
@@ -0,0 +1,104 @@
+/***********************************************************************
+
+ File:   iov.c
+
+ Contents: Fingerprints of texts held in scattered buffers.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include "iov.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* IOV_CHUNK is the most given to fingerprint_ctx_update at once.  */
+
+#define IOV_CHUNK 0x40000000L
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Append the SIZE bytes of BUFFER to the text of CTX.  The context
+   carries the residue from one buffer to the next, so a buffer may end
+   part way through a word of the text.  */
+
+static void
+iov_update (fingerprint_ctx_t* ctx, const char* buffer, size_t size)
+{
+  while (size > 0) {
+    size_t n = size < (size_t) IOV_CHUNK ? size : (size_t) IOV_CHUNK;
+
+    fingerprint_ctx_update (ctx, buffer, (int) n);
+    buffer += n;
+    size -= n;
+  }
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_t
+fingerprint_from_iov (const struct iovec* iov, int cnt)
+{
+  return fingerprint_basis_from_iov (NULL, iov, cnt);
+}
+
+fingerprint_t
+fingerprint_basis_from_iov (const fingerprint_basis_t* basis,
+                            const struct iovec*        iov,
+                            int                        cnt)
+{
+  fingerprint_ctx_t ctx;
+
+  fingerprint_ctx_init (&ctx, basis);
+  fingerprint_ctx_update_iov (&ctx, iov, cnt);
+  return fingerprint_ctx_final (&ctx);
+}
+
+void
+fingerprint_ctx_update_iov (fingerprint_ctx_t*  ctx,
+                            const struct iovec* iov,
+                            int                 cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; ++i)
+    iov_update (ctx, (const char*) iov[i].iov_base, iov[i].iov_len);
+}
+
+ssize_t
+fingerprint_ctx_readv (fingerprint_ctx_t*  ctx,
+                       int                 fd,
+                       const struct iovec* iov,
+                       int                 cnt)
+{
+  ssize_t result = readv (fd, iov, cnt);
+  size_t  left;
+  int     i;
+
+  if (result <= 0)
+    return result;
+
+  /* readv fills the buffers in order, so the bytes read are a prefix
+     of the text of IOV.  */
+  left = (size_t) result;
+  for (i = 0; i < cnt && left > 0; ++i) {
+    size_t n = iov[i].iov_len < left ? iov[i].iov_len : left;
+
+    iov_update (ctx, (const char*) iov[i].iov_base, n);
+    left -= n;
+  }
+  return result;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,68 @@
+/***********************************************************************
+
+ File:   iov.h
+
+ Contents: Fingerprints of texts held in scattered buffers.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_IOV_H
+#define FINGERPRINT_IOV_H
+
+#include "rabin64.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A text may be held in pieces, as an array of struct iovec in the
+   form taken by readv and writev.  The functions below fingerprint such
+   a text in place, with the same result as fingerprint_from_buffer
+   gives for the pieces joined together, and without joining them.
+   They are not available on Windows, which has no struct iovec.  */
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return the fingerprint of the text held in the CNT buffers of
+   IOV.  */
+extern fingerprint_t fingerprint_from_iov (const struct iovec* iov,
+                                           int                 cnt);
+
+/* Return the fingerprint of the text held in the CNT buffers of IOV,
+   with respect to BASIS.  */
+extern fingerprint_t fingerprint_basis_from_iov
+                        (const fingerprint_basis_t* basis,
+                         const struct iovec*        iov,
+                         int                        cnt);
+
+/* Append the text held in the CNT buffers of IOV to the text of
+   CTX.  */
+extern void fingerprint_ctx_update_iov (fingerprint_ctx_t*  ctx,
+                                        const struct iovec* iov,
+                                        int                 cnt);
+
+/* Read from the file descriptor FD into the CNT buffers of IOV, as
+   readv does, and append the bytes read to the text of CTX.  Return
+   what readv returns; CTX is unchanged if that is -1.  */
+extern ssize_t fingerprint_ctx_readv (fingerprint_ctx_t*  ctx,
+                                      int                 fd,
+                                      const struct iovec* iov,
+                                      int                 cnt);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* _WIN32 */
+
+#endif /* FINGERPRINT_IOV_H */
@@ -0,0 +1,391 @@
+/***********************************************************************
+
+ File:   match.c
+
+ Contents: Multi-pattern substring search with rolling fingerprints.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "match.h"
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* MATCH_BLOCK is the number of bytes whose window fingerprints are
+   computed at a time.  */
+
+#define MATCH_BLOCK 1024
+
+/* MATCH_FILTER_BITS is the base-2 logarithm of the number of bits in
+   the filter which screens fingerprints before the hash tables are
+   consulted.  The filter is kept small enough to stay in the level-1
+   cache.  */
+
+#define MATCH_FILTER_BITS 17
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* A match_group_t holds the patterns of one length.  */
+
+typedef struct match_group_t {
+  int           length; /* The length of the patterns.  */
+  fingerprint_roller_t*
+                roller; /* The rolling fingerprint of the text.  */
+  unsigned int  mask;   /* The number of buckets, less one.  */
+  int*          heads;  /* The first pattern in each bucket, or -1.  */
+} match_group_t;
+
+/* A match_hit_t is an occurrence found in the current block.  */
+
+typedef struct match_hit_t {
+  unsigned long end;    /* The offset of the last byte.  */
+  int           pattern;
+                        /* The index of the pattern.  */
+} match_hit_t;
+
+struct fingerprint_matcher_t {
+  int           count;  /* The number of patterns.  */
+  const char**  text;   /* The bytes of each pattern.  */
+  int*          length; /* The length of each pattern.  */
+  fingerprint_t*
+                fp;     /* The fingerprint of each pattern.  */
+  int*          next;   /* The next pattern in the same bucket, or -1.  */
+  int           groups; /* The number of distinct lengths.  */
+  match_group_t*
+                group;  /* The patterns of each length.  */
+  unsigned char filter[1 << (MATCH_FILTER_BITS - 3)];
+                        /* Bit K is set if some pattern has a key whose
+                           filter bit is K.  */
+  int           keep;   /* The number of trailing bytes of the text
+                           that must be kept, one less than the longest
+                           pattern.  */
+  int           kept;   /* The number of bytes now in TAIL.  */
+  char*         tail;   /* The last bytes of the text.  */
+  unsigned long offset; /* The number of bytes in the text so far.  */
+  fingerprint_t window[MATCH_BLOCK];
+                        /* The window fingerprints of a block.  */
+  match_hit_t*  hits;   /* The occurrences in the current block.  */
+  int           nhits;  /* The number of entries in HITS.  */
+  int           hitsize;
+                        /* The number of entries allocated for HITS.  */
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Return the 32-bit key of FP.  The fingerprint of a window of eight
+   bytes or less is little more than the bytes themselves, so all of
+   its bits are mixed into the key, whose high bits are the best
+   mixed.  */
+
+static unsigned int
+match_key (const fingerprint_t* fp)
+{
+  unsigned int half[2];
+
+  memcpy (half, FINGERPRINT_BYTE (*fp), sizeof (half));
+  return (half[0] ^ (half[1] * 0x85ebca6bU)) * 0x9e3779b1U;
+}
+
+/* Return the bit of the filter for KEY.  */
+
+#define MATCH_FILTER(key) ((key) >> (32 - MATCH_FILTER_BITS))
+
+/* Return the bucket of KEY within GROUP.  */
+
+#define MATCH_BUCKET(group, key) \
+  ((((key) ^ ((key) >> 16)) * 0xc2b2ae35U >> 8) & (group)->mask)
+
+/* Return non-zero if the LENGTH bytes of the text which end at
+   BUFFER[END] are the bytes of TEXT.  Bytes before the start of
+   BUFFER are taken from the tail of MATCHER.  */
+
+static int
+match_verify (const fingerprint_matcher_t* matcher,
+              const char*                  buffer,
+              int                          end,
+              const char*                  text,
+              int                          length)
+{
+  int start = end + 1 - length;
+  int k;
+
+  if (start >= 0)
+    return memcmp (buffer + start, text, length) == 0;
+  k = -start;
+  return (memcmp (matcher->tail + matcher->kept - k, text, k) == 0
+          && memcmp (buffer, text + k, length - k) == 0);
+}
+
+/* Order two hits by their ends, and then by their patterns.  */
+
+static int
+match_compare (const void* a, const void* b)
+{
+  const match_hit_t* h1 = (const match_hit_t*) a;
+  const match_hit_t* h2 = (const match_hit_t*) b;
+
+  if (h1->end != h2->end)
+    return h1->end < h2->end ? -1 : 1;
+  return h1->pattern - h2->pattern;
+}
+
+/* Record an occurrence of PATTERN ending at END.  Return zero if
+   memory is exhausted.  */
+
+static int
+match_add_hit (fingerprint_matcher_t* matcher,
+               unsigned long          end,
+               int                    pattern)
+{
+  if (matcher->nhits == matcher->hitsize) {
+    int size = matcher->hitsize ? 2 * matcher->hitsize : 64;
+    match_hit_t* hits = (match_hit_t*)
+      realloc (matcher->hits, size * sizeof (match_hit_t));
+
+    if (!hits)
+      return 0;
+    matcher->hits = hits;
+    matcher->hitsize = size;
+  }
+  matcher->hits[matcher->nhits].end = end;
+  matcher->hits[matcher->nhits].pattern = pattern;
+  ++matcher->nhits;
+  return 1;
+}
+
+/* Find the occurrences of the patterns of GROUP which end within the
+   SIZE bytes of BUFFER, which start at offset BASE of the text.  Return
+   zero if memory is exhausted.  */
+
+static int
+match_scan_group (fingerprint_matcher_t* matcher,
+                  match_group_t*         group,
+                  const char*            buffer,
+                  int                    size,
+                  int                    at,
+                  unsigned long          base)
+{
+  int i = 0;
+
+  fingerprint_roller_update (group->roller, buffer + at, size,
+                             matcher->window);
+
+  /* The first windows of the text are short.  */
+  if (base + 1 < (unsigned long) group->length)
+    i = group->length - 1 - base;
+
+  for (; i < size; ++i) {
+    unsigned int key = match_key (&matcher->window[i]);
+    unsigned int k = MATCH_FILTER (key);
+    int p;
+
+    if (!(matcher->filter[k >> 3] & (1 << (k & 7))))
+      continue;
+    for (p = group->heads[MATCH_BUCKET (group, key)];
+         p >= 0;
+         p = matcher->next[p])
+      if (memcmp (&matcher->fp[p], &matcher->window[i],
+                  sizeof (fingerprint_t)) == 0
+          && match_verify (matcher, buffer, at + i,
+                           matcher->text[p], group->length)
+          && !match_add_hit (matcher, base + i, p))
+        return 0;
+  }
+  return 1;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_matcher_t*
+fingerprint_matcher_new (const char* const* patterns,
+                         const int*         lengths,
+                         int                n)
+{
+  fingerprint_matcher_t* matcher;
+  char* copy;
+  size_t total = 0;
+  int i, g;
+
+  for (i = 0; i < n; ++i) {
+    if (lengths[i] <= 0)
+      return NULL;
+    total += lengths[i];
+  }
+
+  matcher = (fingerprint_matcher_t*) calloc (1, sizeof (*matcher));
+  if (!matcher)
+    return NULL;
+  matcher->text = (const char**) calloc (n + 1, sizeof (char*));
+  matcher->length = (int*) calloc (n + 1, sizeof (int));
+  matcher->fp = (fingerprint_t*) malloc ((n + 1) * sizeof (fingerprint_t));
+  matcher->next = (int*) malloc ((n + 1) * sizeof (int));
+  matcher->group = (match_group_t*) calloc (n + 1, sizeof (match_group_t));
+  copy = (char*) malloc (total + 1);
+  if (!matcher->text || !matcher->length || !matcher->fp
+      || !matcher->next || !matcher->group || !copy) {
+    free (copy);
+    fingerprint_matcher_free (matcher);
+    return NULL;
+  }
+
+  /* The copies of the patterns share a single block, which is freed
+     through the first of them.  */
+  for (i = 0; i < n; ++i) {
+    memcpy (copy, patterns[i], lengths[i]);
+    matcher->text[i] = copy;
+    matcher->length[i] = lengths[i];
+    copy += lengths[i];
+    if (lengths[i] > matcher->keep + 1)
+      matcher->keep = lengths[i] - 1;
+  }
+  matcher->count = n;
+  if (n == 0)
+    free (copy);
+  else
+    fingerprint_from_buffers ((const char* const*) matcher->text,
+                              matcher->length, n, matcher->fp);
+
+  /* Form a group for each distinct length, in the order in which the
+     lengths first appear.  */
+  for (i = 0; i < n; ++i) {
+    for (g = 0; g < matcher->groups; ++g)
+      if (matcher->group[g].length == lengths[i])
+        break;
+    if (g == matcher->groups) {
+      matcher->group[g].length = lengths[i];
+      ++matcher->groups;
+    }
+    ++matcher->group[g].mask;
+  }
+  for (g = 0; g < matcher->groups; ++g) {
+    match_group_t* group = &matcher->group[g];
+    unsigned int buckets = 1;
+
+    while (buckets < 2 * group->mask)
+      buckets <<= 1;
+    group->mask = buckets - 1;
+    group->heads = (int*) malloc (buckets * sizeof (int));
+    group->roller = fingerprint_roller_new (NULL, group->length);
+    if (!group->heads || !group->roller) {
+      fingerprint_matcher_free (matcher);
+      return NULL;
+    }
+    memset (group->heads, -1, buckets * sizeof (int));
+  }
+
+  /* Insert the patterns in reverse, so that each bucket lists its
+     patterns in order.  */
+  for (i = n - 1; i >= 0; --i) {
+    unsigned int key = match_key (&matcher->fp[i]);
+    unsigned int k = MATCH_FILTER (key);
+    match_group_t* group;
+
+    for (g = 0; matcher->group[g].length != lengths[i]; ++g)
+      ;
+    group = &matcher->group[g];
+    matcher->next[i] = group->heads[MATCH_BUCKET (group, key)];
+    group->heads[MATCH_BUCKET (group, key)] = i;
+    matcher->filter[k >> 3] |= 1 << (k & 7);
+  }
+
+  matcher->tail = (char*) malloc (matcher->keep + 1);
+  if (!matcher->tail) {
+    fingerprint_matcher_free (matcher);
+    return NULL;
+  }
+  return matcher;
+}
+
+void
+fingerprint_matcher_free (fingerprint_matcher_t* matcher)
+{
+  int g;
+
+  if (!matcher)
+    return;
+  if (matcher->group)
+    for (g = 0; g < matcher->groups; ++g) {
+      free (matcher->group[g].heads);
+      fingerprint_roller_free (matcher->group[g].roller);
+    }
+  if (matcher->text && matcher->count > 0)
+    free ((char*) matcher->text[0]);
+  free (matcher->text);
+  free (matcher->length);
+  free (matcher->fp);
+  free (matcher->next);
+  free (matcher->group);
+  free (matcher->tail);
+  free (matcher->hits);
+  free (matcher);
+}
+
+void
+fingerprint_matcher_reset (fingerprint_matcher_t* matcher)
+{
+  int g;
+
+  for (g = 0; g < matcher->groups; ++g)
+    fingerprint_roller_reset (matcher->group[g].roller);
+  matcher->kept = 0;
+  matcher->offset = 0;
+}
+
+int
+fingerprint_matcher_scan (fingerprint_matcher_t* matcher,
+                          const char*            buffer,
+                          int                    size,
+                          fingerprint_match_fn_t fn,
+                          void*                  arg)
+{
+  int reported = 0;
+  int at, g, i;
+
+  for (at = 0; at < size; at += MATCH_BLOCK) {
+    int n = size - at < MATCH_BLOCK ? size - at : MATCH_BLOCK;
+
+    matcher->nhits = 0;
+    for (g = 0; g < matcher->groups; ++g)
+      if (!match_scan_group (matcher, &matcher->group[g], buffer, n, at,
+                             matcher->offset + at))
+        return -1;
+    if (matcher->groups > 1 && matcher->nhits > 1)
+      qsort (matcher->hits, matcher->nhits, sizeof (match_hit_t),
+             match_compare);
+    for (i = 0; i < matcher->nhits; ++i) {
+      const match_hit_t* hit = &matcher->hits[i];
+
+      fn (arg, hit->pattern,
+          hit->end + 1 - matcher->length[hit->pattern]);
+    }
+    reported += matcher->nhits;
+  }
+
+  /* Keep the bytes that later occurrences may start with.  */
+  if (size >= matcher->keep) {
+    memcpy (matcher->tail, buffer + size - matcher->keep, matcher->keep);
+    matcher->kept = matcher->keep;
+  } else if (size > 0) {
+    int old = matcher->kept + size <= matcher->keep
+      ? matcher->kept : matcher->keep - size;
+
+    memmove (matcher->tail, matcher->tail + matcher->kept - old, old);
+    memcpy (matcher->tail + old, buffer, size);
+    matcher->kept = old + size;
+  }
+  matcher->offset += size;
+  return reported;
+}
@@ -0,0 +1,83 @@
+/***********************************************************************
+
+ File:   match.h
+
+ Contents: Multi-pattern substring search with rolling fingerprints.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_MATCH_H
+#define FINGERPRINT_MATCH_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A matcher finds every occurrence of a fixed set of patterns in a
+   text, using the method of Rabin and Karp.  The patterns are grouped
+   by length.  For each group, a fingerprint_roller_t computes the
+   fingerprint of the window ending at each byte of the text, and the
+   fingerprint is looked up in a hash table of the fingerprints of the
+   patterns in that group.  Every candidate is checked against the
+   pattern itself, so no false matches are reported.
+
+   The text may be presented in pieces; occurrences which straddle two
+   pieces are found just as if the text had been presented at once.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* A fingerprint_matcher_t holds a compiled set of patterns, and the
+   position of a scan within a text.  The type is opaque.  */
+
+typedef struct fingerprint_matcher_t fingerprint_matcher_t;
+
+/* A fingerprint_match_fn_t is called for each occurrence found.
+   PATTERN is the index of the pattern, and OFFSET is the position of
+   its first byte, counting from the start of the text.  */
+
+typedef void (*fingerprint_match_fn_t) (void*         arg,
+                                        int           pattern,
+                                        unsigned long offset);
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return a new matcher for the N patterns PATTERNS[I], of LENGTHS[I]
+   bytes, positioned at the start of a text.  The patterns are copied.
+   Return NULL if some pattern is empty, or if memory is exhausted.  */
+extern fingerprint_matcher_t* fingerprint_matcher_new
+                        (const char* const* patterns,
+                         const int*         lengths,
+                         int                n);
+
+/* Release MATCHER.  */
+extern void fingerprint_matcher_free (fingerprint_matcher_t* matcher);
+
+/* Return MATCHER to the start of a new text.  */
+extern void fingerprint_matcher_reset (fingerprint_matcher_t* matcher);
+
+/* Append BUFFER to the text of MATCHER, calling FN (ARG, ...) for each
+   occurrence which ends within BUFFER.  Occurrences are reported in
+   the order of their last bytes, and then in the order of the
+   patterns.  Return the number of occurrences reported, or -1 if
+   memory is exhausted.  */
+extern int fingerprint_matcher_scan (fingerprint_matcher_t* matcher,
+                                     const char*            buffer,
+                                     int                    size,
+                                     fingerprint_match_fn_t fn,
+                                     void*                  arg);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_MATCH_H */
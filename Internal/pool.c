@@ -0,0 +1,432 @@
+/***********************************************************************
+
+ File:   pool.c
+
+ Contents: A pool of threads which fingerprint buffers and files.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+/* POOL_THREADS is 1 if jobs run on threads of their own.  */
+
+#if !defined(FINGERPRINT_NO_THREADS) && !defined(_WIN32)
+#define POOL_THREADS 1
+#include <pthread.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else /* !(!defined(FINGERPRINT_NO_THREADS) && ...) */
+#define POOL_THREADS 0
+#endif /* !defined(FINGERPRINT_NO_THREADS) && ... */
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* POOL_CHUNK is the most given to fingerprint_ctx_update at once, and
+   POOL_READ_SIZE the size of the reads of a file.  */
+
+#define POOL_CHUNK 0x40000000L
+#define POOL_READ_SIZE 65536
+
+/* POOL_MAX_THREADS bounds the number of threads of a pool.  */
+
+#define POOL_MAX_THREADS 256
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* A pool_job_t is a job, which is on the queue of POOL until a thread
+   takes it, and then on the list of finished jobs until its result is
+   collected.  */
+
+typedef struct pool_job_t {
+  struct pool_job_t*
+                next;   /* The next job on the same list.  */
+  const fingerprint_basis_t*
+                basis;  /* The basis.  */
+  const char*   buffer; /* The text, or NULL for a file.  */
+  unsigned long size;   /* The size of the text.  */
+  char*         path;   /* The name of the file, or NULL.  */
+  fingerprint_pool_result_t
+                result; /* The result.  */
+} pool_job_t;
+
+/* A pool_list_t is a list of jobs, first in, first out.  */
+
+typedef struct pool_list_t {
+  pool_job_t*   head;
+  pool_job_t*   tail;
+} pool_list_t;
+
+struct fingerprint_pool_t {
+  pool_list_t   queue;  /* The jobs not yet started.  */
+  pool_list_t   done;   /* The jobs finished but not collected.  */
+  unsigned long pending;
+                        /* The number of jobs not collected.  */
+#if POOL_THREADS
+  pthread_mutex_t
+                lock;   /* Guards the fields above and STOP.  */
+  pthread_cond_t
+                work;   /* Signalled when a job is queued, or when
+                           STOP is set.  */
+  pthread_cond_t
+                finish; /* Signalled when a job finishes.  */
+  int           stop;   /* Non-zero if the threads are to exit.  */
+  int           threads;
+                        /* The number of threads.  */
+  pthread_t     thread[POOL_MAX_THREADS];
+                        /* The threads.  */
+  pid_t         pid;    /* The process which owns the threads.  */
+#endif /* POOL_THREADS */
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+static void
+pool_push (pool_list_t* list, pool_job_t* job)
+{
+  job->next = NULL;
+  if (list->tail)
+    list->tail->next = job;
+  else
+    list->head = job;
+  list->tail = job;
+}
+
+static pool_job_t*
+pool_pop (pool_list_t* list)
+{
+  pool_job_t* job = list->head;
+
+  if (job) {
+    list->head = job->next;
+    if (!list->head)
+      list->tail = NULL;
+  }
+  return job;
+}
+
+/* Run JOB, using BUFFER, of POOL_READ_SIZE bytes, to read a file.  */
+
+static void
+pool_run (pool_job_t* job, char* buffer)
+{
+  fingerprint_ctx_t ctx;
+
+  fingerprint_ctx_init (&ctx, job->basis);
+  job->result.error = 0;
+  if (job->path) {
+    FILE* f = fopen (job->path, "rb");
+    size_t n;
+
+    if (!f) {
+      job->result.error = errno ? errno : ENOENT;
+      return;
+    }
+    while ((n = fread (buffer, 1, POOL_READ_SIZE, f)) > 0)
+      fingerprint_ctx_update (&ctx, buffer, (int) n);
+    if (ferror (f))
+      job->result.error = errno ? errno : EIO;
+    fclose (f);
+  } else {
+    const char* p = job->buffer;
+    unsigned long left = job->size;
+
+    while (left > 0) {
+      unsigned long n = left < POOL_CHUNK ? left : POOL_CHUNK;
+
+      fingerprint_ctx_update (&ctx, p, (int) n);
+      p += n;
+      left -= n;
+    }
+  }
+  job->result.fp = fingerprint_ctx_final (&ctx);
+}
+
+#if POOL_THREADS
+/* Return non-zero if POOL was made by this process.  */
+
+static int
+pool_owned (const fingerprint_pool_t* pool)
+{
+  return pool->pid == getpid ();
+}
+
+/* The body of each thread of the pool ARG.  */
+
+static void*
+pool_thread (void* arg)
+{
+  fingerprint_pool_t* pool = (fingerprint_pool_t*) arg;
+  char* buffer = (char*) malloc (POOL_READ_SIZE);
+
+  pthread_mutex_lock (&pool->lock);
+  for (;;) {
+    pool_job_t* job;
+
+    while (!pool->stop && !pool->queue.head)
+      pthread_cond_wait (&pool->work, &pool->lock);
+    job = pool_pop (&pool->queue);
+    if (!job)
+      break;
+    pthread_mutex_unlock (&pool->lock);
+
+    if (job->path && !buffer)
+      job->result.error = ENOMEM;
+    else
+      pool_run (job, buffer);
+
+    pthread_mutex_lock (&pool->lock);
+    pool_push (&pool->done, job);
+    pthread_cond_signal (&pool->finish);
+  }
+  pthread_mutex_unlock (&pool->lock);
+  free (buffer);
+  return NULL;
+}
+#endif /* POOL_THREADS */
+
+/* Add JOB to POOL, or free it and return zero.  */
+
+static int
+pool_add (fingerprint_pool_t* pool, pool_job_t* job)
+{
+#if POOL_THREADS
+  if (!pool_owned (pool)) {
+    free (job->path);
+    free (job);
+    return 0;
+  }
+  pthread_mutex_lock (&pool->lock);
+  pool_push (&pool->queue, job);
+  ++pool->pending;
+  pthread_cond_signal (&pool->work);
+  pthread_mutex_unlock (&pool->lock);
+#else /* !POOL_THREADS */
+  char* buffer = job->path ? (char*) malloc (POOL_READ_SIZE) : NULL;
+
+  if (job->path && !buffer)
+    job->result.error = ENOMEM;
+  else
+    pool_run (job, buffer);
+  free (buffer);
+  pool_push (&pool->done, job);
+  ++pool->pending;
+#endif /* POOL_THREADS */
+  return 1;
+}
+
+/* Take the first finished job of POOL into *RESULT, if there is one,
+   and return non-zero.  The caller holds the lock.  */
+
+static int
+pool_collect (fingerprint_pool_t* pool, fingerprint_pool_result_t* result)
+{
+  pool_job_t* job = pool_pop (&pool->done);
+
+  if (!job)
+    return 0;
+  *result = job->result;
+  --pool->pending;
+  free (job->path);
+  free (job);
+  return 1;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_pool_t*
+fingerprint_pool_new (int threads)
+{
+  fingerprint_pool_t* pool;
+
+  pool = (fingerprint_pool_t*) calloc (1, sizeof (*pool));
+  if (!pool)
+    return NULL;
+#if POOL_THREADS
+  if (threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+#endif /* ifdef _SC_NPROCESSORS_ONLN */
+    if (threads <= 0)
+      threads = 1;
+  }
+  if (threads > POOL_MAX_THREADS)
+    threads = POOL_MAX_THREADS;
+
+  pool->pid = getpid ();
+  if (pthread_mutex_init (&pool->lock, NULL) != 0) {
+    free (pool);
+    return NULL;
+  }
+  if (pthread_cond_init (&pool->work, NULL) != 0) {
+    pthread_mutex_destroy (&pool->lock);
+    free (pool);
+    return NULL;
+  }
+  if (pthread_cond_init (&pool->finish, NULL) != 0) {
+    pthread_cond_destroy (&pool->work);
+    pthread_mutex_destroy (&pool->lock);
+    free (pool);
+    return NULL;
+  }
+  while (pool->threads < threads
+         && pthread_create (&pool->thread[pool->threads], NULL,
+                            pool_thread, pool) == 0)
+    ++pool->threads;
+  if (pool->threads == 0) {
+    fingerprint_pool_free (pool);
+    return NULL;
+  }
+#else /* !POOL_THREADS */
+  (void) threads;
+#endif /* POOL_THREADS */
+  return pool;
+}
+
+void
+fingerprint_pool_free (fingerprint_pool_t* pool)
+{
+  pool_job_t* job;
+
+  if (!pool)
+    return;
+#if POOL_THREADS
+  if (pool_owned (pool)) {
+    int i;
+
+    pthread_mutex_lock (&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast (&pool->work);
+    pthread_mutex_unlock (&pool->lock);
+    fingerprint_pool_cancel (pool);
+    for (i = 0; i < pool->threads; ++i)
+      pthread_join (pool->thread[i], NULL);
+    pthread_cond_destroy (&pool->finish);
+    pthread_cond_destroy (&pool->work);
+    pthread_mutex_destroy (&pool->lock);
+  }
+#endif /* POOL_THREADS */
+  while ((job = pool_pop (&pool->queue)) || (job = pool_pop (&pool->done))) {
+    free (job->path);
+    free (job);
+  }
+  free (pool);
+}
+
+int
+fingerprint_pool_add_buffer (fingerprint_pool_t*        pool,
+                             const fingerprint_basis_t* basis,
+                             const char*                buffer,
+                             unsigned long              size,
+                             void*                      arg)
+{
+  pool_job_t* job = (pool_job_t*) calloc (1, sizeof (*job));
+
+  if (!job)
+    return 0;
+  job->basis = basis;
+  job->buffer = buffer;
+  job->size = size;
+  job->result.arg = arg;
+  return pool_add (pool, job);
+}
+
+int
+fingerprint_pool_add_file (fingerprint_pool_t*        pool,
+                           const fingerprint_basis_t* basis,
+                           const char*                path,
+                           void*                      arg)
+{
+  pool_job_t* job = (pool_job_t*) calloc (1, sizeof (*job));
+
+  if (!job)
+    return 0;
+  job->path = (char*) malloc (strlen (path) + 1);
+  if (!job->path) {
+    free (job);
+    return 0;
+  }
+  strcpy (job->path, path);
+  job->basis = basis;
+  job->result.arg = arg;
+  return pool_add (pool, job);
+}
+
+int
+fingerprint_pool_wait (fingerprint_pool_t*        pool,
+                       fingerprint_pool_result_t* result)
+{
+  int found;
+
+#if POOL_THREADS
+  if (!pool_owned (pool))
+    return 0;
+  pthread_mutex_lock (&pool->lock);
+  while (!pool->done.head && pool->pending > 0)
+    pthread_cond_wait (&pool->finish, &pool->lock);
+  found = pool_collect (pool, result);
+  pthread_mutex_unlock (&pool->lock);
+#else /* !POOL_THREADS */
+  found = pool_collect (pool, result);
+#endif /* POOL_THREADS */
+  return found;
+}
+
+int
+fingerprint_pool_poll (fingerprint_pool_t*        pool,
+                       fingerprint_pool_result_t* result)
+{
+  int found;
+
+#if POOL_THREADS
+  if (!pool_owned (pool))
+    return 0;
+  pthread_mutex_lock (&pool->lock);
+  found = pool_collect (pool, result);
+  pthread_mutex_unlock (&pool->lock);
+#else /* !POOL_THREADS */
+  found = pool_collect (pool, result);
+#endif /* POOL_THREADS */
+  return found;
+}
+
+void
+fingerprint_pool_cancel (fingerprint_pool_t* pool)
+{
+  pool_job_t* job;
+
+#if POOL_THREADS
+  if (!pool_owned (pool))
+    return;
+  pthread_mutex_lock (&pool->lock);
+#endif /* POOL_THREADS */
+  while ((job = pool_pop (&pool->queue)) != NULL) {
+    job->result.error = ECANCELED;
+    pool_push (&pool->done, job);
+  }
+#if POOL_THREADS
+  pthread_cond_broadcast (&pool->finish);
+  pthread_mutex_unlock (&pool->lock);
+#endif /* POOL_THREADS */
+}
+
+unsigned long
+fingerprint_pool_pending (const fingerprint_pool_t* pool)
+{
+  return pool->pending;
+}
@@ -0,0 +1,115 @@
+/***********************************************************************
+
+ File:   pool.h
+
+ Contents: A pool of threads which fingerprint buffers and files.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_POOL_H
+#define FINGERPRINT_POOL_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A pool runs fingerprinting jobs on threads of its own, so that a
+   single-threaded caller can fingerprint many buffers or files at
+   once.  Jobs are added with an argument of the caller's choosing, and
+   their results are collected in the order in which they finish, each
+   with its argument.
+
+   A pool is used by one thread at a time.  After a fork, the copy of
+   a pool in the child process has no threads: no jobs can be added to
+   it, none of its results can be collected, and fingerprint_pool_free
+   releases its memory only.
+
+   Where threads are not available, which is assumed if
+   FINGERPRINT_NO_THREADS is defined or the target is Windows, each job
+   is run as it is added, and a pool may still be used after a fork.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* The type fingerprint_pool_t is opaque.  */
+
+typedef struct fingerprint_pool_t fingerprint_pool_t;
+
+/* A fingerprint_pool_result_t is the result of a job.  */
+
+typedef struct fingerprint_pool_result_t {
+  void*         arg;    /* The argument given when the job was
+                           added.  */
+  fingerprint_t fp;     /* The fingerprint, if ERROR is zero.  */
+  int           error;  /* Zero, or the errno value of a file that
+                           could not be read, or ECANCELED for a job
+                           that was cancelled.  */
+} fingerprint_pool_result_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return a new pool of THREADS threads, or of one thread for each
+   processor if THREADS is not positive.  Return NULL if no thread can
+   be started, or if memory is exhausted.  */
+extern fingerprint_pool_t* fingerprint_pool_new (int threads);
+
+/* Cancel the jobs of POOL which have not started, wait for those which
+   have, and release POOL.  Results not yet collected are lost.  */
+extern void fingerprint_pool_free (fingerprint_pool_t* pool);
+
+/* Add a job to POOL which fingerprints the SIZE bytes of BUFFER with
+   respect to BASIS, or to the default basis if BASIS is NULL.  BUFFER
+   and BASIS must stay unchanged until the result has been collected.
+   Return zero if memory is exhausted, or POOL belongs to another
+   process, and non-zero otherwise.  */
+extern int fingerprint_pool_add_buffer (fingerprint_pool_t*        pool,
+                                        const fingerprint_basis_t* basis,
+                                        const char*                buffer,
+                                        unsigned long              size,
+                                        void*                      arg);
+
+/* Add a job to POOL which fingerprints the contents of the file PATH
+   with respect to BASIS, or to the default basis if BASIS is NULL.
+   BASIS must stay unchanged until the result has been collected.
+   Return zero if memory is exhausted, or POOL belongs to another
+   process, and non-zero otherwise.  */
+extern int fingerprint_pool_add_file (fingerprint_pool_t*        pool,
+                                      const fingerprint_basis_t* basis,
+                                      const char*                path,
+                                      void*                      arg);
+
+/* If POOL has jobs whose results have not been collected, wait for one
+   to finish, store its result in *RESULT, and return non-zero;
+   otherwise, return zero.  */
+extern int fingerprint_pool_wait (fingerprint_pool_t*        pool,
+                                  fingerprint_pool_result_t* result);
+
+/* If a job of POOL has finished and its result has not been collected,
+   store its result in *RESULT, and return non-zero; otherwise, return
+   zero at once.  */
+extern int fingerprint_pool_poll (fingerprint_pool_t*        pool,
+                                  fingerprint_pool_result_t* result);
+
+/* Finish at once the jobs of POOL which have not started, with ERROR
+   set to ECANCELED.  */
+extern void fingerprint_pool_cancel (fingerprint_pool_t* pool);
+
+/* Return the number of jobs of POOL whose results have not been
+   collected.  */
+extern unsigned long fingerprint_pool_pending
+                        (const fingerprint_pool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_POOL_H */
@@ -61,6 +61,18 @@ $Id: rabin64.c,v 1.3 2000/09/05 11:39:13 borud Exp $
 #endif /* ifdef FINGERPRINT_LITTLE_ENDIAN */
 #endif /* FINGERPRINT_USE_INTEGRAL_TYPE */
 
+/* Where it is not given, take the byte order from the compiler if it
+   says what it is.  */
+
+#if !defined(FINGERPRINT_LITTLE_ENDIAN) && defined(__BYTE_ORDER__) \
+    && defined(__ORDER_LITTLE_ENDIAN__) && defined(__ORDER_BIG_ENDIAN__)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define FINGERPRINT_LITTLE_ENDIAN 1
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define FINGERPRINT_LITTLE_ENDIAN 0
+#endif /* __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ */
+#endif /* !defined(FINGERPRINT_LITTLE_ENDIAN) && ... */
+
 /* MAY_BE_LITTLE_ENDIAN is non-zero if the target might be
    little-endian.  */
 
@@ -83,6 +95,30 @@ $Id: rabin64.c,v 1.3 2000/09/05 11:39:13 borud Exp $
 #endif /* (!defined(FINGERPRINT_LITTLE_ENDIAN)
            || FINGERPRINT_LITTLE_ENDIAN) */
 
+/* POLY_X86_SIMD is 1 if the compiler can build kernels for the x86
+   vector extensions, which are then selected at run time according to
+   the processor.  Defining FINGERPRINT_NO_SIMD suppresses them.  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(FINGERPRINT_NO_SIMD)
+#define POLY_X86_SIMD 1
+#include <immintrin.h>
+#else /* !(defined(__GNUC__) && ...) */
+#define POLY_X86_SIMD 0
+#endif /* defined(__GNUC__) && ... */
+
+/* POLY_LINE_SIZE is the size of a cache line, and POLY_ALIGNED asks
+   the compiler to start a static table on one.  Without a compiler
+   that understands the request, tables are merely contiguous.  */
+
+#define POLY_LINE_SIZE 64
+
+#ifdef __GNUC__
+#define POLY_ALIGNED __attribute__ ((aligned (POLY_LINE_SIZE)))
+#else /* ifndef __GNUC__ */
+#define POLY_ALIGNED
+#endif /* ifdef __GNUC__ */
+
 /***********************************************************************
   Types
 ***********************************************************************/
@@ -254,10 +290,15 @@ typedef union int_bytes_t {
   Variables
 ***********************************************************************/
 
+/* The module keeps no state that changes: everything is either
+   constant or belongs to an object passed by the caller, so that
+   several threads may use it at once.  Where the byte order is not
+   known at compile time, poly_little_endian examines it afresh each
+   time; this costs little, as compilers usually reduce it to a
+   constant.  */
+
 #ifndef FINGERPRINT_LITTLE_ENDIAN
-static int poly_little_endian;
-static int poly_big_endian;
-static int poly_init_done;
+#define poly_little_endian (poly_byte_order ())
 #else /* ifdef FINGERPRINT_LITTLE_ENDIAN */
 #define poly_little_endian FINGERPRINT_LITTLE_ENDIAN
 #endif /* ifndef FINGERPRINT_LITTLE_ENDIAN */
@@ -267,10 +308,15 @@ static int poly_init_done;
 static const poly_t
                 POLY_ONE = POLY_INIT (0, (-0x7fffffff - 1));
 
+/* The tables of the Modula-3 basis are kept in a single block which
+   starts on a cache line, so that they straddle as few lines as
+   possible.  */
+
 static const poly_t
-                poly64[256]
-                        /* poly64[i] = i(x) * x^64 MOD P */
-                        = {POLY_INIT (0, 0),
+                poly_table[4][256] POLY_ALIGNED
+                        = {
+                        /* poly_table[0][i] = i(x) * x^64 MOD P */
+                          {POLY_INIT (0, 0),
                            POLY_INIT (36728807, 152935311),
                            POLY_INIT (73457614, 305870622),
                            POLY_INIT (105951273, 455519377),
@@ -526,12 +572,9 @@ static const poly_t
                            POLY_INIT (93259116, 355484059),
                            POLY_INIT (64992581, 236383498),
                            POLY_INIT (32496290, 118191749)
-                        };
-
-static const poly_t
-                poly72[256]
-                        /* poly72[i] = i(x) * x^72 MOD P */
-                        = {POLY_INIT (0, 0),
+                          },
+                        /* poly_table[1][i] = i(x) * x^72 MOD P */
+                          {POLY_INIT (0, 0),
                            POLY_INIT (-1961202135, 335293334),
                            POLY_INIT (468213049, 344628781),
                            POLY_INIT (-1863175408, 125220283),
@@ -787,12 +830,9 @@ static const poly_t
                            POLY_INIT (-1740251814, 201607461),
                            POLY_INIT (146271818, 192085150),
                            POLY_INIT (-2085781405, 412014344)
-                        };
-
-static const poly_t
-                poly80[256]
-                        /* poly80[i] = i(x) * X^80 MOD P */
-                        = {POLY_INIT (0, 0),
+                          },
+                        /* poly_table[2][i] = i(x) * x^80 MOD P */
+                          {POLY_INIT (0, 0),
                            POLY_INIT (-1753253426, 125726524),
                            POLY_INIT (788460444, 251453049),
                            POLY_INIT (-1182692782, 159560005),
@@ -1048,12 +1088,9 @@ static const poly_t
                            POLY_INIT (563510808, 330081567),
                            POLY_INIT (-1743260598, 439227482),
                            POLY_INIT (258510212, 491813734)
-};
-
-static const poly_t
-                poly88[256]
-                        /* poly80[i] = i(x) * X^80 MOD P */
-                        = {POLY_INIT (0, 0),
+                          },
+                        /* poly_table[3][i] = i(x) * x^88 MOD P */
+                          {POLY_INIT (0, 0),
                            POLY_INIT (964379295, 346020725),
                            POLY_INIT (2133460053, 441286634),
                            POLY_INIT (1179731658, 248685727),
@@ -1309,10 +1346,1096 @@ static const poly_t
                            POLY_INIT (450237082, 351136813),
                            POLY_INIT (1552372816, 440354994),
                            POLY_INIT (1711019727, 245404615)
+                          }
+                        };
+
+/* A basis is the polynomial P together with the tables derived from
+   it.  The tables above belong to the Modula-3 basis, which is used
+   whenever a caller passes a null basis; other bases are generated by
+   fingerprint_basis_new.
+
+   With the bit ordering used here, the Modula-3 polynomial is in fact
+   divisible by x^3, so fingerprint_basis_new would refuse it.  It is
+   kept as the default so that existing fingerprints remain valid.  */
+
+struct fingerprint_basis_t {
+  poly_t        p;      /* P, less its x^64 term.  */
+  const poly_t  (*table)[256];
+                        /* table[k][i] = i(x) * x^(64 + 8 * k) MOD P */
+};
+
+typedef fingerprint_basis_t basis_t;
+
+static const basis_t
+                poly_default_basis
+                        = {POLY_INIT (116277429, 431580288),
+                           poly_table};
+
+/* The second basis of a 128-bit fingerprint.  Its polynomial is the
+   one chosen by fingerprint_basis_random (128), and its tables are
+   built in like those above, so that it needs no initialization.  */
+
+static const poly_t
+                poly_wide_table[4][256] POLY_ALIGNED
+                        = {
+                        /* poly_wide_table[0][i] = i(x) * x^64 MOD P */
+                          {POLY_INIT (0, 0),
+                           POLY_INIT (-289131675, -162268687),
+                           POLY_INIT (-1219273363, -73344196),
+                           POLY_INIT (1503096328, 234037965),
+                           POLY_INIT (75334013, -532242778),
+                           POLY_INIT (-356929000, 370501463),
+                           POLY_INIT (-1288774640, 468075930),
+                           POLY_INIT (1575677813, -306856853),
+                           POLY_INIT (1646279005, -678816365),
+                           POLY_INIT (-1931212232, 567929954),
+                           POLY_INIT (-713858000, 741002927),
+                           POLY_INIT (1001871189, -629590178),
+                           POLY_INIT (1717418016, 936151861),
+                           POLY_INIT (-2003203259, -1046515004),
+                           POLY_INIT (-787552947, -865316855),
+                           POLY_INIT (1070257704, 977250808),
+                           POLY_INIT (-1365554915, -1206713351),
+                           POLY_INIT (1079999096, 1312881160),
+                           POLY_INIT (432542832, 1135859909),
+                           POLY_INIT (-150198507, -1243602636),
+                           POLY_INIT (-1427716000, 1482005855),
+                           POLY_INIT (1143143173, -1375312722),
+                           POLY_INIT (498439437, -1544206749),
+                           POLY_INIT (-210655640, 1436991378),
+                           POLY_INIT (-860131264, 1872303722),
+                           POLY_INIT (578765605, -1714753637),
+                           POLY_INIT (2078813485, -1808151210),
+                           POLY_INIT (-1792270776, 1651127463),
+                           POLY_INIT (-926486211, -1881175860),
+                           POLY_INIT (637715032, 2039247165),
+                           POLY_INIT (2140515408, 1954501616),
+                           POLY_INIT (-1856921803, -2111002111),
+                           POLY_INIT (938322333, 1730228012),
+                           POLY_INIT (-651584776, -1854744867),
+                           POLY_INIT (-2134969104, -1669204976),
+                           POLY_INIT (1853540245, 1792151009),
+                           POLY_INIT (865085664, -2023247478),
+                           POLY_INIT (-581690491, 1899251835),
+                           POLY_INIT (-2067565171, 2093443766),
+                           POLY_INIT (1778861800, -1969974457),
+                           POLY_INIT (1439535296, -1330955585),
+                           POLY_INIT (-1156996187, 1190708046),
+                           POLY_INIT (-492909139, 1259069827),
+                           POLY_INIT (207290056, -1118300046),
+                           POLY_INIT (1370493373, 1357751321),
+                           POLY_INIT (-1082907944, -1497473560),
+                           POLY_INIT (-421311280, -1420984539),
+                           POLY_INIT (136806325, 1562281684),
+                           POLY_INIT (-1720262528, -550359851),
+                           POLY_INIT (2008208357, 694277412),
+                           POLY_INIT (774225389, 613611497),
+                           POLY_INIT (-1058959736, -759099880),
+                           POLY_INIT (-1660198403, 1064612467),
+                           POLY_INIT (1942966936, -920171646),
+                           POLY_INIT (710425744, -992712369),
+                           POLY_INIT (-996405259, 847745214),
+                           POLY_INIT (-78194211, 146291014),
+                           POLY_INIT (361949880, -18104137),
+                           POLY_INIT (1275430064, -216472966),
+                           POLY_INIT (-1564362795, 88808331),
+                           POLY_INIT (-13936480, -385964064),
+                           POLY_INIT (300903365, 514678289),
+                           POLY_INIT (1215825357, 324959452),
+                           POLY_INIT (-1497614680, -452098771),
+                           POLY_INIT (1876644666, -834511272),
+                           POLY_INIT (-2128650145, 940681129),
+                           POLY_INIT (-662172073, 904037732),
+                           POLY_INIT (910966066, -1011778411),
+                           POLY_INIT (1806094919, 772063486),
+                           POLY_INIT (-2057117406, -665372401),
+                           POLY_INIT (-587886806, -710665278),
+                           POLY_INIT (842120271, 603447859),
+                           POLY_INIT (234580583, 432557003),
+                           POLY_INIT (-482387710, -275008966),
+                           POLY_INIT (-1163380982, -496463625),
+                           POLY_INIT (1416365167, 339437830),
+                           POLY_INIT (159836954, -108079763),
+                           POLY_INIT (-415049601, 266153116),
+                           POLY_INIT (-1093290377, 36572753),
+                           POLY_INIT (1343325458, -193071200),
+                           POLY_INIT (-1052763609, 1985043873),
+                           POLY_INIT (797190466, -2147310512),
+                           POLY_INIT (1980974922, -1913551203),
+                           POLY_INIT (-1730710481, 2074247020),
+                           POLY_INIT (-985818278, -1776827641),
+                           POLY_INIT (737781823, 1615084278),
+                           POLY_INIT (1919862327, 1840715835),
+                           POLY_INIT (-1666517678, -1679498806),
+                           POLY_INIT (-1553980550, -1579464654),
+                           POLY_INIT (1302597663, 1468576195),
+                           POLY_INIT (338918935, 1518048014),
+                           POLY_INIT (-84456078, -1406637313),
+                           POLY_INIT (-1491230201, 1100863124),
+                           POLY_INIT (1238995298, -1211224219),
+                           POLY_INIT (273612650, -1170403928),
+                           POLY_INIT (-24458225, 1282339929),
+                           POLY_INIT (1479998119, -1453100684),
+                           POLY_INIT (-1225602622, 1597016197),
+                           POLY_INIT (-278550582, 1388554824),
+                           POLY_INIT (27366575, -1534045255),
+                           POLY_INIT (1548450778, 1227222994),
+                           POLY_INIT (-1299232577, -1082780125),
+                           POLY_INIT (-350738761, -1299893010),
+                           POLY_INIT (98309586, 1154927903),
+                           POLY_INIT (974570490, 2129224935),
+                           POLY_INIT (-724373345, -2001036010),
+                           POLY_INIT (-1924817257, -2058764325),
+                           POLY_INIT (1669443058, 1931101738),
+                           POLY_INIT (1047216775, -1632634303),
+                           POLY_INIT (-793808414, 1761346480),
+                           POLY_INIT (-1992810518, 1695490429),
+                           POLY_INIT (1744579727, -1822631796),
+                           POLY_INIT (-156388422, 292582029),
+                           POLY_INIT (409567455, -417100932),
+                           POLY_INIT (1107226327, -355423823),
+                           POLY_INIT (-1355096654, 478367808),
+                           POLY_INIT (-221236537, -248058837),
+                           POLY_INIT (471073186, 124065242),
+                           POLY_INIT (1166241706, 177616663),
+                           POLY_INIT (-1421386545, -54145306),
+                           POLY_INIT (-1802663193, -956668130),
+                           POLY_INIT (2051651970, 816422639),
+                           POLY_INIT (601806730, 1029356578),
+                           POLY_INIT (-853875473, -888584749),
+                           POLY_INIT (-1863316582, 649918904),
+                           POLY_INIT (2117351679, -789643191),
+                           POLY_INIT (665016055, -585358716),
+                           POLY_INIT (-915970670, 726653813),
+                           POLY_INIT (-1251107373, -1954311057),
+                           POLY_INIT (1537846966, 2110811550),
+                           POLY_INIT (37667006, 1881362259),
+                           POLY_INIT (-319097893, -2039433566),
+                           POLY_INIT (-1324344146, 1808075465),
+                           POLY_INIT (1607741387, -1651051720),
+                           POLY_INIT (105071043, -1872375307),
+                           POLY_INIT (-393776474, 1714825220),
+                           POLY_INIT (-682777458, 1544126972),
+                           POLY_INIT (965318635, -1436911603),
+                           POLY_INIT (1612642787, -1482073408),
+                           POLY_INIT (-1898263930, 1375380273),
+                           POLY_INIT (-751819277, -1135665318),
+                           POLY_INIT (1039406742, 1243408043),
+                           POLY_INIT (1684240542, 1206895718),
+                           POLY_INIT (-1968747525, -1313063529),
+                           POLY_INIT (469161166, 865114006),
+                           POLY_INIT (-181213269, -977047961),
+                           POLY_INIT (-1398437469, -936358742),
+                           POLY_INIT (1113701062, 1046721883),
+                           POLY_INIT (529225139, -740947664),
+                           POLY_INIT (-246454570, 629534913),
+                           POLY_INIT (-1462236962, 678875660),
+                           POLY_INIT (1176255419, -567989251),
+                           POLY_INIT (2044128659, -468024827),
+                           POLY_INIT (-1760370954, 306805748),
+                           POLY_INIT (-830099202, 532306233),
+                           POLY_INIT (541164443, -370564920),
+                           POLY_INIT (2108386542, 73145507),
+                           POLY_INIT (-1821417589, -233839278),
+                           POLY_INIT (-889704061, -211041),
+                           POLY_INIT (607912678, 162479726),
+                           POLY_INIT (-2105527218, -324879549),
+                           POLY_INIT (1816397611, 452018866),
+                           POLY_INIT (903047459, 386031743),
+                           POLY_INIT (-619226554, -514745970),
+                           POLY_INIT (-2030193357, 216278501),
+                           POLY_INIT (1748600406, -88613868),
+                           POLY_INIT (833546334, -146473255),
+                           POLY_INIT (-546645189, 18286376),
+                           POLY_INIT (-526381805, 992521936),
+                           POLY_INIT (241450614, -847554783),
+                           POLY_INIT (1475563646, -1064798740),
+                           POLY_INIT (-1187552485, 920357917),
+                           POLY_INIT (-455242642, -613535626),
+                           POLY_INIT (169459467, 759024007),
+                           POLY_INIT (1401868547, 550431562),
+                           POLY_INIT (-1119165850, -694349125),
+                           POLY_INIT (739999059, 1420933306),
+                           POLY_INIT (-1025552842, -1562230453),
+                           POLY_INIT (-1689771970, -1357814906),
+                           POLY_INIT (1972114267, 1497537143),
+                           POLY_INIT (677837870, -1258871268),
+                           POLY_INIT (-962408629, 1118101485),
+                           POLY_INIT (-1623875261, 1331166496),
+                           POLY_INIT (1911656998, -1190918959),
+                           POLY_INIT (1312506894, -2093241047),
+                           POLY_INIT (-1593870485, 1969771736),
+                           POLY_INIT (-110618269, 2023454229),
+                           POLY_INIT (397158918, -1899458588),
+                           POLY_INIT (1246152051, 1669149583),
+                           POLY_INIT (-1534921194, -1792095618),
+                           POLY_INIT (-48916450, -1730287437),
+                           POLY_INIT (332508027, 1854804290),
+                           POLY_INIT (-625553687, 1170328119),
+                           POLY_INIT (879951244, -1282264122),
+                           POLY_INIT (1843762052, -1100934901),
+                           POLY_INIT (-2094948127, 1211295994),
+                           POLY_INIT (-557101164, -1517857647),
+                           POLY_INIT (806321393, 1406446944),
+                           POLY_INIT (1771574009, 1579650989),
+                           POLY_INIT (-2024005220, -1468762532),
+                           POLY_INIT (-1198065740, -1840521308),
+                           POLY_INIT (1448264913, 1679304277),
+                           POLY_INIT (264612569, 1777009816),
+                           POLY_INIT (-519988804, -1615266455),
+                           POLY_INIT (-1125419319, 1913471234),
+                           POLY_INIT (1378829740, -2074167053),
+                           POLY_INIT (196619172, -1985111490),
+                           POLY_INIT (-444852031, 2147378127),
+                           POLY_INIT (1949140980, -36517426),
+                           POLY_INIT (-1695959919, 193015871),
+                           POLY_INIT (-1015096679, 108139250),
+                           POLY_INIT (767224316, -266212605),
+                           POLY_INIT (1884292745, 496260968),
+                           POLY_INIT (-1634454036, -339235175),
+                           POLY_INIT (-956081180, -432763820),
+                           POLY_INIT (700934273, 275215781),
+                           POLY_INIT (369999529, 710466653),
+                           POLY_INIT (-121008692, -603249236),
+                           POLY_INIT (-1587616828, -772274335),
+                           POLY_INIT (1335546017, 665583248),
+                           POLY_INIT (309346260, -903986437),
+                           POLY_INIT (-55309135, 1011727114),
+                           POLY_INIT (-1524407623, 834574791),
+                           POLY_INIT (1273450972, -940744650),
+                           POLY_INIT (-312776844, 585164059),
+                           POLY_INIT (60773393, -726459158),
+                           POLY_INIT (1510488601, -650101209),
+                           POLY_INIT (-1261696644, 789825494),
+                           POLY_INIT (-383326711, -1029276739),
+                           POLY_INIT (132306284, 888504908),
+                           POLY_INIT (1584773988, 956735617),
+                           POLY_INIT (-1330542591, -816490128),
+                           POLY_INIT (-1887740375, -177540984),
+                           POLY_INIT (1639935308, 54069625),
+                           POLY_INIT (942146372, 248130484),
+                           POLY_INIT (-689164255, -124136891),
+                           POLY_INIT (-1962483884, 355233326),
+                           POLY_INIT (1707273265, -478177313),
+                           POLY_INIT (1012236857, -292768494),
+                           POLY_INIT (-762203812, 417287395),
+                           POLY_INIT (1136668265, -1695291678),
+                           POLY_INIT (-1392239348, 1822433043),
+                           POLY_INIT (-191663356, 1632845278),
+                           POLY_INIT (441925729, -1761557457),
+                           POLY_INIT (1203613460, 2058713156),
+                           POLY_INIT (-1451647887, -1931050571),
+                           POLY_INIT (-252775815, -2129288328),
+                           POLY_INIT (506118428, 2001099401),
+                           POLY_INIT (568334132, 1299837809),
+                           POLY_INIT (-819714991, -1154872704),
+                           POLY_INIT (-1766634919, -1227282355),
+                           POLY_INIT (2021095740, 1082839484),
+                           POLY_INIT (631084617, -1388352041),
+                           POLY_INIT (-883317460, 1533842470),
+                           POLY_INIT (-1831941340, 1453307627),
+                           POLY_INIT (2081093697, -1597223142)
+                          },
+                        /* poly_wide_table[1][i] = i(x) * x^72 MOD P */
+                          {POLY_INIT (0, 0),
+                           POLY_INIT (1130466444, -1082112550),
+                           POLY_INIT (-333962561, 1745331051),
+                           POLY_INIT (-1350980045, -678959439),
+                           POLY_INIT (-667925122, -804305193),
+                           POLY_INIT (-1689138702, 1871643405),
+                           POLY_INIT (875063233, -1207376452),
+                           POLY_INIT (2001333069, 126394470),
+                           POLY_INIT (-625233573, -1223056016),
+                           POLY_INIT (-1713750569, 144302250),
+                           POLY_INIT (916689892, -551680485),
+                           POLY_INIT (1975656296, 1620984769),
+                           POLY_INIT (42726437, 1729553319),
+                           POLY_INIT (1105885353, -661215619),
+                           POLY_INIT (-292301158, 252788940),
+                           POLY_INIT (-1376626154, -1332673258),
+                           POLY_INIT (-542353135, 2033476158),
+                           POLY_INIT (-1664232035, -961271836),
+                           POLY_INIT (867466158, 288604501),
+                           POLY_INIT (1893070626, -1363966833),
+                           POLY_INIT (127671407, -1455741719),
+                           POLY_INIT (1157468387, 381378867),
+                           POLY_INIT (-343654704, -1052997758),
+                           POLY_INIT (-1461341604, 2126299736),
+                           POLY_INIT (85452874, -835860658),
+                           POLY_INIT (1182164166, 1907196564),
+                           POLY_INIT (-384840971, -1507171291),
+                           POLY_INIT (-1435613575, 430580223),
+                           POLY_INIT (-584602316, 505577881),
+                           POLY_INIT (-1639571016, -1583168445),
+                           POLY_INIT (826249099, 1982145266),
+                           POLY_INIT (1918763783, -911907032),
+                           POLY_INIT (-1084706270, -228014979),
+                           POLY_INIT (-63357266, 1307083175),
+                           POLY_INIT (1396740253, -1703975146),
+                           POLY_INIT (270605329, 636429004),
+                           POLY_INIT (1734932316, 577209002),
+                           POLY_INIT (604601296, -1645754512),
+                           POLY_INIT (-1955539485, 1247814081),
+                           POLY_INIT (-938387089, -169843685),
+                           POLY_INIT (1709376377, 1165058317),
+                           POLY_INIT (646090741, -84859689),
+                           POLY_INIT (-1980030522, 762757734),
+                           POLY_INIT (-895832758, -1829337156),
+                           POLY_INIT (-1110227449, -1786894374),
+                           POLY_INIT (-21837173, 721314304),
+                           POLY_INIT (1372284088, -42367823),
+                           POLY_INIT (313190452, 1123664235),
+                           POLY_INIT (1626663731, -1956862397),
+                           POLY_INIT (596993983, 886891417),
+                           POLY_INIT (-1930638964, -480574168),
+                           POLY_INIT (-812825344, 1557872882),
+                           POLY_INIT (-1195069875, 1532223636),
+                           POLY_INIT (-73063743, -455891634),
+                           POLY_INIT (1423740146, 861160447),
+                           POLY_INIT (398262398, -1932261851),
+                           POLY_INIT (-1169204632, 1011155763),
+                           POLY_INIT (-114370844, -2084223255),
+                           POLY_INIT (1448573143, 1413652568),
+                           POLY_INIT (355923035, -339548798),
+                           POLY_INIT (1652498198, -330676764),
+                           POLY_INIT (555651994, 1405747262),
+                           POLY_INIT (-1905836631, -2075269489),
+                           POLY_INIT (-855199451, 1003332437),
+                           POLY_INIT (342515683, -204038108),
+                           POLY_INIT (1460392815, 1280763390),
+                           POLY_INIT (-126714532, -1680800945),
+                           POLY_INIT (-1156320816, 609306261),
+                           POLY_INIT (-866510179, 601482995),
+                           POLY_INIT (-1891920367, -1671847127),
+                           POLY_INIT (541210658, 1272858008),
+                           POLY_INIT (1663284398, -195166142),
+                           POLY_INIT (-825102664, 1154418004),
+                           POLY_INIT (-1917820364, -78692210),
+                           POLY_INIT (583650311, 751347263),
+                           POLY_INIT (1638416523, -1823939611),
+                           POLY_INIT (383888326, -1799339133),
+                           POLY_INIT (1434462026, 725616217),
+                           POLY_INIT (-84309639, -54009624),
+                           POLY_INIT (-1181219339, 1128768818),
+                           POLY_INIT (-876214542, -1964850662),
+                           POLY_INIT (-2002285954, 895649728),
+                           POLY_INIT (668869709, -488283791),
+                           POLY_INIT (1690282177, 1566909611),
+                           POLY_INIT (334906252, 1525515469),
+                           POLY_INIT (1352126208, -445791977),
+                           POLY_INIT (-1154765, 854206374),
+                           POLY_INIT (-1131418177, -1922407812),
+                           POLY_INIT (293451689, 1039886186),
+                           POLY_INIT (1377581861, -2105859408),
+                           POLY_INIT (-43674346, 1442628609),
+                           POLY_INIT (-1107027558, -360939045),
+                           POLY_INIT (-917638441, -302767683),
+                           POLY_INIT (-1976795557, 1383359591),
+                           POLY_INIT (626380904, -2047638826),
+                           POLY_INIT (1714707684, 980666124),
+                           POLY_INIT (-1422725695, 29254745),
+                           POLY_INIT (-397188787, -1103224445),
+                           POLY_INIT (1193987966, 1773782834),
+                           POLY_INIT (72041458, -700874008),
+                           POLY_INIT (1929554111, -776920434),
+                           POLY_INIT (811803699, 1848731476),
+                           POLY_INIT (-1625650688, -1179221531),
+                           POLY_INIT (-595917172, 104252479),
+                           POLY_INIT (1904827546, -1230520023),
+                           POLY_INIT (854118422, 153584883),
+                           POLY_INIT (-1651409371, -559914430),
+                           POLY_INIT (-554634583, 1629497240),
+                           POLY_INIT (-1447487004, 1722320894),
+                           POLY_INIT (-354904728, -651640284),
+                           POLY_INIT (1168194395, 246359189),
+                           POLY_INIT (113293271, -1322294961),
+                           POLY_INIT (1956558032, 2022311527),
+                           POLY_INIT (939472988, -955628611),
+                           POLY_INIT (-1736010129, 277718284),
+                           POLY_INIT (-605611293, -1358044970),
+                           POLY_INIT (-1397821010, -1467662160),
+                           POLY_INIT (-271614686, 386205034),
+                           POLY_INIT (1085723409, -1065163813),
+                           POLY_INIT (64446365, 2130880001),
+                           POLY_INIT (-1373305461, -812408041),
+                           POLY_INIT (-314275577, 1880352461),
+                           POLY_INIT (1111303988, -1483472772),
+                           POLY_INIT (22850488, 403981734),
+                           POLY_INIT (1981104373, 530376128),
+                           POLY_INIT (896846969, -1608736742),
+                           POLY_INIT (-1710398902, 2006664875),
+                           POLY_INIT (-647172410, -937753743),
+                           POLY_INIT (1108313185, -257267561),
+                           POLY_INIT (23988461, 1328164173),
+                           POLY_INIT (-1374181666, -1733440516),
+                           POLY_INIT (-311023022, 657296934),
+                           POLY_INIT (-1707097825, 547696192),
+                           POLY_INIT (-648131181, -1624937574),
+                           POLY_INIT (1982325664, 1218612523),
+                           POLY_INIT (893808428, -148715279),
+                           POLY_INIT (-1733020358, 1202965991),
+                           POLY_INIT (-606750282, -130840515),
+                           POLY_INIT (1957435269, 800353932),
+                           POLY_INIT (936221449, -1875629226),
+                           POLY_INIT (1082421316, -1749251280),
+                           POLY_INIT (65404104, 675073770),
+                           POLY_INIT (-1399041285, -4511653),
+                           POLY_INIT (-268575113, 1077636481),
+                           POLY_INIT (-1650205328, -1986131287),
+                           POLY_INIT (-557690372, 907956083),
+                           POLY_INIT (1908146127, -510023230),
+                           POLY_INIT (853177155, 1578757144),
+                           POLY_INIT (1167300622, 1502694526),
+                           POLY_INIT (116528258, -435091036),
+                           POLY_INIT (-1450460495, 831975189),
+                           POLY_INIT (-353749443, -1911117105),
+                           POLY_INIT (1192782891, 1049079769),
+                           POLY_INIT (75096231, -2130187773),
+                           POLY_INIT (-1426043244, 1451232434),
+                           POLY_INIT (-396246504, -385857176),
+                           POLY_INIT (-1624757931, -293017330),
+                           POLY_INIT (-599153191, 1359523028),
+                           POLY_INIT (1932528618, -2037429659),
+                           POLY_INIT (810649446, 957288383),
+                           POLY_INIT (-44616125, 46312682),
+                           POLY_INIT (-1103709489, -1119688400),
+                           POLY_INIT (290395388, 1791299457),
+                           POLY_INIT (1378785392, -716879269),
+                           POLY_INIT (627536701, -758257091),
+                           POLY_INIT (1711734705, 1833807847),
+                           POLY_INIT (-914402942, -1161148074),
+                           POLY_INIT (-1977688818, 88738956),
+                           POLY_INIT (669812504, -1243936358),
+                           POLY_INIT (1686965140, 173755456),
+                           POLY_INIT (-873159257, -572740879),
+                           POLY_INIT (-2003490517, 1650257707),
+                           POLY_INIT (-2309530, 1708412749),
+                           POLY_INIT (-1128444182, -632026473),
+                           POLY_INIT (331669721, 231992358),
+                           POLY_INIT (1353018453, -1303139844),
+                           POLY_INIT (586903378, 2079772372),
+                           POLY_INIT (1637540830, -998864114),
+                           POLY_INIT (-823964179, 334589375),
+                           POLY_INIT (-1920810655, -1401870235),
+                           POLY_INIT (-87348692, -1409710077),
+                           POLY_INIT (-1179998560, 343526873),
+                           POLY_INIT (382929043, -1006752920),
+                           POLY_INIT (1437762591, 2088660658),
+                           POLY_INIT (-129966583, -856724572),
+                           POLY_INIT (-1155444091, 1936666238),
+                           POLY_INIT (341376182, -1528248113),
+                           POLY_INIT (1463382074, 459836693),
+                           POLY_INIT (544250743, 484453747),
+                           POLY_INIT (1662064635, -1553962839),
+                           POLY_INIT (-865551928, 1961332248),
+                           POLY_INIT (-1895221948, -882390078),
+                           POLY_INIT (1449515906, 58509491),
+                           POLY_INIT (352605966, -1124299415),
+                           POLY_INIT (-1166149315, 1803250648),
+                           POLY_INIT (-115575375, -721736190),
+                           POLY_INIT (-1906991364, -747401628),
+                           POLY_INIT (-852225424, 1827916734),
+                           POLY_INIT (1649261635, -1150014193),
+                           POLY_INIT (556544207, 83126485),
+                           POLY_INIT (-1931580711, -1268421181),
+                           POLY_INIT (-809507243, 199567385),
+                           POLY_INIT (1623607398, -597504344),
+                           POLY_INIT (598197482, 1675791218),
+                           POLY_INIT (1424895911, 1684679444),
+                           POLY_INIT (395289387, -605393202),
+                           POLY_INIT (-1191834344, 208504959),
+                           POLY_INIT (-73956972, -1276260955),
+                           POLY_INIT (-1983282541, 2051582605),
+                           POLY_INIT (-894956001, -976687273),
+                           POLY_INIT (1708236844, 307169766),
+                           POLY_INIT (649079968, -1378923460),
+                           POLY_INIT (1375324141, -1438127014),
+                           POLY_INIT (311970657, 365406592),
+                           POLY_INIT (-1109269166, -1035972815),
+                           POLY_INIT (-25138722, 2109737707),
+                           POLY_INIT (1399993288, -850325507),
+                           POLY_INIT (269729604, 1926318631),
+                           POLY_INIT (-1083567753, -1521046378),
+                           POLY_INIT (-66347525, 450292044),
+                           POLY_INIT (-1958578506, 492718378),
+                           POLY_INIT (-937166278, -1562506000),
+                           POLY_INIT (1733973001, 1968826945),
+                           POLY_INIT (607901829, -891703397),
+                           POLY_INIT (-381851232, -250344242),
+                           POLY_INIT (-1436752596, 1318340884),
+                           POLY_INIT (86330143, -1726763099),
+                           POLY_INIT (1178912659, 647228031),
+                           POLY_INIT (822947038, 555436569),
+                           POLY_INIT (1919721554, -1634005053),
+                           POLY_INIT (-585822623, 1226631538),
+                           POLY_INIT (-1636531475, -157504344),
+                           POLY_INIT (864475387, 1175300542),
+                           POLY_INIT (1894208631, -108139420),
+                           POLY_INIT (-543229372, 772410069),
+                           POLY_INIT (-1660979512, -1853206769),
+                           POLY_INIT (-340353659, -1778192535),
+                           POLY_INIT (-1462300407, 696429235),
+                           POLY_INIT (128892730, -33207294),
+                           POLY_INIT (1154429878, 1099237848),
+                           POLY_INIT (915484849, -2011140368),
+                           POLY_INIT (1978711101, 933243690),
+                           POLY_INIT (-628551154, -534262373),
+                           POLY_INIT (-1712808318, 1604814913),
+                           POLY_INIT (-291408433, 1479485479),
+                           POLY_INIT (-1379862205, -407933443),
+                           POLY_INIT (45700976, 807963468),
+                           POLY_INIT (1104731132, -1884762474),
+                           POLY_INIT (-332758550, 1060752256),
+                           POLY_INIT (-1354035866, -2135323046),
+                           POLY_INIT (3318613, 1463707883),
+                           POLY_INIT (1129525209, -390189775),
+                           POLY_INIT (874169492, -281637545),
+                           POLY_INIT (2004568088, 1354156173),
+                           POLY_INIT (-670898645, -2026820036),
+                           POLY_INIT (-1687983449, 951151590)
+                          },
+                        /* poly_wide_table[2][i] = i(x) * x^80 MOD P */
+                          {POLY_INIT (0, 0),
+                           POLY_INIT (158549119, -1125081313),
+                           POLY_INIT (2017309529, 1860572897),
+                           POLY_INIT (1901000486, -770274818),
+                           POLY_INIT (-260348238, -573821502),
+                           POLY_INIT (-116907315, 1631367901),
+                           POLY_INIT (-2008623637, -1289077981),
+                           POLY_INIT (-2127195756, 265987132),
+                           POLY_INIT (-1976699197, -1398836390),
+                           POLY_INIT (-2090945860, 275770437),
+                           POLY_INIT (-233814630, -1032231493),
+                           POLY_INIT (-77397531, 2122971812),
+                           POLY_INIT (2052493425, 1901289112),
+                           POLY_INIT (1931858958, -844906105),
+                           POLY_INIT (40575784, 531974265),
+                           POLY_INIT (186148695, -1555703962),
+                           POLY_INIT (2122372641, 1312411242),
+                           POLY_INIT (2012451422, -221687435),
+                           POLY_INIT (113075576, 551540875),
+                           POLY_INIT (265167111, -1674623084),
+                           POLY_INIT (-1896107885, -1812601944),
+                           POLY_INIT (-2021067540, 788888759),
+                           POLY_INIT (-154795062, -49023671),
+                           POLY_INIT (-4896843, 1105422934),
+                           POLY_INIT (-189980446, -492389072),
+                           POLY_INIT (-35756899, 1582703151),
+                           POLY_INIT (-1936682053, -1941918767),
+                           POLY_INIT (-2048665660, 816854222),
+                           POLY_INIT (81151568, 1063948530),
+                           POLY_INIT (228917807, -2087055379),
+                           POLY_INIT (2095838473, 1368163859),
+                           POLY_INIT (1972941174, -310634228),
+                           POLY_INIT (-50222014, -1670144812),
+                           POLY_INIT (-193796035, 545457099),
+                           POLY_INIT (-2059657445, -225080779),
+                           POLY_INIT (-1940956316, 1315247402),
+                           POLY_INIT (226151152, 1103081750),
+                           POLY_INIT (67735183, -45142519),
+                           POLY_INIT (1967618473, 794404855),
+                           POLY_INIT (2083798486, -1817626392),
+                           POLY_INIT (1999395457, 820834190),
+                           POLY_INIT (2120163070, -1944293231),
+                           POLY_INIT (252832216, 1577777519),
+                           POLY_INIT (107130279, -486906256),
+                           POLY_INIT (-2024326093, -316620212),
+                           POLY_INIT (-1910212532, 1372609875),
+                           POLY_INIT (-9793686, -2084121427),
+                           POLY_INIT (-166081771, 1060522930),
+                           POLY_INIT (-2088666525, -766881090),
+                           POLY_INIT (-1963835876, 1857736097),
+                           POLY_INIT (-71513798, -1129560993),
+                           POLY_INIT (-221278907, 6085440),
+                           POLY_INIT (1945771217, 260472700),
+                           POLY_INIT (2055821486, -1284054941),
+                           POLY_INIT (197635976, 1633708445),
+                           POLY_INIT (45411319, -577702270),
+                           POLY_INIT (162303136, 2127897060),
+                           POLY_INIT (14665951, -1037713669),
+                           POLY_INIT (1905344505, 271791877),
+                           POLY_INIT (2028108678, -1396463590),
+                           POLY_INIT (-103290350, -1558639578),
+                           POLY_INIT (-257642899, 535401273),
+                           POLY_INIT (-2115348149, -838919481),
+                           POLY_INIT (-2003231436, 1896842712),
+                           POLY_INIT (-1864867037, 803213686),
+                           POLY_INIT (-1716836516, -1827631511),
+                           POLY_INIT (-387592070, 1090914199),
+                           POLY_INIT (-510225403, -34170744),
+                           POLY_INIT (1621296529, -231981900),
+                           POLY_INIT (1775256046, 1323082667),
+                           POLY_INIT (413054664, -1664472491),
+                           POLY_INIT (300806839, 540718410),
+                           POLY_INIT (452302304, -2088803796),
+                           POLY_INIT (327602591, 1066401075),
+                           POLY_INIT (1657284281, -308710195),
+                           POLY_INIT (1807442630, 1365896146),
+                           POLY_INIT (-359730350, 1588809710),
+                           POLY_INIT (-469911763, -498872079),
+                           POLY_INIT (-1833746421, 810899727),
+                           POLY_INIT (-1681914764, -1935292912),
+                           POLY_INIT (-296176382, 1641668380),
+                           POLY_INIT (-416550531, -584499197),
+                           POLY_INIT (-1771764133, 255838717),
+                           POLY_INIT (-1625931228, -1278257438),
+                           POLY_INIT (505664432, -1139412258),
+                           POLY_INIT (391157711, 15035841),
+                           POLY_INIT (1713266921, -755768257),
+                           POLY_INIT (1869423766, 1845721888),
+                           POLY_INIT (1685406657, -851006394),
+                           POLY_INIT (1829111742, 1907766105),
+                           POLY_INIT (474542232, -1549747545),
+                           POLY_INIT (356234471, 525346232),
+                           POLY_INIT (-1811012237, 277512580),
+                           POLY_INIT (-1652727540, -1401282917),
+                           POLY_INIT (-332163542, 2121045861),
+                           POLY_INIT (-448736683, -1029961606),
+                           POLY_INIT (1842990945, -1282175582),
+                           POLY_INIT (1688898334, 258151101),
+                           POLY_INIT (367295544, -579495101),
+                           POLY_INIT (479672391, 1636107356),
+                           POLY_INIT (-1650284077, 1851760736),
+                           POLY_INIT (-1798181460, -760266881),
+                           POLY_INIT (-442557814, 12170881),
+                           POLY_INIT (-320053515, -1136055906),
+                           POLY_INIT (-403424862, 520945400),
+                           POLY_INIT (-293110307, -1543740953),
+                           POLY_INIT (-1614181637, 1911220249),
+                           POLY_INIT (-1766142332, -853903610),
+                           POLY_INIT (395271952, -1027550406),
+                           POLY_INIT (519838575, 2117094437),
+                           POLY_INIT (1873996873, -1406745125),
+                           POLY_INIT (1723967542, 282483396),
+                           POLY_INIT (324606272, -39173176),
+                           POLY_INIT (438983999, 1096473815),
+                           POLY_INIT (1801759257, -1823714007),
+                           POLY_INIT (1645735526, 800901686),
+                           POLY_INIT (-484278286, 543583754),
+                           POLY_INIT (-363775091, -1667829483),
+                           POLY_INIT (-1692414805, 1317042411),
+                           POLY_INIT (-1838380844, -227481612),
+                           POLY_INIT (-1720389757, 1362440338),
+                           POLY_INIT (-1878545412, -305811571),
+                           POLY_INIT (-515285798, 1070802547),
+                           POLY_INIT (-398845787, -2094810772),
+                           POLY_INIT (1762625841, -1929831088),
+                           POLY_INIT (1618791758, 805929551),
+                           POLY_INIT (288504424, -501281871),
+                           POLY_INIT (406945303, 1592759470),
+                           POLY_INIT (565233222, 1606427373),
+                           POLY_INIT (683901497, -483344910),
+                           POLY_INIT (1502442783, 824587276),
+                           POLY_INIT (1358836064, -1915311341),
+                           POLY_INIT (-775184140, -2113138897),
+                           POLY_INIT (-658971509, 1056739376),
+                           POLY_INIT (-1443490899, -320202290),
+                           POLY_INIT (-1601873966, 1343915729),
+                           POLY_INIT (-1415761787, -211856969),
+                           POLY_INIT (-1561430790, 1336921768),
+                           POLY_INIT (-744455204, -1648801962),
+                           POLY_INIT (-623655005, 558487625),
+                           POLY_INIT (1541822007, 781417589),
+                           POLY_INIT (1385501256, -1838947478),
+                           POLY_INIT (601613678, 1081436820),
+                           POLY_INIT (715694353, -58329717),
+                           POLY_INIT (1596985447, 301591687),
+                           POLY_INIT (1447253016, -1391889512),
+                           POLY_INIT (655205182, 2132802150),
+                           POLY_INIT (780068673, -1007721095),
+                           POLY_INIT (-1354008875, -868892347),
+                           POLY_INIT (-1506266454, 1891982938),
+                           POLY_INIT (-680082036, -1563175004),
+                           POLY_INIT (-570064397, 505628859),
+                           POLY_INIT (-719460700, -1117347875),
+                           POLY_INIT (-596729125, 26607810),
+                           POLY_INIT (-1390389763, -746550980),
+                           POLY_INIT (-1538059902, 1869616675),
+                           POLY_INIT (627474454, 1621799455),
+                           POLY_INIT (739624041, -598070016),
+                           POLY_INIT (1566257999, 239903998),
+                           POLY_INIT (1411938096, -1296286751),
+                           POLY_INIT (-592352764, -1011630535),
+                           POLY_INIT (-708694405, 2135105830),
+                           POLY_INIT (-1534273187, -1386895144),
+                           POLY_INIT (-1375757022, 296040391),
+                           POLY_INIT (751439030, 511677435),
+                           POLY_INIT (632899785, -1567683356),
+                           POLY_INIT (1425522671, 1889109274),
+                           POLY_INIT (1568996240, -865527291),
+                           POLY_INIT (1453104327, 1865207139),
+                           POLY_INIT (1609554104, -740535684),
+                           POLY_INIT (782315422, 30071682),
+                           POLY_INIT (668101601, -1120254819),
+                           POLY_INIT (-1494746507, -1293885279),
+                           POLY_INIT (-1349206518, 235962302),
+                           POLY_INIT (-556119764, -603523520),
+                           POLY_INIT (-676786861, 1626761567),
+                           POLY_INIT (-1573798875, -1920307117),
+                           POLY_INIT (-1421674406, 830140236),
+                           POLY_INIT (-636743812, -479435086),
+                           POLY_INIT (-746632445, 1604123053),
+                           POLY_INIT (1380637335, 1346788753),
+                           POLY_INIT (1530502888, -323566962),
+                           POLY_INIT (712468942, 1050692464),
+                           POLY_INIT (587476401, -2108631953),
+                           POLY_INIT (672942822, 555025161),
+                           POLY_INIT (560926361, -1645896682),
+                           POLY_INIT (1344403903, 1341330920),
+                           POLY_INIT (1498594752, -217871625),
+                           POLY_INIT (-664327084, -52875573),
+                           POLY_INIT (-787191765, 1076474324),
+                           POLY_INIT (-1604673779, -1841350614),
+                           POLY_INIT (-1456874638, 785360693),
+                           POLY_INIT (-1318541979, 1881158555),
+                           POLY_INIT (-1206132454, -858739580),
+                           POLY_INIT (-917170628, 516302202),
+                           POLY_INIT (-1071230397, -1573471643),
+                           POLY_INIT (1091814359, -1377034663),
+                           POLY_INIT (1214285736, 287080774),
+                           POLY_INIT (959344782, -1022752584),
+                           POLY_INIT (811414769, 2147129255),
+                           POLY_INIT (994399142, -591445823),
+                           POLY_INIT (842405849, 1615847390),
+                           POLY_INIT (1131995391, -1302768096),
+                           POLY_INIT (1242276992, 246008127),
+                           POLY_INIT (-885115628, 24341763),
+                           POLY_INIT (-1035112085, -1115426276),
+                           POLY_INIT (-1291614643, 1872067554),
+                           POLY_INIT (-1167015374, -748296963),
+                           POLY_INIT (-806849724, 1041890801),
+                           POLY_INIT (-962906309, -2098634002),
+                           POLY_INIT (-1210728419, 1358949136),
+                           POLY_INIT (-1096383390, -334531569),
+                           POLY_INIT (1066604022, -472526797),
+                           POLY_INIT (920670601, 1596280620),
+                           POLY_INIT (1202628271, -1925986606),
+                           POLY_INIT (1323164368, 834886093),
+                           POLY_INIT (1170572679, -1836675413),
+                           POLY_INIT (1287045624, 779489716),
+                           POLY_INIT (1039677150, -60778422),
+                           POLY_INIT (881554081, 1083180885),
+                           POLY_INIT (-1245781195, 1330291561),
+                           POLY_INIT (-1127372982, -205898634),
+                           POLY_INIT (-847032212, 564966792),
+                           POLY_INIT (-990899181, -1654904169),
+                           POLY_INIT (1281952039, -330059953),
+                           POLY_INIT (1159351640, 1352872016),
+                           POLY_INIT (877967998, -2102019666),
+                           POLY_INIT (1026031105, 1044719281),
+                           POLY_INIT (-1139642475, 832537229),
+                           POLY_INIT (-1251922966, -1922097774),
+                           POLY_INIT (-1003496244, 1601803372),
+                           POLY_INIT (-849569613, -477557901),
+                           POLY_INIT (-968556572, 1087167509),
+                           POLY_INIT (-818431077, -63159542),
+                           POLY_INIT (-1099346755, 774556404),
+                           POLY_INIT (-1224079166, -1831184917),
+                           POLY_INIT (910137686, -1660882473),
+                           POLY_INIT (1062001961, 569405128),
+                           POLY_INIT (1308764687, -202971338),
+                           POLY_INIT (1198616176, 1326872617),
+                           POLY_INIT (854187782, -1570086619),
+                           POLY_INIT (999988089, 513474106),
+                           POLY_INIT (1255435359, -863209532),
+                           POLY_INIT (1135028256, 1887234267),
+                           POLY_INIT (-1030571596, 2141605095),
+                           POLY_INIT (-874381877, -1017719816),
+                           POLY_INIT (-1162933523, 289430022),
+                           POLY_INIT (-1277407598, -1380924135),
+                           POLY_INIT (-1195103803, 250942079),
+                           POLY_INIT (-1313378886, -1308258976),
+                           POLY_INIT (-1057383780, 1611859102),
+                           POLY_INIT (-913645853, -589063295),
+                           POLY_INIT (1220497271, -751222851),
+                           POLY_INIT (1103891208, 1875484834),
+                           POLY_INIT (813890606, -1109448356),
+                           POLY_INIT (972142673, 19904067)
+                          },
+                        /* poly_wide_table[3][i] = i(x) * x^88 MOD P */
+                          {POLY_INIT (0, 0),
+                           POLY_INIT (-697428266, 737356778),
+                           POLY_INIT (-1394856532, 1474713557),
+                           POLY_INIT (2058500986, 2081782847),
+                           POLY_INIT (1505254232, -1345540181),
+                           POLY_INIT (-1881780850, -2076212159),
+                           POLY_INIT (-177965324, -131401602),
+                           POLY_INIT (587882530, -740699244),
+                           POLY_INIT (-643068649, 1218344841),
+                           POLY_INIT (264608705, 1668111459),
+                           POLY_INIT (1970774203, 527966300),
+                           POLY_INIT (-1558595987, 881527734),
+                           POLY_INIT (-2146183601, -414001118),
+                           POLY_INIT (1451081881, -861801528),
+                           POLY_INIT (751827939, -1330343945),
+                           POLY_INIT (-90051275, -1689803747),
+                           POLY_INIT (-1286137298, -1858277613),
+                           POLY_INIT (1698237688, -1160788743),
+                           POLY_INIT (529217410, -958744378),
+                           POLY_INIT (-907730604, -316042452),
+                           POLY_INIT (-353418890, 1055932600),
+                           POLY_INIT (1015109536, 352545618),
+                           POLY_INIT (1177775322, 1763055469),
+                           POLY_INIT (-1872922100, 1122319495),
+                           POLY_INIT (1794938681, -643655526),
+                           POLY_INIT (-1131249169, -229526672),
+                           POLY_INIT (-970933611, -1908093105),
+                           POLY_INIT (273591363, -1514675035),
+                           POLY_INIT (860146785, 1986934577),
+                           POLY_INIT (-450176329, 1570577627),
+                           POLY_INIT (-1617370675, 562585828),
+                           POLY_INIT (1240921883, 175852302),
+                           POLY_INIT (208998395, 897513208),
+                           POLY_INIT (-635758291, 512613650),
+                           POLY_INIT (-1599528361, 1654169901),
+                           POLY_INIT (1992766593, 1231784647),
+                           POLY_INIT (1439519907, -1699587757),
+                           POLY_INIT (-2086452619, -1321110855),
+                           POLY_INIT (-116295409, -850129274),
+                           POLY_INIT (796880857, -425253524),
+                           POLY_INIT (-706837780, 2111865201),
+                           POLY_INIT (61903930, 1444129435),
+                           POLY_INIT (2030219072, 705091236),
+                           POLY_INIT (-1351829098, 32898382),
+                           POLY_INIT (-1939416652, -768856358),
+                           POLY_INIT (1510526818, -102824656),
+                           POLY_INIT (549123096, -2050328305),
+                           POLY_INIT (-153820466, -1371974939),
+                           POLY_INIT (-1088285227, -1539171861),
+                           POLY_INIT (1766589187, -1884212735),
+                           POLY_INIT (335427705, -207335874),
+                           POLY_INIT (-980406609, -665360940),
+                           POLY_INIT (-426094963, 193902144),
+                           POLY_INIT (821319771, 545103274),
+                           POLY_INIT (1246126881, 1550377365),
+                           POLY_INIT (-1675069961, 2006698623),
+                           POLY_INIT (1720293570, -321098142),
+                           POLY_INIT (-1327002092, -953203320),
+                           POLY_INIT (-900352658, -1153812041),
+                           POLY_INIT (473670584, -1865870755),
+                           POLY_INIT (1060225946, 1125171657),
+                           POLY_INIT (-379595444, 1759767075),
+                           POLY_INIT (-1813123530, 351704604),
+                           POLY_INIT (1166276832, 1057340918),
+                           POLY_INIT (417996790, 1795026416),
+                           POLY_INIT (-830207712, 1091487258),
+                           POLY_INIT (-1271516582, 1025227301),
+                           POLY_INIT (1649943692, 384340431),
+                           POLY_INIT (1095910574, -986627493),
+                           POLY_INIT (-1757654408, -289248847),
+                           POLY_INIT (-309434110, -1831398002),
+                           POLY_INIT (1004568532, -1188807068),
+                           POLY_INIT (-1052667167, 576952953),
+                           POLY_INIT (388990007, 160477587),
+                           POLY_INIT (1839054669, 1971703212),
+                           POLY_INIT (-1141659237, 1584850502),
+                           POLY_INIT (-1728460359, -1917897262),
+                           POLY_INIT (1318575983, -1503912392),
+                           POLY_INIT (874898453, -632724985),
+                           POLY_INIT (-498339133, -239449619),
+                           POLY_INIT (-1413675560, -71236893),
+                           POLY_INIT (2110984974, -802019063),
+                           POLY_INIT (123807860, -1406708426),
+                           POLY_INIT (-787530078, -2016117028),
+                           POLY_INIT (-234529152, 1410182472),
+                           POLY_INIT (611010646, 2147387042),
+                           POLY_INIT (1591309100, 65796765),
+                           POLY_INIT (-2001246726, 672715127),
+                           POLY_INIT (1914079439, -1285589654),
+                           POLY_INIT (-1535599079, -1733534080),
+                           POLY_INIT (-557144733, -457628993),
+                           POLY_INIT (145011637, -817231531),
+                           POLY_INIT (732877719, 479451841),
+                           POLY_INIT (-37698239, 929100075),
+                           POLY_INIT (-2022506949, 1265995028),
+                           POLY_INIT (1360849133, 1619437310),
+                           POLY_INIT (345968653, 1602427656),
+                           POLY_INIT (-1024391461, 1953509602),
+                           POLY_INIT (-1203552863, 140856541),
+                           POLY_INIT (1848454007, 597059383),
+                           POLY_INIT (1294420821, -263211869),
+                           POLY_INIT (-1689690749, -608395447),
+                           POLY_INIT (-503617799, -1482038410),
+                           POLY_INIT (932540463, -1940207460),
+                           POLY_INIT (-852189926, 387804289),
+                           POLY_INIT (458918860, 1022248811),
+                           POLY_INIT (1642639542, 1090206548),
+                           POLY_INIT (-1215912352, 1795690686),
+                           POLY_INIT (-1802713534, -1194212566),
+                           POLY_INIT (1122160788, -1826428736),
+                           POLY_INIT (944827374, -281570049),
+                           POLY_INIT (-297861832, -993738987),
+                           POLY_INIT (-1480062429, -826280933),
+                           POLY_INIT (1906711797, -447946767),
+                           POLY_INIT (185870223, -1722178610),
+                           POLY_INIT (-579194535, -1297446876),
+                           POLY_INIT (-26193541, 1634950064),
+                           POLY_INIT (673073069, 1249931354),
+                           POLY_INIT (1387035863, 915737701),
+                           POLY_INIT (-2067633663, 493234063),
+                           POLY_INIT (2120451892, -2044623982),
+                           POLY_INIT (-1475505694, -1378703240),
+                           POLY_INIT (-759190888, -775433145),
+                           POLY_INIT (80854094, -97189971),
+                           POLY_INIT (668720236, 703409209),
+                           POLY_INIT (-239744326, 35522515),
+                           POLY_INIT (-1962413632, 2114681836),
+                           POLY_INIT (1567221526, 1442336774),
+                           POLY_INIT (835993580, -704914464),
+                           POLY_INIT (-407230150, -32968694),
+                           POLY_INIT (-1660415424, -2111992779),
+                           POLY_INIT (1264977046, -1443977249),
+                           POLY_INIT (1751934132, 2050454603),
+                           POLY_INIT (-1107135902, 1371824033),
+                           POLY_INIT (-995079912, 768680862),
+                           POLY_INIT (316563406, 102893684),
+                           POLY_INIT (-394284293, -1654281111),
+                           POLY_INIT (1041343533, -1231648893),
+                           POLY_INIT (1151573847, -897320004),
+                           POLY_INIT (-1832023679, -512700330),
+                           POLY_INIT (-1312298589, 849937346),
+                           POLY_INIT (1739194229, 425338920),
+                           POLY_INIT (488358927, 1699697687),
+                           POLY_INIT (-881470759, 1320976381),
+                           POLY_INIT (-2105334334, 1153905907),
+                           POLY_INIT (1424831252, 1865686809),
+                           POLY_INIT (777980014, 320955174),
+                           POLY_INIT (-130998600, 953305292),
+                           POLY_INIT (-616857958, -351560872),
+                           POLY_INIT (223701068, -1057443662),
+                           POLY_INIT (2011648822, -1125266291),
+                           POLY_INIT (-1584839200, -1759582361),
+                           POLY_INIT (1529391317, 207176570),
+                           POLY_INIT (-1924743677, 665479312),
+                           POLY_INIT (-134969991, 1539249327),
+                           POLY_INIT (563778479, 1884045125),
+                           POLY_INIT (43053965, -1550455599),
+                           POLY_INIT (-721492645, -2006530245),
+                           POLY_INIT (-1370694111, -193742076),
+                           POLY_INIT (2015545591, -545222418),
+                           POLY_INIT (1033973783, -528143080),
+                           POLY_INIT (-338745663, -881457422),
+                           POLY_INIT (-1854071365, -1218217267),
+                           POLY_INIT (1192430445, -1668263641),
+                           POLY_INIT (1679387471, 1330217651),
+                           POLY_INIT (-1300791911, 1689954649),
+                           POLY_INIT (-926595357, 414176614),
+                           POLY_INIT (514543669, 861732492),
+                           POLY_INIT (-469058304, -1474602351),
+                           POLY_INIT (845458390, -2081918597),
+                           POLY_INIT (1222021292, -193212),
+                           POLY_INIT (-1632074118, -737270098),
+                           POLY_INIT (-1112349096, 131593530),
+                           POLY_INIT (1809641614, 740613840),
+                           POLY_INIT (292473844, 1345430255),
+                           POLY_INIT (-956244702, 2076346629),
+                           POLY_INIT (-1896469959, 1907999243),
+                           POLY_INIT (1486372079, 1514858977),
+                           POLY_INIT (573179797, 643798494),
+                           POLY_INIT (-196865725, 229424692),
+                           POLY_INIT (-682725023, -562729568),
+                           POLY_INIT (18900919, -175749558),
+                           POLY_INIT (2073189581, -1986839947),
+                           POLY_INIT (-1375974885, -1570762337),
+                           POLY_INIT (1465755438, 958903682),
+                           POLY_INIT (-2127318536, 315924072),
+                           POLY_INIT (-75396478, 1858200151),
+                           POLY_INIT (770677844, 1160956349),
+                           POLY_INIT (249953398, -1762977239),
+                           POLY_INIT (-661919072, -1122487869),
+                           POLY_INIT (-1573269030, -1056092676),
+                           POLY_INIT (1951909644, -352426474),
+                           POLY_INIT (691937306, -1090111984),
+                           POLY_INIT (-11520308, -1795875334),
+                           POLY_INIT (-2048782922, -387948091),
+                           POLY_INIT (1401690976, -1022146001),
+                           POLY_INIT (1887861570, 281713083),
+                           POLY_INIT (-1494717036, 993636945),
+                           POLY_INIT (-598059282, 1194118766),
+                           POLY_INIT (171196472, 1826612612),
+                           POLY_INIT (-258626291, -141016679),
+                           POLY_INIT (654031835, -596940173),
+                           POLY_INIT (1548320929, -1602349492),
+                           POLY_INIT (-1977117065, -1953677914),
+                           POLY_INIT (-1456605611, 1481961010),
+                           POLY_INIT (2135154819, 1940375000),
+                           POLY_INIT (99736569, 263371239),
+                           POLY_INIT (-744501969, 608277005),
+                           POLY_INIT (-1704379852, 775608579),
+                           POLY_INIT (1275538658, 97121001),
+                           POLY_INIT (917837720, 2044497622),
+                           POLY_INIT (-522518194, 1378854204),
+                           POLY_INIT (-1009688212, -2114554200),
+                           POLY_INIT (364869562, -1442489022),
+                           POLY_INIT (1863142592, -703585923),
+                           POLY_INIT (-1184671210, -35452265),
+                           POLY_INIT (1136834339, 1722068618),
+                           POLY_INIT (-1783848459, 1297581408),
+                           POLY_INIT (-283207025, 826472799),
+                           POLY_INIT (963677273, 447861429),
+                           POLY_INIT (444263547, -915930847),
+                           POLY_INIT (-871040339, -493147445),
+                           POLY_INIT (-1230585385, -1634838796),
+                           POLY_INIT (1623774977, -1250067170),
+                           POLY_INIT (625684449, -1971797784),
+                           POLY_INIT (-215664329, -1584665854),
+                           POLY_INIT (-1986592179, -576809155),
+                           POLY_INIT (1610159259, -160580393),
+                           POLY_INIT (2096329913, 632581955),
+                           POLY_INIT (-1432526225, 239551657),
+                           POLY_INIT (-802203371, 1917991062),
+                           POLY_INIT (104943555, 1503728508),
+                           POLY_INIT (-52387082, -1025067167),
+                           POLY_INIT (713995296, -384459637),
+                           POLY_INIT (1346146138, -1795104588),
+                           POLY_INIT (-2041407092, -1091318946),
+                           POLY_INIT (-1520895570, 1831475402),
+                           POLY_INIT (1932980088, 1188639520),
+                           POLY_INIT (159699970, 986468127),
+                           POLY_INIT (-538262828, 289367285),
+                           POLY_INIT (-1776536113, 457453563),
+                           POLY_INIT (1081221913, 817300497),
+                           POLY_INIT (985667683, 1285716014),
+                           POLY_INIT (-324137291, 1733383108),
+                           POLY_INIT (-811307369, -1266122672),
+                           POLY_INIT (432699457, -1619285062),
+                           POLY_INIT (1668825915, -479275131),
+                           POLY_INIT (-1256827411, -929170321),
+                           POLY_INIT (1337440472, 1406818418),
+                           POLY_INIT (-1713787378, 2015982488),
+                           POLY_INIT (-479488652, 71045031),
+                           POLY_INIT (889553826, 802104397),
+                           POLY_INIT (370140032, -65603623),
+                           POLY_INIT (-1067322026, -672801741),
+                           POLY_INIT (-1160524244, -1410293748),
+                           POLY_INIT (1824381178, -2147251226)
+                          }
                         };
 
+static const basis_t
+                poly_wide_basis
+                        = {POLY_INIT (-1251107373, -1954311057),
+                           poly_wide_table};
+
+/* A generated basis shares a single allocation with its tables.  The
+   tables come first, and the storage is placed on a cache line
+   boundary within the block returned by malloc.  */
+
+typedef struct basis_storage_t {
+  poly_t        table[4][256];
+  basis_t       basis;
+  void*         block;  /* The address to pass to free.  */
+} basis_storage_t;
+
+/* Return BASIS, or the built-in basis if BASIS is null.  */
+
+#define POLY_BASIS(basis) ((basis) ? (basis) : &poly_default_basis)
+
 #ifndef FINGERPRINT_LITTLE_ENDIAN
-static void poly_find_byte_order (void)
+/* Return 1 if the target is little-endian, and 0 if it is
+   big-endian.  */
+
+static int poly_byte_order (void)
 {
   int_32_t    i = 0x12345678;
   int_bytes_t x = { i };
@@ -1322,15 +2445,14 @@ static void poly_find_byte_order (void)
   word_t      a3 = word_extract (i, 24, 8);
 
   if (a0 == x.b[0] && a1 == x.b[1] && a2 == x.b[2] && a3 == x.b[3]) {
-    poly_little_endian = 1;
+    return 1;
   } else if (a0 == x.b[3] && a1 == x.b[2] && a2 == x.b[1] && a3 == x.b[0]) {
-    poly_big_endian = 1;
+    return 0;
   } else {
     /* Unsupported byte ordering ...  */
     assert (0);
+    return 0;
   }
-
-  poly_init_done = 1;
 }
 #endif /* FINGERPRINT_LITTLE_ENDIAN */
 
@@ -1356,10 +2478,46 @@ static int_32_t poly_fix_32 (word_t x)
 }
 
 #if MAY_BE_LITTLE_ENDIAN
-static poly_t poly_extend_words_le (const poly_t  p,
-                                    const byte_t* source,
-                                    int           len)
+#if FINGERPRINT_USE_INTEGRAL_TYPE
+/* With a 64-bit type, each table entry is fetched with a single load
+   and the residue is never split into halves.  */
+
+static poly_t poly_extend_words_le (const basis_t* basis,
+                                    const poly_t   p,
+                                    const byte_t*  source,
+                                    int            len)
 {
+  const poly_t* poly64 = basis->table[0];
+  const poly_t* poly72 = basis->table[1];
+  const poly_t* poly80 = basis->table[2];
+  const poly_t* poly88 = basis->table[3];
+  int_ptr_t   ip = (int_ptr_t) source;
+  poly_t      t = p;
+  word_t      t0;
+
+  while (len > 0) {
+    t0 = word_and (t, POLY_SIG_BITS);
+    t = (((t >> 32) & POLY_SIG_BITS)
+         ^ poly88[word_extract (t0, 0, 8)]
+         ^ poly80[word_extract (t0, 8, 8)]
+         ^ poly72[word_extract (t0, 16, 8)]
+         ^ poly64[word_extract (t0, 24, 8)]
+         ^ (((poly_t) *ip) << 32));
+    len -= sizeof (int_32_t);
+    ++ip;
+  }
+  return t;
+}
+#else /* !FINGERPRINT_USE_INTEGRAL_TYPE */
+static poly_t poly_extend_words_le (const basis_t* basis,
+                                    const poly_t   p,
+                                    const byte_t*  source,
+                                    int            len)
+{
+  const poly_t* poly64 = basis->table[0];
+  const poly_t* poly72 = basis->table[1];
+  const poly_t* poly80 = basis->table[2];
+  const poly_t* poly88 = basis->table[3];
   int_ptr_t   ip = (int_ptr_t) source;
   int_bytes_t tmp;
   /* Curiously, the Modula-3 sources use INTEGER for the type of the
@@ -1390,13 +2548,19 @@ static poly_t poly_extend_words_le (const poly_t  p,
   POLY_FORM (result, p0, p1);
   return result;
 }
+#endif /* FINGERPRINT_USE_INTEGRAL_TYPE */
 #endif /* MAY_BE_LITTLE_ENDIAN */
 
 #if MAY_BE_BIG_ENDIAN
-static poly_t poly_extend_words_be (const poly_t  p,
-                                    const byte_t* source,
-                                    int           len)
+static poly_t poly_extend_words_be (const basis_t* basis,
+                                    const poly_t   p,
+                                    const byte_t*  source,
+                                    int            len)
 {
+  const poly_t* poly64 = basis->table[0];
+  const poly_t* poly72 = basis->table[1];
+  const poly_t* poly80 = basis->table[2];
+  const poly_t* poly88 = basis->table[3];
   int_ptr_t   ip = (int_ptr_t) source;
   int_bytes_t tmp;
   int_32_t    p0 = POLY_HALF (p, 0);
@@ -1437,7 +2601,8 @@ static poly_t poly_extend_words_be (const poly_t  p,
 }
 #endif /* MAY_BE_BIG_ENDIAN */
 
-static poly_t poly_extend_bytes (const poly_t t,
+static poly_t poly_extend_bytes (const basis_t* basis,
+                                 const poly_t t,
                                  const byte_t* addr,
                                  int len)
 {
@@ -1484,13 +2649,13 @@ static poly_t poly_extend_bytes (const poly_t t,
 
   if (poly_little_endian) {
 #if MAY_BE_LITTLE_ENDIAN
-    return poly_extend_words_le (result, tmp, 4);
+    return poly_extend_words_le (basis, result, tmp, 4);
 #else /* MAY_BE_LITTLE_ENDIAN */
     ;
 #endif /* MAY_BE_LITTLE_ENDIAN */
   } else {
 #if MAY_BE_BIG_ENDIAN
-    return poly_extend_words_be (result, tmp, 4);
+    return poly_extend_words_be (basis, result, tmp, 4);
 #else /* MAY_BE_BIG_ENDIAN */
     ;
 #endif /* MAY_BE_BIG_ENDIAN */
@@ -1501,25 +2666,20 @@ static poly_t poly_extend_bytes (const poly_t t,
    define a polynomial, A(x) of degree 8 * LEN.  The procedure returns
    (INIT * x ^ (8 * LEN) + A(x)) % PolyBasis.P.  */
 
-static poly_t poly_compute_mod (poly_t        init,
-                                const byte_t* addr,
-                                integer_t     len)
+static poly_t poly_compute_mod (const basis_t* basis,
+                                poly_t         init,
+                                const byte_t*  addr,
+                                integer_t      len)
 {
   integer_t j;
   integer_t k;
   poly_t    result = init;
 
-#ifndef FINGERPRINT_LITTLE_ENDIAN
-  /* We don't need to do this if we already know the endianness.  */
-  if (!poly_init_done)
-    poly_find_byte_order ();
-#endif /* FINGERPRINT_LITTLE_ENDIAN */
-
   /* Word align the source pointer.  */
-  j = mod ((word_t) addr, 4);
+  j = (integer_t) ((size_t) addr & 3);
   if (len >= 4 && j != 0) {
     j = 4 - j;
-    result = poly_extend_bytes (result, addr, j);
+    result = poly_extend_bytes (basis, result, addr, j);
     addr += j;
     len -= j;
   }
@@ -1530,13 +2690,13 @@ static poly_t poly_compute_mod (poly_t        init,
     k = len - j;
     if (poly_little_endian) {
 #if MAY_BE_LITTLE_ENDIAN
-      result = poly_extend_words_le (result, addr, k);
+      result = poly_extend_words_le (basis, result, addr, k);
 #else /* MAY_BE_LITTLE_ENDIAN */
       ;
 #endif /* MAY_BE_LITTLE_ENDIAN */
     } else {
 #if MAY_BE_BIG_ENDIAN
-      result = poly_extend_words_be (result, addr, k);
+      result = poly_extend_words_be (basis, result, addr, k);
 #else /* MAY_BE_BIG_ENDIAN */
       ;
 #endif /* MAY_BE_BIG_ENDIAN */
@@ -1547,7 +2707,7 @@ static poly_t poly_compute_mod (poly_t        init,
 
   /* Finish up the last few bytes.  */
   if (len > 0)
-    result = poly_extend_bytes (result, addr, len);
+    result = poly_extend_bytes (basis, result, addr, len);
 
   return result;
 }
@@ -1566,7 +2726,7 @@ static void poly_to_bytes (poly_t t, byte_t* b)
   b[7] = word_extract (POLY_HALF (t, 1), 24, 8);
 }
 
-static void poly_from_bytes (byte_t* b, poly_t* t)
+static void poly_from_bytes (const byte_t* b, poly_t* t)
 {
   /* Assume the bytes are in little-endian order.  */
   POLY_HALF (*t, 0) =
@@ -1585,6 +2745,707 @@ static void poly_from_bytes (byte_t* b, poly_t* t)
 #define poly_from_bytes(b, t) (*(t) = (*((poly_t*) b)))
 #endif /* !FINGERPRINT_USE_INTEGRAL_TYPE */
 
+/***********************************************************************
+  Basis Generation
+***********************************************************************/
+
+/* ZERO = T { 0, 0 }; X = T { 0, 16_40000000 }, the polynomial x.  */
+
+static const poly_t
+                POLY_ZERO = POLY_INIT (0, 0);
+static const poly_t
+                POLY_X = POLY_INIT (0, 0x40000000);
+
+/* Return T1 + T2, which is also T1 - T2.  */
+
+static poly_t poly_plus (poly_t t1, poly_t t2)
+{
+  poly_t result;
+
+  POLY_FORM (result,
+             poly_fix_32 (word_xor (POLY_HALF (t1, 0), POLY_HALF (t2, 0))),
+             poly_fix_32 (word_xor (POLY_HALF (t1, 1), POLY_HALF (t2, 1))));
+  return result;
+}
+
+static int poly_equal (poly_t t1, poly_t t2)
+{
+  return (word_and (word_xor (POLY_HALF (t1, 0), POLY_HALF (t2, 0)),
+                    POLY_SIG_BITS) == 0
+          && word_and (word_xor (POLY_HALF (t1, 1), POLY_HALF (t2, 1)),
+                       POLY_SIG_BITS) == 0);
+}
+
+/* Return T * x MOD P, where P is given less its x^64 term.  Because
+   the coefficients are stored in reverse order, multiplying by x is a
+   shift towards the high-order bits, and the coefficient of x^63
+   falls out of bit 0 of the first half.  */
+
+static poly_t poly_times_x (poly_t t, poly_t p)
+{
+  word_t t0 = word_and (POLY_HALF (t, 0), POLY_SIG_BITS);
+  word_t t1 = word_and (POLY_HALF (t, 1), POLY_SIG_BITS);
+  word_t carry = word_and (t0, 1);
+  poly_t result;
+
+  t0 = word_or (word_right_shift (t0, 1),
+                word_and (word_left_shift (t1, 31), POLY_SIG_BITS));
+  t1 = word_right_shift (t1, 1);
+  if (carry) {
+    t0 = word_xor (t0, POLY_HALF (p, 0));
+    t1 = word_xor (t1, POLY_HALF (p, 1));
+  }
+  POLY_FORM (result, poly_fix_32 (t0), poly_fix_32 (t1));
+  return result;
+}
+
+/* Return T1 * T2 MOD P.  The coefficients of T2 are consumed from
+   x^63 down to x^0 by Horner's rule.  */
+
+static poly_t poly_times (poly_t t1, poly_t t2, poly_t p)
+{
+  poly_t result = POLY_ZERO;
+  int    i;
+
+  for (i = 0; i < 64; ++i) {
+    result = poly_times_x (result, p);
+    if (word_extract (POLY_HALF (t2, i / 32), i % 32, 1))
+      result = poly_plus (result, t1);
+  }
+  return result;
+}
+
+/* Return non-zero if x^64 + P is irreducible.  Every factor of a
+   polynomial that divides x^(2^64) - x has a degree dividing 64, and
+   such a polynomial has no repeated factors.  So if P passes that
+   test but is reducible, all of its factors have degree at most 32,
+   and therefore it also divides x^(2^32) - x, which an irreducible P
+   of degree 64 cannot.  This avoids a GCD on 65-bit operands.  */
+
+static int poly_irreducible (poly_t p)
+{
+  poly_t t = POLY_X;
+  int    i;
+
+  /* A zero constant term means that x divides P.  */
+  if (word_extract (POLY_HALF (p, 1), 31, 1) == 0)
+    return 0;
+
+  for (i = 1; i <= 64; ++i) {
+    t = poly_times (t, t, p);
+    if (i == 32 && poly_equal (t, POLY_X))
+      return 0;
+  }
+  return poly_equal (t, POLY_X);
+}
+
+/* Fill in the tables of STORAGE for the polynomial P.  The entry for
+   byte I begins as i(x), whose coefficient of x^7 is bit 0 of I, and
+   is then multiplied up through x^64, x^72, x^80 and x^88.  */
+
+static void poly_make_basis (basis_storage_t* storage, poly_t p)
+{
+  int    i;
+  int    j;
+  int    k;
+  poly_t t;
+
+  for (i = 0; i < 256; ++i) {
+    POLY_FORM (t, 0, poly_fix_32 (word_left_shift (i, 24)));
+    for (j = 0; j < 4; ++j) {
+      for (k = 0; k < (j == 0 ? 64 : 8); ++k)
+        t = poly_times_x (t, p);
+      storage->table[j][i] = t;
+    }
+  }
+
+  storage->basis.p = p;
+  storage->basis.table = (const poly_t (*)[256]) storage->table;
+}
+
+/* Allocate the storage for a generated basis, aligned on a cache
+   line.  */
+
+static basis_storage_t* poly_alloc_basis (void)
+{
+  char*            block;
+  basis_storage_t* storage;
+  size_t           skew;
+
+  block = (char*) malloc (sizeof (basis_storage_t) + POLY_LINE_SIZE - 1);
+  if (block == NULL)
+    return NULL;
+
+  skew = (size_t) block % POLY_LINE_SIZE;
+  storage = (basis_storage_t*) (block + (skew ? POLY_LINE_SIZE - skew : 0));
+  storage->block = block;
+  return storage;
+}
+
+/* Mix the 32 bits of X thoroughly; this is the finalizer from
+   MurmurHash3.  It drives the search for a random basis, so that
+   nearby seeds select unrelated polynomials.  */
+
+static word_t poly_mix (word_t x)
+{
+  x = word_and (x, POLY_SIG_BITS);
+  x = word_xor (x, word_right_shift (x, 16));
+  x = word_and (word_times (x, 0x85ebca6b), POLY_SIG_BITS);
+  x = word_xor (x, word_right_shift (x, 13));
+  x = word_and (word_times (x, 0xc2b2ae35), POLY_SIG_BITS);
+  x = word_xor (x, word_right_shift (x, 16));
+  return x;
+}
+
+/***********************************************************************
+  Multi-Buffer Kernel
+***********************************************************************/
+
+/* A single residue is computed by a chain of dependent table lookups,
+   which leaves most of the processor idle.  The routines below advance
+   the residues of POLY_LANES independent buffers in lockstep, so that
+   the lookups for one lane overlap the latency of the others.  Only
+   the little-endian word order is supported; elsewhere the buffers
+   are simply processed one after another.  */
+
+#define POLY_LANES 4
+
+/* Return (T * x^32 + W) MOD P, where W holds four bytes of text in
+   little-endian order.  This is one iteration of
+   poly_extend_words_le, but it picks the bytes of T out arithmetically,
+   so it can be used whatever the byte order of the host.  */
+
+#if FINGERPRINT_USE_INTEGRAL_TYPE
+static poly_t poly_step (const poly_t (*table)[256], poly_t t, int_32_t w)
+{
+  word_t t0 = word_and (t, POLY_SIG_BITS);
+
+  return (((t >> 32) & POLY_SIG_BITS)
+          ^ table[3][word_extract (t0, 0, 8)]
+          ^ table[2][word_extract (t0, 8, 8)]
+          ^ table[1][word_extract (t0, 16, 8)]
+          ^ table[0][word_extract (t0, 24, 8)]
+          ^ (((poly_t) w) << 32));
+}
+#else /* !FINGERPRINT_USE_INTEGRAL_TYPE */
+static poly_t poly_step (const poly_t (*table)[256], poly_t t, int_32_t w)
+{
+  word_t        t0 = word_and (POLY_HALF (t, 0), POLY_SIG_BITS);
+  const poly_t* e88 = &table[3][word_extract (t0, 0, 8)];
+  const poly_t* e80 = &table[2][word_extract (t0, 8, 8)];
+  const poly_t* e72 = &table[1][word_extract (t0, 16, 8)];
+  const poly_t* e64 = &table[0][word_extract (t0, 24, 8)];
+  poly_t        result;
+
+  POLY_FORM (result,
+             word_xor (POLY_HALF (t, 1),
+                       word_xor (word_xor (POLY_HALF (*e88, 0),
+                                           POLY_HALF (*e80, 0)),
+                                 word_xor (POLY_HALF (*e72, 0),
+                                           POLY_HALF (*e64, 0)))),
+             word_xor (w,
+                       word_xor (word_xor (POLY_HALF (*e88, 1),
+                                           POLY_HALF (*e80, 1)),
+                                 word_xor (POLY_HALF (*e72, 1),
+                                           POLY_HALF (*e64, 1)))));
+  return result;
+}
+#endif /* FINGERPRINT_USE_INTEGRAL_TYPE */
+
+#if MAY_BE_LITTLE_ENDIAN
+/* Return the word at ADDR, which need not be aligned.  */
+
+static int_32_t poly_load_word (const byte_t* addr)
+{
+  int_32_t w;
+
+  memcpy (&w, addr, sizeof (w));
+  return w;
+}
+
+/* Advance each of the POLY_LANES residues in T by WORDS words of text,
+   reading the text of lane L from IP[L] and moving IP[L] on by
+   STEP[L] bytes per word.  An idle lane has a step of 0 and reads the
+   same word over and over; its residue is garbage.  */
+
+static void poly_extend_lanes_le (const basis_t* basis,
+                                  poly_t*        t,
+                                  const byte_t** ip,
+                                  const int*     step,
+                                  int            words)
+{
+  const poly_t  (*table)[256] = basis->table;
+  poly_t        t0 = t[0];
+  poly_t        t1 = t[1];
+  poly_t        t2 = t[2];
+  poly_t        t3 = t[3];
+  const byte_t* ip0 = ip[0];
+  const byte_t* ip1 = ip[1];
+  const byte_t* ip2 = ip[2];
+  const byte_t* ip3 = ip[3];
+  const int     step0 = step[0];
+  const int     step1 = step[1];
+  const int     step2 = step[2];
+  const int     step3 = step[3];
+
+  while (words-- > 0) {
+    t0 = poly_step (table, t0, poly_load_word (ip0));
+    t1 = poly_step (table, t1, poly_load_word (ip1));
+    t2 = poly_step (table, t2, poly_load_word (ip2));
+    t3 = poly_step (table, t3, poly_load_word (ip3));
+    ip0 += step0;
+    ip1 += step1;
+    ip2 += step2;
+    ip3 += step3;
+  }
+
+  t[0] = t0;
+  t[1] = t1;
+  t[2] = t2;
+  t[3] = t3;
+  ip[0] = ip0;
+  ip[1] = ip1;
+  ip[2] = ip2;
+  ip[3] = ip3;
+}
+
+#if POLY_X86_SIMD && defined(FINGERPRINT_AVX2_GATHER)
+/* The same, keeping the four residues in one AVX2 register and
+   fetching the table entries with gathers.  A table entry has the
+   layout of a little-endian 64-bit integer in either configuration.
+   On processors whose gathers are microcoded, such as recent Intel
+   parts with the gather data sampling mitigation, this is slower than
+   the scalar lanes, so it has to be asked for.  */
+
+__attribute__ ((target ("avx2")))
+static void poly_extend_lanes_avx2 (const basis_t* basis,
+                                    poly_t*        t,
+                                    const byte_t** ip,
+                                    const int*     step,
+                                    int            words)
+{
+  const long long* table = (const long long*) basis->table;
+  const __m256i    low = _mm256_set1_epi64x (0xff);
+  const __m256i    row1 = _mm256_set1_epi64x (256);
+  const __m256i    row2 = _mm256_set1_epi64x (512);
+  const __m256i    row3 = _mm256_set1_epi64x (768);
+  __m256i          v = _mm256_loadu_si256 ((const __m256i*) t);
+  __m256i          w;
+  const byte_t*    ip0 = ip[0];
+  const byte_t*    ip1 = ip[1];
+  const byte_t*    ip2 = ip[2];
+  const byte_t*    ip3 = ip[3];
+
+  while (words-- > 0) {
+    w = _mm256_set_epi32 (poly_load_word (ip3), 0, poly_load_word (ip2), 0,
+                          poly_load_word (ip1), 0, poly_load_word (ip0), 0);
+    v = _mm256_xor_si256
+          (_mm256_xor_si256
+             (_mm256_xor_si256 (_mm256_srli_epi64 (v, 32), w),
+              _mm256_i64gather_epi64
+                (table, _mm256_add_epi64 (_mm256_and_si256 (v, low), row3),
+                 8)),
+           _mm256_xor_si256
+             (_mm256_xor_si256
+                (_mm256_i64gather_epi64
+                   (table,
+                    _mm256_add_epi64 (_mm256_and_si256
+                                        (_mm256_srli_epi64 (v, 8), low),
+                                      row2),
+                    8),
+                 _mm256_i64gather_epi64
+                   (table,
+                    _mm256_add_epi64 (_mm256_and_si256
+                                        (_mm256_srli_epi64 (v, 16), low),
+                                      row1),
+                    8)),
+              _mm256_i64gather_epi64
+                (table,
+                 _mm256_and_si256 (_mm256_srli_epi64 (v, 24), low),
+                 8)));
+    ip0 += step[0];
+    ip1 += step[1];
+    ip2 += step[2];
+    ip3 += step[3];
+  }
+
+  _mm256_storeu_si256 ((__m256i*) t, v);
+  ip[0] = ip0;
+  ip[1] = ip1;
+  ip[2] = ip2;
+  ip[3] = ip3;
+}
+#endif /* POLY_X86_SIMD && defined(FINGERPRINT_AVX2_GATHER) */
+
+/* Compute the fingerprints of the N buffers ADDR[I] of length LEN[I]
+   into OUT[I].  Each lane takes the next buffer as soon as it has
+   finished its last, so that buffers of different lengths keep all of
+   the lanes busy until the supply runs out.  */
+
+static void poly_compute_mod_lanes (const basis_t*        basis,
+                                    const byte_t* const*  addr,
+                                    const int*            len,
+                                    int                   n,
+                                    fingerprint_t*        out)
+{
+  static const int_32_t idle_word = 0;
+  poly_t         t[POLY_LANES];
+  const byte_t*  ip[POLY_LANES];
+  int            step[POLY_LANES];
+  int            words[POLY_LANES];
+  int            which[POLY_LANES];
+  int            next = 0;
+  int            active;
+  int            k;
+  int            l;
+  void           (*extend) (const basis_t*, poly_t*, const byte_t**,
+                            const int*, int) = poly_extend_lanes_le;
+  poly_t         poly;
+
+#if POLY_X86_SIMD && defined(FINGERPRINT_AVX2_GATHER)
+  if (__builtin_cpu_supports ("avx2"))
+    extend = poly_extend_lanes_avx2;
+#endif /* POLY_X86_SIMD && defined(FINGERPRINT_AVX2_GATHER) */
+
+  for (l = 0; l < POLY_LANES; ++l)
+    which[l] = -1;
+
+  for (;;) {
+    /* Give every idle lane a buffer, if any remain.  Buffers too short
+       to contribute a whole word are finished on the spot.  */
+    active = 0;
+    for (l = 0; l < POLY_LANES; ++l) {
+      while (which[l] < 0 && next < n) {
+        if (len[next] < 4) {
+          poly = poly_compute_mod (basis, POLY_ONE, addr[next], len[next]);
+          poly_to_bytes (poly, FINGERPRINT_BYTE (out[next]));
+          ++next;
+        } else {
+          which[l] = next;
+          t[l] = POLY_ONE;
+          ip[l] = addr[next];
+          step[l] = 4;
+          words[l] = len[next] / 4;
+          ++next;
+        }
+      }
+      if (which[l] < 0) {
+        ip[l] = (const byte_t*) &idle_word;
+        step[l] = 0;
+      } else {
+        ++active;
+      }
+    }
+    if (active == 0)
+      break;
+
+    /* Run until the first lane runs out of whole words.  */
+    k = INT_MAX;
+    for (l = 0; l < POLY_LANES; ++l)
+      if (which[l] >= 0 && words[l] < k)
+        k = words[l];
+    extend (basis, t, ip, step, k);
+
+    /* Finish the lanes that are done with their trailing bytes.  */
+    for (l = 0; l < POLY_LANES; ++l) {
+      if (which[l] < 0)
+        continue;
+      words[l] -= k;
+      if (words[l] == 0) {
+        poly = poly_compute_mod (basis, t[l], ip[l], len[which[l]] % 4);
+        poly_to_bytes (poly, FINGERPRINT_BYTE (out[which[l]]));
+        which[l] = -1;
+      }
+    }
+  }
+}
+#endif /* MAY_BE_LITTLE_ENDIAN */
+
+/***********************************************************************
+  Rolling Fingerprints
+***********************************************************************/
+
+/* Return (T * x^8 + C) MOD P, for a byte C; this appends C to the text
+   whose residue is T.  */
+
+#if FINGERPRINT_USE_INTEGRAL_TYPE
+static poly_t poly_shift_byte (const poly_t (*table)[256], poly_t t, word_t c)
+{
+  return (((t >> 8) & ((((poly_t) 1) << 56) - 1))
+          ^ table[0][word_extract (t, 0, 8)]
+          ^ (((poly_t) c) << 56));
+}
+#else /* !FINGERPRINT_USE_INTEGRAL_TYPE */
+static poly_t poly_shift_byte (const poly_t (*table)[256], poly_t t, word_t c)
+{
+  word_t        t0 = word_and (POLY_HALF (t, 0), POLY_SIG_BITS);
+  word_t        t1 = word_and (POLY_HALF (t, 1), POLY_SIG_BITS);
+  const poly_t* e = &table[0][word_extract (t0, 0, 8)];
+  poly_t        result;
+
+  POLY_FORM (result,
+             poly_fix_32 (word_xor (word_or (word_right_shift (t0, 8),
+                                             word_left_shift (t1, 24)),
+                                    POLY_HALF (*e, 0))),
+             poly_fix_32 (word_xor (word_or (word_right_shift (t1, 8),
+                                             word_left_shift (c, 24)),
+                                    POLY_HALF (*e, 1))));
+  return result;
+}
+#endif /* FINGERPRINT_USE_INTEGRAL_TYPE */
+
+/* Store T in the bytes B, as poly_to_bytes does.  On a little-endian
+   target, the halves of a poly_t are already laid out in that order,
+   so they can be copied whole; LE says whether the target is
+   little-endian.  */
+
+#if !FINGERPRINT_USE_INTEGRAL_TYPE
+#define poly_store(t, b, le)                                    \
+  ((le) ? (void) memcpy ((b), &(t), sizeof (poly_t))            \
+        : poly_to_bytes ((t), (b)))
+#else /* FINGERPRINT_USE_INTEGRAL_TYPE */
+#define poly_store(t, b, le) ((void) (le), poly_to_bytes (t, b))
+#endif /* !FINGERPRINT_USE_INTEGRAL_TYPE */
+
+/* A roller keeps the fingerprint of the last WINDOW bytes of a text.
+   If X = x^(8 * WINDOW), the fingerprint of a window A is X + A(x), so
+   sliding the window on by one byte, dropping O at the front and
+   adding C at the back, gives
+
+     X + (A(x) + O(x) * X) * x^8 + C(x)
+       = F * x^8 + C(x) + (O(x) * X + X * x^8 + X)
+
+   where F is the old fingerprint.  The term in parentheses depends
+   only on O, and is tabulated in OUT.  The last WINDOW bytes are kept
+   in RING, with the byte at stream position Q in RING[Q MOD WINDOW].  */
+
+struct fingerprint_roller_t {
+  const basis_t* basis;
+  int            window;
+  poly_t         out[256];
+  poly_t         t;     /* The fingerprint of the current window.  */
+  unsigned long  seen;  /* The number of bytes in the stream.  */
+  byte_t*        ring;
+};
+
+typedef fingerprint_roller_t roller_t;
+
+/***********************************************************************
+  Substring Fingerprints
+***********************************************************************/
+
+/* The fingerprint of the first I bytes of a buffer B is R[I] = x^(8 *
+   I) + B[0..I)(x), so for I <= J, with L = J - I,
+
+     R[J] = R[I] * x^(8 * L) + B[I..J)(x)
+
+   and the fingerprint of B[I..J) is
+
+     x^(8 * L) + B[I..J)(x) = R[J] + (R[I] + 1) * x^(8 * L)
+
+   A prefix table keeps R for every I, and x^(8 * L) as the product of
+   LOW[L MOD 256] and HIGH[L DIV 256], so that the fingerprint of any
+   range takes at most two multiplications MOD P.  */
+
+/* A poly_times_t returns the product MOD P of two residues.  */
+
+typedef poly_t (*poly_times_t) (const basis_t*, poly_t, poly_t);
+
+struct fingerprint_prefix_t {
+  const basis_t* basis;
+  unsigned long  size;  /* The length of the buffer.  */
+  poly_t*        prefix;
+                        /* prefix[i] = R[i], for i in [0..size].  */
+  poly_t         low[256];
+                        /* low[i] = x^(8 * i) MOD P.  */
+  poly_t*        high;  /* high[i] = x^(2048 * i) MOD P.  */
+  poly_times_t   times; /* The multiplication to use.  */
+};
+
+typedef fingerprint_prefix_t prefix_t;
+
+/* Store in W[0..1] the carry-less product of the 32-bit words A and B,
+   W[0] taking the low half.  B is taken four bits at a time, from a
+   table of the products of A with every four-bit word.  */
+
+static void poly_clmul_32 (word_t a, word_t b, word_t* w)
+{
+  word_t lo[16];
+  word_t hi[16];
+  word_t l = 0;
+  word_t h = 0;
+  int    i;
+
+  lo[0] = 0;
+  hi[0] = 0;
+  for (i = 1; i < 16; ++i) {
+    if (i % 2) {
+      lo[i] = word_xor (lo[i - 1], a);
+      hi[i] = hi[i - 1];
+    } else {
+      lo[i] = word_and (word_left_shift (lo[i / 2], 1), POLY_SIG_BITS);
+      hi[i] = word_or (word_left_shift (hi[i / 2], 1),
+                       word_right_shift (lo[i / 2], 31));
+    }
+  }
+
+  for (i = 28; i >= 0; i -= 4) {
+    word_t n = word_extract (b, i, 4);
+
+    h = word_or (word_left_shift (h, 4), word_right_shift (l, 28));
+    l = word_xor (word_and (word_left_shift (l, 4), POLY_SIG_BITS), lo[n]);
+    h = word_xor (h, hi[n]);
+  }
+  w[0] = word_and (l, POLY_SIG_BITS);
+  w[1] = word_and (h, POLY_SIG_BITS);
+}
+
+/* Return the residue MOD P of the carry-less product W[0..3], low word
+   first, of the 64-bit words of two residues.  Since the coefficients
+   are stored in reverse order, the product shifted up by one bit holds
+   H * x^64 + L with H in W[0..1] and L in W[2..3], and L is stepped
+   into H a word at a time.  */
+
+static poly_t poly_reduce_128 (const basis_t* basis, word_t* w)
+{
+  poly_t h;
+  int    i;
+
+  for (i = 3; i > 0; --i)
+    w[i] = word_and (word_or (word_left_shift (w[i], 1),
+                              word_right_shift (w[i - 1], 31)),
+                     POLY_SIG_BITS);
+  w[0] = word_and (word_left_shift (w[0], 1), POLY_SIG_BITS);
+
+  POLY_FORM (h, poly_fix_32 (w[0]), poly_fix_32 (w[1]));
+  h = poly_step (basis->table, h, poly_fix_32 (w[2]));
+  return poly_step (basis->table, h, poly_fix_32 (w[3]));
+}
+
+/* Return T1 * T2 MOD P.  Unlike poly_times, this takes a fixed number
+   of word operations and eight table lookups.  */
+
+static poly_t poly_times_fast (const basis_t* basis, poly_t t1, poly_t t2)
+{
+  word_t a0 = word_and (POLY_HALF (t1, 0), POLY_SIG_BITS);
+  word_t a1 = word_and (POLY_HALF (t1, 1), POLY_SIG_BITS);
+  word_t b0 = word_and (POLY_HALF (t2, 0), POLY_SIG_BITS);
+  word_t b1 = word_and (POLY_HALF (t2, 1), POLY_SIG_BITS);
+  word_t w[4];
+  word_t m[2];
+
+  /* By Karatsuba's method, the middle term is (A0 + A1) * (B0 + B1)
+     less the outer two.  */
+  poly_clmul_32 (a0, b0, w);
+  poly_clmul_32 (a1, b1, w + 2);
+  poly_clmul_32 (word_xor (a0, a1), word_xor (b0, b1), m);
+  m[0] = word_xor (m[0], word_xor (w[0], w[2]));
+  m[1] = word_xor (m[1], word_xor (w[1], w[3]));
+  w[1] = word_xor (w[1], m[0]);
+  w[2] = word_xor (w[2], m[1]);
+  return poly_reduce_128 (basis, w);
+}
+
+#if POLY_X86_SIMD
+/* poly_times_fast, using the carry-less multiply instruction.  */
+
+__attribute__ ((target ("sse2,pclmul")))
+static poly_t poly_times_clmul (const basis_t* basis, poly_t t1, poly_t t2)
+{
+  __m128i a = _mm_set_epi32 (0, 0, (int) POLY_HALF (t1, 1),
+                             (int) POLY_HALF (t1, 0));
+  __m128i b = _mm_set_epi32 (0, 0, (int) POLY_HALF (t2, 1),
+                             (int) POLY_HALF (t2, 0));
+  __m128i p = _mm_clmulepi64_si128 (a, b, 0);
+  word_t  w[4];
+
+  w[0] = (word_t) _mm_cvtsi128_si32 (p);
+  w[1] = (word_t) _mm_cvtsi128_si32 (_mm_srli_si128 (p, 4));
+  w[2] = (word_t) _mm_cvtsi128_si32 (_mm_srli_si128 (p, 8));
+  w[3] = (word_t) _mm_cvtsi128_si32 (_mm_srli_si128 (p, 12));
+  return poly_reduce_128 (basis, w);
+}
+#endif /* POLY_X86_SIMD */
+
+/* Return the fastest multiplication this processor can run.  */
+
+static poly_times_t poly_times_select (void)
+{
+#if POLY_X86_SIMD
+  if (__builtin_cpu_supports ("pclmul"))
+    return poly_times_clmul;
+#endif /* POLY_X86_SIMD */
+  return poly_times_fast;
+}
+
+/* Return x^(8 * N) MOD P, by squaring once for each bit of N.  Since
+   the bits are taken from the top, each multiplication by x^8 is a
+   shift by a zero byte.  */
+
+static poly_t poly_power_bytes (const basis_t* basis,
+                                poly_times_t   times,
+                                unsigned long  n)
+{
+  poly_t        t = POLY_ONE;
+  unsigned long bit;
+
+  if (n == 0)
+    return t;
+  for (bit = 1; bit <= n / 2; bit <<= 1)
+    ;
+  for (; bit != 0; bit >>= 1) {
+    t = times (basis, t, t);
+    if (n & bit)
+      t = poly_shift_byte (basis->table, t, 0);
+  }
+  return t;
+}
+
+/***********************************************************************
+  Wide Fingerprints
+***********************************************************************/
+
+/* A 128-bit fingerprint is the pair of residues of a text with respect
+   to two bases.  Each residue is a chain of dependent table lookups,
+   so the two chains are run side by side over the same words, and the
+   second costs little more than the first.  Only the little-endian
+   word order is supported; elsewhere the residues are computed one
+   after the other.  */
+
+/* Replace *T1 and *T2 by (*T1 * x^(8 * LEN) + A(x)) MOD the polynomial
+   of BASIS1 and (*T2 * x^(8 * LEN) + A(x)) MOD that of BASIS2, where
+   A is the polynomial of the LEN bytes at ADDR.  */
+
+static void poly_compute_mod_wide (const basis_t* basis1,
+                                   const basis_t* basis2,
+                                   poly_t*        t1,
+                                   poly_t*        t2,
+                                   const byte_t*  addr,
+                                   integer_t      len)
+{
+#if MAY_BE_LITTLE_ENDIAN
+  if (poly_little_endian) {
+    const poly_t (*table1)[256] = basis1->table;
+    const poly_t (*table2)[256] = basis2->table;
+    poly_t       u1 = *t1;
+    poly_t       u2 = *t2;
+    int_32_t     w;
+
+    for (; len >= 4; len -= 4) {
+      w = poly_load_word (addr);
+      u1 = poly_step (table1, u1, w);
+      u2 = poly_step (table2, u2, w);
+      addr += 4;
+    }
+    *t1 = poly_compute_mod (basis1, u1, addr, len);
+    *t2 = poly_compute_mod (basis2, u2, addr, len);
+    return;
+  }
+#endif /* MAY_BE_LITTLE_ENDIAN */
+  *t1 = poly_compute_mod (basis1, *t1, addr, len);
+  *t2 = poly_compute_mod (basis2, *t2, addr, len);
+}
+
 /***********************************************************************
   Modula-3 `Fingerprint' Module
 ***********************************************************************/
@@ -1598,6 +3459,12 @@ static void poly_from_bytes (byte_t* b, poly_t* t)
 #define FINGERPRINT_C 0x402d619b
 #define FINGERPRINT_D 0x0bf359a7
 
+/* A saved context starts with a tag and the version of the layout of
+   the bytes after it.  */
+
+#define FINGERPRINT_CTX_TAG "FPC"
+#define FINGERPRINT_CTX_VERSION 1
+
 /***********************************************************************
   Variables
 ***********************************************************************/
@@ -1607,8 +3474,15 @@ const fingerprint_t
                 fingerprint_zero;
 #endif /* FINGERPRINT_USE_INTEGRAL_TYPE */
 
-/* const */ fingerprint_t
-                fingerprint_of_empty;
+/* The fingerprint of the empty text is ONE.  */
+
+#if !FINGERPRINT_USE_INTEGRAL_TYPE
+const fingerprint_t
+                fingerprint_of_empty = { { 0, 0, 0, 0, 0, 0, 0, 0x80 } };
+#else /* FINGERPRINT_USE_INTEGRAL_TYPE */
+const fingerprint_t
+                fingerprint_of_empty = POLY_INIT (0, (-0x7fffffff - 1));
+#endif /* !FINGERPRINT_USE_INTEGRAL_TYPE */
 
 static const byte_t fingerprint_perm[256]
                         = { 55, 254, 252, 251, 250, 248, 240, 245,
@@ -1651,17 +3525,14 @@ static const byte_t fingerprint_perm[256]
 
 void fingerprint_init (void)
 {
-  /* Make sure that the configuration was correct.  */
+  /* Make sure that the configuration was correct.  There is nothing
+     else to do.  */
 #if UCHAR_MAX != 255
 #error "The fingerprint module requires 8-bit characters."
 #endif /* UCHAR_MAX != 255 */
   assert (sizeof (int_32_t) == 4);
   assert (sizeof (poly_t) == 8);
   assert (sizeof (fingerprint_t) == 8);
-  assert (sizeof (void*) == sizeof (integer_t));
-
-  /* Intialize.  */
-  poly_to_bytes (POLY_ONE, FINGERPRINT_BYTE (fingerprint_of_empty));
 }
 
 
@@ -1678,7 +3549,8 @@ fingerprint_from_buffer (const char *buffer, int size)
   fingerprint_t result;
   poly_t        poly;
 
-  poly = poly_compute_mod (POLY_ONE,
+  poly = poly_compute_mod (&poly_default_basis,
+                           POLY_ONE,
                            (const byte_t*) buffer,
                            (integer_t) size);
   poly_to_bytes (poly, FINGERPRINT_BYTE (result));
@@ -1686,27 +3558,58 @@ fingerprint_from_buffer (const char *buffer, int size)
   return result;
 }
 
+void fingerprint_from_buffers (const char* const* buffers,
+                               const int*         sizes,
+                               int                n,
+                               fingerprint_t*     out)
+{
+  int i;
+
+  if (poly_little_endian) {
+#if MAY_BE_LITTLE_ENDIAN
+    poly_compute_mod_lanes (&poly_default_basis,
+                            (const byte_t* const*) buffers, sizes, n, out);
+    return;
+#endif /* MAY_BE_LITTLE_ENDIAN */
+  }
+
+  for (i = 0; i < n; ++i)
+    out[i] = fingerprint_from_buffer (buffers[i], sizes[i]);
+}
+
 inline fingerprint_t 
 fingerprint_from_text (const char* text)
 {
   return fingerprint_from_buffer(text, strlen(text));
 }
 
-fingerprint_t fingerprint_combine (fingerprint_t fp1,
-                                   fingerprint_t fp2)
+/* Return the residue of the 16-byte text FP1 FP2, as computed by
+   poly_compute_mod from ONE.  ONE * x^128 + FP1 * x^64 + FP2 is
+   (P + FP1) * x^64 + FP2, since x^64 MOD P is the stored part of P, so
+   only the two words of FP2 need to be stepped in.  */
+
+static poly_t poly_combine_mod (const basis_t* basis,
+                                fingerprint_t  fp1,
+                                fingerprint_t  fp2)
 {
-  poly_t        poly1;
-  poly_t        poly2;
-  fingerprint_t buf[2];
-  fingerprint_t res;
-  int           i;
+  poly_t t1;
+  poly_t t2;
+  poly_t t;
+
+  poly_from_bytes (FINGERPRINT_BYTE (fp1), &t1);
+  poly_from_bytes (FINGERPRINT_BYTE (fp2), &t2);
+  t = poly_plus (basis->p, t1);
+  t = poly_step (basis->table, t, POLY_HALF (t2, 0));
+  return poly_step (basis->table, t, POLY_HALF (t2, 1));
+}
 
-  buf[0] = fp1;
-  buf[1] = fp2;
+/* Scramble the residue POLY1 of a combined pair into the bytes of the
+   fingerprint RES.  */
 
-  poly1 = poly_compute_mod (POLY_ONE,
-                            (const byte_t*) &buf[0],
-                            sizeof (buf));
+static void poly_combine_finish (poly_t poly1, fingerprint_t* res)
+{
+  poly_t poly2;
+  int    i;
 
   POLY_HALF (poly2, 0) =
     poly_fix_32 (word_plus (word_times (POLY_HALF (poly1, 0),
@@ -1718,15 +3621,103 @@ fingerprint_t fingerprint_combine (fingerprint_t fp1,
                                         FINGERPRINT_C),
                             word_times (POLY_HALF (poly1, 1),
                                         FINGERPRINT_D)));
-  poly_to_bytes (poly2, FINGERPRINT_BYTE (res));
+  poly_to_bytes (poly2, FINGERPRINT_BYTE (*res));
 
   for (i = 0; i < 8; ++i)
-    FINGERPRINT_BYTE (res)[i] =
-      fingerprint_perm [FINGERPRINT_BYTE (res)[i]];
+    FINGERPRINT_BYTE (*res)[i] =
+      fingerprint_perm [FINGERPRINT_BYTE (*res)[i]];
+}
+
+#if POLY_X86_SIMD
+/* Scramble the N residues in POLY, which is a multiple of four, into
+   RES.  The multiplications are done on pairs of halves, and each
+   byte is looked up in fingerprint_perm by selecting one of sixteen
+   rows with its high nibble and indexing the row with its low nibble
+   through vpshufb.  */
+
+__attribute__ ((target ("avx2")))
+static void poly_combine_finish_avx2 (const poly_t*  poly,
+                                      fingerprint_t* res,
+                                      int            n)
+{
+  const __m256i ad = _mm256_set_epi32 (FINGERPRINT_D, FINGERPRINT_A,
+                                       FINGERPRINT_D, FINGERPRINT_A,
+                                       FINGERPRINT_D, FINGERPRINT_A,
+                                       FINGERPRINT_D, FINGERPRINT_A);
+  const __m256i bc = _mm256_set_epi32 (FINGERPRINT_C, FINGERPRINT_B,
+                                       FINGERPRINT_C, FINGERPRINT_B,
+                                       FINGERPRINT_C, FINGERPRINT_B,
+                                       FINGERPRINT_C, FINGERPRINT_B);
+  const __m256i nibble = _mm256_set1_epi8 (0x0f);
+  __m256i       row[16];
+  __m256i       x;
+  __m256i       lo;
+  __m256i       hi;
+  __m256i       y;
+  int           h;
+  int           i;
+
+  for (h = 0; h < 16; ++h)
+    row[h] = _mm256_broadcastsi128_si256
+               (_mm_loadu_si128 ((const __m128i*) &fingerprint_perm[16 * h]));
+
+  for (i = 0; i < n; i += 4) {
+    x = _mm256_loadu_si256 ((const __m256i*) &poly[i]);
+    x = _mm256_add_epi32 (_mm256_mullo_epi32 (x, ad),
+                          _mm256_mullo_epi32
+                            (_mm256_shuffle_epi32 (x, 0xb1), bc));
+
+    lo = _mm256_and_si256 (x, nibble);
+    hi = _mm256_and_si256 (_mm256_srli_epi16 (x, 4), nibble);
+    y = _mm256_setzero_si256 ();
+    for (h = 0; h < 16; ++h)
+      y = _mm256_or_si256
+            (y, _mm256_and_si256 (_mm256_shuffle_epi8 (row[h], lo),
+                                  _mm256_cmpeq_epi8
+                                    (hi, _mm256_set1_epi8 ((char) h))));
+    _mm256_storeu_si256 ((__m256i*) &res[i], y);
+  }
+}
+#endif /* POLY_X86_SIMD */
+
+fingerprint_t fingerprint_combine (fingerprint_t fp1,
+                                   fingerprint_t fp2)
+{
+  fingerprint_t res;
 
+  poly_combine_finish (poly_combine_mod (&poly_default_basis, fp1, fp2),
+                       &res);
   return res;
 }
 
+void fingerprint_combine_n (const fingerprint_t* fp1,
+                            const fingerprint_t* fp2,
+                            int                  n,
+                            fingerprint_t*       out)
+{
+  int    i = 0;
+#if POLY_X86_SIMD
+  poly_t poly[64];
+  int    j;
+  int    k;
+
+  if (__builtin_cpu_supports ("avx2")) {
+    for (; i + 4 <= n; i += k) {
+      k = n - i < 64 ? (n - i) & ~3 : 64;
+      for (j = 0; j < k; ++j)
+        poly[j] = poly_combine_mod (&poly_default_basis,
+                                    fp1[i + j], fp2[i + j]);
+      poly_combine_finish_avx2 (poly, &out[i], k);
+    }
+  }
+#endif /* POLY_X86_SIMD */
+
+  for (; i < n; ++i)
+    poly_combine_finish (poly_combine_mod (&poly_default_basis,
+                                           fp1[i], fp2[i]),
+                         &out[i]);
+}
+
 fingerprint_t fingerprint_from_chars (const char*   text,
                                       fingerprint_t fp)
 {
@@ -1739,7 +3730,8 @@ fingerprint_t fingerprint_from_chars (const char*   text,
     return fp;
 
   poly_from_bytes (FINGERPRINT_BYTE (fp), &init);
-  poly = poly_compute_mod (init, (const byte_t*) text, n);
+  poly = poly_compute_mod (&poly_default_basis, init,
+                           (const byte_t*) text, n);
   poly_to_bytes (poly, FINGERPRINT_BYTE (result));
 
   return result;
@@ -1766,15 +3758,518 @@ word_t fingerprint_hash (fingerprint_t fp)
   return word_xor (POLY_HALF (x, 0), POLY_HALF (x, 1));
 }
 
+void fingerprint_hash_n (const fingerprint_t* fp,
+                         int                  n,
+                         word_t*              out)
+{
+  poly_t x;
+  int    i;
+
+  for (i = 0; i < n; ++i) {
+    poly_from_bytes (FINGERPRINT_BYTE (fp[i]), &x);
+    out[i] = word_xor (POLY_HALF (x, 0), POLY_HALF (x, 1));
+  }
+}
+
+int fingerprint_poly_irreducible (fingerprint_t poly)
+{
+  poly_t p;
+
+  poly_from_bytes (FINGERPRINT_BYTE (poly), &p);
+  return poly_irreducible (p);
+}
+
+fingerprint_basis_t* fingerprint_basis_new (fingerprint_t poly)
+{
+  basis_storage_t* storage;
+  poly_t           p;
+
+  poly_from_bytes (FINGERPRINT_BYTE (poly), &p);
+  if (!poly_irreducible (p))
+    return NULL;
+
+  storage = poly_alloc_basis ();
+  if (storage == NULL)
+    return NULL;
+  poly_make_basis (storage, p);
+
+  return &storage->basis;
+}
+
+fingerprint_basis_t* fingerprint_basis_random (unsigned long seed)
+{
+  basis_storage_t* storage;
+  poly_t           p;
+  word_t           state;
+  word_t           t0;
+  word_t           t1;
+
+  /* Fold all of SEED into the initial state, without shifting by the
+     full width of a 32-bit long.  */
+  state = poly_mix (word_xor (poly_mix (word_and (seed, POLY_SIG_BITS)),
+                              word_and ((seed >> 16) >> 16, POLY_SIG_BITS)));
+
+  /* About one in 32 polynomials with a non-zero constant term is
+     irreducible, so this loop runs a few dozen times.  */
+  do {
+    state = word_plus (state, 0x9e3779b9);
+    t0 = poly_mix (state);
+    state = word_plus (state, 0x9e3779b9);
+    t1 = word_or (poly_mix (state), 0x80000000);
+    POLY_FORM (p, poly_fix_32 (t0), poly_fix_32 (t1));
+  } while (!poly_irreducible (p));
+
+  storage = poly_alloc_basis ();
+  if (storage == NULL)
+    return NULL;
+  poly_make_basis (storage, p);
+
+  return &storage->basis;
+}
+
+void fingerprint_basis_free (fingerprint_basis_t* basis)
+{
+  basis_storage_t* storage;
+
+  if (basis == NULL || basis == &poly_default_basis)
+    return;
+
+  storage = (basis_storage_t*)
+    ((char*) basis - offsetof (basis_storage_t, basis));
+  free (storage->block);
+}
+
+fingerprint_t fingerprint_basis_poly (const fingerprint_basis_t* basis)
+{
+  fingerprint_t result;
+
+  poly_to_bytes (POLY_BASIS (basis)->p, FINGERPRINT_BYTE (result));
+  return result;
+}
+
+fingerprint_t fingerprint_basis_from_buffer (const fingerprint_basis_t* basis,
+                                             const char*                buffer,
+                                             int                        size)
+{
+  fingerprint_t result;
+  poly_t        poly;
+
+  poly = poly_compute_mod (POLY_BASIS (basis),
+                           POLY_ONE,
+                           (const byte_t*) buffer,
+                           (integer_t) size);
+  poly_to_bytes (poly, FINGERPRINT_BYTE (result));
+
+  return result;
+}
+
+void fingerprint_ctx_init (fingerprint_ctx_t*         ctx,
+                           const fingerprint_basis_t* basis)
+{
+  ctx->basis = basis;
+  poly_to_bytes (POLY_ONE, FINGERPRINT_BYTE (ctx->residue));
+  ctx->length = 0;
+}
+
+void fingerprint_ctx_update (fingerprint_ctx_t* ctx,
+                             const char*        buffer,
+                             int                size)
+{
+  poly_t poly;
+
+  if (size <= 0)
+    return;
+
+  poly_from_bytes (FINGERPRINT_BYTE (ctx->residue), &poly);
+  poly = poly_compute_mod (POLY_BASIS (ctx->basis), poly,
+                           (const byte_t*) buffer, (integer_t) size);
+  poly_to_bytes (poly, FINGERPRINT_BYTE (ctx->residue));
+  ctx->length += size;
+}
+
+fingerprint_t fingerprint_ctx_final (const fingerprint_ctx_t* ctx)
+{
+  return ctx->residue;
+}
+
+/* A saved context holds, after the tag and version, the residue as
+   the bytes of a fingerprint, the length as 64 bits with the most
+   significant byte first, and the polynomial of the basis as the bytes
+   of a fingerprint.  */
+
+void fingerprint_ctx_save (const fingerprint_ctx_t* ctx,
+                           fingerprint_byte_t*      state)
+{
+  fingerprint_t poly = fingerprint_basis_poly (ctx->basis);
+  unsigned long length = ctx->length;
+  int           i;
+
+  memcpy (state, FINGERPRINT_CTX_TAG, 3);
+  state[3] = FINGERPRINT_CTX_VERSION;
+  memcpy (state + 4, FINGERPRINT_BYTE (ctx->residue), 8);
+  for (i = 19; i >= 12; --i) {
+    state[i] = (fingerprint_byte_t) (length & 0xff);
+    length >>= 8;
+  }
+  memcpy (state + 20, FINGERPRINT_BYTE (poly), 8);
+}
+
+int fingerprint_ctx_restore (fingerprint_ctx_t*         ctx,
+                             const fingerprint_basis_t* basis,
+                             const fingerprint_byte_t*  state,
+                             unsigned long              size)
+{
+  fingerprint_t poly = fingerprint_basis_poly (basis);
+  unsigned long length = 0;
+  int           i;
+
+  if (size != FINGERPRINT_CTX_STATE_SIZE
+      || memcmp (state, FINGERPRINT_CTX_TAG, 3) != 0
+      || state[3] != FINGERPRINT_CTX_VERSION
+      || memcmp (state + 20, FINGERPRINT_BYTE (poly), 8) != 0)
+    return 0;
+  for (i = 12; i < 20; ++i) {
+    if (length > ULONG_MAX >> 8)
+      return 0;
+    length = (length << 8) | state[i];
+  }
+
+  ctx->basis = basis;
+  memcpy (FINGERPRINT_BYTE (ctx->residue), state + 4, 8);
+  ctx->length = length;
+  return 1;
+}
+
+fingerprint_roller_t* fingerprint_roller_new (const fingerprint_basis_t* basis,
+                                              int                        window)
+{
+  roller_t* r;
+  poly_t    x;
+  poly_t    k;
+  poly_t    o;
+  int       i;
+
+  if (window < 1)
+    return NULL;
+
+  r = (roller_t*) malloc (sizeof (roller_t) + window);
+  if (r == NULL)
+    return NULL;
+  r->basis = POLY_BASIS (basis);
+  r->window = window;
+  r->ring = (byte_t*) (r + 1);
+
+  /* X = x^(8 * WINDOW), and K = X * x^8 + X.  */
+  x = POLY_ONE;
+  for (i = 0; i < window; ++i)
+    x = poly_shift_byte (r->basis->table, x, 0);
+  k = poly_plus (poly_shift_byte (r->basis->table, x, 0), x);
+
+  for (i = 0; i < 256; ++i) {
+    POLY_FORM (o, 0, poly_fix_32 (word_left_shift (i, 24)));
+    r->out[i] = poly_plus (poly_times (o, x, r->basis->p), k);
+  }
+
+  fingerprint_roller_reset (r);
+  return r;
+}
+
+void fingerprint_roller_free (fingerprint_roller_t* roller)
+{
+  free (roller);
+}
+
+void fingerprint_roller_reset (fingerprint_roller_t* roller)
+{
+  roller->t = POLY_ONE;
+  roller->seen = 0;
+}
+
+void fingerprint_roller_update (fingerprint_roller_t* roller,
+                                const char*           buffer,
+                                int                   size,
+                                fingerprint_t*        out)
+{
+  const poly_t  (*table)[256] = roller->basis->table;
+  const poly_t* drop = roller->out;
+  const byte_t* b = (const byte_t*) buffer;
+  byte_t*       ring = roller->ring;
+  int           w = roller->window;
+  poly_t        t = roller->t;
+  int           le = poly_little_endian;
+  int           i = 0;
+
+  /* While the window is filling, the text simply grows.  */
+  for (; i < size && roller->seen + i < (unsigned long) w; ++i) {
+    t = poly_shift_byte (table, t, b[i]);
+    if (out != NULL)
+      poly_store (t, FINGERPRINT_BYTE (out[i]), le);
+  }
+
+  /* The bytes leaving the window come from the ring until they can be
+     found in BUFFER itself.  */
+  for (; i < size && i < w; ++i) {
+    t = poly_plus (poly_shift_byte (table, t, b[i]),
+                   drop[ring[(roller->seen + i) % w]]);
+    if (out != NULL)
+      poly_store (t, FINGERPRINT_BYTE (out[i]), le);
+  }
+
+  if (out != NULL) {
+    /* Each fingerprint depends on the one before, so a single chain
+       waits on its table lookups.  When there is room, the rest of
+       BUFFER is cut into four stretches whose chains are run side by
+       side; each stretch after the first starts from the window of
+       bytes just before it.  */
+    if ((size - i) / 4 >= 2 * w + 16) {
+      int    n = (size - i) / 4;
+      int    s1 = i + n;
+      int    s2 = s1 + n;
+      int    s3 = s2 + n;
+      poly_t t1 = POLY_ONE;
+      poly_t t2 = POLY_ONE;
+      poly_t t3 = POLY_ONE;
+      int    j;
+
+      for (j = -w; j < 0; ++j) {
+        t1 = poly_shift_byte (table, t1, b[s1 + j]);
+        t2 = poly_shift_byte (table, t2, b[s2 + j]);
+        t3 = poly_shift_byte (table, t3, b[s3 + j]);
+      }
+      for (j = 0; j < n; ++j) {
+        t = poly_plus (poly_shift_byte (table, t, b[i + j]),
+                       drop[b[i + j - w]]);
+        t1 = poly_plus (poly_shift_byte (table, t1, b[s1 + j]),
+                        drop[b[s1 + j - w]]);
+        t2 = poly_plus (poly_shift_byte (table, t2, b[s2 + j]),
+                        drop[b[s2 + j - w]]);
+        t3 = poly_plus (poly_shift_byte (table, t3, b[s3 + j]),
+                        drop[b[s3 + j - w]]);
+        poly_store (t, FINGERPRINT_BYTE (out[i + j]), le);
+        poly_store (t1, FINGERPRINT_BYTE (out[s1 + j]), le);
+        poly_store (t2, FINGERPRINT_BYTE (out[s2 + j]), le);
+        poly_store (t3, FINGERPRINT_BYTE (out[s3 + j]), le);
+      }
+      t = t3;
+      i = s3 + n;
+    }
+    for (; i < size; ++i) {
+      t = poly_plus (poly_shift_byte (table, t, b[i]), drop[b[i - w]]);
+      poly_store (t, FINGERPRINT_BYTE (out[i]), le);
+    }
+  } else {
+    for (; i < size; ++i)
+      t = poly_plus (poly_shift_byte (table, t, b[i]), drop[b[i - w]]);
+  }
+
+  /* Keep the tail of BUFFER for the next call.  */
+  for (i = size < w ? 0 : size - w; i < size; ++i)
+    ring[(roller->seen + i) % w] = b[i];
+
+  roller->t = t;
+  roller->seen += size;
+}
+
+fingerprint_t fingerprint_roller_value (const fingerprint_roller_t* roller)
+{
+  fingerprint_t result;
+
+  poly_to_bytes (roller->t, FINGERPRINT_BYTE (result));
+  return result;
+}
+
+int fingerprint_roller_window (const fingerprint_roller_t* roller)
+{
+  return roller->window;
+}
+
+fingerprint_prefix_t* fingerprint_prefix_new (const fingerprint_basis_t* basis,
+                                              const char*                buffer,
+                                              unsigned long              size)
+{
+  const byte_t* b = (const byte_t*) buffer;
+  prefix_t*     p;
+  poly_t        t;
+  unsigned long i;
+
+  if (size >= (size_t) -1 / sizeof (poly_t))
+    return NULL;
+
+  p = (prefix_t*) malloc (sizeof (prefix_t));
+  if (p == NULL)
+    return NULL;
+  p->basis = POLY_BASIS (basis);
+  p->size = size;
+  p->prefix = (poly_t*) malloc ((size + 1) * sizeof (poly_t));
+  p->high = (poly_t*) malloc ((size / 256 + 1) * sizeof (poly_t));
+  if (p->prefix == NULL || p->high == NULL) {
+    fingerprint_prefix_free (p);
+    return NULL;
+  }
+  p->times = poly_times_select ();
+
+  t = POLY_ONE;
+  p->prefix[0] = t;
+  for (i = 0; i < size; ++i) {
+    t = poly_shift_byte (p->basis->table, t, b[i]);
+    p->prefix[i + 1] = t;
+  }
+
+  /* T ends as x^2048.  */
+  t = POLY_ONE;
+  for (i = 0; i < 256; ++i) {
+    p->low[i] = t;
+    t = poly_shift_byte (p->basis->table, t, 0);
+  }
+  p->high[0] = POLY_ONE;
+  for (i = 1; i <= size / 256; ++i)
+    p->high[i] = p->times (p->basis, p->high[i - 1], t);
+
+  return p;
+}
+
+void fingerprint_prefix_free (fingerprint_prefix_t* prefix)
+{
+  if (prefix == NULL)
+    return;
+  free (prefix->prefix);
+  free (prefix->high);
+  free (prefix);
+}
+
+unsigned long fingerprint_prefix_size (const fingerprint_prefix_t* prefix)
+{
+  return prefix->size;
+}
+
+fingerprint_t fingerprint_prefix_range (const fingerprint_prefix_t* prefix,
+                                        unsigned long               start,
+                                        unsigned long               end)
+{
+  unsigned long n = end - start;
+  fingerprint_t result;
+  poly_t        t;
+
+  t = poly_plus (prefix->prefix[start], POLY_ONE);
+  if (n % 256 != 0)
+    t = prefix->times (prefix->basis, t, prefix->low[n % 256]);
+  if (n / 256 != 0)
+    t = prefix->times (prefix->basis, t, prefix->high[n / 256]);
+  t = poly_plus (prefix->prefix[end], t);
+  poly_to_bytes (t, FINGERPRINT_BYTE (result));
+  return result;
+}
+
+fingerprint_t fingerprint_update_range (fingerprint_t fp,
+                                        unsigned long size,
+                                        unsigned long offset,
+                                        const char*   old_bytes,
+                                        const char*   new_bytes,
+                                        unsigned long len)
+{
+  return fingerprint_basis_update_range (NULL, fp, size, offset,
+                                         old_bytes, new_bytes, len);
+}
+
+fingerprint_t fingerprint_basis_update_range
+                (const fingerprint_basis_t* basis,
+                 fingerprint_t              fp,
+                 unsigned long              size,
+                 unsigned long              offset,
+                 const char*                old_bytes,
+                 const char*                new_bytes,
+                 unsigned long              len)
+{
+  const basis_t* b = POLY_BASIS (basis);
+  poly_times_t   times;
+  byte_t         delta[256];
+  poly_t         d = POLY_ZERO;
+  poly_t         t;
+  unsigned long  i;
+  unsigned long  n;
+  fingerprint_t  result;
+
+  assert (offset <= size && len <= size - offset);
+
+  /* The residue is linear in the bytes of the text, so the edit adds
+     D(x) * x^(8 * (SIZE - OFFSET - LEN)), where D holds the exclusive
+     or of the old and new bytes.  D is found a block at a time.  */
+  for (i = 0; i < len; i += n) {
+    unsigned long j;
+
+    n = len - i < sizeof (delta) ? len - i : sizeof (delta);
+    for (j = 0; j < n; ++j)
+      delta[j] = (byte_t) (old_bytes[i + j] ^ new_bytes[i + j]);
+    d = poly_compute_mod (b, d, delta, (integer_t) n);
+  }
+  if (poly_equal (d, POLY_ZERO))
+    return fp;
+
+  times = poly_times_select ();
+  n = size - offset - len;
+  if (n != 0)
+    d = times (b, d, poly_power_bytes (b, times, n));
+  poly_from_bytes (FINGERPRINT_BYTE (fp), &t);
+  t = poly_plus (t, d);
+  poly_to_bytes (t, FINGERPRINT_BYTE (result));
+  return result;
+}
+
+fingerprint128_t fingerprint128_from_buffer (const char* buffer, int size)
+{
+  return fingerprint128_basis_from_buffer (NULL, NULL, buffer, size);
+}
+
+fingerprint128_t fingerprint128_basis_from_buffer
+                   (const fingerprint_basis_t* basis1,
+                    const fingerprint_basis_t* basis2,
+                    const char*                buffer,
+                    int                        size)
+{
+  fingerprint128_t result;
+  poly_t           t1 = POLY_ONE;
+  poly_t           t2 = POLY_ONE;
+
+  poly_compute_mod_wide (POLY_BASIS (basis1),
+                         basis2 ? basis2 : &poly_wide_basis,
+                         &t1, &t2, (const byte_t*) buffer, (integer_t) size);
+  poly_to_bytes (t1, FINGERPRINT_BYTE (result.fp[0]));
+  poly_to_bytes (t2, FINGERPRINT_BYTE (result.fp[1]));
+  return result;
+}
+
+fingerprint128_t fingerprint128_combine (fingerprint128_t fp1,
+                                         fingerprint128_t fp2)
+{
+  fingerprint128_t res;
+
+  poly_combine_finish (poly_combine_mod (&poly_default_basis,
+                                         fp1.fp[0], fp2.fp[0]),
+                       &res.fp[0]);
+  poly_combine_finish (poly_combine_mod (&poly_wide_basis,
+                                         fp1.fp[1], fp2.fp[1]),
+                       &res.fp[1]);
+  return res;
+}
+
+int fingerprint128_equal (fingerprint128_t fp1, fingerprint128_t fp2)
+{
+  return memcmp (&fp1, &fp2, sizeof (fingerprint128_t)) == 0;
+}
+
+word_t fingerprint128_hash (fingerprint128_t fp)
+{
+  return word_xor (fingerprint_hash (fp.fp[0]), fingerprint_hash (fp.fp[1]));
+}
+
 /***********************************************************************
   Unit Test
 ***********************************************************************/
 
-#undef FINGERPRINT_TEST
 #ifdef FINGERPRINT_TEST
 #include <stdio.h>
 
-static void fingerprint_print (fingerprint_t fp, byte_t* buffer)
+static void fingerprint_print (fingerprint_t fp, char* buffer)
 {
   int i;
 
@@ -51,11 +51,17 @@ extern "C" {
    The code below contains two variants: one for machines which have a
    native 64-bit little-endian integral type, and one for all other
    systems.  (Actually, the "portable" code will not work on those
-   systems which have bytes containing more than 8 bits.  In addition,
-   neither version of the code will work if there is no integer type
-   with the same number of bits as all pointer values.  This may occur
-   either if some pointer types have more or less bits than others, or
-   if there are no integer types with the right number of bits.)
+   systems which have bytes containing more than 8 bits.)
+
+   Threads
+   -------
+
+   The module keeps no state of its own that changes, and needs no
+   initialization, so any number of threads may use it at once without
+   locking.  An object created by the caller, such as a
+   fingerprint_ctx_t or a fingerprint_roller_t, must not be used by two
+   threads at a time; a fingerprint_basis_t may be shared once it has
+   been made.
 
    Configuration
    -------------
@@ -78,29 +84,42 @@ extern "C" {
      FINGERPRINT_POINTER_INT_TYPE
 
        This macro may be defined to the name of a signed integral type
-       with the same number of bits as pointer values.  If this macro
-       is not defined, `int' is used instead.
+       of at least 32 bits, used for the lengths of buffers.  If this
+       macro is not defined, `int' is used instead.
 
      FINGERPRINT_LITTLE_ENDIAN
 
        If this macro is defined to 1, the system is little-endian.  If
        this macro is defined to 0, the system is big-endian.  This
-       macro may be left undefined, in which case the fingerprinting
-       routines will determine the endianness at run-time.  If
+       macro may be left undefined, in which case it is taken from the
+       compiler where the compiler says, and otherwise the
+       fingerprinting routines determine the endianness at run-time.  If
        FINGERPRINT_INTEGRAL_TYPE is defined, it is assumed that the
        system is little-endian; you must not set this flag in that
        case.
 
+     FINGERPRINT_NO_SIMD
+
+       If this macro is defined, the routines will not use the vector
+       instructions of x86 processors, even where the compiler and the
+       processor support them.
+
+     FINGERPRINT_AVX2_GATHER
+
+       If this macro is defined, fingerprint_from_buffers uses AVX2
+       gathers on processors which have them.  This only pays where
+       gathers are fast; on many Intel processors the scalar code is
+       quicker.
+
    Testing
    -------
 
-   When the fingerprint module is initialized, if will perform some
-   basic consistency checking, unless NDEBUG is defined.  In addition,
-   you can build fingerprint.c, defining FINGERPRINT_TEST, to build a
-   small program which tests the basic functionality of the
-   fingerprint module.  You should undertake this procedure if running
-   the fingerprint module in a configuration you have not used
-   before.  */
+   fingerprint_init performs some basic consistency checking, unless
+   NDEBUG is defined.  In addition, you can build fingerprint.c,
+   defining FINGERPRINT_TEST, to build a small program which tests the
+   basic functionality of the fingerprint module.  You should undertake
+   this procedure if running the fingerprint module in a configuration
+   you have not used before.  */
 
 /***********************************************************************
   Macros
@@ -115,6 +134,11 @@ extern "C" {
 #define FINGERPRINT_USE_INTEGRAL_TYPE 0
 #endif /* ifdef FINGERPRINT_USE_INTEGRAL_TYPE */
 
+/* FINGERPRINT_CTX_STATE_SIZE is the number of bytes of a context saved
+   by fingerprint_ctx_save.  */
+
+#define FINGERPRINT_CTX_STATE_SIZE 28
+
 /***********************************************************************
   Types
 ***********************************************************************/
@@ -158,6 +182,54 @@ typedef FINGERPRINT_INTEGRAL_TYPE fingerprint_t;
 #define FINGERPRINT_BYTE(fp) ((fingerprint_byte_t*) &(fp))
 #endif /* !FINGERPRINT_USE_INTEGRAL_TYPE */
 
+/* A fingerprint_basis_t is an irreducible polynomial P of degree 64,
+   together with the lookup tables derived from it.  Fingerprints are
+   residues MOD P, so fingerprints computed with different bases are
+   unrelated.  The type is opaque.  Wherever a basis is expected, a
+   null pointer stands for the basis of the Modula-3 module, which is
+   the one used by all of the functions that do not take a basis.  */
+
+typedef struct fingerprint_basis_t fingerprint_basis_t;
+
+/* A fingerprint_ctx_t accumulates the fingerprint of a text which is
+   presented in pieces.  Each context refers to its own basis, so that
+   contexts for different bases can be used side by side.  */
+
+typedef struct fingerprint_ctx_t {
+  const fingerprint_basis_t*
+                basis;  /* The basis in use, or null.  */
+  fingerprint_t residue;
+                        /* The fingerprint of the text so far.  */
+  unsigned long length; /* The number of bytes in the text so far.  */
+} fingerprint_ctx_t;
+
+/* A fingerprint_roller_t keeps the fingerprint of the last few bytes
+   of a text, the window, as more of the text is presented.  The
+   fingerprint of a full window is the same as fingerprint_from_buffer
+   would give for those bytes.  The type is opaque.  */
+
+typedef struct fingerprint_roller_t fingerprint_roller_t;
+
+/* A fingerprint_prefix_t holds the fingerprints of every prefix of a
+   buffer, from which the fingerprint of any range of the buffer is
+   found in constant time, the same as fingerprint_from_buffer would
+   give for the bytes of the range.  It takes eight bytes for each byte
+   of the buffer, which it does not keep.  The type is opaque.  */
+
+typedef struct fingerprint_prefix_t fingerprint_prefix_t;
+
+/* A fingerprint128_t is a 128-bit checksum, made of the fingerprints
+   of a text with respect to two bases.  Unless other bases are given,
+   FP[0] is the fingerprint that fingerprint_from_buffer gives, and
+   FP[1] is taken with respect to a second built-in basis, whose
+   polynomial is irreducible.  Two different texts are as likely to
+   share a 128-bit fingerprint as two 64-bit fingerprints are to
+   collide twice over.  */
+
+typedef struct fingerprint128_t {
+  fingerprint_t fp[2];
+} fingerprint128_t;
+
 /***********************************************************************
   Variables
 ***********************************************************************/
@@ -171,24 +243,30 @@ extern const fingerprint_t
 #define fingerprint_zero ((fingerprint_t) 0)
 #endif /* FINGERPRINT_USE_INTEGRAL_TYPE */
 
-extern /*const*/ fingerprint_t
+extern const fingerprint_t
                 fingerprint_of_empty;
-                        /*  The fingerprint of the empty text.  This
-                            value should be thought of as const, but
-                            cannot be, since it must be dynamically
-                            initialized.   */
+                        /* The fingerprint of the empty text.  */
 
 /***********************************************************************
   Functions
 ***********************************************************************/
 
-/* Initialize the fingerprint module.  This routine must be called
-   before any other routine in this module.  */
+/* Check the configuration of the fingerprint module.  The module needs
+   no initialization, so this routine need not be called; it is kept
+   for the sake of existing callers.  */
 extern void fingerprint_init (void);
 
 /* Return the fingerprint of BUFFER.  */
 extern fingerprint_t fingerprint_from_buffer (const char *buffer, int size);
 
+/* Store the fingerprint of BUFFERS[I], of SIZES[I] bytes, in OUT[I],
+   for each I below N.  Several buffers are processed at once, so this
+   is faster than calling fingerprint_from_buffer for each.  */
+extern void fingerprint_from_buffers (const char* const* buffers,
+                                      const int*         sizes,
+                                      int                n,
+                                      fingerprint_t*     out);
+
 /* Return the fingerprint of TEXT.  */
 extern fingerprint_t fingerprint_from_text (const char* text);
 
@@ -196,6 +274,13 @@ extern fingerprint_t fingerprint_from_text (const char* text);
 extern fingerprint_t fingerprint_combine (fingerprint_t fp1,
                                           fingerprint_t fp2);
 
+/* Store fingerprint_combine (FP1[I], FP2[I]) in OUT[I], for each I
+   below N.  */
+extern void fingerprint_combine_n (const fingerprint_t* fp1,
+                                   const fingerprint_t* fp2,
+                                   int                  n,
+                                   fingerprint_t*       out);
+
 /* Return of the fingerprint of T and TEXT where T is the text whose
    fingerprint is FP.  */
 extern fingerprint_t fingerprint_from_chars (const char*   text,
@@ -219,6 +304,171 @@ extern int fingerprint_equal_f (fingerprint_t fp1,
 /* Return a hash code for FP.  */
 extern fingerprint_word_t fingerprint_hash (fingerprint_t fp);
 
+/* Store fingerprint_hash (FP[I]) in OUT[I], for each I below N.  */
+extern void fingerprint_hash_n (const fingerprint_t* fp,
+                                int                  n,
+                                fingerprint_word_t*  out);
+
+/* Return non-zero if x^64 + POLY is irreducible, where POLY holds the
+   coefficients of x^63 ... x^0 in the same order as the bits of a
+   fingerprint.  */
+extern int fingerprint_poly_irreducible (fingerprint_t poly);
+
+/* Return a new basis for the polynomial x^64 + POLY, generating its
+   tables.  Return NULL if the polynomial is not irreducible, or if
+   memory is exhausted.  */
+extern fingerprint_basis_t* fingerprint_basis_new (fingerprint_t poly);
+
+/* Return a new basis for an irreducible polynomial chosen by SEED.
+   The same seed always selects the same polynomial.  Return NULL if
+   memory is exhausted.  */
+extern fingerprint_basis_t* fingerprint_basis_random (unsigned long seed);
+
+/* Release BASIS, which was returned by fingerprint_basis_new or
+   fingerprint_basis_random.  */
+extern void fingerprint_basis_free (fingerprint_basis_t* basis);
+
+/* Return the polynomial of BASIS, less its x^64 term, in the form
+   accepted by fingerprint_basis_new.  */
+extern fingerprint_t fingerprint_basis_poly
+                        (const fingerprint_basis_t* basis);
+
+/* Return the fingerprint of BUFFER with respect to BASIS.  */
+extern fingerprint_t fingerprint_basis_from_buffer
+                        (const fingerprint_basis_t* basis,
+                         const char*                buffer,
+                         int                        size);
+
+/* Start CTX on the empty text, with respect to BASIS.  */
+extern void fingerprint_ctx_init (fingerprint_ctx_t*         ctx,
+                                  const fingerprint_basis_t* basis);
+
+/* Append BUFFER to the text of CTX.  */
+extern void fingerprint_ctx_update (fingerprint_ctx_t* ctx,
+                                    const char*        buffer,
+                                    int                size);
+
+/* Return the fingerprint of the text of CTX.  */
+extern fingerprint_t fingerprint_ctx_final (const fingerprint_ctx_t* ctx);
+
+/* Save CTX in the FINGERPRINT_CTX_STATE_SIZE bytes at STATE, so that
+   the text can be resumed later, perhaps in another process or on
+   another host.  The saved bytes are the same in every configuration.
+   They record the polynomial of the basis of CTX, but not the basis
+   itself.  */
+extern void fingerprint_ctx_save (const fingerprint_ctx_t* ctx,
+                                  fingerprint_byte_t*      state);
+
+/* Set CTX, with respect to BASIS, to the context saved in the SIZE
+   bytes at STATE, and return non-zero.  Return zero, leaving CTX
+   unchanged, if STATE was not saved by this version of
+   fingerprint_ctx_save, or was saved from a context whose basis has
+   another polynomial, or holds a length too large for an unsigned
+   long.  */
+extern int fingerprint_ctx_restore (fingerprint_ctx_t*         ctx,
+                                    const fingerprint_basis_t* basis,
+                                    const fingerprint_byte_t*  state,
+                                    unsigned long              size);
+
+/* Return a new roller for windows of WINDOW bytes with respect to
+   BASIS, positioned at the start of a text.  Return NULL if WINDOW is
+   not positive, or if memory is exhausted.  */
+extern fingerprint_roller_t* fingerprint_roller_new
+                        (const fingerprint_basis_t* basis,
+                         int                        window);
+
+/* Release ROLLER.  */
+extern void fingerprint_roller_free (fingerprint_roller_t* roller);
+
+/* Return ROLLER to the start of a new text.  */
+extern void fingerprint_roller_reset (fingerprint_roller_t* roller);
+
+/* Append BUFFER to the text of ROLLER.  Unless OUT is NULL, store in
+   OUT[I] the fingerprint of the window which ends with BUFFER[I]; if
+   fewer than a window of bytes have been seen, this is the fingerprint
+   of all of them.  */
+extern void fingerprint_roller_update (fingerprint_roller_t* roller,
+                                       const char*           buffer,
+                                       int                   size,
+                                       fingerprint_t*        out);
+
+/* Return the fingerprint of the current window of ROLLER.  */
+extern fingerprint_t fingerprint_roller_value
+                        (const fingerprint_roller_t* roller);
+
+/* Return the size of the window of ROLLER.  */
+extern int fingerprint_roller_window (const fingerprint_roller_t* roller);
+
+/* Return a new prefix table for the SIZE bytes of BUFFER with respect
+   to BASIS.  Return NULL if memory is exhausted.  */
+extern fingerprint_prefix_t* fingerprint_prefix_new
+                        (const fingerprint_basis_t* basis,
+                         const char*                buffer,
+                         unsigned long              size);
+
+/* Release PREFIX.  */
+extern void fingerprint_prefix_free (fingerprint_prefix_t* prefix);
+
+/* Return the size of the buffer of PREFIX.  */
+extern unsigned long fingerprint_prefix_size
+                        (const fingerprint_prefix_t* prefix);
+
+/* Return the fingerprint of the bytes from START up to but not
+   including END of the buffer of PREFIX.  START must not exceed END,
+   nor END the size of the buffer.  */
+extern fingerprint_t fingerprint_prefix_range
+                        (const fingerprint_prefix_t* prefix,
+                         unsigned long               start,
+                         unsigned long               end);
+
+/* Return the fingerprint of a text of SIZE bytes whose fingerprint is
+   FP, after the LEN bytes OLD_BYTES at OFFSET are replaced by the LEN
+   bytes NEW_BYTES.  OFFSET + LEN must not exceed SIZE.  The time taken
+   grows with LEN and with the logarithm of SIZE, not with SIZE.  */
+extern fingerprint_t fingerprint_update_range (fingerprint_t fp,
+                                               unsigned long size,
+                                               unsigned long offset,
+                                               const char*   old_bytes,
+                                               const char*   new_bytes,
+                                               unsigned long len);
+
+/* fingerprint_update_range, with respect to BASIS.  */
+extern fingerprint_t fingerprint_basis_update_range
+                        (const fingerprint_basis_t* basis,
+                         fingerprint_t              fp,
+                         unsigned long              size,
+                         unsigned long              offset,
+                         const char*                old_bytes,
+                         const char*                new_bytes,
+                         unsigned long              len);
+
+/* Return the 128-bit fingerprint of BUFFER, made in a single pass over
+   its bytes.  */
+extern fingerprint128_t fingerprint128_from_buffer (const char* buffer,
+                                                    int         size);
+
+/* Return the 128-bit fingerprint of BUFFER with respect to BASIS1 and
+   BASIS2, where a null BASIS2 stands for the second built-in basis.
+   The two bases should differ.  */
+extern fingerprint128_t fingerprint128_basis_from_buffer
+                           (const fingerprint_basis_t* basis1,
+                            const fingerprint_basis_t* basis2,
+                            const char*                buffer,
+                            int                        size);
+
+/* Return the 128-bit fingerprint of the ordered pair (FP1, FP2), each
+   half combined as by fingerprint_combine with respect to the built-in
+   bases.  */
+extern fingerprint128_t fingerprint128_combine (fingerprint128_t fp1,
+                                                fingerprint128_t fp2);
+
+/* Return FP1 == FP2.  */
+extern int fingerprint128_equal (fingerprint128_t fp1,
+                                 fingerprint128_t fp2);
+
+/* Return a hash code for FP.  */
+extern fingerprint_word_t fingerprint128_hash (fingerprint128_t fp);
+
 #ifdef __cplusplus
 }
 #endif /* ifdef __cplusplus */
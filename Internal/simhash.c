@@ -0,0 +1,428 @@
+/***********************************************************************
+
+ File:   simhash.c
+
+ Contents: SimHash signatures and an index for finding near ones.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "simhash.h"
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* SIMHASH_X86_SIMD is 1 if the compiler can build kernels for the x86
+   vector extensions, which are then selected at run time according to
+   the processor.  Defining FINGERPRINT_NO_SIMD suppresses them.  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(FINGERPRINT_NO_SIMD)
+#define SIMHASH_X86_SIMD 1
+#include <immintrin.h>
+#else /* !(defined(__GNUC__) && ...) */
+#define SIMHASH_X86_SIMD 0
+#endif /* defined(__GNUC__) && ... */
+
+/* SIMHASH_MIN_BUCKETS is the number of buckets in each band of an
+   empty index.  */
+
+#define SIMHASH_MIN_BUCKETS 1024
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+typedef fingerprint_word_t word_t;
+
+/* A simhash_band_t is the hash table of one band of an index.  */
+
+typedef struct simhash_band_t {
+  word_t        mask[2];
+                        /* The bits of the band, in each half of a
+                           signature.  */
+  word_t        limit;  /* The number of values the band can take, or
+                           zero if that is 2^32 or more.  */
+  int*          heads;  /* The first signature in each bucket, or -1.  */
+} simhash_band_t;
+
+struct fingerprint_simhash_index_t {
+  int           k;      /* The greatest distance of interest.  */
+  int           bands;  /* The number of bands, K + 1.  */
+  simhash_band_t
+                band[64];
+                        /* The bands.  */
+  word_t        buckets;
+                        /* The number of buckets in each band, a power
+                           of 2, or the number of values of a band if
+                           that is less.  */
+  int           count;  /* The number of signatures.  */
+  int           size;   /* The number of signatures there is room
+                           for.  */
+  word_t*       sig;    /* The halves of each signature.  */
+  unsigned long*
+                id;     /* The identifier of each signature.  */
+  int*          next;   /* NEXT[E * BANDS + B] is the signature after E
+                           in its bucket of band B, or -1.  */
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Return X with its bits mixed.  */
+
+static word_t
+simhash_fmix (word_t x)
+{
+  x ^= x >> 16;
+  x *= 0x85ebca6bU;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35U;
+  return x ^ (x >> 16);
+}
+
+/* Return the number of bits set in X.  */
+
+static int
+simhash_popcount (word_t x)
+{
+#ifdef __GNUC__
+  return __builtin_popcount (x);
+#else /* !__GNUC__ */
+  x = x - ((x >> 1) & 0x55555555U);
+  x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+  x = (x + (x >> 4)) & 0x0f0f0f0fU;
+  return (int) ((x * 0x01010101U) >> 24);
+#endif /* __GNUC__ */
+}
+
+/* Store the halves of SIG in H.  */
+
+static void
+simhash_halves (fingerprint_t sig, word_t* h)
+{
+  const fingerprint_byte_t* b = FINGERPRINT_BYTE (sig);
+
+  h[0] = (word_t) b[0] | ((word_t) b[1] << 8)
+    | ((word_t) b[2] << 16) | ((word_t) b[3] << 24);
+  h[1] = (word_t) b[4] | ((word_t) b[5] << 8)
+    | ((word_t) b[6] << 16) | ((word_t) b[7] << 24);
+}
+
+/* Add WEIGHT to TOTAL[I] for each bit I set in the halves H of a mixed
+   fingerprint, and subtract it for each bit clear.  */
+
+static void
+simhash_accumulate (int* total, const word_t* h, int weight)
+{
+  int i;
+
+  for (i = 0; i < 32; ++i) {
+    total[i] += (h[0] >> i) & 1 ? weight : -weight;
+    total[32 + i] += (h[1] >> i) & 1 ? weight : -weight;
+  }
+}
+
+#if SIMHASH_X86_SIMD
+/* As simhash_accumulate, eight positions to a vector: each byte of the
+   halves is broadcast, its bits are spread to the lanes, and the lanes
+   select the weight or its negation.  */
+
+__attribute__ ((target ("avx2")))
+static void
+simhash_accumulate_avx2 (int* total, const word_t* h, int weight)
+{
+  const __m256i bit = _mm256_setr_epi32 (1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256i plus = _mm256_set1_epi32 (weight);
+  const __m256i minus = _mm256_set1_epi32 (-weight);
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    __m256i b = _mm256_set1_epi32 ((int) ((h[i >> 2] >> (8 * (i & 3)))
+                                          & 0xff));
+    __m256i set = _mm256_cmpeq_epi32 (_mm256_and_si256 (b, bit), bit);
+    __m256i t = _mm256_loadu_si256 ((const __m256i*) (total + 8 * i));
+
+    t = _mm256_add_epi32 (t, _mm256_blendv_epi8 (minus, plus, set));
+    _mm256_storeu_si256 ((__m256i*) (total + 8 * i), t);
+  }
+}
+#endif /* SIMHASH_X86_SIMD */
+
+/* Return the bucket of band B of INDEX for the signature whose halves
+   are H.  */
+
+static word_t
+simhash_bucket (const fingerprint_simhash_index_t* index,
+                int                                b,
+                const word_t*                      h)
+{
+  const simhash_band_t* band = &index->band[b];
+
+  return simhash_fmix ((h[0] & band->mask[0])
+                       ^ simhash_fmix ((h[1] & band->mask[1]) + b))
+    & (index->buckets - 1);
+}
+
+/* Link signature E into the buckets of each band of INDEX.  */
+
+static void
+simhash_link (fingerprint_simhash_index_t* index, int e)
+{
+  int b;
+
+  for (b = 0; b < index->bands; ++b) {
+    word_t bucket = simhash_bucket (index, b, &index->sig[2 * e]);
+
+    index->next[e * index->bands + b] = index->band[b].heads[bucket];
+    index->band[b].heads[bucket] = e;
+  }
+}
+
+/* Give each band of INDEX BUCKETS buckets, relinking its signatures.
+   Return zero if memory is exhausted.  */
+
+static int
+simhash_rehash (fingerprint_simhash_index_t* index, word_t buckets)
+{
+  int* heads[64];
+  int b, e;
+
+  for (b = 0; b < index->bands; ++b) {
+    heads[b] = (int*) malloc (buckets * sizeof (int));
+    if (!heads[b]) {
+      while (b-- > 0)
+        free (heads[b]);
+      return 0;
+    }
+    memset (heads[b], -1, buckets * sizeof (int));
+  }
+  for (b = 0; b < index->bands; ++b) {
+    free (index->band[b].heads);
+    index->band[b].heads = heads[b];
+  }
+  index->buckets = buckets;
+  for (e = 0; e < index->count; ++e)
+    simhash_link (index, e);
+  return 1;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+void
+fingerprint_simhash_init (fingerprint_simhash_ctx_t* ctx)
+{
+  memset (ctx->total, 0, sizeof (ctx->total));
+}
+
+void
+fingerprint_simhash_add (fingerprint_simhash_ctx_t* ctx,
+                         fingerprint_t              fp,
+                         int                        weight)
+{
+  word_t h[2];
+
+  /* The fingerprint of a short feature is little more than its bytes,
+     so both halves are mixed, each into the other.  */
+  simhash_halves (fp, h);
+  h[0] = simhash_fmix (h[0] ^ (h[1] * 0x9e3779b1U));
+  h[1] = simhash_fmix (h[1] ^ (h[0] * 0x85ebca6bU));
+
+#if SIMHASH_X86_SIMD
+  if (__builtin_cpu_supports ("avx2")) {
+    simhash_accumulate_avx2 (ctx->total, h, weight);
+    return;
+  }
+#endif /* SIMHASH_X86_SIMD */
+  simhash_accumulate (ctx->total, h, weight);
+}
+
+void
+fingerprint_simhash_add_buffer (fingerprint_simhash_ctx_t* ctx,
+                                const char*                buffer,
+                                int                        size,
+                                int                        weight)
+{
+  fingerprint_simhash_add (ctx, fingerprint_from_buffer (buffer, size),
+                           weight);
+}
+
+fingerprint_t
+fingerprint_simhash_final (const fingerprint_simhash_ctx_t* ctx)
+{
+  fingerprint_t sig;
+  fingerprint_byte_t* b = FINGERPRINT_BYTE (sig);
+  int i;
+
+  memset (b, 0, sizeof (fingerprint_t));
+  for (i = 0; i < 64; ++i)
+    if (ctx->total[i] > 0)
+      b[i >> 3] |= 1 << (i & 7);
+  return sig;
+}
+
+int
+fingerprint_simhash_distance (fingerprint_t sig1, fingerprint_t sig2)
+{
+  word_t h1[2];
+  word_t h2[2];
+
+  simhash_halves (sig1, h1);
+  simhash_halves (sig2, h2);
+  return simhash_popcount (h1[0] ^ h2[0]) + simhash_popcount (h1[1] ^ h2[1]);
+}
+
+fingerprint_simhash_index_t*
+fingerprint_simhash_index_new (int k)
+{
+  fingerprint_simhash_index_t* index;
+  word_t buckets = SIMHASH_MIN_BUCKETS;
+  int b, i;
+
+  if (k < 0 || k >= 64)
+    return NULL;
+
+  index = (fingerprint_simhash_index_t*) calloc (1, sizeof (*index));
+  if (!index)
+    return NULL;
+  index->k = k;
+  index->bands = k + 1;
+
+  /* Band B holds bits 64 * B / BANDS up to 64 * (B + 1) / BANDS.  */
+  for (b = 0; b < index->bands; ++b) {
+    int lo = 64 * b / index->bands;
+    int hi = 64 * (b + 1) / index->bands;
+
+    for (i = lo; i < hi; ++i)
+      index->band[b].mask[i >> 5] |= (word_t) 1 << (i & 31);
+    index->band[b].limit = hi - lo < 32 ? (word_t) 1 << (hi - lo) : 0;
+    if (index->band[b].limit && index->band[b].limit < buckets)
+      buckets = index->band[b].limit;
+  }
+
+  if (!simhash_rehash (index, buckets)) {
+    fingerprint_simhash_index_free (index);
+    return NULL;
+  }
+  return index;
+}
+
+void
+fingerprint_simhash_index_free (fingerprint_simhash_index_t* index)
+{
+  int b;
+
+  if (!index)
+    return;
+  for (b = 0; b < index->bands; ++b)
+    free (index->band[b].heads);
+  free (index->sig);
+  free (index->id);
+  free (index->next);
+  free (index);
+}
+
+int
+fingerprint_simhash_index_add (fingerprint_simhash_index_t* index,
+                               fingerprint_t                sig,
+                               unsigned long                id)
+{
+  int b;
+
+  if (index->count == index->size) {
+    int size = index->size ? 2 * index->size : 1024;
+    word_t* s = (word_t*) realloc (index->sig, 2 * size * sizeof (word_t));
+    unsigned long* d;
+    int* n;
+
+    if (!s)
+      return 0;
+    index->sig = s;
+    d = (unsigned long*) realloc (index->id, size * sizeof (unsigned long));
+    if (!d)
+      return 0;
+    index->id = d;
+    n = (int*) realloc (index->next, size * index->bands * sizeof (int));
+    if (!n)
+      return 0;
+    index->next = n;
+    index->size = size;
+  }
+
+  /* Keep about one signature to a bucket, as far as the values of the
+     narrowest band allow.  */
+  if ((word_t) index->count >= index->buckets) {
+    word_t buckets = 2 * index->buckets;
+
+    for (b = 0; b < index->bands; ++b)
+      if (index->band[b].limit && index->band[b].limit < buckets)
+        buckets = index->band[b].limit;
+    if (buckets > index->buckets && !simhash_rehash (index, buckets))
+      return 0;
+  }
+
+  simhash_halves (sig, &index->sig[2 * index->count]);
+  index->id[index->count] = id;
+  simhash_link (index, index->count);
+  ++index->count;
+  return 1;
+}
+
+int
+fingerprint_simhash_index_query (const fingerprint_simhash_index_t* index,
+                                 fingerprint_t                      sig,
+                                 fingerprint_simhash_fn_t           fn,
+                                 void*                              arg)
+{
+  word_t h[2];
+  int found = 0;
+  int b, c, e;
+
+  simhash_halves (sig, h);
+  for (b = 0; b < index->bands; ++b) {
+    const simhash_band_t* band = &index->band[b];
+
+    for (e = band->heads[simhash_bucket (index, b, h)];
+         e >= 0;
+         e = index->next[e * index->bands + b]) {
+      const word_t* s = &index->sig[2 * e];
+      int distance;
+
+      if (((s[0] ^ h[0]) & band->mask[0])
+          || ((s[1] ^ h[1]) & band->mask[1]))
+        continue;
+      distance = (simhash_popcount (s[0] ^ h[0])
+                  + simhash_popcount (s[1] ^ h[1]));
+      if (distance > index->k)
+        continue;
+
+      /* A signature which agrees with SIG on an earlier band has
+         been reported already.  */
+      for (c = 0; c < b; ++c)
+        if (!((s[0] ^ h[0]) & index->band[c].mask[0])
+            && !((s[1] ^ h[1]) & index->band[c].mask[1]))
+          break;
+      if (c < b)
+        continue;
+
+      fn (arg, index->id[e], distance);
+      ++found;
+    }
+  }
+  return found;
+}
+
+unsigned long
+fingerprint_simhash_index_size (const fingerprint_simhash_index_t* index)
+{
+  return index->count;
+}
@@ -0,0 +1,127 @@
+/***********************************************************************
+
+ File:   simhash.h
+
+ Contents: SimHash signatures and an index for finding near ones.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_SIMHASH_H
+#define FINGERPRINT_SIMHASH_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A SimHash signature summarizes a weighted set of features, such as
+   the words of a document, in 64 bits, so that similar sets have
+   signatures which differ in few bits.  Each feature is fingerprinted,
+   and its fingerprint is mixed so that its bits are evenly spread.
+   For each bit position, the weights of the features with that bit set
+   are added, and the weights of the others subtracted; bit I of the
+   signature is set if the total for position I is positive.
+
+   Signatures are held in fingerprint_t objects, with bit I in bit
+   I MOD 8 of FINGERPRINT_BYTE (SIG)[I / 8].
+
+   A fingerprint_simhash_index_t finds the signatures within a given
+   Hamming distance K of a query.  The 64 bits are cut into K + 1
+   bands; two signatures within distance K agree exactly on at least
+   one band, so each band has a hash table of the signatures with each
+   value of that band, and only the signatures in the buckets of the
+   query are compared with it.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* A fingerprint_simhash_ctx_t accumulates the features of a
+   signature.  The total weight of the features must stay within the
+   range of an int.  */
+
+typedef struct fingerprint_simhash_ctx_t {
+  int           total[64];
+                        /* The sum, over the features, of the weight
+                           of each feature, or its negation if bit I of
+                           the mixed fingerprint is clear.  */
+} fingerprint_simhash_ctx_t;
+
+/* A fingerprint_simhash_index_t holds a set of signatures, each with
+   an identifier.  The type is opaque.  */
+
+typedef struct fingerprint_simhash_index_t fingerprint_simhash_index_t;
+
+/* A fingerprint_simhash_fn_t is called for each signature found by
+   fingerprint_simhash_index_query.  ID is the identifier given when
+   the signature was added, and DISTANCE its distance from the
+   query.  */
+
+typedef void (*fingerprint_simhash_fn_t) (void*         arg,
+                                          unsigned long id,
+                                          int           distance);
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Start CTX on the empty set of features.  */
+extern void fingerprint_simhash_init (fingerprint_simhash_ctx_t* ctx);
+
+/* Add the feature whose fingerprint is FP to CTX, with WEIGHT.  */
+extern void fingerprint_simhash_add (fingerprint_simhash_ctx_t* ctx,
+                                     fingerprint_t              fp,
+                                     int                        weight);
+
+/* Add the feature BUFFER to CTX, with WEIGHT.  */
+extern void fingerprint_simhash_add_buffer
+                        (fingerprint_simhash_ctx_t* ctx,
+                         const char*                buffer,
+                         int                        size,
+                         int                        weight);
+
+/* Return the signature of the features of CTX.  */
+extern fingerprint_t fingerprint_simhash_final
+                        (const fingerprint_simhash_ctx_t* ctx);
+
+/* Return the number of bits in which SIG1 and SIG2 differ.  */
+extern int fingerprint_simhash_distance (fingerprint_t sig1,
+                                         fingerprint_t sig2);
+
+/* Return a new, empty index for finding signatures within distance
+   K, which must be below 64, of a query.  Return NULL if K is out of
+   range, or if memory is exhausted.  */
+extern fingerprint_simhash_index_t* fingerprint_simhash_index_new (int k);
+
+/* Release INDEX.  */
+extern void fingerprint_simhash_index_free
+                        (fingerprint_simhash_index_t* index);
+
+/* Add SIG to INDEX, with identifier ID.  Return zero if memory is
+   exhausted, and non-zero otherwise.  */
+extern int fingerprint_simhash_index_add (fingerprint_simhash_index_t* index,
+                                          fingerprint_t                sig,
+                                          unsigned long                id);
+
+/* Call FN (ARG, ...) once for each signature of INDEX within distance
+   K of SIG, and return the number of calls.  */
+extern int fingerprint_simhash_index_query
+                        (const fingerprint_simhash_index_t* index,
+                         fingerprint_t                      sig,
+                         fingerprint_simhash_fn_t           fn,
+                         void*                              arg);
+
+/* Return the number of signatures in INDEX.  */
+extern unsigned long fingerprint_simhash_index_size
+                        (const fingerprint_simhash_index_t* index);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_SIMHASH_H */
@@ -0,0 +1,353 @@
+/***********************************************************************
+
+ File:   sketch.c
+
+ Contents: MinHash sketches of the shingles of a text.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "sketch.h"
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* SKETCH_BLOCK is the number of bytes whose shingle fingerprints are
+   computed at a time.  */
+
+#define SKETCH_BLOCK 1024
+
+/* SKETCH_MAX_BINS is the largest K for a K-permutation sketch; the
+   bin of a value is taken from its high 16 bits.  */
+
+#define SKETCH_MAX_BINS 65536
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+struct fingerprint_sketch_t {
+  fingerprint_sketch_kind_t
+                kind;   /* The kind of sketch.  */
+  int           k;      /* The number of values.  */
+  int           shingle;
+                        /* The length of a shingle.  */
+  const fingerprint_basis_t*
+                basis;  /* The basis of the fingerprints.  */
+  fingerprint_roller_t*
+                roller; /* The fingerprint of the current shingle.  */
+  unsigned long length; /* The number of bytes in the text so far.  */
+  fingerprint_word_t*
+                value;  /* For a bottom-K sketch, the candidates for
+                           the K smallest values, of which there is room
+                           for 2K; for a K-permutation sketch, the
+                           smallest value in each bin.  */
+  int           count;  /* For a bottom-K sketch, the number of
+                           candidates; for a K-permutation sketch,
+                           non-zero if any shingle has been seen.  */
+  fingerprint_word_t
+                limit;  /* For a bottom-K sketch with K values, the
+                           largest of them; no larger value can enter
+                           the sketch.  */
+  int           full;   /* Non-zero if LIMIT is valid.  */
+  unsigned char*
+                filled; /* For a K-permutation sketch, whether each bin
+                           has a value.  */
+  fingerprint_t window[SKETCH_BLOCK];
+                        /* The shingle fingerprints of a block.  */
+};
+
+/***********************************************************************
+  Static Functions
+***********************************************************************/
+
+/* Return the value of the shingle whose fingerprint is FP.  The
+   fingerprint of a shingle of eight bytes or less is little more than
+   the bytes themselves, so its bits are mixed thoroughly.  */
+
+static fingerprint_word_t
+sketch_value (const fingerprint_t* fp)
+{
+  fingerprint_word_t half[2];
+  fingerprint_word_t v;
+
+  memcpy (half, FINGERPRINT_BYTE (*fp), sizeof (half));
+  v = half[0] ^ (half[1] * 0x85ebca6bU);
+  v ^= v >> 16;
+  v *= 0xc2b2ae35U;
+  v ^= v >> 13;
+  v *= 0x846ca68bU;
+  return v ^ (v >> 16);
+}
+
+/* Order two values.  */
+
+static int
+sketch_compare (const void* a, const void* b)
+{
+  fingerprint_word_t v1 = *(const fingerprint_word_t*) a;
+  fingerprint_word_t v2 = *(const fingerprint_word_t*) b;
+
+  return v1 < v2 ? -1 : v1 > v2;
+}
+
+/* Reduce the candidates of the bottom-K sketch SKETCH to at most K
+   distinct values, in increasing order.  */
+
+static void
+sketch_compact (fingerprint_sketch_t* sketch)
+{
+  int i, n = 0;
+
+  qsort (sketch->value, sketch->count, sizeof (fingerprint_word_t),
+         sketch_compare);
+  for (i = 0; i < sketch->count && n < sketch->k; ++i)
+    if (n == 0 || sketch->value[i] != sketch->value[n - 1])
+      sketch->value[n++] = sketch->value[i];
+  sketch->count = n;
+  if (n == sketch->k) {
+    sketch->limit = sketch->value[n - 1];
+    sketch->full = 1;
+  }
+}
+
+/* Add the SIZE shingle fingerprints in WINDOW to the bottom-K sketch
+   SKETCH.  Once the sketch is full, few values are below its limit,
+   so most are dismissed with a single comparison.  */
+
+static void
+sketch_add_bottom_k (fingerprint_sketch_t* sketch,
+                     const fingerprint_t*  window,
+                     int                   size)
+{
+  int i;
+
+  for (i = 0; i < size; ++i) {
+    fingerprint_word_t v = sketch_value (&window[i]);
+
+    if (sketch->full && v >= sketch->limit)
+      continue;
+    sketch->value[sketch->count++] = v;
+    if (sketch->count == 2 * sketch->k)
+      sketch_compact (sketch);
+  }
+}
+
+/* Add the SIZE shingle fingerprints in WINDOW to the K-permutation
+   sketch SKETCH.  */
+
+static void
+sketch_add_k_perm (fingerprint_sketch_t* sketch,
+                   const fingerprint_t*  window,
+                   int                   size)
+{
+  fingerprint_word_t k = sketch->k;
+  int i;
+
+  for (i = 0; i < size; ++i) {
+    fingerprint_word_t v = sketch_value (&window[i]);
+    fingerprint_word_t bin = ((v >> 16) * k) >> 16;
+
+    if (!sketch->filled[bin] || v < sketch->value[bin]) {
+      sketch->value[bin] = v;
+      sketch->filled[bin] = 1;
+    }
+  }
+  if (size > 0)
+    sketch->count = 1;
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_sketch_t*
+fingerprint_sketch_new (const fingerprint_basis_t* basis,
+                        int                        shingle,
+                        int                        k,
+                        fingerprint_sketch_kind_t  kind)
+{
+  fingerprint_sketch_t* sketch;
+
+  if (shingle <= 0 || k <= 0
+      || (kind == FINGERPRINT_SKETCH_K_PERM && k > SKETCH_MAX_BINS))
+    return NULL;
+
+  sketch = (fingerprint_sketch_t*) calloc (1, sizeof (*sketch));
+  if (!sketch)
+    return NULL;
+  sketch->kind = kind;
+  sketch->k = k;
+  sketch->shingle = shingle;
+  sketch->basis = basis;
+  sketch->roller = fingerprint_roller_new (basis, shingle);
+  if (kind == FINGERPRINT_SKETCH_BOTTOM_K)
+    sketch->value = (fingerprint_word_t*)
+      malloc (2 * k * sizeof (fingerprint_word_t));
+  else {
+    sketch->value = (fingerprint_word_t*)
+      malloc (k * sizeof (fingerprint_word_t));
+    sketch->filled = (unsigned char*) malloc (k);
+  }
+  if (!sketch->roller || !sketch->value
+      || (kind == FINGERPRINT_SKETCH_K_PERM && !sketch->filled)) {
+    fingerprint_sketch_free (sketch);
+    return NULL;
+  }
+
+  fingerprint_sketch_reset (sketch);
+  return sketch;
+}
+
+void
+fingerprint_sketch_free (fingerprint_sketch_t* sketch)
+{
+  if (!sketch)
+    return;
+  fingerprint_roller_free (sketch->roller);
+  free (sketch->value);
+  free (sketch->filled);
+  free (sketch);
+}
+
+void
+fingerprint_sketch_reset (fingerprint_sketch_t* sketch)
+{
+  fingerprint_roller_reset (sketch->roller);
+  sketch->length = 0;
+  sketch->count = 0;
+  sketch->full = 0;
+  if (sketch->filled)
+    memset (sketch->filled, 0, sketch->k);
+}
+
+void
+fingerprint_sketch_update (fingerprint_sketch_t* sketch,
+                           const char*           buffer,
+                           int                   size)
+{
+  int at;
+
+  for (at = 0; at < size; at += SKETCH_BLOCK) {
+    int n = size - at < SKETCH_BLOCK ? size - at : SKETCH_BLOCK;
+    int i = 0;
+
+    fingerprint_roller_update (sketch->roller, buffer + at, n,
+                               sketch->window);
+
+    /* The windows before the first full shingle are not shingles.  */
+    if (sketch->length + 1 < (unsigned long) sketch->shingle)
+      i = sketch->shingle - 1 - sketch->length;
+    sketch->length += n;
+    if (i >= n)
+      continue;
+
+    if (sketch->kind == FINGERPRINT_SKETCH_BOTTOM_K)
+      sketch_add_bottom_k (sketch, sketch->window + i, n - i);
+    else
+      sketch_add_k_perm (sketch, sketch->window + i, n - i);
+  }
+}
+
+int
+fingerprint_sketch_k (const fingerprint_sketch_t* sketch)
+{
+  return sketch->k;
+}
+
+int
+fingerprint_sketch_values (fingerprint_sketch_t* sketch,
+                           fingerprint_word_t*   out)
+{
+  fingerprint_word_t carry;
+  int f, i, j;
+
+  if (sketch->kind == FINGERPRINT_SKETCH_BOTTOM_K) {
+    sketch_compact (sketch);
+    memcpy (out, sketch->value, sketch->count * sizeof (fingerprint_word_t));
+    return sketch->count;
+  }
+
+  if (sketch->count == 0)
+    return 0;
+
+  /* Each empty bin takes the value of the next bin, cyclically, that
+     is not empty.  The bins are visited backwards from a full one, so
+     that the value to take is always at hand.  */
+  for (f = 0; !sketch->filled[f]; ++f)
+    ;
+  carry = sketch->value[f];
+  for (j = 0; j < sketch->k; ++j) {
+    i = (f + sketch->k - j) % sketch->k;
+    if (sketch->filled[i])
+      carry = sketch->value[i];
+    out[i] = carry;
+  }
+  return sketch->k;
+}
+
+double
+fingerprint_sketch_estimate (fingerprint_sketch_kind_t kind,
+                             int                       k,
+                             const fingerprint_word_t* a,
+                             int                       na,
+                             const fingerprint_word_t* b,
+                             int                       nb)
+{
+  int i = 0, j = 0, n = 0, common = 0;
+
+  /* Two texts without shingles are taken to be alike.  */
+  if (na == 0 || nb == 0)
+    return na == nb ? 1.0 : 0.0;
+
+  if (kind == FINGERPRINT_SKETCH_K_PERM) {
+    for (i = 0; i < k; ++i)
+      common += a[i] == b[i];
+    return (double) common / k;
+  }
+
+  /* Walk the K smallest values of the union.  */
+  while (n < k && (i < na || j < nb)) {
+    if (j == nb || (i < na && a[i] < b[j]))
+      ++i;
+    else if (i == na || b[j] < a[i])
+      ++j;
+    else {
+      ++i;
+      ++j;
+      ++common;
+    }
+    ++n;
+  }
+  return (double) common / n;
+}
+
+double
+fingerprint_sketch_jaccard (fingerprint_sketch_t* s1,
+                            fingerprint_sketch_t* s2)
+{
+  fingerprint_word_t* a;
+  fingerprint_word_t* b;
+  double result;
+  int na, nb;
+
+  if (s1->kind != s2->kind || s1->k != s2->k
+      || s1->shingle != s2->shingle || s1->basis != s2->basis)
+    return -1;
+
+  a = (fingerprint_word_t*) malloc (2 * s1->k * sizeof (fingerprint_word_t));
+  if (!a)
+    return -1;
+  b = a + s1->k;
+  na = fingerprint_sketch_values (s1, a);
+  nb = fingerprint_sketch_values (s2, b);
+  result = fingerprint_sketch_estimate (s1->kind, s1->k, a, na, b, nb);
+  free (a);
+  return result;
+}
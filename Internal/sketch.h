@@ -0,0 +1,123 @@
+/***********************************************************************
+
+ File:   sketch.h
+
+ Contents: MinHash sketches of the shingles of a text.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_SKETCH_H
+#define FINGERPRINT_SKETCH_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* The shingles of a text are its substrings of some fixed length.  Two
+   texts are similar if their sets of shingles are; the usual measure
+   is the Jaccard index, the size of the intersection of the sets over
+   the size of their union.  A sketch is a small signature of the set of
+   shingles of a text, from which the Jaccard index of two texts can be
+   estimated without the texts themselves.
+
+   Each shingle is fingerprinted with a fingerprint_roller_t, and the
+   fingerprint is mixed down to a 32-bit value, so that the text is
+   read only once.  Two kinds of sketch are provided:
+
+     FINGERPRINT_SKETCH_BOTTOM_K
+
+       The sketch is the K smallest distinct values.  The estimate is
+       the fraction of the K smallest values of the union of two
+       sketches that are in both.
+
+     FINGERPRINT_SKETCH_K_PERM
+
+       The values are split into K bins by their high bits, and the
+       sketch holds the smallest value in each bin; this stands for K
+       separate permutations at the cost of one.  Empty bins borrow
+       the value of the next bin that is not empty.  The estimate is
+       the fraction of the bins whose values agree.
+
+   Sketches can only be compared if they were made with the same kind,
+   K, shingle length and basis.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* A fingerprint_sketch_kind_t selects the kind of a sketch.  */
+
+typedef enum fingerprint_sketch_kind_t {
+  FINGERPRINT_SKETCH_BOTTOM_K,
+  FINGERPRINT_SKETCH_K_PERM
+} fingerprint_sketch_kind_t;
+
+/* A fingerprint_sketch_t accumulates the sketch of a text which is
+   presented in pieces.  The type is opaque.  */
+
+typedef struct fingerprint_sketch_t fingerprint_sketch_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Return a new sketch of kind KIND, of K values, for shingles of
+   SHINGLE bytes fingerprinted with respect to BASIS.  Return NULL if
+   K or SHINGLE is not positive, or if memory is exhausted.  */
+extern fingerprint_sketch_t* fingerprint_sketch_new
+                        (const fingerprint_basis_t* basis,
+                         int                        shingle,
+                         int                        k,
+                         fingerprint_sketch_kind_t  kind);
+
+/* Release SKETCH.  */
+extern void fingerprint_sketch_free (fingerprint_sketch_t* sketch);
+
+/* Return SKETCH to the empty text.  */
+extern void fingerprint_sketch_reset (fingerprint_sketch_t* sketch);
+
+/* Append BUFFER to the text of SKETCH.  */
+extern void fingerprint_sketch_update (fingerprint_sketch_t* sketch,
+                                       const char*           buffer,
+                                       int                   size);
+
+/* Return the number K of values of SKETCH: the most that
+   fingerprint_sketch_values stores.  */
+extern int fingerprint_sketch_k (const fingerprint_sketch_t* sketch);
+
+/* Store the values of SKETCH in OUT, which has room for K values, and
+   return their number.  A bottom-K sketch has fewer than K values if
+   the text has fewer than K distinct shingles; its values are stored
+   in increasing order.  A K-permutation sketch has K values, or none
+   if the text is shorter than one shingle.  */
+extern int fingerprint_sketch_values (fingerprint_sketch_t* sketch,
+                                      fingerprint_word_t*   out);
+
+/* Return the estimate of the Jaccard index of the texts whose sketches
+   of kind KIND and K values are A, of NA values, and B, of NB values,
+   as returned by fingerprint_sketch_values.  */
+extern double fingerprint_sketch_estimate
+                        (fingerprint_sketch_kind_t kind,
+                         int                       k,
+                         const fingerprint_word_t* a,
+                         int                       na,
+                         const fingerprint_word_t* b,
+                         int                       nb);
+
+/* Return the estimate of the Jaccard index of the texts of S1 and S2.
+   Return -1 if the sketches cannot be compared, or if memory is
+   exhausted.  */
+extern double fingerprint_sketch_jaccard (fingerprint_sketch_t* s1,
+                                          fingerprint_sketch_t* s2);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_SKETCH_H */
@@ -0,0 +1,1236 @@
+/***********************************************************************
+
+ File:   store.c
+
+ Contents: A store of chunks addressed by their fingerprints.
+
+***********************************************************************/
+
+/***********************************************************************
+  Included Files
+***********************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "store.h"
+
+/* STORE_MMAP is 1 if packs can be mapped into memory.  */
+
+#if defined(__unix__) || defined(__unix) || defined(unix) \
+    || (defined(__APPLE__) && defined(__MACH__))
+#define STORE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else /* !(defined(__unix__) || ...) */
+#define STORE_MMAP 0
+#endif /* defined(__unix__) || ... */
+
+/* STORE_THREADS is 1 if a store has locks.  */
+
+#if !defined(FINGERPRINT_NO_THREADS) && !defined(_WIN32)
+#define STORE_THREADS 1
+#include <pthread.h>
+#else /* !(!defined(FINGERPRINT_NO_THREADS) && ...) */
+#define STORE_THREADS 0
+#endif /* !defined(FINGERPRINT_NO_THREADS) && ... */
+
+/***********************************************************************
+  Macros
+***********************************************************************/
+
+/* STORE_MAGIC starts the CATALOG, and STORE_PACK_MAGIC each pack.  */
+
+#define STORE_MAGIC "FPSTORE1"
+#define STORE_PACK_MAGIC "FPPACK01"
+
+/* STORE_START is the offset of the first record of a pack, and
+   STORE_HEADER the size of the header of a record: the fingerprint,
+   then the length as eight bytes.  STORE_ENTRY is the size of a record
+   of the CATALOG: the fingerprint, then the pack, offset, length and
+   references as eight bytes each.  */
+
+#define STORE_START 8
+#define STORE_HEADER 16
+#define STORE_ENTRY 40
+
+/* STORE_PACK_SIZE is the size at which a pack is full, and the size of
+   the mapping made for a new pack, which covers it as it grows.  A
+   chunk too large for this is given a pack of its own.  */
+
+#define STORE_PACK_SIZE (64UL << 20)
+
+/* STORE_BATCH is the number of new chunks gathered before they are
+   added to the table.  */
+
+#define STORE_BATCH 256
+
+/* STORE_PIECE is the most given to fingerprint_ctx_update at once.  */
+
+#define STORE_PIECE 0x40000000UL
+
+#if STORE_THREADS
+#define STORE_LOCK(store, lock) pthread_mutex_lock (&(store)->lock)
+#define STORE_UNLOCK(store, lock) pthread_mutex_unlock (&(store)->lock)
+#define STORE_READ(store) pthread_rwlock_rdlock (&(store)->table_lock)
+#define STORE_WRITE(store) pthread_rwlock_wrlock (&(store)->table_lock)
+#define STORE_DONE(store) pthread_rwlock_unlock (&(store)->table_lock)
+#else /* !STORE_THREADS */
+#define STORE_LOCK(store, lock) ((void) 0)
+#define STORE_UNLOCK(store, lock) ((void) 0)
+#define STORE_READ(store) ((void) 0)
+#define STORE_WRITE(store) ((void) 0)
+#define STORE_DONE(store) ((void) 0)
+#endif /* STORE_THREADS */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+typedef fingerprint_byte_t byte_t;
+
+/* A store_pack_t is a pack.  */
+
+typedef struct store_pack_t {
+  unsigned long id;     /* The number in the name of the file.  */
+  char*         path;   /* The name of the file.  */
+  const byte_t* base;   /* The mapping of the file, or NULL if it is
+                           read instead.  */
+  size_t        mapped; /* The length of the mapping.  */
+  unsigned long limit;  /* The size at which the pack is full.  */
+  unsigned long size;   /* The number of bytes written.  */
+  unsigned long live;   /* The number of bytes in records of chunks in
+                           the table.  */
+  unsigned long pins;   /* The number of views of the pack.  */
+  int           retired;
+                        /* Non-zero once the pack has left the store.  */
+  int           doomed; /* Non-zero if the file is to be removed when
+                           the pack is released.  */
+} store_pack_t;
+
+/* A store_entry_t is a chunk in the table.  A slot of the table whose
+   PACK is NULL is empty.  */
+
+typedef struct store_entry_t {
+  byte_t        key[8]; /* The bytes of the fingerprint.  */
+  store_pack_t* pack;
+  unsigned long offset; /* The offset of the bytes of the chunk.  */
+  unsigned long length;
+  unsigned long refs;   /* The number of references.  */
+} store_entry_t;
+
+/* A store_batch_t is a chunk waiting to be added to the table.  */
+
+typedef struct store_batch_t {
+  store_entry_t entry;
+  store_pack_t* from;   /* For a chunk moved by compaction, its old
+                           pack; otherwise, NULL.  */
+  unsigned long from_offset;
+                        /* For a chunk moved by compaction, its old
+                           offset.  */
+} store_batch_t;
+
+struct fingerprint_store_t {
+  char*         dir;    /* The directory of the store.  */
+  const fingerprint_basis_t*
+                basis;
+#if STORE_THREADS
+  pthread_mutex_t
+                write_lock;
+                        /* Taken by writers in turn; guards ACTIVE,
+                           FILE, NEXT and the sizes of packs.  */
+  pthread_mutex_t
+                batch_lock;
+                        /* Guards BATCH.  */
+  pthread_rwlock_t
+                table_lock;
+                        /* Guards the table and PACK.  */
+  pthread_mutex_t
+                pin_lock;
+                        /* Guards the pins of packs, VIEWS and
+                           CLOSED.  */
+#endif /* STORE_THREADS */
+  int           locks;  /* The number of locks made.  */
+  store_pack_t* active; /* The pack being written, or NULL.  */
+  FILE*         file;   /* The file of ACTIVE.  */
+  unsigned long next;   /* The number for the next pack.  */
+  store_pack_t**
+                pack;   /* The packs, oldest first.  */
+  unsigned long packs;  /* The number of packs.  */
+  unsigned long room;   /* The number of packs there is room for.  */
+  store_entry_t*
+                slot;   /* The table, with linear probing.  */
+  unsigned long mask;   /* The number of slots less one.  */
+  unsigned long count;  /* The number of chunks in the table.  */
+  store_batch_t batch[STORE_BATCH];
+                        /* The chunks waiting for the table.  */
+  int           batched;
+                        /* The number of chunks in BATCH.  */
+  unsigned long views;  /* The number of views.  */
+  int           closed; /* Non-zero once the store has been closed.  */
+};
+
+/***********************************************************************
+  Static Functions: Encoding and Files
+***********************************************************************/
+
+static void
+store_put64 (byte_t* b, unsigned long x)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    b[i] = (byte_t) (x & 0xff);
+    x >>= 8;
+  }
+}
+
+static unsigned long
+store_get64 (const byte_t* b)
+{
+  unsigned long x = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i)
+    x = (x << 8) | b[i];
+  return x;
+}
+
+/* Return the name of file NAME within the directory of STORE, or NULL
+   if memory is exhausted.  The caller must free the result.  */
+
+static char*
+store_path (const fingerprint_store_t* store, const char* name)
+{
+  char* path = (char*) malloc (strlen (store->dir) + strlen (name) + 2);
+
+  if (path)
+    sprintf (path, "%s/%s", store->dir, name);
+  return path;
+}
+
+/* Return the fingerprint of the SIZE bytes of BUFFER.  */
+
+static fingerprint_t
+store_fingerprint (const fingerprint_store_t* store,
+                   const char*                buffer,
+                   unsigned long              size)
+{
+  fingerprint_ctx_t ctx;
+
+  if (size <= STORE_PIECE)
+    return fingerprint_basis_from_buffer (store->basis, buffer, (int) size);
+  fingerprint_ctx_init (&ctx, store->basis);
+  while (size > 0) {
+    unsigned long n = size < STORE_PIECE ? size : STORE_PIECE;
+
+    fingerprint_ctx_update (&ctx, buffer, (int) n);
+    buffer += n;
+    size -= n;
+  }
+  return fingerprint_ctx_final (&ctx);
+}
+
+/***********************************************************************
+  Static Functions: Packs
+***********************************************************************/
+
+/* Make a pack of file ID of STORE, which is full at LIMIT bytes, and
+   map LENGTH bytes of its file, if the system allows.  Return NULL if
+   memory is exhausted.  */
+
+static store_pack_t*
+store_pack_make (const fingerprint_store_t* store,
+                 unsigned long              id,
+                 unsigned long              limit,
+                 unsigned long              length)
+{
+  store_pack_t* pack = (store_pack_t*) calloc (1, sizeof (*pack));
+  char name[64];
+
+  if (!pack)
+    return NULL;
+  sprintf (name, "%08lu.pack", id);
+  pack->path = store_path (store, name);
+  if (!pack->path) {
+    free (pack);
+    return NULL;
+  }
+  pack->id = id;
+  pack->limit = limit;
+
+#if STORE_MMAP
+  {
+    int fd = open (pack->path, O_RDONLY);
+
+    if (fd >= 0) {
+      void* p = mmap (NULL, (size_t) length, PROT_READ, MAP_SHARED,
+                      fd, 0);
+
+      if (p != MAP_FAILED) {
+        pack->base = (const byte_t*) p;
+        pack->mapped = (size_t) length;
+      }
+      close (fd);
+    }
+  }
+#else /* !STORE_MMAP */
+  (void) length;
+#endif /* STORE_MMAP */
+  return pack;
+}
+
+/* Release PACK, and remove its file if it is doomed.  */
+
+static void
+store_pack_free (store_pack_t* pack)
+{
+#if STORE_MMAP
+  if (pack->base)
+    munmap ((void*) pack->base, pack->mapped);
+#endif /* STORE_MMAP */
+  if (pack->doomed)
+    remove (pack->path);
+  free (pack->path);
+  free (pack);
+}
+
+/* Retire PACK from STORE, releasing it unless it has views, in which
+   case the last view releases it.  */
+
+static void
+store_pack_retire (fingerprint_store_t* store, store_pack_t* pack)
+{
+  int idle;
+
+  STORE_LOCK (store, pin_lock);
+  pack->retired = 1;
+  idle = pack->pins == 0;
+  STORE_UNLOCK (store, pin_lock);
+  if (idle)
+    store_pack_free (pack);
+}
+
+/* Return the LENGTH bytes at OFFSET in PACK.  If PACK is not mapped,
+   they are read into memory, which is stored in *COPY and must be
+   freed by the caller; otherwise, *COPY is set to NULL.  Return NULL
+   on failure.  */
+
+static const byte_t*
+store_pack_read (const store_pack_t* pack,
+                 unsigned long       offset,
+                 unsigned long       length,
+                 byte_t**            copy)
+{
+  FILE* file;
+  byte_t* b;
+
+  *copy = NULL;
+  if (pack->base)
+    return pack->base + offset;
+  b = (byte_t*) malloc (length ? length : 1);
+  if (!b)
+    return NULL;
+  file = fopen (pack->path, "rb");
+  if (!file || fseek (file, (long) offset, SEEK_SET) != 0
+      || fread (b, 1, length, file) != length) {
+    if (file)
+      fclose (file);
+    free (b);
+    errno = EIO;
+    return NULL;
+  }
+  fclose (file);
+  *copy = b;
+  return b;
+}
+
+/* Add PACK to the packs of STORE.  Return zero if memory is
+   exhausted.  */
+
+static int
+store_pack_add (fingerprint_store_t* store, store_pack_t* pack)
+{
+  if (store->packs == store->room) {
+    unsigned long room = store->room ? 2 * store->room : 16;
+    store_pack_t** p = (store_pack_t**)
+      realloc (store->pack, room * sizeof (store_pack_t*));
+
+    if (!p)
+      return 0;
+    store->pack = p;
+    store->room = room;
+  }
+  store->pack[store->packs++] = pack;
+  return 1;
+}
+
+/* Finish the pack being written by STORE, if there is one.  Return zero
+   if it cannot be written.  */
+
+static int
+store_seal (fingerprint_store_t* store)
+{
+  int ok = 1;
+
+  if (!store->file)
+    return 1;
+  ok = fflush (store->file) == 0;
+#if STORE_MMAP
+  ok = ok && fsync (fileno (store->file)) == 0;
+#endif /* STORE_MMAP */
+  ok = fclose (store->file) == 0 && ok;
+  store->file = NULL;
+  store->active = NULL;
+  return ok;
+}
+
+/* Begin a new pack for STORE with room for at least NEED bytes of
+   records.  Return zero on failure.  */
+
+static int
+store_begin (fingerprint_store_t* store, unsigned long need)
+{
+  unsigned long limit = STORE_START + need;
+  store_pack_t* pack;
+  FILE* file;
+  char name[64];
+  char* path;
+  int ok;
+
+  if (limit < need) {
+    errno = EFBIG;
+    return 0;
+  }
+  if (limit < STORE_PACK_SIZE)
+    limit = STORE_PACK_SIZE;
+  if (!store_seal (store))
+    return 0;
+
+  sprintf (name, "%08lu.pack", store->next);
+  path = store_path (store, name);
+  file = path ? fopen (path, "wb") : NULL;
+  free (path);
+  if (!file)
+    return 0;
+  if (fwrite (STORE_PACK_MAGIC, 1, STORE_START, file) != STORE_START
+      || fflush (file) != 0) {
+    fclose (file);
+    return 0;
+  }
+  pack = store_pack_make (store, store->next, limit, limit);
+  if (!pack) {
+    fclose (file);
+    return 0;
+  }
+  pack->size = STORE_START;
+
+  STORE_WRITE (store);
+  ok = store_pack_add (store, pack);
+  STORE_DONE (store);
+  if (!ok) {
+    fclose (file);
+    store_pack_free (pack);
+    return 0;
+  }
+  ++store->next;
+  store->active = pack;
+  store->file = file;
+  return 1;
+}
+
+/* Append a record of the LENGTH bytes of DATA, with fingerprint KEY,
+   to the pack being written by STORE, and store the pack and offset of
+   the bytes in *PACK and *OFFSET.  Return zero on failure.  */
+
+static int
+store_append (fingerprint_store_t* store,
+              const byte_t*        key,
+              const void*          data,
+              unsigned long        length,
+              store_pack_t**       pack,
+              unsigned long*       offset)
+{
+  unsigned long need = STORE_HEADER + length;
+  byte_t header[STORE_HEADER];
+  store_pack_t* active = store->active;
+
+  if (need < length) {
+    errno = EFBIG;
+    return 0;
+  }
+  if (!active || need > active->limit - active->size) {
+    if (!store_begin (store, need))
+      return 0;
+    active = store->active;
+  }
+  memcpy (header, key, 8);
+  store_put64 (header + 8, length);
+  if (fwrite (header, 1, STORE_HEADER, store->file) != STORE_HEADER
+      || fwrite (data, 1, length, store->file) != length
+      || fflush (store->file) != 0) {
+    /* What was written is past the size of the pack, so it will be
+       ignored; start a new pack next time.  */
+    active->limit = active->size;
+    return 0;
+  }
+  *pack = active;
+  *offset = active->size + STORE_HEADER;
+  active->size += need;
+  return 1;
+}
+
+/***********************************************************************
+  Static Functions: The Table
+***********************************************************************/
+
+/* Return the home slot of KEY in a table of MASK + 1 slots.  */
+
+static unsigned long
+store_hash (const byte_t* key, unsigned long mask)
+{
+  unsigned int h;
+
+  memcpy (&h, key, sizeof (h));
+  h ^= (unsigned int) key[4] << 24 | key[5] << 16 | key[6] << 8 | key[7];
+  h *= 0x9e3779b1U;
+  return (unsigned long) h & mask;
+}
+
+/* Return the slot of KEY in the table of STORE: either that of its
+   chunk, or the empty slot where it would go.  */
+
+static store_entry_t*
+store_find (const fingerprint_store_t* store, const byte_t* key)
+{
+  unsigned long mask = store->mask;
+  unsigned long s;
+
+  for (s = store_hash (key, mask);
+       store->slot[s].pack && memcmp (store->slot[s].key, key, 8) != 0;
+       s = (s + 1) & mask)
+    ;
+  return &store->slot[s];
+}
+
+/* Make room in the table of STORE for N more chunks, keeping it no
+   more than three quarters full.  Return zero if memory is
+   exhausted.  */
+
+static int
+store_reserve (fingerprint_store_t* store, unsigned long n)
+{
+  unsigned long mask = store->slot ? store->mask : 255;
+  unsigned long old_mask = store->mask;
+  store_entry_t* old = store->slot;
+  unsigned long i;
+
+  while (4 * (store->count + n) > 3 * (mask + 1))
+    mask = 2 * mask + 1;
+  if (old && mask == old_mask)
+    return 1;
+  store->slot = (store_entry_t*) calloc (mask + 1, sizeof (store_entry_t));
+  if (!store->slot) {
+    store->slot = old;
+    return 0;
+  }
+  store->mask = mask;
+  for (i = 0; old && i <= old_mask; ++i)
+    if (old[i].pack)
+      *store_find (store, old[i].key) = old[i];
+  free (old);
+  return 1;
+}
+
+/* Remove the chunk in slot E of the table of STORE, moving later
+   chunks of its run back so that none is cut off from its home.  */
+
+static void
+store_remove (fingerprint_store_t* store, store_entry_t* e)
+{
+  unsigned long mask = store->mask;
+  unsigned long i = (unsigned long) (e - store->slot);
+  unsigned long j = i;
+
+  e->pack->live -= STORE_HEADER + e->length;
+  --store->count;
+  for (;;) {
+    unsigned long home;
+
+    store->slot[i].pack = NULL;
+    do {
+      j = (j + 1) & mask;
+      if (!store->slot[j].pack)
+        return;
+      home = store_hash (store->slot[j].key, mask);
+    } while (i <= j ? i < home && home <= j : i < home || home <= j);
+    store->slot[i] = store->slot[j];
+    i = j;
+  }
+}
+
+/* Add the chunks in the batch of STORE to its table, whose batch lock
+   must be held.  Return zero if memory is exhausted.  */
+
+static int
+store_apply (fingerprint_store_t* store)
+{
+  int i;
+
+  if (store->batched == 0)
+    return 1;
+  STORE_WRITE (store);
+  if (!store_reserve (store, store->batched)) {
+    STORE_DONE (store);
+    errno = ENOMEM;
+    return 0;
+  }
+  for (i = 0; i < store->batched; ++i) {
+    const store_batch_t* b = &store->batch[i];
+    store_entry_t* e = store_find (store, b->entry.key);
+
+    if (!b->from) {
+      *e = b->entry;
+      ++store->count;
+    } else if (e->pack == b->from && e->offset == b->from_offset) {
+      /* The chunk is still in the table where compaction found it,
+         so it moves; if not, the copy is dead.  */
+      e->pack->live -= STORE_HEADER + e->length;
+      e->pack = b->entry.pack;
+      e->offset = b->entry.offset;
+    } else
+      continue;
+    e->pack->live += STORE_HEADER + e->length;
+  }
+  STORE_DONE (store);
+  store->batched = 0;
+  return 1;
+}
+
+/* Add the chunks in the batch of STORE to its table.  Return zero if
+   memory is exhausted.  */
+
+static int
+store_publish (fingerprint_store_t* store)
+{
+  int ok;
+
+  STORE_LOCK (store, batch_lock);
+  ok = store_apply (store);
+  STORE_UNLOCK (store, batch_lock);
+  return ok;
+}
+
+/* Add B to the batch of STORE, adding the batch to the table first if
+   it is full.  Return zero if memory is exhausted.  */
+
+static int
+store_batch (fingerprint_store_t* store, const store_batch_t* b)
+{
+  int ok = 1;
+
+  STORE_LOCK (store, batch_lock);
+  if (store->batched == STORE_BATCH)
+    ok = store_apply (store);
+  if (ok)
+    store->batch[store->batched++] = *b;
+  STORE_UNLOCK (store, batch_lock);
+  return ok;
+}
+
+/* Add DELTA to the references to the chunk KEY of STORE, forgetting it
+   if none are left, and return the number left, or -1 if it is not
+   there.  */
+
+static long
+store_adjust (fingerprint_store_t* store, const byte_t* key, int delta)
+{
+  long refs = -1;
+  int pass;
+
+  for (pass = 0; pass < 2 && refs < 0; ++pass) {
+    store_entry_t* e;
+
+    /* A chunk not in the table may be waiting in the batch.  */
+    if (pass > 0 && !store_publish (store))
+      break;
+    STORE_WRITE (store);
+    e = store_find (store, key);
+    if (e->pack) {
+      e->refs += delta;
+      refs = (long) e->refs;
+      if (e->refs == 0)
+        store_remove (store, e);
+    }
+    STORE_DONE (store);
+  }
+  return refs;
+}
+
+/* Write the CATALOG of STORE, whose write lock must be held, from the
+   packs and table, which must not change meanwhile.  Return zero on
+   failure.  */
+
+static int
+store_write_catalog (fingerprint_store_t* store)
+{
+  char* tmp = store_path (store, "CATALOG.tmp");
+  char* path = store_path (store, "CATALOG");
+  fingerprint_t poly = fingerprint_basis_poly (store->basis);
+  byte_t b[STORE_ENTRY];
+  FILE* file = NULL;
+  unsigned long i;
+  int ok = 0;
+
+  if (tmp && path && (file = fopen (tmp, "wb")) != NULL) {
+    memcpy (b, STORE_MAGIC, 8);
+    memcpy (b + 8, FINGERPRINT_BYTE (poly), 8);
+    store_put64 (b + 16, store->next);
+    store_put64 (b + 24, store->packs);
+    ok = fwrite (b, 1, 32, file) == 32;
+    for (i = 0; ok && i < store->packs; ++i) {
+      store_put64 (b, store->pack[i]->id);
+      store_put64 (b + 8, store->pack[i]->size);
+      ok = fwrite (b, 1, 16, file) == 16;
+    }
+    store_put64 (b, store->count);
+    ok = ok && fwrite (b, 1, 8, file) == 8;
+    for (i = 0; ok && i <= store->mask; ++i) {
+      const store_entry_t* e = &store->slot[i];
+
+      if (!e->pack)
+        continue;
+      memcpy (b, e->key, 8);
+      store_put64 (b + 8, e->pack->id);
+      store_put64 (b + 16, e->offset);
+      store_put64 (b + 24, e->length);
+      store_put64 (b + 32, e->refs);
+      ok = fwrite (b, 1, STORE_ENTRY, file) == STORE_ENTRY;
+    }
+    ok = fflush (file) == 0 && ok;
+#if STORE_MMAP
+    ok = ok && fsync (fileno (file)) == 0;
+#endif /* STORE_MMAP */
+    ok = fclose (file) == 0 && ok;
+#if !STORE_MMAP
+    remove (path);
+#endif /* !STORE_MMAP */
+    ok = ok && rename (tmp, path) == 0;
+  }
+  free (tmp);
+  free (path);
+  return ok;
+}
+
+/* Write the pack being written by STORE, whose write lock must be
+   held, to disk, and then the CATALOG.  Return zero on failure.  */
+
+static int
+store_sync (fingerprint_store_t* store)
+{
+  int ok = store_publish (store);
+
+  if (ok && store->file) {
+    ok = fflush (store->file) == 0;
+#if STORE_MMAP
+    ok = ok && fsync (fileno (store->file)) == 0;
+#endif /* STORE_MMAP */
+  }
+  if (ok) {
+    STORE_READ (store);
+    ok = store_write_catalog (store);
+    STORE_DONE (store);
+  }
+  return ok;
+}
+
+/* Read the CATALOG of STORE, if there is one, or write an empty one.
+   Return zero on failure.  */
+
+static int
+store_read_catalog (fingerprint_store_t* store)
+{
+  char* path = store_path (store, "CATALOG");
+  fingerprint_t poly = fingerprint_basis_poly (store->basis);
+  byte_t b[STORE_ENTRY];
+  unsigned long i, n, count;
+  FILE* file;
+  int ok;
+
+  if (!path)
+    return 0;
+  file = fopen (path, "rb");
+  if (!file) {
+    /* A new store starts with an empty CATALOG, which also checks
+       that the directory is there.  */
+    int absent = errno == ENOENT;
+
+    free (path);
+    return absent && store_write_catalog (store);
+  }
+  free (path);
+
+  ok = fread (b, 1, 32, file) == 32 && memcmp (b, STORE_MAGIC, 8) == 0;
+  if (ok && memcmp (b + 8, FINGERPRINT_BYTE (poly), 8) != 0) {
+    fclose (file);
+    errno = EINVAL;
+    return 0;
+  }
+  store->next = ok ? store_get64 (b + 16) : 0;
+  n = ok ? store_get64 (b + 24) : 0;
+  for (i = 0; ok && i < n; ++i) {
+    unsigned long id, size;
+    store_pack_t* pack;
+
+    ok = fread (b, 1, 16, file) == 16;
+    id = store_get64 (b);
+    size = store_get64 (b + 8);
+    ok = ok && size >= STORE_START && id < store->next
+      && (i == 0 || id > store->pack[i - 1]->id);
+    pack = ok ? store_pack_make (store, id, 0, size) : NULL;
+    if (pack)
+      pack->size = size;
+    ok = pack && store_pack_add (store, pack);
+    if (pack && !ok)
+      store_pack_free (pack);
+#if STORE_MMAP
+    if (ok) {
+      /* The file may hold more than the CATALOG says, but not
+         less.  */
+      struct stat st;
+
+      ok = stat (pack->path, &st) == 0
+        && (unsigned long) st.st_size >= size;
+    }
+#endif /* STORE_MMAP */
+  }
+  ok = ok && fread (b, 1, 8, file) == 8;
+  count = ok ? store_get64 (b) : 0;
+  ok = ok && store_reserve (store, count);
+  for (i = 0; ok && i < count; ++i) {
+    unsigned long id, lo = 0, hi = store->packs;
+    store_entry_t* e;
+
+    ok = fread (b, 1, STORE_ENTRY, file) == STORE_ENTRY;
+    id = store_get64 (b + 8);
+    while (ok && lo < hi) {
+      unsigned long mid = lo + (hi - lo) / 2;
+
+      if (store->pack[mid]->id < id)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    ok = ok && lo < store->packs && store->pack[lo]->id == id;
+    if (!ok)
+      break;
+    e = store_find (store, b);
+    memcpy (e->key, b, 8);
+    e->offset = store_get64 (b + 16);
+    e->length = store_get64 (b + 24);
+    e->refs = store_get64 (b + 32);
+    ok = !e->pack && e->refs > 0
+      && e->offset >= STORE_START + STORE_HEADER
+      && e->offset <= store->pack[lo]->size
+      && e->length <= store->pack[lo]->size - e->offset;
+    if (!ok)
+      break;
+    e->pack = store->pack[lo];
+    e->pack->live += STORE_HEADER + e->length;
+    ++store->count;
+  }
+  fclose (file);
+  if (!ok)
+    errno = EINVAL;
+  return ok;
+}
+
+/* Release the memory of STORE, which must have no packs.  */
+
+static void
+store_free (fingerprint_store_t* store)
+{
+#if STORE_THREADS
+  if (store->locks > 0)
+    pthread_mutex_destroy (&store->write_lock);
+  if (store->locks > 1)
+    pthread_mutex_destroy (&store->batch_lock);
+  if (store->locks > 2)
+    pthread_rwlock_destroy (&store->table_lock);
+  if (store->locks > 3)
+    pthread_mutex_destroy (&store->pin_lock);
+#endif /* STORE_THREADS */
+  free (store->dir);
+  free (store);
+}
+
+/* Release the packs and table of STORE, and STORE itself unless it has
+   views, in which case the last view releases it.  */
+
+static void
+store_shut (fingerprint_store_t* store)
+{
+  unsigned long i;
+  int idle;
+
+  if (store->file)
+    fclose (store->file);
+  for (i = 0; i < store->packs; ++i)
+    store_pack_retire (store, store->pack[i]);
+  free (store->pack);
+  free (store->slot);
+  STORE_LOCK (store, pin_lock);
+  store->closed = 1;
+  idle = store->views == 0;
+  STORE_UNLOCK (store, pin_lock);
+  if (idle)
+    store_free (store);
+}
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+fingerprint_store_t*
+fingerprint_store_open (const char*                dir,
+                        const fingerprint_basis_t* basis)
+{
+  fingerprint_store_t* store;
+
+  store = (fingerprint_store_t*) calloc (1, sizeof (*store));
+  if (!store)
+    return NULL;
+  store->dir = (char*) malloc (strlen (dir) + 1);
+  if (!store->dir) {
+    free (store);
+    return NULL;
+  }
+  strcpy (store->dir, dir);
+  store->basis = basis;
+  store->next = 1;
+
+#if STORE_THREADS
+  if (pthread_mutex_init (&store->write_lock, NULL) != 0
+      || (++store->locks,
+          pthread_mutex_init (&store->batch_lock, NULL) != 0)
+      || (++store->locks,
+          pthread_rwlock_init (&store->table_lock, NULL) != 0)
+      || (++store->locks,
+          pthread_mutex_init (&store->pin_lock, NULL) != 0)) {
+    store_free (store);
+    return NULL;
+  }
+  ++store->locks;
+#endif /* STORE_THREADS */
+
+  if (!store_reserve (store, 1) || !store_read_catalog (store)) {
+    int e = errno;
+
+    store_shut (store);
+    errno = e;
+    return NULL;
+  }
+  return store;
+}
+
+int
+fingerprint_store_close (fingerprint_store_t* store)
+{
+  int ok;
+
+  if (!store)
+    return 1;
+  STORE_LOCK (store, write_lock);
+  ok = store_sync (store);
+  STORE_UNLOCK (store, write_lock);
+  store_shut (store);
+  return ok;
+}
+
+int
+fingerprint_store_put (fingerprint_store_t* store,
+                       const char*          buffer,
+                       unsigned long        size,
+                       fingerprint_t*       fp)
+{
+  store_batch_t b;
+  const byte_t* key;
+  int found = 0;
+  int ok = 1;
+  int i;
+
+  *fp = store_fingerprint (store, buffer, size);
+  key = FINGERPRINT_BYTE (*fp);
+
+  STORE_LOCK (store, write_lock);
+
+  /* Look in the table and then the batch, holding the batch lock so
+     that the chunk cannot pass from one to the other meanwhile.  */
+  STORE_LOCK (store, batch_lock);
+  STORE_READ (store);
+  found = store_find (store, key)->pack != NULL;
+  STORE_DONE (store);
+  if (found) {
+    store_entry_t* e;
+
+    STORE_WRITE (store);
+    e = store_find (store, key);
+    if (!e->pack)
+      /* The last reference was dropped meanwhile.  */
+      found = 0;
+    else if (e->length == size)
+      ++e->refs;
+    else
+      ok = 0;
+    STORE_DONE (store);
+  }
+  for (i = 0; !found && i < store->batched; ++i)
+    if (memcmp (store->batch[i].entry.key, key, 8) == 0) {
+      found = 1;
+      if (store->batch[i].entry.length == size)
+        ++store->batch[i].entry.refs;
+      else
+        ok = 0;
+    }
+  STORE_UNLOCK (store, batch_lock);
+
+  if (!ok)
+    errno = EEXIST;
+  else if (!found) {
+    memcpy (b.entry.key, key, 8);
+    b.entry.length = size;
+    b.entry.refs = 1;
+    b.from = NULL;
+    b.from_offset = 0;
+    ok = (store_append (store, key, buffer, size,
+                        &b.entry.pack, &b.entry.offset)
+          && store_batch (store, &b));
+  }
+  STORE_UNLOCK (store, write_lock);
+  return ok;
+}
+
+int
+fingerprint_store_get (fingerprint_store_t*      store,
+                       fingerprint_t             fp,
+                       fingerprint_store_view_t* view)
+{
+  const byte_t* key = FINGERPRINT_BYTE (fp);
+  store_pack_t* pack = NULL;
+  unsigned long offset = 0, length = 0;
+  const byte_t* data;
+  byte_t* copy;
+  int pass;
+
+  for (pass = 0; pass < 2 && !pack; ++pass) {
+    const store_entry_t* e;
+
+    /* A chunk not in the table may be waiting in the batch.  */
+    if (pass > 0 && !store_publish (store))
+      return -1;
+    STORE_READ (store);
+    e = store_find (store, key);
+    if (e->pack) {
+      /* Pin the pack before the table lock is let go, so that a
+         compaction cannot release it.  */
+      pack = e->pack;
+      offset = e->offset;
+      length = e->length;
+      STORE_LOCK (store, pin_lock);
+      ++pack->pins;
+      ++store->views;
+      STORE_UNLOCK (store, pin_lock);
+    }
+    STORE_DONE (store);
+  }
+  if (!pack)
+    return 0;
+
+  view->store = store;
+  view->pack = pack;
+  view->copy = NULL;
+  data = store_pack_read (pack, offset, length, &copy);
+  if (!data) {
+    fingerprint_store_release (view);
+    return -1;
+  }
+  view->data = (const char*) data;
+  view->size = length;
+  view->copy = (char*) copy;
+  return 1;
+}
+
+void
+fingerprint_store_release (fingerprint_store_view_t* view)
+{
+  fingerprint_store_t* store = view->store;
+  store_pack_t* pack = (store_pack_t*) view->pack;
+  int idle, last;
+
+  free (view->copy);
+  STORE_LOCK (store, pin_lock);
+  idle = --pack->pins == 0 && pack->retired;
+  last = --store->views == 0 && store->closed;
+  STORE_UNLOCK (store, pin_lock);
+  if (idle)
+    store_pack_free (pack);
+  if (last)
+    store_free (store);
+}
+
+long
+fingerprint_store_ref (fingerprint_store_t* store, fingerprint_t fp)
+{
+  return store_adjust (store, FINGERPRINT_BYTE (fp), 1);
+}
+
+long
+fingerprint_store_unref (fingerprint_store_t* store, fingerprint_t fp)
+{
+  return store_adjust (store, FINGERPRINT_BYTE (fp), -1);
+}
+
+int
+fingerprint_store_flush (fingerprint_store_t* store)
+{
+  int ok;
+
+  STORE_LOCK (store, write_lock);
+  ok = store_sync (store);
+  STORE_UNLOCK (store, write_lock);
+  return ok;
+}
+
+long
+fingerprint_store_compact (fingerprint_store_t* store, double waste)
+{
+  store_pack_t** victim = NULL;
+  unsigned long victims = 0;
+  unsigned long i, j;
+  int ok;
+
+  STORE_LOCK (store, write_lock);
+
+  /* Chunks waiting in the batch may be in the packs to be compacted, so
+     they go into the table first, where compaction can see them.  */
+  ok = store_publish (store);
+
+  STORE_READ (store);
+  if (ok && store->packs > 0) {
+    victim = (store_pack_t**) malloc (store->packs * sizeof (*victim));
+    ok = victim != NULL;
+  }
+  for (i = 0; ok && i < store->packs; ++i) {
+    store_pack_t* pack = store->pack[i];
+    unsigned long used = pack->size - STORE_START;
+
+    if (pack != store->active
+        && (used == 0 || used - pack->live >= waste * used))
+      victim[victims++] = pack;
+  }
+  STORE_DONE (store);
+
+  /* Copy the live chunks of each victim to the end of the active pack.
+     Readers go on finding them in the victim until the batch of moves
+     goes into the table.  */
+  for (i = 0; ok && i < victims; ++i) {
+    store_pack_t* pack = victim[i];
+    unsigned long pos = STORE_START;
+
+    while (ok && pos < pack->size) {
+      store_batch_t b;
+      const byte_t* r;
+      byte_t* copy;
+      int live;
+
+      r = store_pack_read (pack, pos, STORE_HEADER, &copy);
+      if (!r) {
+        ok = 0;
+        break;
+      }
+      memcpy (b.entry.key, r, 8);
+      b.entry.length = store_get64 (r + 8);
+      free (copy);
+      b.from = pack;
+      b.from_offset = pos + STORE_HEADER;
+      if (b.entry.length > pack->size - b.from_offset) {
+        errno = EINVAL;
+        ok = 0;
+        break;
+      }
+      pos = b.from_offset + b.entry.length;
+
+      STORE_READ (store);
+      {
+        const store_entry_t* e = store_find (store, b.entry.key);
+
+        live = e->pack == pack && e->offset == b.from_offset;
+      }
+      STORE_DONE (store);
+      if (!live)
+        continue;
+
+      r = store_pack_read (pack, b.from_offset, b.entry.length, &copy);
+      ok = (r != NULL
+            && store_append (store, b.entry.key, r, b.entry.length,
+                             &b.entry.pack, &b.entry.offset)
+            && store_batch (store, &b));
+      free (copy);
+    }
+  }
+  ok = ok && store_publish (store);
+
+  /* The victims hold no live chunks now; take them out of the store,
+     and only remove their files once the CATALOG no longer names
+     them.  */
+  if (ok) {
+    STORE_WRITE (store);
+    for (i = 0, j = 0; i < store->packs; ++i) {
+      unsigned long k;
+
+      for (k = 0; k < victims && victim[k] != store->pack[i]; ++k)
+        ;
+      if (k == victims)
+        store->pack[j++] = store->pack[i];
+    }
+    store->packs = j;
+    STORE_DONE (store);
+    if (store_sync (store))
+      for (i = 0; i < victims; ++i)
+        victim[i]->doomed = 1;
+    else
+      ok = 0;
+    for (i = 0; i < victims; ++i)
+      store_pack_retire (store, victim[i]);
+  }
+  STORE_UNLOCK (store, write_lock);
+  free (victim);
+  return ok ? (long) victims : -1;
+}
+
+void
+fingerprint_store_stats (fingerprint_store_t* store,
+                         unsigned long*       chunks,
+                         unsigned long*       live,
+                         unsigned long*       total,
+                         unsigned long*       packs)
+{
+  unsigned long i;
+
+  STORE_LOCK (store, write_lock);
+  store_publish (store);
+  STORE_READ (store);
+  *chunks = store->count;
+  *live = 0;
+  *total = 0;
+  for (i = 0; i < store->packs; ++i) {
+    *live += store->pack[i]->live;
+    *total += store->pack[i]->size;
+  }
+  *packs = store->packs;
+  STORE_DONE (store);
+  STORE_UNLOCK (store, write_lock);
+}
@@ -0,0 +1,151 @@
+/***********************************************************************
+
+ File:   store.h
+
+ Contents: A store of chunks addressed by their fingerprints.
+
+***********************************************************************/
+
+#ifndef FINGERPRINT_STORE_H
+#define FINGERPRINT_STORE_H
+
+#include "rabin64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/***********************************************************************
+  Notes
+***********************************************************************/
+
+/* A store keeps chunks of bytes under their fingerprints, so that a
+   chunk stored twice is kept once, and lives in a directory of its
+   own.  The chunks are appended to pack files, each of which is begun
+   when the last fills; a chunk is recorded in a pack as its
+   fingerprint and length, eight bytes each, followed by its bytes.  A
+   table in memory maps each fingerprint to the pack, offset and length
+   of its chunk, together with a count of references to it: storing a
+   chunk already present adds a reference, and a chunk whose last
+   reference is dropped is forgotten, though its bytes stay in its pack
+   until the pack is compacted.  Two chunks are taken to be the same if
+   their fingerprints and lengths are.
+
+   Flushing a store writes the table, and the length of each pack, to a
+   file called CATALOG.  A store is opened as it was last flushed;
+   anything done since is lost if the store is not closed, and the
+   bytes of such chunks are overwritten or ignored.  The CATALOG also
+   records the polynomial of the basis of the store, which must be the
+   same each time it is opened.
+
+   Compacting a store copies the chunks still referenced in the packs
+   with the most dead bytes to the end of the newest pack, and removes
+   the old packs.  Where the system provides it, packs are mapped into
+   memory, so that a chunk is read by returning a view of its bytes in
+   the mapping, without copying them; a view pins its pack, and a pack
+   removed by compaction is unmapped, and its file deleted, only when
+   its last view is released.
+
+   A store may be used by several threads at once, except that it must
+   not be closed while other calls are in progress.  Readers share a
+   lock on the table, and only wait for writers while a batch of new
+   chunks is added to it, or a count changes.  Writers take turns to
+   append chunks, and gather new chunks into batches, which readers
+   see as soon as they look for one; a compaction holds off writers,
+   but not readers.  Where threads are not available, which is assumed
+   if FINGERPRINT_NO_THREADS is defined or the target is Windows, a
+   store must be used by one thread at a time.  */
+
+/***********************************************************************
+  Types
+***********************************************************************/
+
+/* The type fingerprint_store_t is opaque.  */
+
+typedef struct fingerprint_store_t fingerprint_store_t;
+
+/* A fingerprint_store_view_t is a view of the bytes of a chunk.  Only
+   DATA and SIZE are for the caller; the rest are for the store.  */
+
+typedef struct fingerprint_store_view_t {
+  const char*   data;   /* The bytes of the chunk.  */
+  unsigned long size;   /* The length of the chunk.  */
+  fingerprint_store_t*
+                store;
+  void*         pack;
+  char*         copy;
+} fingerprint_store_view_t;
+
+/***********************************************************************
+  Functions
+***********************************************************************/
+
+/* Open the store in the directory DIR, which must exist, taking
+   fingerprints with respect to BASIS; an empty directory holds an
+   empty store.  Return NULL if the store cannot be read, if it was
+   made with another basis, or if memory is exhausted.  */
+extern fingerprint_store_t* fingerprint_store_open
+                        (const char*                dir,
+                         const fingerprint_basis_t* basis);
+
+/* Flush STORE, and release it.  Return zero if the flush fails, and
+   non-zero otherwise; STORE is released either way, though views of
+   it remain valid until they are released.  */
+extern int fingerprint_store_close (fingerprint_store_t* store);
+
+/* Store the SIZE bytes of BUFFER as a chunk of STORE, or add a
+   reference to the chunk if it is already there, and store its
+   fingerprint in *FP.  Return zero if a pack cannot be written, if a
+   chunk of another length has the same fingerprint, or if memory is
+   exhausted, and non-zero otherwise.  */
+extern int fingerprint_store_put (fingerprint_store_t* store,
+                                  const char*          buffer,
+                                  unsigned long        size,
+                                  fingerprint_t*       fp);
+
+/* Look up FP in STORE.  If it is present, store a view of its chunk in
+   *VIEW, which must be released with fingerprint_store_release, and
+   return 1; otherwise, return 0.  Return -1 if the chunk cannot be
+   read.  */
+extern int fingerprint_store_get (fingerprint_store_t*      store,
+                                  fingerprint_t             fp,
+                                  fingerprint_store_view_t* view);
+
+/* Release VIEW.  */
+extern void fingerprint_store_release (fingerprint_store_view_t* view);
+
+/* Add a reference to the chunk FP of STORE, and return the number of
+   references to it, or -1 if it is not there.  */
+extern long fingerprint_store_ref (fingerprint_store_t* store,
+                                   fingerprint_t        fp);
+
+/* Drop a reference to the chunk FP of STORE, and return the number of
+   references left, or -1 if it is not there.  The chunk is forgotten
+   when none are left.  */
+extern long fingerprint_store_unref (fingerprint_store_t* store,
+                                     fingerprint_t        fp);
+
+/* Write the packs and the table of STORE to disk.  Return zero on
+   failure, and non-zero otherwise.  */
+extern int fingerprint_store_flush (fingerprint_store_t* store);
+
+/* Compact each pack of STORE, other than the newest, of which at least
+   the fraction WASTE is dead, and flush STORE.  Return the number of
+   packs removed, or -1 on failure.  */
+extern long fingerprint_store_compact (fingerprint_store_t* store,
+                                       double               waste);
+
+/* Store in *CHUNKS the number of chunks in STORE, in *LIVE the number
+   of bytes their records take in the packs, in *TOTAL the number of
+   bytes in the packs, and in *PACKS the number of packs.  */
+extern void fingerprint_store_stats (fingerprint_store_t* store,
+                                     unsigned long*       chunks,
+                                     unsigned long*       live,
+                                     unsigned long*       total,
+                                     unsigned long*       packs);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* FINGERPRINT_STORE_H */
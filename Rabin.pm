@@ -1,6 +1,11 @@
 package Fingerprint::Rabin;
 
-use Fingerprint::Rabin::Internal qw(fp_buffer fp_hash fp_free fp_combine);
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_buffers fp_hash fp_combine
+				    fp_buffer_basis fp_to_binary fp_from_binary
+				    fp_to_hex fp_from_hex fp_to_base32
+				    fp_from_base32 fp_range fp_concat
+				    fp_layer_fingerprint fp_update_range fp_deep
+				    fp_buffer_cached);
 use strict;
 
 sub new {
@@ -9,6 +14,46 @@ sub new {
 	return bless \fp_buffer($text);
 }
 
+sub new_cached {
+	# The fingerprint is kept on the caller's string, not a copy.
+	return bless \fp_buffer_cached($_[0]);
+}
+
+sub new_list {
+	return map { my $fingerprint = $_; bless \$fingerprint } fp_buffers(@_);
+}
+
+sub new_range {
+	my $text = shift;
+	my $offset = shift;
+	my $length = shift;
+
+	return bless \fp_range($text, $offset, $length);
+}
+
+sub new_concat {
+	return bless \fp_concat(@_);
+}
+
+sub new_from_handle {
+	my $handle = shift;
+
+	return bless \fp_layer_fingerprint($handle);
+}
+
+sub new_deep {
+	my $data = shift;
+
+	return bless \fp_deep($data);
+}
+
+sub new_with_basis {
+	my $basis = shift;
+	my $text = shift;
+
+	return bless \fp_buffer_basis($basis, $text);
+}
+
 sub hash {
 	my $fingerprint = shift;
 
@@ -22,9 +67,44 @@ sub combine {
 	return bless \fp_combine($$fingerprint1, $$fingerprint2);
 }
 
-sub DESTROY {
+sub update_range {
 	my $fingerprint = shift;
-	fp_free($$fingerprint);
+	my $size = shift;
+	my $offset = shift;
+	my $old = shift;
+	my $new = shift;
+
+	return bless \fp_update_range($$fingerprint, $size, $offset, $old, $new);
+}
+
+sub to_binary {
+	my $fingerprint = shift;
+
+	return fp_to_binary($$fingerprint);
+}
+
+sub to_hex {
+	my $fingerprint = shift;
+
+	return fp_to_hex($$fingerprint);
+}
+
+sub to_base32 {
+	my $fingerprint = shift;
+
+	return fp_to_base32($$fingerprint);
+}
+
+sub from_binary {
+	return map { my $fingerprint = $_; bless \$fingerprint } fp_from_binary(@_);
+}
+
+sub from_hex {
+	return map { my $fingerprint = $_; bless \$fingerprint } fp_from_hex(@_);
+}
+
+sub from_base32 {
+	return map { my $fingerprint = $_; bless \$fingerprint } fp_from_base32(@_);
 }
 
 return 1;
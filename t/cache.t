@@ -0,0 +1,47 @@
+use strict;
+use warnings;
+use Test::More tests => 15;
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_cache_new fp_cache_get
+				    fp_cache_put fp_cache_remove
+				    fp_cache_clear fp_cache_count
+				    fp_cache_bytes fp_cache_stats
+				    fp_cache_free);
+
+my $cache = fp_cache_new(64, 16, 1);
+my @fp = map { fp_buffer("key $_") } 0 .. 999;
+
+ok(!defined fp_cache_get($cache, $fp[0]), 'a new cache is empty');
+fp_cache_put($cache, $fp[0], "a\0b");
+is(fp_cache_get($cache, $fp[0]), "a\0b", 'a value reads back');
+fp_cache_put($cache, $fp[0], '');
+is(fp_cache_get($cache, $fp[0]), '', 'a value is replaced');
+ok(!eval { fp_cache_put($cache, $fp[1], 'x' x 17); 1 },
+   'a value longer than the value size croaks');
+is(fp_cache_remove($cache, $fp[0]), 1, 'remove finds the value');
+is(fp_cache_remove($cache, $fp[0]), 0, 'and then does not');
+
+my ($hits, $misses) = fp_cache_stats($cache);
+is($hits, 2, 'hits are counted');
+is($misses, 1, 'misses are counted');
+
+# Store many more values than fit, reading one after each: the CLOCK
+# hand finds its bit set each time, so it is never evicted.
+fp_cache_put($cache, $fp[0], 'hot');
+for my $i (1 .. 999) {
+	fp_cache_put($cache, $fp[$i], "cold $i");
+	fp_cache_get($cache, $fp[0]);
+}
+my $count = fp_cache_count($cache);
+ok($count >= 64 && $count < 1000, "a full cache evicts values ($count held)");
+is(fp_cache_get($cache, $fp[0]), 'hot', 'a value in use is not evicted');
+is(fp_cache_get($cache, $fp[999]), 'cold 999', 'the newest value is held');
+my $held = grep { defined fp_cache_get($cache, $fp[$_]) } 0 .. 999;
+is($held, $count, 'the count matches the values held');
+
+($hits, $misses) = fp_cache_stats($cache);
+is($hits + $misses, 3 + 999 + 2 + 1000, 'every get is counted');
+ok(fp_cache_bytes($cache) >= 64 * 16, 'the memory covers the values');
+
+fp_cache_clear($cache);
+is(fp_cache_count($cache), 0, 'clear empties the cache');
+fp_cache_free($cache);
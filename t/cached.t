@@ -0,0 +1,96 @@
+use strict;
+use warnings;
+use Test::More tests => 16;
+use File::Temp qw(tempfile);
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_buffer_cached fp_to_hex);
+
+my $TEXT = 'the quick brown fox jumps over the lazy dog ' x 100;
+
+# Fingerprint the scalar through the cache, as after an edit, and
+# compare with a fresh fingerprint of its bytes.
+sub cached_ok {
+	my $name = pop;
+
+	is(fp_to_hex(fp_buffer_cached($_[0])), fp_to_hex(fp_buffer($_[0])),
+	   $name);
+}
+
+# Return a copy of the text whose fingerprint has been cached.  The
+# copy has a buffer of its own, rather than one shared with the text,
+# so that edits in place keep its address and length.
+sub cached {
+	my $s = '';
+
+	$s .= $TEXT;
+	fp_buffer_cached($s);
+	return \$s;
+}
+
+my $s = cached();
+cached_ok($$s, 'an unedited scalar');
+cached_ok($$s, 'an unedited scalar a second time');
+
+$s = cached();
+substr($$s, 4, 5, 'QUICK');
+cached_ok($$s, 'four-argument substr');
+
+$s = cached();
+substr($$s, 4, 5) = 'slow!';
+cached_ok($$s, 'lvalue substr');
+
+$s = cached();
+$$s =~ tr/a-e/A-E/;
+cached_ok($$s, 'tr///');
+
+$s = cached();
+$$s =~ s/fox/cat/;
+cached_ok($$s, 's///');
+
+$s = cached();
+vec($$s, 10, 8) = ord('!');
+cached_ok($$s, 'vec');
+
+$s = cached();
+$$s .= 'more';
+cached_ok($$s, '.=');
+
+$s = cached();
+$$s x= 2;
+cached_ok($$s, 'x=');
+
+$s = cached();
+chop($$s);
+cached_ok($$s, 'chop');
+
+open(my $in, '<', \$TEXT) or die;
+$s = cached();
+read($in, $$s, length($TEXT));
+cached_ok($$s, 'read of the same bytes');
+$s = cached();
+seek($in, 10, 0);
+read($in, $$s, 20, 4);
+cached_ok($$s, 'read at an offset');
+close($in);
+
+my ($fh, $file) = tempfile(UNLINK => 1);
+print $fh uc($TEXT);
+close($fh);
+open($in, '<', $file) or die;
+$s = cached();
+sysread($in, $$s, length($TEXT));
+cached_ok($$s, 'sysread of bytes of the same length');
+close($in);
+
+$s = cached();
+for ($$s) {
+	tr/o/0/;
+}
+cached_ok($$s, 'tr/// through a foreach alias');
+
+$s = cached();
+$_ .= '!' for $$s;
+cached_ok($$s, '.= through a foreach alias');
+
+$s = cached();
+$$s = uc($$s);
+cached_ok($$s, 'assignment');
@@ -0,0 +1,55 @@
+use strict;
+use warnings;
+use Test::More tests => 9;
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_to_hex fp_chunker_new
+				    fp_chunker_split fp_chunker_free);
+
+my ($MIN, $AVG, $MAX) = (2048, 8192, 65536);
+
+# Several MB of random bytes, with a run of zeros in the middle where
+# the window never changes, so that chunks are cut at the greatest
+# size there.
+srand(1);
+my $text = pack('N*', map { int(rand(2 ** 32)) } 1 .. 1_000_000)
+	 . "\0" x 1_000_000
+	 . pack('N*', map { int(rand(2 ** 32)) } 1 .. 500_000);
+
+sub chunks {
+	my ($chunker, $buffer, $threads) = @_;
+	my @split = fp_chunker_split($chunker, $buffer, $threads);
+	my @chunks;
+
+	push @chunks, [shift @split, shift @split, fp_to_hex(shift @split)]
+		while @split;
+	return \@chunks;
+}
+
+my $chunker = fp_chunker_new(48, $MIN, $AVG, $MAX);
+my $one = chunks($chunker, $text, 1);
+
+is_deeply(chunks($chunker, $text, 2), $one, 'two threads cut as one does');
+is_deeply(chunks($chunker, $text, 8), $one, 'eight threads cut as one does');
+is_deeply(chunks($chunker, $text, 0), $one,
+	  'a thread per processor cuts as one does');
+
+my $offset = 0;
+my $gaps = grep { my $gap = $_->[0] != $offset; $offset += $_->[1]; $gap }
+		@$one;
+ok($gaps == 0 && $offset == length($text), 'the chunks cover the text');
+
+my @short = grep { $_->[1] < $MIN } @$one[0 .. $#$one - 1];
+my @long = grep { $_->[1] > $MAX } @$one;
+ok(!@short && !@long, 'the chunks respect the least and greatest sizes');
+ok((grep { $_->[1] == $MAX } @$one) > 0,
+   'a run without ends is cut at the greatest size');
+
+my $bad = grep { $_->[2] ne fp_to_hex(fp_buffer(substr($text, $_->[0],
+							 $_->[1]))) } @$one;
+is($bad, 0, 'each chunk has the fingerprint of its bytes');
+
+my @empty = fp_chunker_split($chunker, '', 4);
+is(scalar(@empty), 0, 'an empty text has no chunks');
+fp_chunker_free($chunker);
+
+ok(!eval { fp_chunker_new(48, $MAX, $AVG, $MIN); 1 },
+   'a least size above the greatest croaks');
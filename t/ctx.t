@@ -0,0 +1,67 @@
+use strict;
+use warnings;
+use Test::More tests => 10;
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_buffer_basis fp_to_hex
+				    fp_basis_random fp_basis_free fp_ctx_new
+				    fp_ctx_update fp_ctx_final fp_ctx_length
+				    fp_ctx_save fp_ctx_restore fp_ctx_free);
+
+srand(4);
+my $text = pack('C*', map { int(rand(256)) } 1 .. 20_000);
+
+# Fingerprint TEXT in a context under BASIS, if given, saving it after
+# the first CUT bytes and continuing from a restored copy.
+sub resumed {
+	my ($cut, $basis) = @_;
+	my $ctx = fp_ctx_new($basis);
+
+	fp_ctx_update($ctx, substr($text, 0, $cut));
+	my $state = fp_ctx_save($ctx);
+	fp_ctx_free($ctx);
+	$ctx = fp_ctx_restore($state, $basis);
+	fp_ctx_update($ctx, substr($text, $cut));
+	my $fp = fp_ctx_final($ctx);
+	fp_ctx_free($ctx);
+	return fp_to_hex($fp);
+}
+
+my $whole = fp_to_hex(fp_buffer($text));
+my @cuts = (0 .. 17, 1000, 4095 .. 4097, 19_999, 20_000);
+
+my $bad = grep { resumed($_) ne $whole } @cuts;
+is($bad, 0, 'a restored context continues as one pass would');
+
+my $basis = fp_basis_random(11);
+my $basis_whole = fp_to_hex(fp_buffer_basis($basis, $text));
+$bad = grep { resumed($_, $basis) ne $basis_whole } @cuts;
+is($bad, 0, 'the same holds under another basis');
+
+my $ctx = fp_ctx_new();
+fp_ctx_update($ctx, substr($text, 0, 777));
+my $state = fp_ctx_save($ctx);
+my $copy = fp_ctx_restore($state);
+is(fp_ctx_length($copy), 777, 'a restored context keeps its length');
+fp_ctx_update($ctx, 'rest');
+fp_ctx_update($copy, 'rest');
+is(fp_to_hex(fp_ctx_final($copy)), fp_to_hex(fp_ctx_final($ctx)),
+   'a restored context runs alongside the one it was saved from');
+is(fp_ctx_save($ctx), fp_ctx_save($copy), 'their states agree');
+fp_ctx_free($copy);
+fp_ctx_free($ctx);
+
+ok(!eval { fp_ctx_restore($state, $basis); 1 },
+   'a state restored with another basis croaks');
+my $basis_ctx = fp_ctx_new($basis);
+ok(!eval { fp_ctx_restore(fp_ctx_save($basis_ctx)); 1 },
+   'a state saved with another basis croaks');
+fp_ctx_free($basis_ctx);
+fp_basis_free($basis);
+
+ok(!eval { fp_ctx_restore(substr($state, 1)); 1 }, 'a short state croaks');
+my $corrupt = $state;
+substr($corrupt, 0, 1) ^= "\x01";
+ok(!eval { fp_ctx_restore($corrupt); 1 }, 'a state without its tag croaks');
+$corrupt = $state;
+substr($corrupt, 3, 1) = "\xff";
+ok(!eval { fp_ctx_restore($corrupt); 1 },
+   'a state of another version croaks');
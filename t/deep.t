@@ -0,0 +1,72 @@
+use strict;
+use warnings;
+use Test::More tests => 20;
+use Tie::Hash;
+use Fingerprint::Rabin::Internal qw(fp_deep fp_to_hex);
+
+sub deep { return fp_to_hex(fp_deep($_[0])) }
+
+# The same keys, inserted in opposite orders.
+my (%h1, %h2);
+$h1{"key$_"} = $_ for 1 .. 200;
+$h2{"key$_"} = $_ for reverse 1 .. 200;
+is(deep(\%h1), deep(\%h2), 'the order of hash keys does not matter');
+$h2{key7} = 'seven';
+isnt(deep(\%h1), deep(\%h2), 'a changed hash value matters');
+
+isnt(deep([undef]), deep(['']), 'undef differs from the empty string');
+isnt(deep(['ab']), deep(['a', 'b']), 'strings are delimited');
+isnt(deep([1, [2]]), deep([[1], 2]), 'the shape of the data matters');
+is(deep([10, 1.5, -3]), deep(['10', '1.5', '-3']),
+   'numbers fingerprint as their strings');
+
+my $latin = "caf\xe9";
+my $upgraded = $latin;
+utf8::upgrade($upgraded);
+is(deep([$latin]), deep([$upgraded]),
+   'a Latin-1 string and its UTF-8 upgrade agree');
+is(deep({$latin => 1}), deep({$upgraded => 1}),
+   'a Latin-1 key and its UTF-8 upgrade agree');
+isnt(deep(["\x{100}"]), deep(["\xc4\x80"]),
+     'a wide character differs from its UTF-8 bytes');
+
+isnt(deep(bless {}, 'Foo'), deep({}), 'a blessed hash differs from a plain one');
+isnt(deep(bless {}, 'Foo'), deep(bless {}, 'Bar'), 'the class matters');
+
+# Cycles are written as the number of levels they go back, so that
+# cycles of the same shape agree.
+my $c1 = [1];
+push @$c1, $c1;
+my $c2 = [1];
+push @$c2, $c2;
+is(deep($c1), deep($c2), 'cycles of the same shape agree');
+my ($p, $q) = ([1], [1]);
+push @$p, $q;
+push @$q, $p;
+isnt(deep($p), deep($c1), 'cycles of different lengths differ');
+my $shared = [1];
+is(deep([$shared, $shared]), deep([[1], [1]]),
+   'a referent met twice without a cycle is walked twice');
+
+my $d = 'leaf';
+$d = [$d] for 1 .. 4096;
+ok(eval { fp_deep($d); 1 }, 'data nested 4096 deep is walked');
+$d = [$d];
+ok(!eval { fp_deep($d); 1 } && $@ =~ /nested more than 4096 deep/,
+   'data nested more than 4096 deep croaks');
+
+tie my %tied, 'Tie::StdHash';
+ok(!eval { fp_deep(\%tied); 1 } && $@ =~ /tied hash/, 'a tied hash croaks');
+ok(!eval { fp_deep([sub { 1 }]); 1 } && $@ =~ /CODE reference/,
+   'a code reference croaks');
+
+my %iter = (a => 1, b => 2, c => 3);
+my ($first) = each %iter;
+fp_deep(\%iter);
+my $rest = 0;
+$rest++ while each %iter;
+is($rest, 2, 'the hash iterator is left alone');
+
+my $data = {list => [1, 2, {x => undef}], name => "\x{263a}"};
+is(deep($data), deep({name => "\x{263a}", list => [1, 2, {x => undef}]}),
+   'equal structures agree');
@@ -0,0 +1,57 @@
+use strict;
+use warnings;
+use Test::More tests => 16;
+use Fingerprint::Rabin::Internal qw(fp_signature fp_delta fp_patch
+				    fp_basis_random fp_basis_free);
+
+srand(1);
+sub noise { return join('', map { chr(int(rand(256))) } 1 .. shift) }
+
+my $BLOCK = 512;
+my $old = noise(200_000);
+my $sig = fp_signature($old, $BLOCK);
+
+sub round_trip {
+	my ($new, $name) = @_;
+	my $delta = fp_delta($sig, $new);
+
+	is(fp_patch($old, $delta), $new, $name);
+	return length($delta);
+}
+
+my $size = round_trip($old, 'unchanged text');
+ok($size < 100, "an unchanged text has a small delta ($size bytes)");
+
+my $new = $old;
+substr($new, 100_000, 10) = 'x' x 10;
+$size = round_trip($new, 'bytes changed in place');
+ok($size < 2 * $BLOCK, "a small change costs about a block ($size bytes)");
+
+$new = $old;
+substr($new, 50_001, 0) = 'inserted';
+$size = round_trip($new, 'bytes inserted, shifting later blocks');
+ok($size < 2 * $BLOCK, "an insertion costs about a block ($size bytes)");
+
+$new = $old;
+substr($new, 70_003, 1000) = '';
+round_trip($new, 'bytes deleted, shifting later blocks');
+
+$new = substr($old, 100_000) . substr($old, 0, 100_000);
+$size = round_trip($new, 'halves swapped');
+ok($size < 2 * $BLOCK, "moved blocks are copied ($size bytes)");
+
+round_trip(noise(10_000) . $old . noise(777), 'bytes added at both ends');
+round_trip(substr($old, 0, 199_999), 'short last block dropped');
+round_trip('', 'empty new text');
+round_trip(noise(300), 'new text shorter than a block');
+
+my $delta = fp_delta($sig, $new);
+ok(!eval { fp_patch(noise(200_000), $delta); 1 },
+   'a delta does not apply to another old text');
+substr($delta, -5, 1) ^= "\x01";
+ok(!eval { fp_patch($old, $delta); 1 }, 'a corrupted delta is rejected');
+
+my $basis = fp_basis_random(7);
+ok(!eval { fp_delta($sig, $old, $basis); 1 },
+   'a signature is only read with its own basis');
+fp_basis_free($basis);
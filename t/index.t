@@ -0,0 +1,61 @@
+use strict;
+use warnings;
+use Test::More tests => 13;
+use File::Temp qw(tempdir);
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_index_open fp_index_add
+				    fp_index_lookup fp_index_flush
+				    fp_index_compact fp_index_count
+				    fp_index_close);
+
+my $dir = tempdir(CLEANUP => 1);
+
+# Enough records to spill the table in memory into several segments,
+# and to merge some of them.
+my $N = 50_000;
+my @fp = map { fp_buffer("key $_") } 0 .. $N - 1;
+
+sub check {
+	my ($index, $replaced) = @_;
+	my $bad = 0;
+
+	for my $i (0 .. $N - 1) {
+		my @want = $i < $replaced ? ($i + 7, 1) : ($i, 2 * $i);
+		my @got = fp_index_lookup($index, $fp[$i]);
+		$bad++ unless "@got" eq "@want";
+	}
+	return $bad;
+}
+
+my $index = fp_index_open($dir);
+is_deeply([fp_index_lookup($index, $fp[0])], [], 'a new index is empty');
+fp_index_add($index, $fp[$_], $_, 2 * $_) for 0 .. $N - 1;
+is(check($index, 0), 0, 'every record is found before closing');
+
+# Replace the first records; the latest record wins.
+fp_index_add($index, $fp[$_], $_ + 7, 1) for 0 .. 999;
+is(check($index, 1000), 0, 'replaced records are found');
+ok(fp_index_count($index) >= $N, 'the count includes every record');
+fp_index_close($index);
+
+ok(-e "$dir/MANIFEST", 'the index has a manifest');
+$index = fp_index_open($dir);
+is(check($index, 1000), 0, 'every record is found after reopening');
+is_deeply([fp_index_lookup($index, fp_buffer('absent'))], [],
+	  'an absent fingerprint is not found');
+
+fp_index_compact($index);
+is(fp_index_count($index), $N, 'compaction merges replaced records away');
+is(check($index, 1000), 0, 'every record is found after compaction');
+
+fp_index_add($index, fp_buffer('late'), 1, 2);
+fp_index_flush($index);
+is_deeply([fp_index_lookup($index, fp_buffer('late'))], [1, 2],
+	  'a record added after compaction is found');
+fp_index_close($index);
+
+$index = fp_index_open($dir);
+is(fp_index_count($index), $N + 1, 'the count survives reopening');
+is_deeply([fp_index_lookup($index, fp_buffer('late'))], [1, 2],
+	  'a flushed record survives reopening');
+is(check($index, 1000), 0, 'every record is found in the reopened index');
+fp_index_close($index);
@@ -0,0 +1,60 @@
+use strict;
+use warnings;
+use Test::More tests => 10;
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_buffer_basis fp_to_hex
+				    fp_basis_random fp_basis_free
+				    fp_prefix_new fp_prefix_range
+				    fp_prefix_size fp_prefix_free);
+
+sub hex_of { return fp_to_hex($_[0]) }
+
+srand(2);
+my $text = pack('C*', map { int(rand(256)) } 1 .. 10_000);
+my $prefix = fp_prefix_new($text);
+
+is(fp_prefix_size($prefix), length($text), 'the size is that of the text');
+
+# Ranges of every length up to a few words, and long ones, at offsets
+# of every alignment.
+my @ranges = ([0, 0], [0, length($text)], [length($text), 0]);
+for my $offset (0 .. 17, 4093 .. 4100) {
+	push @ranges, [$offset, $_] for 0 .. 17, 1000, 5000;
+}
+push @ranges, map { my $i = int(rand(length($text)));
+		    [$i, int(rand(length($text) - $i + 1))] } 1 .. 500;
+
+my $bad = grep { hex_of(fp_prefix_range($prefix, @$_))
+		 ne hex_of(fp_buffer(substr($text, $_->[0], $_->[1]))) }
+	       @ranges;
+is($bad, 0, 'each range has the fingerprint of its bytes');
+
+is(hex_of(fp_prefix_range($prefix, 1234)),
+   hex_of(fp_buffer(substr($text, 1234))),
+   'a range without a length runs to the end');
+is(hex_of(fp_prefix_range($prefix, -100, 40)),
+   hex_of(fp_buffer(substr($text, -100, 40))),
+   'a negative offset counts from the end');
+
+ok(!eval { fp_prefix_range($prefix, length($text) + 1, 0); 1 },
+   'an offset past the end croaks');
+ok(!eval { fp_prefix_range($prefix, 10, length($text)); 1 },
+   'a length past the end croaks');
+fp_prefix_free($prefix);
+
+my $basis = fp_basis_random(42);
+$prefix = fp_prefix_new($text, $basis);
+$bad = grep { hex_of(fp_prefix_range($prefix, @$_))
+	      ne hex_of(fp_buffer_basis($basis,
+				       substr($text, $_->[0], $_->[1]))) }
+	    @ranges;
+is($bad, 0, 'ranges agree with fp_buffer_basis under another basis');
+isnt(hex_of(fp_prefix_range($prefix, 0, 100)),
+     hex_of(fp_buffer(substr($text, 0, 100))), 'the basis matters');
+fp_prefix_free($prefix);
+fp_basis_free($basis);
+
+$prefix = fp_prefix_new('');
+is(fp_prefix_size($prefix), 0, 'an empty text has size 0');
+is(hex_of(fp_prefix_range($prefix, 0)), hex_of(fp_buffer('')),
+   'the range of an empty text is the empty fingerprint');
+fp_prefix_free($prefix);
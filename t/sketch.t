@@ -0,0 +1,82 @@
+use strict;
+use warnings;
+use Test::More tests => 16;
+use Fingerprint::Rabin::Internal qw(fp_sketch_new fp_sketch_update
+				    fp_sketch_values fp_sketch_jaccard
+				    fp_sketch_reset fp_sketch_free);
+
+my $BOTTOM_K = 0;
+my $K_PERM = 1;
+
+sub per_bin {
+	my ($values) = @_;
+	my $k = @$values;
+
+	for my $i (0 .. $k - 1) {
+		my $v = $values->[$i];
+		next if ((($v >> 16) * $k) >> 16) == $i;
+		return 0 if $v != $values->[($i + 1) % $k];
+	}
+	return 1;
+}
+
+my $text = join(' ', map { "word$_" } 1 .. 5000);
+my $edited = join(' ', map { "word$_" } 1 .. 2500)
+	     . join(' ', map { " other$_" } 1 .. 2500);
+
+for my $kind ($BOTTOM_K, $K_PERM) {
+	my $name = $kind == $BOTTOM_K ? 'bottom-k' : 'k-permutation';
+	my $s1 = fp_sketch_new(8, 128, $kind);
+	my $s2 = fp_sketch_new(8, 128, $kind);
+	my $s3 = fp_sketch_new(8, 128, $kind);
+
+	fp_sketch_update($s1, $text);
+	fp_sketch_update($s2, substr($text, 0, 1000));
+	fp_sketch_update($s2, substr($text, 1000));
+	fp_sketch_update($s3, $edited);
+
+	my @values = fp_sketch_values($s1);
+	is(scalar(@values), 128, "$name: full sketch has k values");
+	is_deeply([fp_sketch_values($s2)], \@values,
+		  "$name: updating in pieces gives the same sketch");
+	if ($kind == $BOTTOM_K) {
+		is_deeply(\@values, [sort { $a <=> $b } @values],
+			  "$name: values are in increasing order");
+	} else {
+		# Each value is in its own bin, or is the value of the
+		# next bin because its own bin is empty.  A short text
+		# leaves bins empty.
+		my $d = fp_sketch_new(8, 128, $kind);
+		fp_sketch_update($d, substr($text, 0, 300));
+		ok(per_bin(\@values) && per_bin([fp_sketch_values($d)]),
+		   "$name: values are per bin");
+		fp_sketch_free($d);
+	}
+	is(fp_sketch_jaccard($s1, $s2), 1, "$name: equal texts estimate 1");
+	my $j = fp_sketch_jaccard($s1, $s3);
+	ok($j > 0.15 && $j < 0.6, "$name: half the text shared estimates about 1/3 ($j)");
+
+	fp_sketch_reset($s3);
+	fp_sketch_update($s3, 'short');
+	my @short = fp_sketch_values($s3);
+	ok(@short < 128, "$name: short text has fewer values");
+
+	fp_sketch_free($s1);
+	fp_sketch_free($s2);
+	fp_sketch_free($s3);
+
+	# The values of a sketch are sized by the sketch itself, however
+	# many there are.
+	my $big = fp_sketch_new(4, 4096, $kind);
+	fp_sketch_update($big, $text x 4);
+	@values = fp_sketch_values($big);
+	is(scalar(@values), 4096, "$name: large sketch has all its values");
+	fp_sketch_free($big);
+}
+
+my $x = fp_sketch_new(8, 64, $BOTTOM_K);
+my $y = fp_sketch_new(8, 64, $K_PERM);
+ok(!eval { fp_sketch_jaccard($x, $y); 1 }, 'sketches of different kinds do not compare');
+ok(!eval { fp_sketch_new(8, 64, 7); 1 }, 'unknown kind croaks');
+fp_sketch_free($x);
+fp_sketch_free($y);
@@ -0,0 +1,74 @@
+use strict;
+use warnings;
+use Test::More tests => 20;
+use File::Temp qw(tempdir);
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_compare fp_basis_random
+				    fp_basis_free fp_store_open fp_store_put
+				    fp_store_get fp_store_ref fp_store_unref
+				    fp_store_flush fp_store_compact
+				    fp_store_stats fp_store_close);
+
+my $dir = tempdir(CLEANUP => 1);
+
+# Chunks of 1 MB, enough of them to fill more than one 64 MB pack.
+my $CHUNKS = 80;
+sub chunk { my $i = shift; return pack('N', $i) x 262144 }
+
+my $store = fp_store_open($dir);
+my @fp = map { fp_store_put($store, chunk($_)) } 0 .. $CHUNKS - 1;
+
+ok(fp_compare($fp[7], fp_buffer(chunk(7))),
+   'put returns the fingerprint of the chunk');
+my ($chunks, $live, $total, $packs) = fp_store_stats($store);
+is($chunks, $CHUNKS, 'every chunk is stored');
+ok($packs >= 2, "chunks roll over into a new pack ($packs packs)");
+ok($live <= $total, 'live bytes do not exceed the pack bytes');
+
+my $bad = grep { ${fp_store_get($store, $fp[$_])} ne chunk($_) } 0 .. $CHUNKS - 1;
+is($bad, 0, 'every chunk reads back');
+ok(!defined fp_store_get($store, fp_buffer('absent')),
+   'an absent chunk reads as undef');
+
+fp_store_put($store, chunk(3));
+is(fp_store_ref($store, $fp[3]), 3, 'storing a chunk again adds a reference');
+is(fp_store_unref($store, $fp[3]), 2, 'unref drops a reference');
+ok(!defined fp_store_unref($store, fp_buffer('absent')),
+   'unref of an absent chunk is undef');
+
+# Forget most of the chunks in the first pack, keeping a few, and hold
+# a view of one of those across compaction.
+my %keep = map { $_ => 1 } 3, 10, 40, 70, 79;
+for my $i (grep { !$keep{$_} } 0 .. 60) {
+	1 while fp_store_unref($store, $fp[$i]);
+}
+ok(!defined fp_store_get($store, $fp[0]), 'a chunk with no references is gone');
+my $view = fp_store_get($store, $fp[10]);
+
+my $removed = fp_store_compact($store, 0.5);
+ok($removed >= 1, "compaction removes packs ($removed)");
+is($$view, chunk(10), 'a view held across compaction is unchanged');
+undef $view;
+($chunks, $live, $total, $packs) = fp_store_stats($store);
+is($chunks, $CHUNKS - 61 + 3, 'compaction keeps the live chunks');
+$bad = grep { ${fp_store_get($store, $fp[$_])} ne chunk($_) }
+	    keys %keep, 61 .. $CHUNKS - 1;
+is($bad, 0, 'live chunks read back after compaction');
+fp_store_close($store);
+
+$store = fp_store_open($dir);
+is((fp_store_stats($store))[0], $chunks, 'reopening keeps the chunks');
+$bad = grep { ${fp_store_get($store, $fp[$_])} ne chunk($_) }
+	    keys %keep, 61 .. $CHUNKS - 1;
+is($bad, 0, 'live chunks read back after reopening');
+ok(!defined fp_store_get($store, $fp[20]), 'forgotten chunks stay gone');
+is(fp_store_ref($store, $fp[3]), 3, 'reference counts survive reopening');
+fp_store_close($store);
+
+my $basis = fp_basis_random(42);
+ok(!eval { fp_store_open($dir, $basis); 1 },
+   'a store does not open with another basis');
+fp_basis_free($basis);
+
+$store = fp_store_open(tempdir(CLEANUP => 1));
+ok(!defined fp_store_get($store, $fp[3]), 'a new store is empty');
+fp_store_close($store);
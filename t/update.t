@@ -0,0 +1,78 @@
+use strict;
+use warnings;
+use Test::More tests => 8;
+use Fingerprint::Rabin;
+use Fingerprint::Rabin::Internal qw(fp_buffer fp_buffer_basis fp_to_hex
+				    fp_basis_random fp_basis_free
+				    fp_update_range);
+
+srand(3);
+my $text = pack('C*', map { int(rand(256)) } 1 .. 5000);
+
+# Overwrite LENGTH bytes of TEXT at OFFSET with random bytes, and
+# return whether updating its fingerprint FP, under BASIS if given,
+# gives the fingerprint of the edited text.
+sub edit_ok {
+	my ($text, $fp, $offset, $length, $basis) = @_;
+	my $old = substr($text, $offset, $length);
+	my $new = pack('C*', map { int(rand(256)) } 1 .. $length);
+	my $edited = $text;
+
+	substr($edited, $offset, $length) = $new;
+	if ($basis) {
+		return fp_to_hex(fp_update_range($fp, length($text), $offset,
+						 $old, $new, $basis))
+		       eq fp_to_hex(fp_buffer_basis($basis, $edited));
+	}
+	return fp_to_hex(fp_update_range($fp, length($text), $offset,
+					 $old, $new))
+	       eq fp_to_hex(fp_buffer($edited));
+}
+
+my $fp = fp_buffer($text);
+my @edits = ([0, 1], [0, 100], [4999, 1], [4900, 100], [0, 5000],
+	     [2500, 0]);
+push @edits, [$_, 1], [$_, 9] for 1 .. 40;
+push @edits, map { my $i = int(rand(5000));
+		   [$i, int(rand(5000 - $i + 1))] } 1 .. 200;
+
+my $bad = grep { !edit_ok($text, $fp, @$_) } @edits;
+is($bad, 0, 'an updated fingerprint is that of the edited text');
+
+my $basis = fp_basis_random(7);
+my $basis_fp = fp_buffer_basis($basis, $text);
+$bad = grep { !edit_ok($text, $basis_fp, @$_, $basis) } @edits;
+is($bad, 0, 'updates agree with fp_buffer_basis under another basis');
+fp_basis_free($basis);
+
+# Edits applied one after another.
+my $current = $text;
+my $current_fp = $fp;
+for my $offset (10, 2000, 10, 4990) {
+	my $new = 'x' x 10;
+
+	$current_fp = fp_update_range($current_fp, length($current), $offset,
+				      substr($current, $offset, 10), $new);
+	substr($current, $offset, 10) = $new;
+}
+is(fp_to_hex($current_fp), fp_to_hex(fp_buffer($current)),
+   'successive updates agree with the final text');
+
+is(fp_to_hex(fp_update_range($fp, 5000, 100, substr($text, 100, 50),
+			     substr($text, 100, 50))),
+   fp_to_hex($fp), 'replacing bytes with themselves changes nothing');
+
+my $object = Fingerprint::Rabin::new($text);
+my $edited = $text;
+substr($edited, 42, 3) = 'abc';
+is(Fingerprint::Rabin::update_range($object, 5000, 42,
+				    substr($text, 42, 3), 'abc')->to_hex,
+   Fingerprint::Rabin::new($edited)->to_hex,
+   'the update_range method agrees');
+
+ok(!eval { fp_update_range($fp, 5000, 10, 'ab', 'abc'); 1 },
+   'old and new of different lengths croak');
+ok(!eval { fp_update_range($fp, 5000, 4999, 'ab', 'cd'); 1 },
+   'a range past the end croaks');
+ok(!eval { fp_update_range($fp, 5000, 5001, '', ''); 1 },
+   'an offset past the end croaks');